@@ -0,0 +1,214 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* The minimum size of a block. Larger allocations get a block of their own. */
+#define ARENA_BLOCK_SIZE 16384
+
+/* The alignment of allocations, sufficient for any type */
+#define ARENA_ALIGNMENT (sizeof(union { void *p; long double d; long long l; }))
+
+typedef struct _arena_block_t {
+	struct _arena_block_t *next;
+	size_t size;
+	size_t used;
+	/* Aligned for any type, followed by size bytes of data */
+	union {
+		void *p;
+		long double d;
+		long long l;
+	} data[];
+} arena_block_t;
+
+struct _arena_t {
+	/* The amount of references held for this arena */
+	unsigned int refcount;
+	/* Blocks in use, the current one first */
+	arena_block_t *blocks;
+	/* Blocks retained by arena_reset(), available for reuse */
+	arena_block_t *free_blocks;
+	/* The most recent allocation, which can be resized in place */
+	void *last;
+};
+
+static void _blocks_free(arena_block_t *block)
+{
+	arena_block_t *next;
+	while(block != NULL) {
+		next = block->next;
+		free(block);
+		block = next;
+	}
+}
+
+/* Make a block with at least size bytes available the current block, reusing
+ * a retained one if possible. */
+static arena_block_t *_arena_grow(arena_t *arena, size_t size)
+{
+	arena_block_t **link;
+	arena_block_t *block;
+
+	for(link = &arena->free_blocks; *link != NULL; link = &(*link)->next) {
+		if((*link)->size >= size) {
+			break;
+		}
+	}
+	if(*link != NULL) {
+		block = *link;
+		*link = block->next;
+	} else {
+		if(size < ARENA_BLOCK_SIZE) {
+			size = ARENA_BLOCK_SIZE;
+		}
+		block = malloc(sizeof(*block) + size);
+		if(block == NULL) {
+			return NULL;
+		}
+		block->size = size;
+	}
+	block->used = 0;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	return block;
+}
+
+arena_t *arena_new()
+{
+	arena_t *arena;
+	arena = malloc(sizeof(*arena));
+	arena = memset(arena, 0, sizeof(*arena));
+	return arena_retain(arena);
+}
+
+arena_t *arena_retain(arena_t *arena)
+{
+	if(arena != NULL) {
+		arena->refcount++;
+	}
+	return arena;
+}
+
+void arena_release(arena_t *arena)
+{
+	if(arena != NULL) {
+		arena->refcount--;
+		if(arena->refcount == 0) {
+			_blocks_free(arena->blocks);
+			_blocks_free(arena->free_blocks);
+			free(arena);
+		}
+	}
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	arena_block_t *block;
+	void *ptr;
+
+	if(arena == NULL) {
+		return malloc(size);
+	}
+	block = arena->blocks;
+	size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+	if(block == NULL || block->size - block->used < size) {
+		block = _arena_grow(arena, size);
+		if(block == NULL) {
+			return NULL;
+		}
+	}
+	ptr = (char *)block->data + block->used;
+	block->used += size;
+	arena->last = ptr;
+	return ptr;
+}
+
+void arena_free(arena_t *arena, void *ptr)
+{
+	if(arena == NULL) {
+		free(ptr);
+	}
+}
+
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t size)
+{
+	arena_block_t *block;
+	size_t offset;
+	size_t rounded;
+	void *result;
+
+	if(arena == NULL) {
+		return realloc(ptr, size);
+	}
+	block = arena->blocks;
+	if(ptr != NULL && ptr == arena->last) {
+		offset = (char *)ptr - (char *)block->data;
+		rounded = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+		if(block->size - offset >= rounded) {
+			block->used = offset + rounded;
+			return ptr;
+		}
+	}
+	result = arena_alloc(arena, size);
+	if(result != NULL && ptr != NULL) {
+		memcpy(result, ptr, old_size < size ? old_size : size);
+	}
+	return result;
+}
+
+char *arena_strdup(arena_t *arena, const char *string)
+{
+	return arena_strndup(arena, string, strlen(string));
+}
+
+char *arena_strndup(arena_t *arena, const char *string, size_t length)
+{
+	char *copy;
+	const char *end;
+
+	end = memchr(string, '\0', length);
+	if(end != NULL) {
+		length = end - string;
+	}
+	copy = arena_alloc(arena, length + 1);
+	if(copy != NULL) {
+		memcpy(copy, string, length);
+		copy[length] = '\0';
+	}
+	return copy;
+}
+
+void arena_reset(arena_t *arena)
+{
+	arena_block_t *block;
+
+	while(arena->blocks != NULL) {
+		block = arena->blocks;
+		arena->blocks = block->next;
+		block->next = arena->free_blocks;
+		arena->free_blocks = block;
+	}
+	arena->last = NULL;
+}
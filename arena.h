@@ -0,0 +1,164 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/* File: arena.h
+A region allocator for short-lived data. Allocations are carved out of large
+blocks, and are never deallocated individually. Instead, the arena is reset
+once none of them is in use, which retains the blocks for subsequent
+allocations. An arena which has grown to its working size therefore no longer
+allocates.
+
+The allocation functions also accept a NULL arena, in which case they
+allocate from the heap as malloc() does. Code which may or may not be given
+an arena deallocates with <arena_free()>, which only has an effect in the
+latter case.
+
+Example:
+	(start code)
+	arena_t *arena = arena_new();
+	char *copy;
+
+	copy = arena_strdup(arena, "foo");
+	// Use copy, without deallocating it
+	arena_reset(arena);
+	arena_release(arena);
+	(end)
+*/
+
+#include <stddef.h>
+
+/* Type: arena_t
+An opaque data type representing an arena.
+*/
+typedef struct _arena_t arena_t;
+
+/* Constructor: arena_new
+Initialize and return a new, empty arena. The arena should be released with
+<arena_release()>.
+
+Returns:
+	An initialized arena, or NULL on error.
+*/
+arena_t *arena_new();
+
+/* Function: arena_retain
+Increment the arena's reference count.
+
+Parameters:
+	arena - A reference to the arena to be retained.
+
+Returns:
+	A reference to the arena.
+
+See Also:
+	<arena_release()>
+*/
+arena_t *arena_retain(arena_t *arena);
+
+/* Function: arena_release
+Decrement the arena's reference count. When it reaches 0 the arena is
+deallocated, together with every allocation made within it.
+
+Parameters:
+	arena - A reference to the arena to be released.
+
+See Also:
+	<arena_retain()>
+*/
+void arena_release(arena_t *arena);
+
+/* Function: arena_alloc
+Allocate memory within an arena. The memory is suitably aligned for any type.
+
+Parameters:
+	arena - The arena to allocate within.
+	size - The amount of bytes to be allocated.
+
+Returns:
+	A pointer to the allocated memory, which remains valid until the arena is
+	reset or deallocated. It must not be passed to free().
+*/
+void *arena_alloc(arena_t *arena, size_t size);
+
+/* Function: arena_free
+Deallocate memory allocated with a NULL arena. Memory allocated within an
+arena is left alone, as it is reclaimed when the arena is reset.
+
+Parameters:
+	arena - The arena ptr was allocated within, or NULL.
+	ptr - The memory to be deallocated, or NULL.
+*/
+void arena_free(arena_t *arena, void *ptr);
+
+/* Function: arena_realloc
+Resize memory allocated within an arena. The most recent allocation is
+resized in place if possible, otherwise the contents are moved.
+
+Parameters:
+	arena - The arena ptr was allocated within.
+	ptr - The memory to be resized, or NULL.
+	old_size - The current size of ptr.
+	size - The new size.
+
+Returns:
+	A pointer to the resized memory.
+*/
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t size);
+
+/* Function: arena_strdup
+Copy a string into an arena.
+
+Parameters:
+	arena - The arena to allocate within.
+	string - The string to be copied.
+
+Returns:
+	A copy of string, which must not be deallocated.
+*/
+char *arena_strdup(arena_t *arena, const char *string);
+
+/* Function: arena_strndup
+Copy at most length characters of a string into an arena. The copy is always
+NUL terminated.
+
+Parameters:
+	arena - The arena to allocate within.
+	string - The string to be copied.
+	length - The maximum amount of characters to be copied.
+
+Returns:
+	A copy of the string, which must not be deallocated.
+*/
+char *arena_strndup(arena_t *arena, const char *string, size_t length);
+
+/* Function: arena_reset
+Discard every allocation made within an arena, keeping its memory for reuse.
+
+Parameters:
+	arena - The arena to be reset.
+*/
+void arena_reset(arena_t *arena);
+
+#endif
@@ -0,0 +1,87 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: arena_test.c
+Unit tests for the region allocator.
+
+See Also:
+	<arena.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+void test_arena_alloc(void **state)
+{
+	arena_t *arena;
+	char *foo;
+	char *bar;
+	char *big;
+
+	arena = arena_new();
+	foo = arena_strdup(arena, "foo");
+	bar = arena_strndup(arena, "barbaz", 3);
+	big = arena_alloc(arena, 100000);
+	memset(big, 'x', 100000);
+
+	assert_string_equal(foo, "foo");
+	assert_string_equal(bar, "bar");
+	assert_true(((size_t)bar & (sizeof(void *) - 1)) == 0);
+	arena_release(arena);
+}
+
+void test_arena_realloc(void **state)
+{
+	arena_t *arena;
+	char *str;
+	char *grown;
+
+	arena = arena_new();
+	str = arena_strdup(arena, "foo");
+	/* The most recent allocation grows in place */
+	grown = arena_realloc(arena, str, 4, 64);
+	assert_true(grown == str);
+	arena_strdup(arena, "bar");
+	grown = arena_realloc(arena, str, 64, 128);
+	assert_true(grown != str);
+	assert_string_equal(grown, "foo");
+	arena_release(arena);
+}
+
+void test_arena_reset(void **state)
+{
+	arena_t *arena;
+	char *first;
+	char *second;
+
+	arena = arena_new();
+	first = arena_strdup(arena, "foo");
+	arena_reset(arena);
+	/* Memory is reused once the arena is reset */
+	second = arena_strdup(arena, "bar");
+	assert_true(first == second);
+	assert_string_equal(second, "bar");
+	arena_release(arena);
+}
@@ -0,0 +1,370 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+
+/* The amount of counters readers are spread over, to keep them from
+contending for a cache line */
+#define kCacheReaderSlots 64
+/* The amount of retired entries after which writers reclaim them */
+#define kCacheRetiredLimit 64
+
+/* Type: _node_t
+An entry of the cache.
+
+next - The next entry of the bucket, read by readers without locking.
+pkgbuild - The cached pkgbuild, which holds a reference.
+referenced - Set by readers, and cleared by the CLOCK hand of writers.
+slot - The index of the entry in the clock.
+key - The key of the entry.
+*/
+typedef struct _node_t {
+	struct _node_t *next;
+	pkgbuild_t *pkgbuild;
+	int referenced;
+	size_t slot;
+	char *key;
+} _node_t;
+
+/* Type: _reader_slot_t
+Counters of readers within a read-side critical section, one per parity of
+the grace period they entered in. Padded to a cache line.
+*/
+typedef struct {
+	unsigned int count[2];
+	char padding[64 - 2 * sizeof(unsigned int)];
+} _reader_slot_t;
+
+struct _pkgbuild_cache_t {
+	unsigned int refcount;
+	/* The buckets, whose heads and links are published atomically */
+	_node_t **buckets;
+	size_t mask;
+	/* Readers entering a critical section count themselves in the slot of
+	their thread, for the current parity. A writer reclaims retired entries
+	once it has flipped the parity and every count for the previous one has
+	dropped to 0. */
+	unsigned int parity;
+	_reader_slot_t readers[kCacheReaderSlots];
+	/* Guards the state below, which only writers access */
+	pthread_mutex_t mutex;
+	/* The entries, in the order of the CLOCK hand */
+	_node_t **clock;
+	size_t capacity;
+	size_t count;
+	size_t hand;
+	/* Entries unlinked from the buckets, not yet reclaimed */
+	_node_t **retired;
+	size_t retired_count;
+};
+
+/* The FNV-1a hash of a key. */
+static size_t _hash(const char *key)
+{
+	size_t hash = 2166136261u;
+
+	for(; *key != '\0'; key++) {
+		hash = (hash ^ (unsigned char)*key) * 16777619u;
+	}
+	return hash;
+}
+
+/* Select the reader counters of the calling thread. */
+static _reader_slot_t *_reader_slot(pkgbuild_cache_t *cache)
+{
+	size_t thread = (size_t)pthread_self();
+
+	return &cache->readers[(thread ^ (thread >> 12)) % kCacheReaderSlots];
+}
+
+/*
+Enter a read-side critical section, within which entries reachable from the
+buckets are not reclaimed.
+
+Returns:
+	The parity to be passed to <_cache_read_unlock()>.
+*/
+static unsigned int _cache_read_lock(pkgbuild_cache_t *cache,
+	_reader_slot_t *slot)
+{
+	unsigned int parity;
+
+	for(;;) {
+		parity = __atomic_load_n(&cache->parity, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&slot->count[parity], 1, __ATOMIC_SEQ_CST);
+		/* A writer flipping the parity in between may not have seen the
+		count, so the section is entered again */
+		if(__atomic_load_n(&cache->parity, __ATOMIC_SEQ_CST) == parity) {
+			return parity;
+		}
+		__atomic_sub_fetch(&slot->count[parity], 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void _cache_read_unlock(_reader_slot_t *slot, unsigned int parity)
+{
+	__atomic_sub_fetch(&slot->count[parity], 1, __ATOMIC_RELEASE);
+}
+
+/* Wait for every reader which may still see a retired entry, and reclaim
+the retired entries. The mutex must be held. */
+static void _cache_reclaim(pkgbuild_cache_t *cache)
+{
+	unsigned int parity;
+	size_t i;
+
+	if(cache->retired_count == 0) {
+		return;
+	}
+	parity = cache->parity;
+	__atomic_store_n(&cache->parity, !parity, __ATOMIC_SEQ_CST);
+	for(i = 0; i < kCacheReaderSlots; i++) {
+		while(__atomic_load_n(&cache->readers[i].count[parity],
+				__ATOMIC_ACQUIRE) != 0) {
+			sched_yield();
+		}
+	}
+	for(i = 0; i < cache->retired_count; i++) {
+		pkgbuild_release(cache->retired[i]->pkgbuild);
+		free(cache->retired[i]);
+	}
+	cache->retired_count = 0;
+}
+
+/* Retire an entry unlinked from its bucket. The mutex must be held. */
+static void _cache_retire(pkgbuild_cache_t *cache, _node_t *node)
+{
+	cache->retired[cache->retired_count++] = node;
+	if(cache->retired_count == kCacheRetiredLimit) {
+		_cache_reclaim(cache);
+	}
+}
+
+/*
+Unlink an entry from its bucket and the clock. The mutex must be held.
+
+Parameters:
+	cache - The cache.
+	link - The link to the entry, within its bucket.
+*/
+static void _cache_unlink(pkgbuild_cache_t *cache, _node_t **link)
+{
+	_node_t *node = *link;
+
+	__atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+	cache->count--;
+	cache->clock[node->slot] = cache->clock[cache->count];
+	cache->clock[node->slot]->slot = node->slot;
+	if(cache->hand >= cache->count) {
+		cache->hand = 0;
+	}
+	_cache_retire(cache, node);
+}
+
+/* Find the link to the entry of a key, or to the end of its bucket. */
+static _node_t **_cache_find(pkgbuild_cache_t *cache, const char *key)
+{
+	_node_t **link;
+
+	for(link = &cache->buckets[_hash(key) & cache->mask]; *link != NULL;
+			link = &(*link)->next) {
+		if(strcmp((*link)->key, key) == 0) {
+			break;
+		}
+	}
+	return link;
+}
+
+/* Evict the entry the CLOCK hand stops at, skipping and clearing those
+which were read since it last passed them. The mutex must be held. */
+static void _cache_evict(pkgbuild_cache_t *cache)
+{
+	_node_t *node;
+
+	for(;;) {
+		node = cache->clock[cache->hand];
+		if(!__atomic_exchange_n(&node->referenced, 0, __ATOMIC_RELAXED)) {
+			break;
+		}
+		cache->hand = (cache->hand + 1) % cache->count;
+	}
+	_cache_unlink(cache, _cache_find(cache, node->key));
+}
+
+pkgbuild_cache_t *pkgbuild_cache_new(size_t capacity)
+{
+	pkgbuild_cache_t *cache;
+	size_t buckets = 16;
+
+	if(capacity == 0) {
+		return NULL;
+	}
+	/* Buckets are never resized, so that readers need not be aware of it */
+	while(buckets < capacity * 2) {
+		buckets *= 2;
+	}
+	cache = calloc(1, sizeof(*cache));
+	cache->buckets = calloc(buckets, sizeof(*cache->buckets));
+	cache->mask = buckets - 1;
+	pthread_mutex_init(&cache->mutex, NULL);
+	cache->clock = malloc(capacity * sizeof(*cache->clock));
+	cache->capacity = capacity;
+	cache->retired = malloc(kCacheRetiredLimit * sizeof(*cache->retired));
+	return pkgbuild_cache_retain(cache);
+}
+
+pkgbuild_t *pkgbuild_cache_get(pkgbuild_cache_t *cache, const char *key)
+{
+	_reader_slot_t *slot;
+	pkgbuild_t *pkgbuild = NULL;
+	_node_t *node;
+	unsigned int parity;
+
+	if(cache == NULL || key == NULL) {
+		return NULL;
+	}
+	slot = _reader_slot(cache);
+	parity = _cache_read_lock(cache, slot);
+	node = __atomic_load_n(&cache->buckets[_hash(key) & cache->mask],
+		__ATOMIC_ACQUIRE);
+	while(node != NULL && strcmp(node->key, key) != 0) {
+		node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	}
+	if(node != NULL) {
+		/* Only written when clear, to keep the cache line shared */
+		if(!__atomic_load_n(&node->referenced, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&node->referenced, 1, __ATOMIC_RELAXED);
+		}
+		pkgbuild = pkgbuild_retain(node->pkgbuild);
+	}
+	_cache_read_unlock(slot, parity);
+	return pkgbuild;
+}
+
+void pkgbuild_cache_put(pkgbuild_cache_t *cache, const char *key,
+	pkgbuild_t *pkgbuild)
+{
+	_node_t **link;
+	_node_t *node;
+	size_t length;
+
+	if(cache == NULL || key == NULL || pkgbuild == NULL) {
+		return;
+	}
+	/* Readers on other threads must not load fields on access */
+	pkgbuild_load_fields(pkgbuild, kPkgbuildFieldAll);
+	pkgbuild_detach(pkgbuild);
+
+	length = strlen(key);
+	node = malloc(sizeof(*node) + length + 1);
+	node->key = (char *)(node + 1);
+	memcpy(node->key, key, length + 1);
+	node->pkgbuild = pkgbuild_retain(pkgbuild);
+	node->referenced = 0;
+
+	pthread_mutex_lock(&cache->mutex);
+	link = _cache_find(cache, key);
+	if(*link != NULL) {
+		_cache_unlink(cache, link);
+	} else if(cache->count == cache->capacity) {
+		_cache_evict(cache);
+		link = _cache_find(cache, key);
+	}
+	node->slot = cache->count;
+	cache->clock[cache->count++] = node;
+	/* The entry is complete before readers can reach it */
+	node->next = *link;
+	__atomic_store_n(link, node, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+int pkgbuild_cache_remove(pkgbuild_cache_t *cache, const char *key)
+{
+	_node_t **link;
+	int removed = 0;
+
+	if(cache == NULL || key == NULL) {
+		return 0;
+	}
+	pthread_mutex_lock(&cache->mutex);
+	link = _cache_find(cache, key);
+	if(*link != NULL) {
+		_cache_unlink(cache, link);
+		removed = 1;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	return removed;
+}
+
+size_t pkgbuild_cache_count(pkgbuild_cache_t *cache)
+{
+	size_t count;
+
+	if(cache == NULL) {
+		return 0;
+	}
+	pthread_mutex_lock(&cache->mutex);
+	count = cache->count;
+	pthread_mutex_unlock(&cache->mutex);
+	return count;
+}
+
+pkgbuild_cache_t *pkgbuild_cache_retain(pkgbuild_cache_t *cache)
+{
+	if(cache != NULL) {
+		__sync_add_and_fetch(&cache->refcount, 1);
+	}
+	return cache;
+}
+
+static void _cache_free(pkgbuild_cache_t *cache)
+{
+	size_t i;
+
+	for(i = 0; i < cache->count; i++) {
+		pkgbuild_release(cache->clock[i]->pkgbuild);
+		free(cache->clock[i]);
+	}
+	for(i = 0; i < cache->retired_count; i++) {
+		pkgbuild_release(cache->retired[i]->pkgbuild);
+		free(cache->retired[i]);
+	}
+	free(cache->retired);
+	free(cache->clock);
+	free(cache->buckets);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
+void pkgbuild_cache_release(pkgbuild_cache_t *cache)
+{
+	if(cache != NULL && __sync_sub_and_fetch(&cache->refcount, 1) == 0) {
+		_cache_free(cache);
+	}
+}
@@ -0,0 +1,156 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: cache_test.c
+Unit tests for caching pkgbuilds.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pkgparse.h"
+
+#define kReaders 4
+#define kKeys 32
+
+/* Parse a PKGBUILD of a package with a version. Its fields are loaded on
+access, until the cache loads them before sharing it. */
+static pkgbuild_t *_parse(const char *name, int version)
+{
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+	char contents[64];
+
+	snprintf(contents, sizeof(contents), "pkgname=%s\npkgver=%d\n", name,
+		version);
+	parser = pkgbuild_parser_new_with_options(kPkgbuildOptionLazy);
+	pkgbuild_parser_feed(parser, contents, strlen(contents));
+	pkgbuild = pkgbuild_parser_finish(parser);
+	pkgbuild_parser_release(parser);
+	return pkgbuild;
+}
+
+/* Insert a freshly parsed pkgbuild into a cache. */
+static void _put(pkgbuild_cache_t *cache, const char *name, int version)
+{
+	pkgbuild_t *pkgbuild;
+
+	pkgbuild = _parse(name, version);
+	pkgbuild_cache_put(cache, name, pkgbuild);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_cache_get_put(void **state)
+{
+	pkgbuild_cache_t *cache;
+	pkgbuild_t *pkgbuild;
+
+	assert_true(pkgbuild_cache_new(0) == NULL);
+	cache = pkgbuild_cache_new(2);
+	assert_true(pkgbuild_cache_get(cache, "foo") == NULL);
+	_put(cache, "foo", 1);
+	_put(cache, "bar", 1);
+	_put(cache, "foo", 2);
+	assert_int_equal(pkgbuild_cache_count(cache), 2);
+
+	/* A pkgbuild remains valid once replaced */
+	pkgbuild = pkgbuild_cache_get(cache, "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	_put(cache, "foo", 3);
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	pkgbuild_release(pkgbuild);
+
+	/* The pkgbuild looked up most recently survives an eviction */
+	pkgbuild_release(pkgbuild_cache_get(cache, "bar"));
+	_put(cache, "baz", 1);
+	assert_int_equal(pkgbuild_cache_count(cache), 2);
+	assert_true(pkgbuild_cache_get(cache, "foo") == NULL);
+	pkgbuild = pkgbuild_cache_get(cache, "bar");
+	assert_true(pkgbuild != NULL);
+	pkgbuild_release(pkgbuild);
+
+	assert_true(pkgbuild_cache_remove(cache, "bar"));
+	assert_false(pkgbuild_cache_remove(cache, "bar"));
+	assert_true(pkgbuild_cache_get(cache, "bar") == NULL);
+	assert_int_equal(pkgbuild_cache_count(cache), 1);
+	pkgbuild_cache_release(cache);
+}
+
+/* Look up every key many times, checking the pkgbuilds found. */
+static void *_read_cache(void *data)
+{
+	pkgbuild_cache_t *cache = data;
+	pkgbuild_t *pkgbuild;
+	char key[16];
+	long failures = 0;
+	int i;
+
+	for(i = 0; i < 20000; i++) {
+		snprintf(key, sizeof(key), "pkg%d", i % kKeys);
+		pkgbuild = pkgbuild_cache_get(cache, key);
+		if(pkgbuild != NULL) {
+			if(strcmp(pkgbuild_names(pkgbuild)[0], key) != 0) {
+				failures++;
+			}
+			pkgbuild_release(pkgbuild);
+		}
+	}
+	return (void *)failures;
+}
+
+void test_cache_concurrent(void **state)
+{
+	pthread_t readers[kReaders];
+	pkgbuild_cache_t *cache;
+	void *failures;
+	char key[16];
+	int i;
+
+	/* Fewer entries than keys, so that writers evict while readers look
+	up */
+	cache = pkgbuild_cache_new(kKeys / 2);
+	for(i = 0; i < kReaders; i++) {
+		assert_int_equal(pthread_create(&readers[i], NULL, _read_cache,
+			cache), 0);
+	}
+	for(i = 0; i < 2000; i++) {
+		snprintf(key, sizeof(key), "pkg%d", i % kKeys);
+		_put(cache, key, i);
+		if(i % 7 == 0) {
+			pkgbuild_cache_remove(cache, key);
+		}
+	}
+	for(i = 0; i < kReaders; i++) {
+		pthread_join(readers[i], &failures);
+		assert_true(failures == NULL);
+	}
+	assert_true(pkgbuild_cache_count(cache) <= kKeys / 2);
+	pkgbuild_cache_release(cache);
+}
@@ -0,0 +1,349 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "pkgparse.h"
+
+/* The amount of checksum arrays, one for each hash_algorithm_t */
+#define kChecksumAlgorithmCount 5
+
+/* The amount of bytes each digest is updated with at a time, so that every
+digest of a file is computed while the data is in the cache */
+#define kChecksumChunkSize (256 * 1024)
+
+/* Fields of the checksum arrays, indexed by their hash_algorithm_t */
+static const unsigned int _checksum_fields[kChecksumAlgorithmCount] = {
+	kPkgbuildFieldMd5sums, kPkgbuildFieldSha1sums, kPkgbuildFieldSha256sums,
+	kPkgbuildFieldSha384sums, kPkgbuildFieldSha512sums,
+};
+
+/* Type: _verification_t
+The sources of a pkgbuild being verified, shared by the threads verifying
+them.
+
+mutex - Guards next.
+next - The index of the next source to be verified.
+sources - The source array of the pkgbuild.
+source_count - The amount of sources.
+sums - The checksum arrays, indexed by their hash_algorithm_t, or NULL for
+	arrays which are not defined.
+sum_counts - The amount of checksums of each array.
+directory - The directory the sources have been downloaded to.
+results - The result of each source.
+*/
+typedef struct {
+	pthread_mutex_t mutex;
+	size_t next;
+	char **sources;
+	size_t source_count;
+	char **sums[kChecksumAlgorithmCount];
+	size_t sum_counts[kChecksumAlgorithmCount];
+	const char *directory;
+	pkgbuild_checksum_t *results;
+} _verification_t;
+
+/*
+Determine the name of the file a source is downloaded to, as makepkg does:
+the name before "::" if the source is renamed, and otherwise the last
+component of the URL, without a #fragment.
+
+Parameters:
+	source - The source entry.
+	length - Set to the length of the name.
+
+Returns:
+	A pointer to the name within source.
+*/
+static const char *_source_filename(const char *source, size_t *length)
+{
+	const char *end;
+	const char *start;
+
+	end = strstr(source, "::");
+	if(end != NULL) {
+		*length = end - source;
+		return source;
+	}
+	end = strchr(source, '#');
+	if(end == NULL) {
+		end = source + strlen(source);
+	}
+	while(end > source && end[-1] == '/') {
+		end--;
+	}
+	for(start = end; start > source && start[-1] != '/'; start--);
+	*length = end - start;
+	return start;
+}
+
+/* Compare a digest with a checksum written in hexadecimal. */
+static int _digest_matches(const unsigned char *digest, size_t length,
+	const char *sum)
+{
+	static const char digits[] = "0123456789abcdef";
+	char hex[2 * kHashMaxLength + 1];
+	size_t i;
+
+	if(strlen(sum) != 2 * length) {
+		return 0;
+	}
+	for(i = 0; i < length; i++) {
+		hex[2 * i] = digits[digest[i] >> 4];
+		hex[2 * i + 1] = digits[digest[i] & 0xf];
+	}
+	hex[2 * length] = '\0';
+	return strcasecmp(hex, sum) == 0;
+}
+
+/*
+Compute the digests of a file with several algorithms at once. The file is
+mapped into memory, or read if it cannot be mapped.
+
+Parameters:
+	path - The path to the file.
+	algorithms - A bit for each hash_algorithm_t to be computed.
+	digests - The buffers the digests are stored in, indexed by algorithm.
+
+Returns:
+	True (1) on success or false (0) if the file cannot be read.
+*/
+static int _hash_file(const char *path, unsigned int algorithms,
+	unsigned char digests[][kHashMaxLength])
+{
+	hash_t hashes[kChecksumAlgorithmCount];
+	struct stat st;
+	unsigned char *data;
+	unsigned char *buffer = NULL;
+	size_t offset;
+	size_t length;
+	ssize_t count;
+	int success = 1;
+	int fd;
+	int i;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return 0;
+	}
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return 0;
+	}
+	for(i = 0; i < kChecksumAlgorithmCount; i++) {
+		if(algorithms & (1u << i)) {
+			hash_init(&hashes[i], i);
+		}
+	}
+
+	data = MAP_FAILED;
+	if(st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	if(data != MAP_FAILED) {
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		for(offset = 0; offset < (size_t)st.st_size; offset += length) {
+			length = st.st_size - offset;
+			if(length > kChecksumChunkSize) {
+				length = kChecksumChunkSize;
+			}
+			for(i = 0; i < kChecksumAlgorithmCount; i++) {
+				if(algorithms & (1u << i)) {
+					hash_update(&hashes[i], data + offset, length);
+				}
+			}
+		}
+		munmap(data, st.st_size);
+	} else {
+		buffer = malloc(kChecksumChunkSize);
+		while((count = read(fd, buffer, kChecksumChunkSize)) > 0) {
+			for(i = 0; i < kChecksumAlgorithmCount; i++) {
+				if(algorithms & (1u << i)) {
+					hash_update(&hashes[i], buffer, count);
+				}
+			}
+		}
+		success = count == 0;
+		free(buffer);
+	}
+	close(fd);
+
+	/* Digests are finished even on error, releasing their state */
+	for(i = 0; i < kChecksumAlgorithmCount; i++) {
+		if(algorithms & (1u << i)) {
+			hash_final(&hashes[i], digests[i]);
+		}
+	}
+	return success;
+}
+
+/* Verify a source against each of its checksums. */
+static void _verify_source(_verification_t *verification, size_t index)
+{
+	unsigned char digests[kChecksumAlgorithmCount][kHashMaxLength];
+	pkgbuild_checksum_t *result = &verification->results[index];
+	const char *filename;
+	const char *sum;
+	unsigned int algorithms = 0;
+	size_t length;
+	char *path;
+	int i;
+
+	result->failed = 0;
+	for(i = 0; i < kChecksumAlgorithmCount; i++) {
+		if(verification->sums[i] == NULL) {
+			continue;
+		}
+		if(index >= verification->sum_counts[i]) {
+			/* The checksum array is shorter than the source array */
+			result->failed |= _checksum_fields[i];
+		} else if(strcmp(verification->sums[i][index], "SKIP") != 0) {
+			algorithms |= 1u << i;
+		}
+	}
+	if(algorithms == 0) {
+		result->status = result->failed ? kPkgbuildChecksumFailed
+			: kPkgbuildChecksumSkipped;
+		return;
+	}
+
+	filename = _source_filename(verification->sources[index], &length);
+	path = malloc(strlen(verification->directory) + length + 2);
+	sprintf(path, "%s/%.*s", verification->directory, (int)length, filename);
+	if(!_hash_file(path, algorithms, digests)) {
+		result->status = kPkgbuildChecksumMissing;
+		free(path);
+		return;
+	}
+	free(path);
+
+	for(i = 0; i < kChecksumAlgorithmCount; i++) {
+		if(!(algorithms & (1u << i))) {
+			continue;
+		}
+		sum = verification->sums[i][index];
+		if(!_digest_matches(digests[i], hash_length(i), sum)) {
+			result->failed |= _checksum_fields[i];
+		}
+	}
+	result->status = result->failed ? kPkgbuildChecksumFailed
+		: kPkgbuildChecksumPassed;
+}
+
+/* Verify sources until none are left. */
+static void *_verify_sources(void *data)
+{
+	_verification_t *verification = data;
+	size_t index;
+
+	for(;;) {
+		pthread_mutex_lock(&verification->mutex);
+		index = verification->next++;
+		pthread_mutex_unlock(&verification->mutex);
+		if(index >= verification->source_count) {
+			break;
+		}
+		_verify_source(verification, index);
+	}
+	return NULL;
+}
+
+/* Count the elements of an array, which may be NULL. */
+static size_t _array_length(char **array)
+{
+	size_t length = 0;
+	while(array != NULL && array[length] != NULL) {
+		length++;
+	}
+	return length;
+}
+
+int pkgbuild_verify_sources(pkgbuild_t *pkgbuild, const char *directory,
+	size_t threads, pkgbuild_checksum_t *results)
+{
+	_verification_t verification;
+	pthread_t *workers;
+	size_t worker_count = 0;
+	size_t i;
+	long cpus;
+	int failures = 0;
+
+	if(pkgbuild == NULL || directory == NULL || results == NULL) {
+		return -1;
+	}
+	memset(&verification, 0, sizeof(verification));
+	verification.sources = pkgbuild_sources(pkgbuild);
+	verification.source_count = _array_length(verification.sources);
+	verification.sums[kHashMd5] = pkgbuild_md5sums(pkgbuild);
+	verification.sums[kHashSha1] = pkgbuild_sha1sums(pkgbuild);
+	verification.sums[kHashSha256] = pkgbuild_sha256sums(pkgbuild);
+	verification.sums[kHashSha384] = pkgbuild_sha384sums(pkgbuild);
+	verification.sums[kHashSha512] = pkgbuild_sha512sums(pkgbuild);
+	for(i = 0; i < kChecksumAlgorithmCount; i++) {
+		verification.sum_counts[i] = _array_length(verification.sums[i]);
+	}
+	verification.directory = directory;
+	verification.results = results;
+	if(verification.source_count == 0) {
+		return 0;
+	}
+
+	if(threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (size_t)cpus : 1;
+	}
+	if(threads > verification.source_count) {
+		threads = verification.source_count;
+	}
+	pthread_mutex_init(&verification.mutex, NULL);
+	/* The calling thread verifies sources as well */
+	workers = malloc(threads * sizeof(*workers));
+	for(i = 1; i < threads; i++) {
+		if(pthread_create(&workers[worker_count], NULL, _verify_sources,
+				&verification) == 0) {
+			worker_count++;
+		}
+	}
+	_verify_sources(&verification);
+	for(i = 0; i < worker_count; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	pthread_mutex_destroy(&verification.mutex);
+
+	for(i = 0; i < verification.source_count; i++) {
+		if(results[i].status == kPkgbuildChecksumFailed
+				|| results[i].status == kPkgbuildChecksumMissing) {
+			failures++;
+		}
+	}
+	return failures;
+}
@@ -0,0 +1,99 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: checksum_test.c
+Unit tests for the verification of sources.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pkgparse.h"
+
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+
+void test_verify_sources(void **directory)
+{
+	pkgbuild_checksum_t results[5];
+	pkgbuild_t *pkgbuild;
+	FILE *fp;
+
+	write_pkgbuild_file(*directory, "foo.txt", "foo\n");
+	write_pkgbuild_file(*directory, "bar.txt", "bar\n");
+	write_pkgbuild_file(*directory, "renamed.txt", "foo\n");
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"source=(https://example.org/foo.txt\n"
+		"        renamed.txt::https://example.org/download?id=1\n"
+		"        https://example.org/bar.txt#sig\n"
+		"        git+https://example.org/foo.git\n"
+		"        https://example.org/missing.txt)\n"
+		"md5sums=(d3b07384d113edec49eaa6238ad5ff00\n"
+		"         D3B07384D113EDEC49EAA6238AD5FF00\n"
+		"         d3b07384d113edec49eaa6238ad5ff00\n"
+		"         SKIP\n"
+		"         SKIP)\n"
+		"sha1sums=(SKIP\n"
+		"          SKIP\n"
+		"          e242ed3bffccdf271b7fbaf34ed72d089537b42f\n"
+		"          SKIP\n"
+		"          e242ed3bffccdf271b7fbaf34ed72d089537b42f)\n"
+		"sha256sums=(b5bb9d8014a0f9b1d61e21e796d78dccdf1352f23cd32812f4850b878ae4944c)\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	assert_int_equal(pkgbuild_verify_sources(pkgbuild, *directory, 2, results),
+		4);
+	assert_int_equal(results[0].status, kPkgbuildChecksumPassed);
+	assert_int_equal(results[0].failed, 0);
+	/* The sha256sums array only covers the first source */
+	assert_int_equal(results[1].status, kPkgbuildChecksumFailed);
+	assert_int_equal(results[1].failed, kPkgbuildFieldSha256sums);
+	assert_int_equal(results[2].status, kPkgbuildChecksumFailed);
+	assert_int_equal(results[2].failed,
+		kPkgbuildFieldMd5sums | kPkgbuildFieldSha256sums);
+	assert_int_equal(results[3].status, kPkgbuildChecksumFailed);
+	assert_int_equal(results[4].status, kPkgbuildChecksumMissing);
+	pkgbuild_release(pkgbuild);
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"source=(https://example.org/foo.txt renamed.txt::foo)\n"
+		"md5sums=(d3b07384d113edec49eaa6238ad5ff00 SKIP)\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+	assert_int_equal(pkgbuild_verify_sources(pkgbuild, *directory, 0, results),
+		0);
+	assert_int_equal(results[0].status, kPkgbuildChecksumPassed);
+	assert_int_equal(results[1].status, kPkgbuildChecksumSkipped);
+	pkgbuild_release(pkgbuild);
+}
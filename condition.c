@@ -0,0 +1,877 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "condition.h"
+#include "utility.h"
+
+/* The most words a test is split into */
+#define kConditionMaxWords 64
+
+/* A word of a test */
+typedef struct {
+	/* The word as written */
+	char *raw;
+	/* The word after expansion and quote removal, or NULL if it is not
+	known */
+	char *value;
+	/* Whether the word refers to $CARCH */
+	int carch;
+	/* Whether any part of the word is quoted or escaped */
+	int quoted;
+	/* Whether the word contains an unquoted expansion, which is subject to
+	word splitting within [ ] */
+	int expanded;
+	/* Whether the word contains an unquoted operator character, such as '&'
+	or '(' */
+	int special;
+} _word_t;
+
+/* A test command being evaluated */
+typedef struct {
+	condition_context_t *context;
+	_word_t *words;
+	/* The words of the expression, excluding the brackets */
+	size_t start;
+	size_t end;
+	/* The word being evaluated */
+	size_t pos;
+	/* Whether the command is [[ ]], rather than [ ] */
+	int extended;
+	/* Whether the expression is malformed */
+	int error;
+} _test_t;
+
+/* The result of an expression */
+typedef struct {
+	condition_t result;
+	arch_test_t arch;
+} _value_t;
+
+static _value_t _or(_test_t *test);
+
+/* Whether a word refers to $CARCH. */
+static int _is_carch(const char *word)
+{
+	static const char *forms[] = {"$CARCH", "\"$CARCH\"", "${CARCH}",
+		"\"${CARCH}\"", NULL};
+	int i;
+
+	for(i = 0; forms[i] != NULL; i++) {
+		if(strcmp(word, forms[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* The length of the variable name at the start of a string. */
+static size_t _name_length(const char *start, const char *end)
+{
+	const char *ptr = start;
+
+	if(ptr >= end || !((*ptr >= 'a' && *ptr <= 'z') || (*ptr >= 'A' && *ptr <= 'Z')
+			|| *ptr == '_')) {
+		return 0;
+	}
+	for(ptr++; ptr < end && ((*ptr >= 'a' && *ptr <= 'z')
+		|| (*ptr >= 'A' && *ptr <= 'Z') || (*ptr >= '0' && *ptr <= '9')
+		|| *ptr == '_'); ptr++);
+	return ptr - start;
+}
+
+/* Whether the value of a variable is known. The architecture never is, since
+ * it is only set by makepkg. */
+static int _is_known(condition_context_t *context, const char *name,
+	size_t length)
+{
+	symbol_t *symbol;
+	char lvalue[64];
+	size_t i;
+
+	if(length >= sizeof(lvalue)) {
+		return 0;
+	}
+	memcpy(lvalue, name, length);
+	lvalue[length] = '\0';
+	if(strcmp(lvalue, "CARCH") == 0) {
+		return 0;
+	}
+	for(i = 0; i < context->unknown_count; i++) {
+		if(strcmp(context->unknown[i], lvalue) == 0) {
+			return 0;
+		}
+	}
+	symbol = table_lookupr(context->table, lvalue);
+	return symbol != NULL && symbol_type(symbol) != kSymbolTypeFunction;
+}
+
+/*
+Determine whether every variable a word refers to is known, and it executes no
+commands.
+
+Parameters:
+	context - The variables the word is evaluated with.
+	ptr - The first character of the word.
+	end - The character following the word.
+
+Returns:
+	True (1) if the word can be expanded, otherwise false (0).
+*/
+static int _is_expandable(condition_context_t *context, const char *ptr,
+	const char *end)
+{
+	const char *name;
+	const char *close;
+	size_t length;
+	int dquote = 0;
+	int depth;
+
+	for(; ptr < end; ptr++) {
+		if(*ptr == '\\') {
+			ptr++;
+			continue;
+		} else if(*ptr == '"') {
+			dquote = !dquote;
+			continue;
+		} else if(*ptr == '\'' && !dquote) {
+			close = memchr(ptr + 1, '\'', end - ptr - 1);
+			if(close == NULL) {
+				return 0;
+			}
+			ptr = close;
+			continue;
+		} else if(*ptr == '`') {
+			return 0;
+		} else if(*ptr != '$' || ptr + 1 >= end) {
+			continue;
+		}
+
+		ptr++;
+		if(*ptr == '(') {
+			return 0;
+		} else if(*ptr == '{') {
+			for(close = ptr + 1, depth = 1; close < end; close++) {
+				if(*close == '{') {
+					depth++;
+				} else if(*close == '}' && --depth == 0) {
+					break;
+				}
+			}
+			if(close >= end) {
+				return 0;
+			}
+			/* ${#var} is the length of var */
+			name = ptr[1] == '#' && ptr + 2 < close ? ptr + 2 : ptr + 1;
+			length = _name_length(name, close);
+			if(length == 0 || !_is_known(context, name, length)
+					|| !_is_expandable(context, name + length, close)) {
+				return 0;
+			}
+			ptr = close;
+		} else {
+			length = _name_length(ptr, end);
+			if(length > 0 && !_is_known(context, ptr, length)) {
+				return 0;
+			} else if(length == 0 && strchr("0123456789@*#?$!-", *ptr) != NULL) {
+				/* Positional and special parameters */
+				return 0;
+			}
+			/* The character following the name is examined next */
+			ptr += length;
+			ptr--;
+		}
+	}
+	return 1;
+}
+
+/* Escape the characters of significance to fnmatch() and to the separation
+ * of alternatives. */
+static char *_escape(arena_t *arena, const char *string)
+{
+	char *escaped;
+	char *ptr;
+
+	ptr = escaped = arena_alloc(arena, strlen(string) * 2 + 1);
+	for(; *string != '\0'; string++) {
+		if(strchr("*?[]\\|", *string) != NULL) {
+			*ptr++ = '\\';
+		}
+		*ptr++ = *string;
+	}
+	*ptr = '\0';
+	return escaped;
+}
+
+/*
+Determine the pattern a word stands for, where it is matched against, such as
+the right hand side of == within [[ ]] or a pattern of a case clause.
+
+Parameters:
+	context - The context the pattern is allocated within.
+	word - The word, which must be known.
+	glob - Whether unquoted characters are of significance to fnmatch().
+
+Returns:
+	The pattern, which must be deallocated using <arena_free()>.
+*/
+static char *_pattern(condition_context_t *context, _word_t *word, int glob)
+{
+	if(glob && !word->quoted) {
+		return arena_strdup(context->arena, word->value);
+	}
+	return _escape(context->arena, word->value);
+}
+
+/* Whether a word is a single quoted string, without escapes. Quotes are
+ * only removed reliably from such words, see <sh_parse_word()>. */
+static int _is_quoted_string(const char *word)
+{
+	const char *close;
+
+	if(*word != '\'' && *word != '"') {
+		return 0;
+	}
+	close = strchr(word + 1, *word);
+	return close != NULL && close[1] == '\0'
+		&& (*word == '\'' || memchr(word, '\\', close - word) == NULL);
+}
+
+/*
+Split a test into words, in place. Quoted strings and expansions are part of
+a word.
+
+Parameters:
+	string - The test, which is modified to terminate each word.
+	words - The array the words are stored in.
+	max - The size of words.
+
+Returns:
+	The amount of words, which is greater than max if there are too many.
+*/
+static size_t _split(char *string, _word_t *words, size_t max)
+{
+	_word_t *word;
+	char *ptr = string;
+	char quote;
+	int depth;
+	size_t count = 0;
+
+	for(;;) {
+		while(*ptr == ' ' || *ptr == '\t') {
+			ptr++;
+		}
+		if(*ptr == '\0') {
+			return count;
+		} else if(count == max) {
+			return max + 1;
+		}
+		word = &words[count++];
+		memset(word, 0, sizeof(*word));
+		word->raw = ptr;
+		quote = '\0';
+		depth = 0;
+		for(; *ptr != '\0'; ptr++) {
+			if(quote == '\'') {
+				if(*ptr == '\'') {
+					quote = '\0';
+				}
+			} else if(*ptr == '\\' && ptr[1] != '\0') {
+				word->quoted = 1;
+				ptr++;
+			} else if(quote == '"') {
+				if(*ptr == '"') {
+					quote = '\0';
+				}
+			} else if(*ptr == '\'' || *ptr == '"') {
+				word->quoted = 1;
+				quote = *ptr;
+			} else if(*ptr == '$' && (ptr[1] == '{' || ptr[1] == '(')) {
+				word->expanded |= depth == 0;
+				depth++;
+				ptr++;
+			} else if(*ptr == '$') {
+				word->expanded |= depth == 0;
+			} else if(depth > 0) {
+				depth -= *ptr == '}' || *ptr == ')';
+			} else if(*ptr == ' ' || *ptr == '\t') {
+				break;
+			} else if(strchr("&|()<>;", *ptr) != NULL) {
+				word->special = 1;
+			}
+		}
+		if(*ptr != '\0') {
+			*ptr++ = '\0';
+		}
+	}
+}
+
+/*
+Expand a word, if it is known.
+
+Parameters:
+	context - The variables the word is evaluated with.
+	word - The word, whose value is set.
+	split - Whether an unquoted expansion is subject to word splitting and
+		pathname expansion, in which case its value is only known if it is a
+		single word without special characters.
+*/
+static void _expand(condition_context_t *context, _word_t *word, int split)
+{
+	word->carch = _is_carch(word->raw);
+	if(word->raw[0] == '\\' && word->raw[1] != '\0' && word->raw[2] == '\0') {
+		/* An escaped operator of [ ], such as \( */
+		word->value = arena_strdup(context->arena, word->raw + 1);
+		return;
+	} else if(word->carch || (word->quoted && !_is_quoted_string(word->raw))
+			|| !_is_expandable(context, word->raw, word->raw + strlen(word->raw))) {
+		return;
+	}
+	word->value = sh_parse_word_with_arena(context->table, word->raw,
+		context->arena);
+	if(word->value != NULL && split && word->expanded
+			&& (*word->value == '\0' || strpbrk(word->value, " \t\n*?[") != NULL)) {
+		arena_free(context->arena, word->value);
+		word->value = NULL;
+	}
+}
+
+static _value_t _result(condition_t result)
+{
+	_value_t value;
+
+	value.result = result;
+	value.arch.pattern = NULL;
+	value.arch.match = 0;
+	return value;
+}
+
+static void _discard(condition_context_t *context, _value_t *value)
+{
+	if(value->result == kConditionArch) {
+		arena_free(context->arena, value->arch.pattern);
+	}
+}
+
+static _value_t _negate(_value_t value)
+{
+	if(value.result == kConditionTrue) {
+		value.result = kConditionFalse;
+	} else if(value.result == kConditionFalse) {
+		value.result = kConditionTrue;
+	} else if(value.result == kConditionArch) {
+		value.arch.match = !value.arch.match;
+	}
+	return value;
+}
+
+/*
+Combine the results of two expressions. Alternative matches of the
+architecture, such as $CARCH = i686 || $CARCH = x86_64, are merged into a
+single pattern, as are conjunctions of mismatches.
+
+Parameters:
+	context - The context the patterns are allocated within.
+	a - The result of the left hand side, which is consumed.
+	b - The result of the right hand side, which is consumed.
+	conjunction - Whether both (1), or either (0) must hold.
+
+Returns:
+	The combined result.
+*/
+static _value_t _combine(condition_context_t *context, _value_t a, _value_t b,
+	int conjunction)
+{
+	condition_t absorbing = conjunction ? kConditionFalse : kConditionTrue;
+	condition_t neutral = conjunction ? kConditionTrue : kConditionFalse;
+	_value_t value;
+	size_t length;
+
+	if(a.result == absorbing || b.result == neutral) {
+		_discard(context, &b);
+		return a;
+	} else if(b.result == absorbing || a.result == neutral) {
+		_discard(context, &a);
+		return b;
+	} else if(a.result == kConditionArch && b.result == kConditionArch
+			&& a.arch.match != conjunction && b.arch.match != conjunction) {
+		value = a;
+		length = strlen(a.arch.pattern);
+		value.arch.pattern = arena_alloc(context->arena,
+			length + strlen(b.arch.pattern) + 2);
+		memcpy(value.arch.pattern, a.arch.pattern, length);
+		value.arch.pattern[length] = '|';
+		strcpy(value.arch.pattern + length + 1, b.arch.pattern);
+		_discard(context, &a);
+		_discard(context, &b);
+		return value;
+	}
+	_discard(context, &a);
+	_discard(context, &b);
+	return _result(kConditionUnknown);
+}
+
+/* The word at a position within a test, as an operator, or NULL if it cannot
+ * be one. Operators of [[ ]] are recognised before expansion, those of [ ]
+ * after. */
+static const char *_operator(_test_t *test, size_t pos)
+{
+	_word_t *word;
+
+	if(pos >= test->end) {
+		return NULL;
+	}
+	word = &test->words[pos];
+	if(test->extended) {
+		return word->quoted || word->expanded ? NULL : word->raw;
+	}
+	return word->value;
+}
+
+static int _is_operator(_test_t *test, size_t pos, const char *op)
+{
+	const char *word = _operator(test, pos);
+	return word != NULL && strcmp(word, op) == 0;
+}
+
+/* Parse an integer operand, which must consist of nothing else. */
+static int _integer(const char *string, long *number)
+{
+	char *end;
+
+	if(string == NULL) {
+		return 0;
+	}
+	*number = strtol(string, &end, 10);
+	while(*end == ' ' || *end == '\t') {
+		end++;
+	}
+	return end != string && *end == '\0';
+}
+
+/* Evaluate a binary primary, such as "$a" = "$b". */
+static _value_t _compare(_test_t *test, _word_t *a, const char *op,
+	_word_t *b)
+{
+	condition_context_t *context = test->context;
+	int string = strcmp(op, "=") == 0 || strcmp(op, "==") == 0
+		|| strcmp(op, "!=") == 0;
+	int negate = strcmp(op, "!=") == 0;
+	_value_t value = _result(kConditionUnknown);
+	char *pattern;
+	long x;
+	long y;
+	int holds;
+
+	if(a->carch || b->carch) {
+		/* Whether the architecture is matched against a pattern depends on
+		which side refers to it */
+		if(!string || (a->carch && b->carch) || (a->carch ? b : a)->value == NULL) {
+			return value;
+		}
+		value.result = kConditionArch;
+		value.arch.pattern = _pattern(context, a->carch ? b : a,
+			test->extended && a->carch);
+		value.arch.match = !negate;
+		return value;
+	} else if(a->value == NULL || b->value == NULL) {
+		return value;
+	}
+
+	if(string) {
+		pattern = _pattern(context, b, test->extended);
+		holds = fnmatch(pattern, a->value, 0) == 0;
+		arena_free(context->arena, pattern);
+		value.result = holds != negate ? kConditionTrue : kConditionFalse;
+		return value;
+	} else if(strcmp(op, "<") == 0 || strcmp(op, ">") == 0) {
+		holds = (strcmp(a->value, b->value) < 0) == (op[0] == '<')
+			&& strcmp(a->value, b->value) != 0;
+		value.result = holds ? kConditionTrue : kConditionFalse;
+		return value;
+	} else if(op[0] != '-' || !_integer(a->value, &x) || !_integer(b->value, &y)) {
+		/* Regular expressions and file comparisons are left to bash */
+		return value;
+	}
+
+	if(strcmp(op, "-eq") == 0) {
+		holds = x == y;
+	} else if(strcmp(op, "-ne") == 0) {
+		holds = x != y;
+	} else if(strcmp(op, "-lt") == 0) {
+		holds = x < y;
+	} else if(strcmp(op, "-le") == 0) {
+		holds = x <= y;
+	} else if(strcmp(op, "-gt") == 0) {
+		holds = x > y;
+	} else if(strcmp(op, "-ge") == 0) {
+		holds = x >= y;
+	} else {
+		return value;
+	}
+	value.result = holds ? kConditionTrue : kConditionFalse;
+	return value;
+}
+
+static int _is_binary(const char *op)
+{
+	static const char *operators[] = {"=", "==", "!=", "<", ">", "=~", "-eq",
+		"-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL};
+	int i;
+
+	for(i = 0; op != NULL && operators[i] != NULL; i++) {
+		if(strcmp(op, operators[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Evaluate a primary: a binary comparison, a unary test or a single word. */
+static _value_t _primary(_test_t *test)
+{
+	_word_t *words = test->words;
+	size_t pos = test->pos;
+	const char *op;
+
+	if(pos >= test->end) {
+		test->error = 1;
+		return _result(kConditionUnknown);
+	}
+
+	op = _operator(test, pos + 1);
+	if(pos + 2 < test->end && _is_binary(op)) {
+		test->pos += 3;
+		return _compare(test, &words[pos], op, &words[pos + 2]);
+	}
+
+	op = _operator(test, pos);
+	if(pos + 1 < test->end && op != NULL && op[0] == '-' && op[1] != '\0'
+			&& op[2] == '\0') {
+		test->pos += 2;
+		if(op[1] != 'n' && op[1] != 'z') {
+			/* Files and options are left to bash */
+			return _result(kConditionUnknown);
+		} else if(words[pos + 1].carch) {
+			/* makepkg always sets the architecture */
+			return _result(op[1] == 'n' ? kConditionTrue : kConditionFalse);
+		} else if(words[pos + 1].value == NULL) {
+			return _result(kConditionUnknown);
+		}
+		return _result((words[pos + 1].value[0] != '\0') == (op[1] == 'n')
+			? kConditionTrue : kConditionFalse);
+	}
+
+	test->pos++;
+	if(words[pos].carch) {
+		return _result(kConditionTrue);
+	} else if(words[pos].value == NULL) {
+		return _result(kConditionUnknown);
+	}
+	return _result(words[pos].value[0] != '\0' ? kConditionTrue : kConditionFalse);
+}
+
+static _value_t _not(_test_t *test)
+{
+	_value_t value;
+
+	if(_is_operator(test, test->pos, "!") && test->pos + 1 < test->end) {
+		test->pos++;
+		return _negate(_not(test));
+	} else if(_is_operator(test, test->pos, "(")) {
+		test->pos++;
+		value = _or(test);
+		if(_is_operator(test, test->pos, ")")) {
+			test->pos++;
+		} else {
+			test->error = 1;
+		}
+		return value;
+	}
+	return _primary(test);
+}
+
+static _value_t _and(_test_t *test)
+{
+	const char *op = test->extended ? "&&" : "-a";
+	_value_t value;
+
+	value = _not(test);
+	while(!test->error && _is_operator(test, test->pos, op)) {
+		test->pos++;
+		value = _combine(test->context, value, _not(test), 1);
+	}
+	return value;
+}
+
+static _value_t _or(_test_t *test)
+{
+	const char *op = test->extended ? "||" : "-o";
+	_value_t value;
+
+	value = _and(test);
+	while(!test->error && _is_operator(test, test->pos, op)) {
+		test->pos++;
+		value = _combine(test->context, value, _and(test), 0);
+	}
+	return value;
+}
+
+/* Whether a word is an operator of [[ ]] containing special characters. */
+static int _is_list_operator(const char *word)
+{
+	static const char *operators[] = {"&&", "||", "(", ")", "<", ">", NULL};
+	int i;
+
+	for(i = 0; operators[i] != NULL; i++) {
+		if(strcmp(word, operators[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Evaluate the expression of a test command, between start and end. */
+static _value_t _evaluate(condition_context_t *context, _word_t *words,
+	size_t start, size_t end, int extended)
+{
+	_test_t test;
+	_value_t value;
+	size_t i;
+
+	for(i = start; i < end; i++) {
+		_expand(context, &words[i], !extended);
+		if(words[i].special && !(extended && _is_list_operator(words[i].raw))) {
+			/* Redirections, or operators not separated by blanks */
+			return _result(kConditionUnknown);
+		} else if(!extended && words[i].value == NULL && !words[i].carch) {
+			/* The words test receives are not known */
+			return _result(kConditionUnknown);
+		}
+	}
+
+	test.context = context;
+	test.words = words;
+	test.start = start;
+	test.end = end;
+	test.pos = start;
+	test.extended = extended;
+	test.error = 0;
+	value = _or(&test);
+	if(test.error || test.pos != end) {
+		_discard(context, &value);
+		return _result(kConditionUnknown);
+	}
+	return value;
+}
+
+condition_t condition_test(condition_context_t *context, char *command,
+	arch_test_t *arch)
+{
+	_word_t words[kConditionMaxWords];
+	_value_t value = _result(kConditionUnknown);
+	_value_t result;
+	const char *close;
+	char *string;
+	size_t count;
+	size_t start;
+	size_t end;
+	size_t i;
+	int conjunction = -1;
+
+	string = arena_strdup(context->arena, command);
+	count = _split(string, words, kConditionMaxWords);
+	if(count > kConditionMaxWords) {
+		arena_free(context->arena, string);
+		return kConditionUnknown;
+	}
+
+	/* Commands joined by && and || are evaluated from left to right */
+	for(start = 0; start < count; start = end + 2) {
+		if(strcmp(words[start].raw, "[") == 0) {
+			close = "]";
+		} else if(strcmp(words[start].raw, "[[") == 0) {
+			close = "]]";
+		} else {
+			break;
+		}
+		for(end = start + 1; end < count && strcmp(words[end].raw, close) != 0; end++);
+		if(end >= count) {
+			break;
+		}
+		result = _evaluate(context, words, start + 1, end, close[1] != '\0');
+		value = conjunction < 0 ? result
+			: _combine(context, value, result, conjunction);
+		if(end + 1 == count) {
+			conjunction = 2;
+			break;
+		} else if(strcmp(words[end + 1].raw, "&&") == 0) {
+			conjunction = 1;
+		} else if(strcmp(words[end + 1].raw, "||") == 0) {
+			conjunction = 0;
+		} else {
+			break;
+		}
+	}
+	/* The commands did not end as expected */
+	if(conjunction != 2) {
+		_discard(context, &value);
+		value = _result(kConditionUnknown);
+	}
+
+	for(i = 0; i < count; i++) {
+		arena_free(context->arena, words[i].value);
+	}
+	arena_free(context->arena, string);
+	if(value.result == kConditionArch) {
+		*arch = value.arch;
+	}
+	return value.result;
+}
+
+condition_t condition_case(condition_context_t *context, char *subject,
+	char *patterns, arch_test_t *arch)
+{
+	_word_t words[kConditionMaxWords];
+	_word_t word;
+	condition_t result = kConditionUnknown;
+	char *string;
+	char *ptr;
+	char *pattern = NULL;
+	char *alternative;
+	char *joined;
+	char quote = '\0';
+	size_t count = 0;
+	size_t length = 0;
+	size_t i;
+	int known = 1;
+
+	/* Split the alternatives at each unquoted '|' */
+	string = arena_strdup(context->arena, patterns);
+	for(ptr = string; ; ptr++) {
+		if(count == 0 || ptr[-1] == '\0') {
+			if(count == kConditionMaxWords) {
+				known = 0;
+				break;
+			}
+			memset(&words[count], 0, sizeof(words[count]));
+			words[count++].raw = ptr;
+		}
+		if(*ptr == '\0') {
+			break;
+		} else if(quote == '\'') {
+			quote = *ptr == quote ? '\0' : quote;
+		} else if(*ptr == '\\' && ptr[1] != '\0') {
+			words[count - 1].quoted = 1;
+			ptr++;
+		} else if(quote != '\0') {
+			quote = *ptr == quote ? '\0' : quote;
+		} else if(*ptr == '\'' || *ptr == '"') {
+			words[count - 1].quoted = 1;
+			quote = *ptr;
+		} else if(*ptr == '|') {
+			*ptr = '\0';
+		}
+	}
+
+	for(i = 0; i < count && known; i++) {
+		/* Blanks around the alternatives are insignificant */
+		for(alternative = words[i].raw; *alternative == ' ' || *alternative == '\t';
+			alternative++);
+		for(ptr = alternative + strlen(alternative); ptr > alternative
+			&& (ptr[-1] == ' ' || ptr[-1] == '\t'); ptr--);
+		*ptr = '\0';
+		words[i].raw = alternative;
+		_expand(context, &words[i], 0);
+		if(words[i].value == NULL) {
+			known = 0;
+			break;
+		}
+		alternative = _pattern(context, &words[i], 1);
+		joined = arena_alloc(context->arena, length + strlen(alternative) + 2);
+		if(pattern != NULL) {
+			memcpy(joined, pattern, length);
+			joined[length++] = '|';
+			arena_free(context->arena, pattern);
+		}
+		strcpy(joined + length, alternative);
+		length += strlen(alternative);
+		arena_free(context->arena, alternative);
+		pattern = joined;
+	}
+
+	memset(&word, 0, sizeof(word));
+	word.raw = subject;
+	_expand(context, &word, 0);
+	if(!known) {
+		arena_free(context->arena, pattern);
+	} else if(word.carch) {
+		result = kConditionArch;
+		arch->pattern = pattern;
+		arch->match = 1;
+	} else if(word.value != NULL) {
+		result = condition_match(pattern, word.value) ? kConditionTrue
+			: kConditionFalse;
+		arena_free(context->arena, pattern);
+	} else {
+		arena_free(context->arena, pattern);
+	}
+
+	for(i = 0; i < count; i++) {
+		arena_free(context->arena, words[i].value);
+	}
+	arena_free(context->arena, word.value);
+	arena_free(context->arena, string);
+	return result;
+}
+
+int condition_match(const char *patterns, const char *string)
+{
+	const char *start;
+	const char *ptr;
+	char *alternative;
+	int matched = 0;
+
+	if(strchr(patterns, '|') == NULL) {
+		return fnmatch(patterns, string, 0) == 0;
+	}
+
+	alternative = malloc(strlen(patterns) + 1);
+	for(start = ptr = patterns; !matched; ptr++) {
+		if(*ptr == '\\' && ptr[1] != '\0') {
+			ptr++;
+		} else if(*ptr == '|' || *ptr == '\0') {
+			memcpy(alternative, start, ptr - start);
+			alternative[ptr - start] = '\0';
+			matched = fnmatch(alternative, string, 0) == 0;
+			if(*ptr == '\0') {
+				break;
+			}
+			start = ptr + 1;
+		}
+	}
+	free(alternative);
+	return matched;
+}
@@ -0,0 +1,124 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef CONDITION_H
+#define CONDITION_H
+
+/* File: condition.h
+Evaluation of the tests of conditionals, such as [ -n "$_flavor" ] or the
+patterns of a case clause. A test is only evaluated when it depends on nothing
+but variables of the PKGBUILD whose values are known. Comparisons of $CARCH
+are not evaluated, but reduced to a pattern the architecture has to match, so
+that every architecture is covered by a single parse.
+*/
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "pkgbuild_private.h"
+#include "symbol.h"
+
+/* Enumeration: condition_t
+The result of a test.
+
+kConditionUnknown - The test depends on something other than known variables,
+	such as files or commands.
+kConditionTrue - The test holds.
+kConditionFalse - The test does not hold.
+kConditionArch - The test holds for the architectures matched by an
+	<arch_test_t>.
+*/
+typedef enum {
+	kConditionUnknown,
+	kConditionTrue,
+	kConditionFalse,
+	kConditionArch,
+} condition_t;
+
+/* Type: condition_context_t
+The variables tests are evaluated with.
+
+table - The namespace variables are looked up in.
+unknown - The names of variables whose values are not known, although they
+	may be defined within table, such as those assigned within a branch which
+	only applies to some architectures.
+unknown_count - The amount of names in unknown.
+arena - The arena results are allocated within, or NULL.
+*/
+typedef struct {
+	table_t *table;
+	char **unknown;
+	size_t unknown_count;
+	arena_t *arena;
+} condition_context_t;
+
+/* Function: condition_test
+Evaluate the test of an if or elif clause. Test commands, "[ expression ]"
+and "[[ expression ]]", are supported, optionally joined by "&&" and "||".
+Within the expressions, string comparisons, integer comparisons, -n, -z, "!",
+grouping and the "-a" and "-o" or "&&" and "||" operators are evaluated.
+
+Parameters:
+	context - The variables the test is evaluated with.
+	command - The test commands, including their brackets.
+	arch - The address where the test on the architecture is stored, if the
+		result is <kConditionArch>. Its pattern is allocated within the arena
+		of the context.
+
+Returns:
+	The result of the test.
+*/
+condition_t condition_test(condition_context_t *context, char *command,
+	arch_test_t *arch);
+
+/* Function: condition_case
+Evaluate whether an item of a case clause matches.
+
+Parameters:
+	context - The variables the patterns are evaluated with.
+	subject - The word following "case", as written.
+	patterns - The patterns of the item, as written and separated by '|',
+		without the closing parenthesis.
+	arch - The address where the test on the architecture is stored, if the
+		result is <kConditionArch>. Its pattern is allocated within the arena
+		of the context.
+
+Returns:
+	The result of the match.
+*/
+condition_t condition_case(condition_context_t *context, char *subject,
+	char *patterns, arch_test_t *arch);
+
+/* Function: condition_match
+Match a string against alternative shell patterns.
+
+Parameters:
+	patterns - Patterns separated by '|'. A '|' which is part of a pattern is
+		escaped with a backslash.
+	string - The string to be matched.
+
+Returns:
+	True (1) if any of the patterns matches, otherwise false (0).
+*/
+int condition_match(const char *patterns, const char *string);
+
+#endif
@@ -0,0 +1,165 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: condition_test.c
+Unit tests for the evaluation of tests.
+
+See Also:
+	<condition.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "condition.h"
+
+void test_condition_test(void **table)
+{
+	struct {
+		char *command;
+		condition_t expected;
+	} cases[] = {
+		{"[ \"$foo\" = foobar ]", kConditionTrue},
+		{"[ $foo != foobar ]", kConditionFalse},
+		{"[ -n \"$foo\" ]", kConditionTrue},
+		{"[ -z \"${foo%bar}\" ]", kConditionFalse},
+		{"[ \"$ham\" ]", kConditionTrue},
+		{"[ $ham = x ]", kConditionUnknown},
+		{"[ \"$nothing\" = x ]", kConditionUnknown},
+		{"[ -f \"$foo\" ]", kConditionUnknown},
+		{"[ \"$(uname)\" = Linux ]", kConditionUnknown},
+		{"[ ${#foo} -eq 6 -a $_eggs = chickens ]", kConditionTrue},
+		{"[ ! \\( x = y -o 1 -gt 2 \\) ]", kConditionTrue},
+		{"[[ $foo == foo* ]]", kConditionTrue},
+		{"[[ $foo == \"foo*\" ]]", kConditionFalse},
+		{"[[ $ham == *and* && ( -z $foo || -n $foo ) ]]", kConditionTrue},
+		{"[[ -f $foo || $foo == foobar ]]", kConditionTrue},
+		{"[[ -f $foo && $foo == x ]]", kConditionFalse},
+		{"[[ $foo =~ ^f ]]", kConditionUnknown},
+		{"[ $foo = x ] || [[ $_eggs < d ]]", kConditionTrue},
+		{"[ $foo = foobar ] && [ -d /usr ]", kConditionUnknown},
+		{"[ $foo = foobar ]&&[ x ]", kConditionUnknown},
+		{NULL, kConditionUnknown},
+	};
+	condition_context_t context;
+	arch_test_t arch;
+	int i;
+
+	context.table = *table;
+	context.unknown = NULL;
+	context.unknown_count = 0;
+	context.arena = NULL;
+	for(i = 0; cases[i].command != NULL; i++) {
+		assert_int_equal(condition_test(&context, cases[i].command, &arch),
+			cases[i].expected);
+	}
+}
+
+void test_condition_test_unknown(void **table)
+{
+	char *unknown[] = {"foo"};
+	condition_context_t context;
+	arch_test_t arch;
+
+	context.table = *table;
+	context.unknown = unknown;
+	context.unknown_count = 1;
+	context.arena = NULL;
+	assert_int_equal(condition_test(&context, "[ $foo = foobar ]", &arch),
+		kConditionUnknown);
+	assert_int_equal(condition_test(&context, "[ $_eggs = chickens ]", &arch),
+		kConditionTrue);
+}
+
+void test_condition_test_arch(void **table)
+{
+	condition_context_t context;
+	arch_test_t arch;
+
+	context.table = *table;
+	context.unknown = NULL;
+	context.unknown_count = 0;
+	context.arena = NULL;
+
+	assert_int_equal(condition_test(&context, "[ \"$CARCH\" = 'x86_64' ]", &arch),
+		kConditionArch);
+	assert_string_equal(arch.pattern, "x86_64");
+	assert_int_equal(arch.match, 1);
+	free(arch.pattern);
+
+	assert_int_equal(condition_test(&context,
+		"[[ $CARCH == arm* || $CARCH == i686 ]]", &arch), kConditionArch);
+	assert_string_equal(arch.pattern, "arm*|i686");
+	assert_int_equal(arch.match, 1);
+	free(arch.pattern);
+
+	assert_int_equal(condition_test(&context,
+		"[ $CARCH != i686 ] && [ \"${CARCH}\" != \"pen*\" ]", &arch),
+		kConditionArch);
+	assert_string_equal(arch.pattern, "i686|pen\\*");
+	assert_int_equal(arch.match, 0);
+	free(arch.pattern);
+
+	assert_int_equal(condition_test(&context,
+		"[[ $foo == foobar && $CARCH == i686 ]]", &arch), kConditionArch);
+	assert_string_equal(arch.pattern, "i686");
+	free(arch.pattern);
+
+	assert_int_equal(condition_test(&context,
+		"[ $CARCH = i686 -a -f /etc/foo ]", &arch), kConditionUnknown);
+}
+
+void test_condition_case(void **table)
+{
+	condition_context_t context;
+	arch_test_t arch;
+
+	context.table = *table;
+	context.unknown = NULL;
+	context.unknown_count = 0;
+	context.arena = NULL;
+
+	assert_int_equal(condition_case(&context, "$foo", "bar | foo*", &arch),
+		kConditionTrue);
+	assert_int_equal(condition_case(&context, "\"$ham\"", "'eggs*'", &arch),
+		kConditionFalse);
+	assert_int_equal(condition_case(&context, "$nothing", "*", &arch),
+		kConditionUnknown);
+	assert_int_equal(condition_case(&context, "$foo", "$(echo foo)", &arch),
+		kConditionUnknown);
+
+	assert_int_equal(condition_case(&context, "\"$CARCH\"", "i?86|\"arm*\"",
+		&arch), kConditionArch);
+	assert_string_equal(arch.pattern, "i?86|arm\\*");
+	assert_int_equal(arch.match, 1);
+	free(arch.pattern);
+}
+
+void test_condition_match(void **state)
+{
+	assert_true(condition_match("x86_64", "x86_64"));
+	assert_false(condition_match("x86_64", "i686"));
+	assert_true(condition_match("i686|arm*", "armv7h"));
+	assert_false(condition_match("i686|arm\\*", "armv7h"));
+	assert_true(condition_match("a\\|b", "a|b"));
+}
@@ -0,0 +1,432 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+#include "symbol.h"
+#include "utility.h"
+
+/* Type: _names_t
+A set of variable names, in order of insertion.
+
+names - The names, which are owned by the derivations they come from.
+count - The amount of names.
+*/
+typedef struct {
+	const char **names;
+	size_t count;
+} _names_t;
+
+static void _free_array(char **array)
+{
+	size_t i;
+
+	if(array != NULL) {
+		for(i = 0; array[i] != NULL; i++) {
+			free(array[i]);
+		}
+		free(array);
+	}
+}
+
+/* Add a name to a set, unless it is already included. Returns true (1) if it
+ * was added. */
+static int _names_add(_names_t *set, const char *name)
+{
+	size_t i;
+
+	for(i = 0; i < set->count; i++) {
+		if(strcmp(set->names[i], name) == 0) {
+			return 0;
+		}
+	}
+	set->names = realloc(set->names, (set->count + 1) * sizeof(*set->names));
+	set->names[set->count++] = name;
+	return 1;
+}
+
+static int _names_include(_names_t *set, const char *name)
+{
+	size_t i;
+
+	for(i = 0; i < set->count; i++) {
+		if(strcmp(set->names[i], name) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void derivation_init(derivation_t *derivation, const char *name,
+	const char *value, char **elements, int append)
+{
+	_names_t set = {NULL, 0};
+	char **references;
+	size_t i;
+	size_t j;
+
+	derivation->name = strdup(name);
+	derivation->offset = 0;
+	derivation->value = value != NULL ? strdup(value) : NULL;
+	derivation->elements = elements;
+	derivation->append = append;
+	if(value != NULL) {
+		derivation->references = sh_references(value);
+		return;
+	}
+
+	/* The references of an array are those of its elements */
+	derivation->references = malloc(sizeof(*derivation->references));
+	derivation->references[0] = NULL;
+	for(i = 0; elements[i] != NULL; i++) {
+		references = sh_references(elements[i]);
+		for(j = 0; references[j] != NULL; j++) {
+			if(_names_add(&set, references[j])) {
+				derivation->references = realloc(derivation->references,
+					(set.count + 1) * sizeof(*derivation->references));
+				derivation->references[set.count - 1] = references[j];
+				derivation->references[set.count] = NULL;
+			} else {
+				free(references[j]);
+			}
+		}
+		free(references);
+	}
+	free(set.names);
+}
+
+/* Copy an array of strings. */
+static char **_copy_array(char **array)
+{
+	char **copy;
+	size_t count;
+	size_t i;
+
+	if(array == NULL) {
+		return NULL;
+	}
+	for(count = 0; array[count] != NULL; count++);
+	copy = malloc((count + 1) * sizeof(*copy));
+	for(i = 0; i < count; i++) {
+		copy[i] = strdup(array[i]);
+	}
+	copy[count] = NULL;
+	return copy;
+}
+
+void derivation_copy(derivation_t *derivation, derivation_t *source)
+{
+	derivation->name = strdup(source->name);
+	derivation->offset = source->offset;
+	derivation->value = source->value != NULL ? strdup(source->value) : NULL;
+	derivation->elements = _copy_array(source->elements);
+	derivation->append = source->append;
+	derivation->references = _copy_array(source->references);
+}
+
+/* Deallocate the members of a derivation. */
+static void _derivation_clear(derivation_t *derivation)
+{
+	free(derivation->name);
+	free(derivation->value);
+	_free_array(derivation->elements);
+	_free_array(derivation->references);
+}
+
+void derivations_free(derivation_t *derivations, size_t count)
+{
+	size_t i;
+
+	for(i = 0; i < count; i++) {
+		_derivation_clear(&derivations[i]);
+	}
+	free(derivations);
+}
+
+void pkgbuild_set_derivations(pkgbuild_t *pkgbuild,
+	derivation_t *derivations, size_t count)
+{
+	if(pkgbuild != NULL) {
+		derivations_free(pkgbuild->derivations, pkgbuild->derivation_count);
+		pkgbuild->derivations = derivations;
+		pkgbuild->derivation_count = count;
+	}
+}
+
+/* Find the field loaded from a variable, or 0. */
+static unsigned int _field_of(const char *name)
+{
+	unsigned int field;
+
+	for(field = 1; field & kPkgbuildFieldAll; field <<= 1) {
+		if(pkgbuild_field_lvalue(field) != NULL
+				&& strcmp(pkgbuild_field_lvalue(field), name) == 0) {
+			return field;
+		}
+	}
+	return 0;
+}
+
+/* Add the variables depending on those of a set to it, until every
+ * dependent is included. */
+static void _add_dependents(pkgbuild_t *pkgbuild, _names_t *set)
+{
+	derivation_t *derivation;
+	size_t count;
+	size_t i;
+	size_t j;
+
+	do {
+		count = set->count;
+		for(i = 0; i < pkgbuild->derivation_count; i++) {
+			derivation = &pkgbuild->derivations[i];
+			for(j = 0; derivation->references[j] != NULL; j++) {
+				if(_names_include(set, derivation->references[j])) {
+					_names_add(set, derivation->name);
+					break;
+				}
+			}
+		}
+	} while(set->count > count);
+}
+
+char **pkgbuild_dependencies(pkgbuild_t *pkgbuild, pkgbuild_field_t field)
+{
+	derivation_t *derivation;
+	_names_t set = {NULL, 0};
+	char **dependencies;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	if(pkgbuild == NULL || pkgbuild->derivations == NULL
+			|| pkgbuild_field_lvalue(field) == NULL) {
+		return NULL;
+	}
+	_names_add(&set, pkgbuild_field_lvalue(field));
+	/* The set grows as the references of its variables are added */
+	for(i = 0; i < set.count; i++) {
+		for(j = 0; j < pkgbuild->derivation_count; j++) {
+			derivation = &pkgbuild->derivations[j];
+			if(strcmp(derivation->name, set.names[i]) != 0) {
+				continue;
+			}
+			for(k = 0; derivation->references[k] != NULL; k++) {
+				_names_add(&set, derivation->references[k]);
+			}
+		}
+	}
+
+	/* The variable of the field itself is not a dependency */
+	dependencies = malloc(set.count * sizeof(*dependencies));
+	for(i = 1; i < set.count; i++) {
+		dependencies[i - 1] = strdup(set.names[i]);
+	}
+	dependencies[set.count - 1] = NULL;
+	free(set.names);
+	return dependencies;
+}
+
+unsigned int pkgbuild_dependents(pkgbuild_t *pkgbuild, const char *name)
+{
+	_names_t set = {NULL, 0};
+	unsigned int fields = 0;
+	size_t i;
+
+	if(pkgbuild == NULL || pkgbuild->derivations == NULL || name == NULL) {
+		return 0;
+	}
+	_names_add(&set, name);
+	_add_dependents(pkgbuild, &set);
+	for(i = 0; i < set.count; i++) {
+		fields |= _field_of(set.names[i]);
+	}
+	free(set.names);
+	return fields;
+}
+
+table_t *derivations_replay(derivation_t *derivations, size_t count)
+{
+	derivation_t *derivation;
+	symbol_t *symbol;
+	table_t *table;
+	char **array;
+	char *string;
+	size_t length;
+	size_t i;
+
+	table = table_new();
+	for(derivation = derivations; derivation < derivations + count;
+			derivation++) {
+		symbol = symbol_new(derivation->name);
+		if(derivation->elements != NULL) {
+			for(length = 0; derivation->elements[length] != NULL; length++);
+			array = malloc((length + 1) * sizeof(*array));
+			for(i = 0; i < length; i++) {
+				array[i] = sh_parse_word(table, derivation->elements[i]);
+			}
+			array[length] = NULL;
+			symbol_set_array(symbol, array);
+			_free_array(array);
+		} else {
+			string = sh_parse_word(table, derivation->value);
+			symbol_set_string(symbol, string);
+			free(string);
+		}
+		if(derivation->append) {
+			table_append(table, symbol);
+		} else {
+			table_insert(table, symbol);
+		}
+		symbol_release(symbol);
+	}
+	return table;
+}
+
+/*
+Change the value of a variable, and load the fields depending on it again.
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	name - The name of the variable.
+	value - The new value as written, or NULL for an array.
+	values - The new elements as written, or NULL for a string.
+
+Returns:
+	True (1) on success, otherwise false (0).
+*/
+static int _set_variable(pkgbuild_t *pkgbuild, const char *name,
+	const char *value, const char **values)
+{
+	derivation_t *derivation = NULL;
+	_names_t set = {NULL, 0};
+	table_t *table;
+	table_t *previous;
+	unsigned int fields = 0;
+	unsigned int field;
+	int arch_specific = 0;
+	char **elements = NULL;
+	char *lvalue;
+	size_t offset;
+	size_t count;
+	size_t i;
+
+	/* Views derive their values from the pkgbuild they are based on */
+	if(pkgbuild == NULL || pkgbuild->derivations == NULL
+			|| pkgbuild->base != NULL || name == NULL) {
+		return 0;
+	}
+	for(i = pkgbuild->derivation_count; i > 0; i--) {
+		if(!pkgbuild->derivations[i - 1].append
+				&& strcmp(pkgbuild->derivations[i - 1].name, name) == 0) {
+			derivation = &pkgbuild->derivations[i - 1];
+			break;
+		}
+	}
+	if(derivation == NULL || (derivation->value == NULL) != (value == NULL)) {
+		return 0;
+	}
+
+	_names_add(&set, derivation->name);
+	_add_dependents(pkgbuild, &set);
+	for(i = 0; i < set.count; i++) {
+		field = _field_of(set.names[i]);
+		fields |= field;
+		/* Such as source_x86_64 */
+		if(field == 0 && strchr(set.names[i] + 1, '_') != NULL) {
+			arch_specific = 1;
+		}
+	}
+	free(set.names);
+	/* Split packages are located by the names of the pkgbuild. Names without
+	a package_* function have no entry, as for a single package. */
+	if((fields & kPkgbuildFieldNames) && pkgbuild->splitpkgs != NULL) {
+		for(i = 0; pkgbuild->names != NULL && pkgbuild->names[i] != NULL; i++) {
+			if(pkgbuild->splitpkgs[i] != NULL) {
+				return 0;
+			}
+		}
+	}
+
+	if(values != NULL) {
+		for(count = 0; values[count] != NULL; count++);
+		elements = malloc((count + 1) * sizeof(*elements));
+		for(i = 0; i < count; i++) {
+			elements[i] = strdup(values[i]);
+		}
+		elements[count] = NULL;
+	}
+	lvalue = derivation->name;
+	offset = derivation->offset;
+	derivation->name = NULL;
+	_derivation_clear(derivation);
+	derivation_init(derivation, lvalue, value, elements, 0);
+	derivation->offset = offset;
+	free(lvalue);
+
+	/* Fields which are not derived from the variable are left alone, and a
+	lazily loaded pkgbuild keeps loading them from its own table */
+	table = derivations_replay(pkgbuild->derivations,
+		pkgbuild->derivation_count);
+	previous = table_retain(pkgbuild->table);
+	pkgbuild_set_table(pkgbuild, table);
+	pkgbuild->loaded &= ~fields;
+	pkgbuild_load_fields(pkgbuild, fields);
+	if((fields & kPkgbuildFieldNames) && pkgbuild->splitpkgs != NULL) {
+		/* There is still no entry for any of the names */
+		for(count = 0; pkgbuild->names != NULL
+				&& pkgbuild->names[count] != NULL; count++);
+		free(pkgbuild->splitpkgs);
+		pkgbuild->splitpkgs = calloc(count + 1, sizeof(*pkgbuild->splitpkgs));
+	}
+	if(arch_specific) {
+		pkgbuild_copy_arch_variables(pkgbuild, table);
+	}
+	pkgbuild_set_table(pkgbuild,
+		(pkgbuild->loaded & kPkgbuildFieldAll) == kPkgbuildFieldAll
+		? NULL : previous);
+	table_release(previous);
+	table_release(table);
+	return 1;
+}
+
+int pkgbuild_set_variable(pkgbuild_t *pkgbuild, const char *name,
+	const char *value)
+{
+	if(value == NULL) {
+		return 0;
+	}
+	return _set_variable(pkgbuild, name, value, NULL);
+}
+
+int pkgbuild_set_variable_array(pkgbuild_t *pkgbuild, const char *name,
+	const char **values)
+{
+	if(values == NULL) {
+		return 0;
+	}
+	return _set_variable(pkgbuild, name, NULL, values);
+}
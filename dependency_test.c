@@ -0,0 +1,200 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* File: dependency_test.c
+Unit tests for tracking the variables fields are derived from.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pkgparse.h"
+
+static const char *_pkgbuild =
+	"pkgname=foo\n"
+	"_name=${pkgname}\n"
+	"pkgver=1.0\n"
+	"pkgrel=1\n"
+	"pkgdesc='A package'\n"
+	"url=\"https://example.org/$_name\"\n"
+	"source=(\"$url/$_name-$pkgver.tar.gz\" extra.patch)\n"
+	"depends=('glibc')\n"
+	"depends+=(\"libfoo>=$pkgver\")\n"
+	"_srcname=$_name-$pkgver\n";
+
+/* Parse a PKGBUILD from a string. */
+static pkgbuild_t *_parse(const char *contents, int options)
+{
+	pkgbuild_t *pkgbuild;
+	FILE *fp;
+
+	fp = tmpfile();
+	fputs(contents, fp);
+	pkgbuild = pkgbuild_parse_with_options(fp, options);
+	fclose(fp);
+	return pkgbuild;
+}
+
+static void _free_array(char **array)
+{
+	size_t i;
+
+	for(i = 0; array[i] != NULL; i++) {
+		free(array[i]);
+	}
+	free(array);
+}
+
+void test_pkgbuild_dependencies(void **state)
+{
+	pkgbuild_t *pkgbuild;
+	char **dependencies;
+
+	pkgbuild = _parse(_pkgbuild, kPkgbuildOptionTrackDependencies);
+	dependencies = pkgbuild_dependencies(pkgbuild, kPkgbuildFieldSources);
+	assert_true(dependencies != NULL);
+	assert_string_equal(dependencies[0], "url");
+	assert_string_equal(dependencies[1], "_name");
+	assert_string_equal(dependencies[2], "pkgver");
+	assert_string_equal(dependencies[3], "pkgname");
+	assert_true(dependencies[4] == NULL);
+	_free_array(dependencies);
+	dependencies = pkgbuild_dependencies(pkgbuild, kPkgbuildFieldDesc);
+	assert_true(dependencies[0] == NULL);
+	_free_array(dependencies);
+
+	assert_int_equal(pkgbuild_dependents(pkgbuild, "pkgver"),
+		kPkgbuildFieldVersion | kPkgbuildFieldSources | kPkgbuildFieldDepends);
+	assert_int_equal(pkgbuild_dependents(pkgbuild, "pkgname"),
+		kPkgbuildFieldNames | kPkgbuildFieldUrl | kPkgbuildFieldSources);
+	assert_int_equal(pkgbuild_dependents(pkgbuild, "_srcname"), 0);
+	pkgbuild_release(pkgbuild);
+
+	/* Dependencies are only tracked on request */
+	pkgbuild = _parse(_pkgbuild, kPkgbuildOptionNone);
+	assert_true(pkgbuild_dependencies(pkgbuild, kPkgbuildFieldSources) == NULL);
+	assert_int_equal(pkgbuild_dependents(pkgbuild, "pkgver"), 0);
+	assert_false(pkgbuild_set_variable(pkgbuild, "pkgver", "1.1"));
+	pkgbuild_release(pkgbuild);
+}
+
+void test_pkgbuild_set_variable(void **state)
+{
+	const char *sources[] = {"\"$_name-$pkgver.zip\"", NULL};
+	const char *names[] = {"bar", "baz", NULL};
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *lazy;
+
+	pkgbuild = _parse(_pkgbuild, kPkgbuildOptionTrackDependencies);
+	assert_true(pkgbuild_set_variable(pkgbuild, "pkgver", "1.1"));
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.1");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0],
+		"https://example.org/foo/foo-1.1.tar.gz");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[1], "extra.patch");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[0], "glibc");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "libfoo>=1.1");
+	assert_string_equal(pkgbuild_url(pkgbuild), "https://example.org/foo");
+	assert_string_equal(pkgbuild_desc(pkgbuild), "A package");
+
+	assert_true(pkgbuild_set_variable_array(pkgbuild, "source", sources));
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0], "foo-1.1.zip");
+	assert_true(pkgbuild_sources(pkgbuild)[1] == NULL);
+	assert_false(pkgbuild_set_variable(pkgbuild, "source", "foo"));
+	assert_false(pkgbuild_set_variable_array(pkgbuild, "pkgver", sources));
+	assert_false(pkgbuild_set_variable(pkgbuild, "epoch", "1"));
+	assert_true(pkgbuild_set_variable(pkgbuild, "pkgname", "bar"));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	assert_true(pkgbuild_names(pkgbuild)[1] == NULL);
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0], "bar-1.1.zip");
+
+	/* Fields which have not been loaded yet are loaded as parsed */
+	lazy = _parse(_pkgbuild,
+		kPkgbuildOptionTrackDependencies | kPkgbuildOptionLazy);
+	assert_true(pkgbuild_set_variable(lazy, "pkgname", "bar"));
+	assert_string_equal(pkgbuild_sources(lazy)[0],
+		"https://example.org/bar/bar-1.0.tar.gz");
+	assert_string_equal(pkgbuild_names(lazy)[0], "bar");
+	assert_string_equal(pkgbuild_desc(lazy), "A package");
+	assert_string_equal(pkgbuild_depends(lazy)[1], "libfoo>=1.0");
+	pkgbuild_release(lazy);
+	pkgbuild_release(pkgbuild);
+
+	/* Values of split packages are derived again unless they depend on
+	variables */
+	pkgbuild = _parse(
+		"pkgname=foo\n"
+		"pkgver=1.0\n"
+		"package() {\n"
+		"  provides=(foo-bin)\n"
+		"}\n", kPkgbuildOptionTrackDependencies);
+	assert_true(pkgbuild_set_variable(pkgbuild, "pkgver", "1.1"));
+	pkgbuild_release(pkgbuild);
+	pkgbuild = _parse(
+		"pkgname=foo\n"
+		"pkgver=1.0\n"
+		"package() {\n"
+		"  provides=(\"foo-bin=$pkgver\")\n"
+		"}\n", kPkgbuildOptionTrackDependencies);
+	assert_false(pkgbuild_set_variable(pkgbuild, "pkgver", "1.1"));
+	pkgbuild_release(pkgbuild);
+
+	/* The names are changed as they are assigned, unless they locate the
+	package functions of split packages */
+	pkgbuild = _parse(
+		"pkgname=(foo)\n"
+		"package() {\n"
+		"  true\n"
+		"}\n", kPkgbuildOptionTrackDependencies);
+	assert_false(pkgbuild_set_variable(pkgbuild, "pkgname", "bar"));
+	assert_true(pkgbuild_set_variable_array(pkgbuild, "pkgname", names));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	assert_string_equal(pkgbuild_names(pkgbuild)[1], "baz");
+	assert_true(pkgbuild_names(pkgbuild)[2] == NULL);
+	pkgbuild_release(pkgbuild);
+	pkgbuild = _parse(
+		"pkgname=(foo foo-docs)\n"
+		"package_foo() {\n"
+		"  true\n"
+		"}\n"
+		"package_foo-docs() {\n"
+		"  true\n"
+		"}\n", kPkgbuildOptionTrackDependencies);
+	assert_false(pkgbuild_set_variable_array(pkgbuild, "pkgname", names));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	pkgbuild_release(pkgbuild);
+
+	/* Values assigned under conditions are only known to a parse */
+	pkgbuild = _parse(
+		"pkgname=foo\n"
+		"pkgver=1.0\n"
+		"if [ \"$CARCH\" = \"x86_64\" ]; then\n"
+		"  depends=(\"libfoo=$pkgver\")\n"
+		"fi\n", kPkgbuildOptionTrackDependencies);
+	assert_false(pkgbuild_set_variable(pkgbuild, "pkgver", "1.1"));
+	pkgbuild_release(pkgbuild);
+}
@@ -0,0 +1,659 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+
+/* Characters which need no quoting in a shell word */
+#define kEditSafeCharacters "abcdefghijklmnopqrstuvwxyz" \
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789@%+=:,./_-"
+
+struct _pkgbuild_edit_t {
+	unsigned int refcount;
+	/* The path of the PKGBUILD, and the directory files it sources are
+	relative to */
+	char *path;
+	char *directory;
+	/* The edited text of the PKGBUILD */
+	char *text;
+	size_t length;
+	size_t size;
+	/* The assignments outside of functions, with offsets into text */
+	assignment_record_t *records;
+	size_t record_count;
+	/* The pkgbuild of the text as of the last call to
+	pkgbuild_edit_pkgbuild() */
+	pkgbuild_t *pkgbuild;
+	/* The variables edited since the pkgbuild was derived */
+	char **edited;
+	size_t edited_count;
+	/* Whether text differs from the file */
+	int modified;
+};
+
+/* Type: _batch_t
+A batch of PKGBUILDs being edited, shared by the threads editing them.
+
+mutex - Guards next and failures.
+next - The index of the next PKGBUILD to be edited.
+paths - The paths of the PKGBUILDs.
+count - The amount of PKGBUILDs.
+callback - The function applying the edits.
+data - The data passed to callback.
+failures - The amount of PKGBUILDs which could not be edited.
+*/
+typedef struct {
+	pthread_mutex_t mutex;
+	size_t next;
+	const char **paths;
+	size_t count;
+	pkgbuild_edit_callback_t callback;
+	void *data;
+	int failures;
+} _batch_t;
+
+/* Read a whole file into a buffer, which is returned along with its length,
+ * or NULL on error. */
+static char *_read_file(const char *path, size_t *length, size_t *size)
+{
+	struct stat st;
+	char *buffer;
+	ssize_t count;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return NULL;
+	}
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t)st.st_size + 1;
+	buffer = malloc(*size);
+	*length = 0;
+	while((count = read(fd, buffer + *length, *size - *length - 1)) > 0) {
+		*length += (size_t)count;
+		/* The file may have grown since fstat() */
+		if(*length + 1 == *size) {
+			*size *= 2;
+			buffer = realloc(buffer, *size);
+		}
+	}
+	close(fd);
+	if(count < 0) {
+		free(buffer);
+		return NULL;
+	}
+	buffer[*length] = '\0';
+	return buffer;
+}
+
+/*
+Parse the text of an edit, and record its assignments.
+
+Parameters:
+	edit - The edit whose pkgbuild and records are replaced.
+
+Returns:
+	True (1) on success, or false (0) if the PKGBUILD is malformed.
+*/
+static int _edit_parse(pkgbuild_edit_t *edit)
+{
+	pkgbuild_parser_t *parser;
+	int parsed;
+
+	/* Functions other than package() cannot assign metadata */
+	parser = pkgbuild_parser_new_with_options(kPkgbuildOptionSkipFunctions
+		| kPkgbuildOptionTrackDependencies);
+	pkgbuild_parser_set_recording(parser, 1);
+	pkgbuild_parser_set_directory(parser, edit->directory);
+	parsed = pkgbuild_parser_feed(parser, edit->text, edit->length);
+	pkgbuild_release(edit->pkgbuild);
+	edit->pkgbuild = pkgbuild_parser_finish(parser);
+	assignment_records_free(edit->records, edit->record_count);
+	edit->records = pkgbuild_parser_take_records(parser, &edit->record_count);
+	pkgbuild_parser_release(parser);
+	return parsed && edit->pkgbuild != NULL;
+}
+
+pkgbuild_edit_t *pkgbuild_edit_new(const char *path)
+{
+	pkgbuild_edit_t *edit;
+	char *slash;
+
+	if(path == NULL) {
+		return NULL;
+	}
+	edit = calloc(1, sizeof(*edit));
+	edit->refcount = 1;
+	edit->text = _read_file(path, &edit->length, &edit->size);
+	if(edit->text == NULL) {
+		free(edit);
+		return NULL;
+	}
+	edit->path = strdup(path);
+	edit->directory = strdup(path);
+	slash = strrchr(edit->directory, '/');
+	if(slash == NULL) {
+		strcpy(edit->directory, ".");
+	} else {
+		/* The root directory keeps its slash */
+		slash[slash == edit->directory] = '\0';
+	}
+	/* A malformed PKGBUILD could not be written back faithfully */
+	if(!_edit_parse(edit)) {
+		pkgbuild_edit_release(edit);
+		return NULL;
+	}
+	return edit;
+}
+
+pkgbuild_edit_t *pkgbuild_edit_retain(pkgbuild_edit_t *edit)
+{
+	if(edit != NULL) {
+		edit->refcount++;
+	}
+	return edit;
+}
+
+void pkgbuild_edit_release(pkgbuild_edit_t *edit)
+{
+	size_t i;
+
+	if(edit == NULL || --edit->refcount > 0) {
+		return;
+	}
+	for(i = 0; i < edit->edited_count; i++) {
+		free(edit->edited[i]);
+	}
+	free(edit->edited);
+	assignment_records_free(edit->records, edit->record_count);
+	pkgbuild_release(edit->pkgbuild);
+	free(edit->text);
+	free(edit->directory);
+	free(edit->path);
+	free(edit);
+}
+
+/*
+Find the assignment an edit of a variable applies to, which is the last one
+outside of conditionals which does not append to the variable.
+
+Parameters:
+	edit - The edit being made.
+	name - The name of the variable.
+	array - Whether an array assignment is expected.
+
+Returns:
+	The record of the assignment, or NULL if there is none.
+*/
+static assignment_record_t *_edit_find(pkgbuild_edit_t *edit,
+	const char *name, int array)
+{
+	assignment_record_t *record;
+	size_t i;
+
+	for(i = edit->record_count; i > 0; i--) {
+		record = &edit->records[i - 1];
+		if(record->name != NULL && !record->conditional && !record->append
+				&& strcmp(record->name, name) == 0) {
+			return record->array == array ? record : NULL;
+		}
+	}
+	return NULL;
+}
+
+/*
+Replace a range of the text of an edit, and move the records following it.
+
+Parameters:
+	edit - The edit being made.
+	offset - The offset of the range.
+	length - The length of the range.
+	replacement - The text replacing the range.
+	replacement_length - The length of replacement.
+*/
+static void _edit_splice(pkgbuild_edit_t *edit, size_t offset, size_t length,
+	const char *replacement, size_t replacement_length)
+{
+	assignment_record_t *record;
+	size_t end = offset + length;
+	size_t i;
+	size_t j;
+
+	if(edit->length - length + replacement_length + 1 > edit->size) {
+		edit->size = (edit->length - length + replacement_length + 1) * 2;
+		edit->text = realloc(edit->text, edit->size);
+	}
+	memmove(edit->text + offset + replacement_length, edit->text + end,
+		edit->length - end + 1);
+	memcpy(edit->text + offset, replacement, replacement_length);
+	edit->length = edit->length - length + replacement_length;
+
+	for(i = 0; i < edit->record_count; i++) {
+		record = &edit->records[i];
+		/* A record starting at offset is the one being replaced */
+		if(record->offset >= end && record->offset > offset) {
+			record->offset = record->offset - length + replacement_length;
+		}
+		for(j = 0; j < record->element_count; j++) {
+			if(record->elements[2 * j] >= end
+					&& record->elements[2 * j] > offset) {
+				record->elements[2 * j] = record->elements[2 * j] - length
+					+ replacement_length;
+			}
+		}
+	}
+	edit->modified = 1;
+}
+
+/*
+Quote a value as a shell word, in the style of the word it replaces: within
+double quotes if it was double quoted, within single quotes if it was single
+quoted or the value needs quoting, and unquoted otherwise. The style is changed
+rather than escaping characters within quotes where possible.
+
+Parameters:
+	value - The literal value.
+	style - The first character of the word being replaced.
+
+Returns:
+	The word, which must be deallocated by the caller.
+*/
+static char *_quote(const char *value, char style)
+{
+	const char *ptr;
+	char *word;
+	char *out;
+	int expands = strpbrk(value, "\\\"$`") != NULL;
+
+	if(style != '"' && style != '\'' && value[0] != '\0'
+			&& value[strspn(value, kEditSafeCharacters)] == '\0') {
+		return strdup(value);
+	}
+	if(style == '"' && expands) {
+		style = '\'';
+	} else if(style != '"' && strchr(value, '\'') != NULL) {
+		style = expands ? '\'' : '"';
+	}
+	/* Each character expands to at most four, as ' does to '\'' */
+	word = malloc(4 * strlen(value) + 3);
+	out = word;
+	*out++ = style == '"' ? '"' : '\'';
+	for(ptr = value; *ptr != '\0'; ptr++) {
+		if(*ptr == '\'' && style != '"') {
+			out = stpcpy(out, "'\\''");
+		} else {
+			*out++ = *ptr;
+		}
+	}
+	*out++ = style == '"' ? '"' : '\'';
+	*out = '\0';
+	return word;
+}
+
+/* Note that a variable has been edited since the pkgbuild was derived. */
+static void _edit_mark(pkgbuild_edit_t *edit, const char *name)
+{
+	size_t i;
+
+	for(i = 0; i < edit->edited_count; i++) {
+		if(strcmp(edit->edited[i], name) == 0) {
+			return;
+		}
+	}
+	edit->edited = realloc(edit->edited,
+		(edit->edited_count + 1) * sizeof(*edit->edited));
+	edit->edited[edit->edited_count++] = strdup(name);
+}
+
+int pkgbuild_edit_set(pkgbuild_edit_t *edit, const char *name,
+	const char *value)
+{
+	assignment_record_t *record;
+	char *word;
+
+	if(edit == NULL || name == NULL || value == NULL) {
+		return 0;
+	}
+	record = _edit_find(edit, name, 0);
+	if(record == NULL) {
+		return 0;
+	}
+	word = _quote(value, record->length > 0 ? edit->text[record->offset] : 0);
+	_edit_splice(edit, record->offset, record->length, word, strlen(word));
+	record->length = strlen(word);
+	free(word);
+	_edit_mark(edit, name);
+	return 1;
+}
+
+/* Rewrite each element of an array assignment which has as many elements as
+ * its new value. */
+static void _edit_replace_elements(pkgbuild_edit_t *edit,
+	assignment_record_t *record, const char **values)
+{
+	size_t *element;
+	size_t i;
+	size_t length;
+	char *word;
+
+	/* Later elements first, so that earlier offsets remain valid */
+	for(i = record->element_count; i > 0; i--) {
+		element = &record->elements[2 * (i - 1)];
+		word = _quote(values[i - 1], edit->text[element[0]]);
+		length = strlen(word);
+		_edit_splice(edit, element[0], element[1], word, length);
+		record->length = record->length - element[1] + length;
+		element[1] = length;
+		free(word);
+	}
+}
+
+/* Rewrite an array assignment whose amount of elements changes. Elements are
+ * separated as the first two were, short of any comment between them, and
+ * quoted as the first was. */
+static void _edit_replace_array(pkgbuild_edit_t *edit,
+	assignment_record_t *record, const char **values, size_t count)
+{
+	const char *separator = " ";
+	size_t separator_length = 1;
+	size_t *elements;
+	size_t length = 1;
+	size_t size;
+	size_t i;
+	char **words;
+	char *literal;
+	char style = 0;
+
+	if(record->element_count > 0) {
+		style = edit->text[record->elements[0]];
+	}
+	if(record->element_count > 1) {
+		separator = edit->text + record->elements[0] + record->elements[1];
+		separator_length = record->elements[2] - record->elements[0]
+			- record->elements[1];
+		/* Elements on separate lines keep the indentation of the second */
+		for(i = separator_length; i > 0; i--) {
+			if(separator[i - 1] == '\n') {
+				separator += i - 1;
+				separator_length -= i - 1;
+				break;
+			}
+		}
+	}
+	words = malloc((count + 1) * sizeof(*words));
+	elements = count > 0 ? malloc(2 * count * sizeof(*elements)) : NULL;
+	size = 3;
+	for(i = 0; i < count; i++) {
+		words[i] = _quote(values[i], style);
+		size += strlen(words[i]) + separator_length;
+	}
+
+	literal = malloc(size);
+	literal[0] = '(';
+	for(i = 0; i < count; i++) {
+		if(i > 0) {
+			memcpy(literal + length, separator, separator_length);
+			length += separator_length;
+		}
+		elements[2 * i] = record->offset + length;
+		elements[2 * i + 1] = strlen(words[i]);
+		memcpy(literal + length, words[i], elements[2 * i + 1]);
+		length += elements[2 * i + 1];
+		free(words[i]);
+	}
+	literal[length++] = ')';
+	free(words);
+
+	_edit_splice(edit, record->offset, record->length, literal, length);
+	record->length = length;
+	free(record->elements);
+	record->elements = elements;
+	record->element_count = count;
+	free(literal);
+}
+
+int pkgbuild_edit_set_array(pkgbuild_edit_t *edit, const char *name,
+	const char **values)
+{
+	assignment_record_t *record;
+	size_t count;
+
+	if(edit == NULL || name == NULL || values == NULL) {
+		return 0;
+	}
+	record = _edit_find(edit, name, 1);
+	if(record == NULL) {
+		return 0;
+	}
+	for(count = 0; values[count] != NULL; count++);
+	if(count == record->element_count) {
+		_edit_replace_elements(edit, record, values);
+	} else {
+		_edit_replace_array(edit, record, values, count);
+	}
+	_edit_mark(edit, name);
+	return 1;
+}
+
+/*
+Derive the fields depending on an edited variable again, see
+<pkgbuild_set_variable()>.
+
+Parameters:
+	edit - The edit.
+	name - The name of the variable.
+
+Returns:
+	True (1) on success, or false (0) if the pkgbuild must be parsed again.
+*/
+static int _edit_derive(pkgbuild_edit_t *edit, const char *name)
+{
+	assignment_record_t *record;
+	char **elements;
+	char *value;
+	size_t i;
+	int derived;
+
+	record = _edit_find(edit, name, 0);
+	if(record != NULL) {
+		value = strndup(edit->text + record->offset, record->length);
+		derived = pkgbuild_set_variable(edit->pkgbuild, name, value);
+		free(value);
+		return derived;
+	}
+
+	record = _edit_find(edit, name, 1);
+	elements = malloc((record->element_count + 1) * sizeof(*elements));
+	for(i = 0; i < record->element_count; i++) {
+		elements[i] = strndup(edit->text + record->elements[2 * i],
+			record->elements[2 * i + 1]);
+	}
+	elements[i] = NULL;
+	derived = pkgbuild_set_variable_array(edit->pkgbuild, name,
+		(const char **)elements);
+	for(i = 0; i < record->element_count; i++) {
+		free(elements[i]);
+	}
+	free(elements);
+	return derived;
+}
+
+pkgbuild_t *pkgbuild_edit_pkgbuild(pkgbuild_edit_t *edit)
+{
+	size_t i;
+
+	if(edit == NULL) {
+		return NULL;
+	}
+	for(i = 0; i < edit->edited_count; i++) {
+		if(!_edit_derive(edit, edit->edited[i])) {
+			_edit_parse(edit);
+			break;
+		}
+	}
+	for(i = 0; i < edit->edited_count; i++) {
+		free(edit->edited[i]);
+	}
+	edit->edited_count = 0;
+	return edit->pkgbuild;
+}
+
+const char *pkgbuild_edit_text(pkgbuild_edit_t *edit, size_t *length)
+{
+	if(edit == NULL) {
+		return NULL;
+	}
+	if(length != NULL) {
+		*length = edit->length;
+	}
+	return edit->text;
+}
+
+int pkgbuild_edit_write(pkgbuild_edit_t *edit)
+{
+	struct stat st;
+	char *temporary;
+	size_t written = 0;
+	ssize_t count;
+	int fd;
+
+	if(edit == NULL) {
+		return 0;
+	}
+	if(!edit->modified) {
+		return 1;
+	}
+	if(stat(edit->path, &st) != 0) {
+		return 0;
+	}
+	temporary = malloc(strlen(edit->path) + sizeof(".XXXXXX"));
+	sprintf(temporary, "%s.XXXXXX", edit->path);
+	fd = mkstemp(temporary);
+	if(fd < 0) {
+		free(temporary);
+		return 0;
+	}
+	fchmod(fd, st.st_mode & 07777);
+	/* The text is written at once, short writes aside */
+	while(written < edit->length && (count = write(fd, edit->text + written,
+			edit->length - written)) > 0) {
+		written += (size_t)count;
+	}
+	/* The PKGBUILD is replaced atomically, so that it is never seen
+	partially written */
+	if(close(fd) != 0 || written < edit->length
+			|| rename(temporary, edit->path) != 0) {
+		unlink(temporary);
+		free(temporary);
+		return 0;
+	}
+	free(temporary);
+	edit->modified = 0;
+	return 1;
+}
+
+/* Edit PKGBUILDs of a batch until every one has been edited. */
+static void *_edit_batch(void *data)
+{
+	_batch_t *batch = data;
+	pkgbuild_edit_t *edit;
+	size_t index;
+	int edited;
+
+	for(;;) {
+		pthread_mutex_lock(&batch->mutex);
+		index = batch->next++;
+		pthread_mutex_unlock(&batch->mutex);
+		if(index >= batch->count) {
+			break;
+		}
+		edit = pkgbuild_edit_new(batch->paths[index]);
+		edited = edit != NULL
+			&& batch->callback(edit, index, batch->data)
+			&& pkgbuild_edit_write(edit);
+		pkgbuild_edit_release(edit);
+		if(!edited) {
+			pthread_mutex_lock(&batch->mutex);
+			batch->failures++;
+			pthread_mutex_unlock(&batch->mutex);
+		}
+	}
+	return NULL;
+}
+
+int pkgbuild_edit_batch(const char **paths, size_t count, size_t threads,
+	pkgbuild_edit_callback_t callback, void *data)
+{
+	_batch_t batch;
+	pthread_t *workers;
+	size_t worker_count = 0;
+	size_t i;
+	long cpus;
+
+	if(paths == NULL || callback == NULL) {
+		return -1;
+	}
+	if(count == 0) {
+		return 0;
+	}
+	memset(&batch, 0, sizeof(batch));
+	batch.paths = paths;
+	batch.count = count;
+	batch.callback = callback;
+	batch.data = data;
+
+	if(threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (size_t)cpus : 1;
+	}
+	if(threads > count) {
+		threads = count;
+	}
+	pthread_mutex_init(&batch.mutex, NULL);
+	/* The calling thread edits PKGBUILDs as well */
+	workers = malloc(threads * sizeof(*workers));
+	for(i = 1; i < threads; i++) {
+		if(pthread_create(&workers[worker_count], NULL, _edit_batch,
+				&batch) == 0) {
+			worker_count++;
+		}
+	}
+	_edit_batch(&batch);
+	for(i = 0; i < worker_count; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	pthread_mutex_destroy(&batch.mutex);
+	return batch.failures;
+}
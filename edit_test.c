@@ -0,0 +1,233 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* File: edit_test.c
+Unit tests for editing PKGBUILDs in place.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "pkgparse.h"
+
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+
+/* Read a file written by a test. */
+static char *_read_file(const char *path)
+{
+	char *contents;
+	long length;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	assert_true(fp != NULL);
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	contents = malloc(length + 1);
+	contents[fread(contents, 1, length, fp)] = '\0';
+	fclose(fp);
+	return contents;
+}
+
+void test_edit_pkgbuild(void **directory)
+{
+	const char *sums[] = {"cccc", "dddd", NULL};
+	const char *more_sums[] = {"SKIP", "eeee", "ffff", NULL};
+	pkgbuild_edit_t *edit;
+	pkgbuild_t *pkgbuild;
+	struct stat st;
+	char *contents;
+	char *path;
+
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"# Maintainer: Foo <foo@example.org>\n"
+		"pkgname=foo\n"
+		"pkgver=1.0 # upstream version\n"
+		"pkgrel=3\n"
+		"_tag=\"v$pkgver\"\n"
+		"pkgdesc='A package'\n"
+		"arch=('x86_64')\n"
+		"source=(\"https://example.org/foo-$pkgver.tar.gz\"\n"
+		"        \"https://example.org/$_tag.patch\")\n"
+		"sha256sums=('aaaa'  # tarball\n"
+		"            'bbbb')\n"
+		"\n"
+		"build() {\n"
+		"  make\n"
+		"}\n"
+		"\n"
+		"package() {\n"
+		"  cd \"$srcdir\"\n"
+		"  make DESTDIR=\"$pkgdir\" install\n"
+		"}\n");
+	chmod(path, 0640);
+
+	edit = pkgbuild_edit_new(path);
+	assert_true(edit != NULL);
+	assert_string_equal(pkgbuild_version(pkgbuild_edit_pkgbuild(edit)), "1.0");
+	assert_true(pkgbuild_edit_set(edit, "pkgver", "1.1"));
+	assert_true(pkgbuild_edit_set(edit, "pkgrel", "1"));
+	assert_true(pkgbuild_edit_set_array(edit, "sha256sums", sums));
+	assert_false(pkgbuild_edit_set(edit, "epoch", "1"));
+	assert_false(pkgbuild_edit_set(edit, "arch", "any"));
+	assert_false(pkgbuild_edit_set_array(edit, "pkgver", sums));
+	assert_string_equal(pkgbuild_edit_text(edit, NULL),
+		"# Maintainer: Foo <foo@example.org>\n"
+		"pkgname=foo\n"
+		"pkgver=1.1 # upstream version\n"
+		"pkgrel=1\n"
+		"_tag=\"v$pkgver\"\n"
+		"pkgdesc='A package'\n"
+		"arch=('x86_64')\n"
+		"source=(\"https://example.org/foo-$pkgver.tar.gz\"\n"
+		"        \"https://example.org/$_tag.patch\")\n"
+		"sha256sums=('cccc'  # tarball\n"
+		"            'dddd')\n"
+		"\n"
+		"build() {\n"
+		"  make\n"
+		"}\n"
+		"\n"
+		"package() {\n"
+		"  cd \"$srcdir\"\n"
+		"  make DESTDIR=\"$pkgdir\" install\n"
+		"}\n");
+
+	/* Values depending on pkgver are derived again */
+	pkgbuild = pkgbuild_edit_pkgbuild(edit);
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.1");
+	assert_int_equal(pkgbuild_rel(pkgbuild), 1);
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0],
+		"https://example.org/foo-1.1.tar.gz");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[1],
+		"https://example.org/v1.1.patch");
+	assert_string_equal(pkgbuild_sha256sums(pkgbuild)[1], "dddd");
+	assert_string_equal(pkgbuild_desc(pkgbuild), "A package");
+
+	/* Values are quoted as needed, in the style of the original */
+	assert_true(pkgbuild_edit_set(edit, "pkgdesc", "It's a package"));
+	assert_true(pkgbuild_edit_set(edit, "_tag", "$tag"));
+	assert_true(pkgbuild_edit_set_array(edit, "sha256sums", more_sums));
+	assert_true(strstr(pkgbuild_edit_text(edit, NULL),
+		"pkgdesc=\"It's a package\"\n"
+		"arch=('x86_64')\n") != NULL);
+	assert_true(strstr(pkgbuild_edit_text(edit, NULL),
+		"_tag='$tag'\n") != NULL);
+	assert_true(strstr(pkgbuild_edit_text(edit, NULL),
+		"sha256sums=('SKIP'\n"
+		"            'eeee'\n"
+		"            'ffff')\n") != NULL);
+	pkgbuild = pkgbuild_edit_pkgbuild(edit);
+	assert_string_equal(pkgbuild_desc(pkgbuild), "It's a package");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[1],
+		"https://example.org/$tag.patch");
+	assert_string_equal(pkgbuild_sha256sums(pkgbuild)[2], "ffff");
+
+	/* The file is rewritten with its permissions */
+	assert_true(pkgbuild_edit_write(edit));
+	contents = _read_file(path);
+	assert_string_equal(contents, pkgbuild_edit_text(edit, NULL));
+	free(contents);
+	assert_int_equal(stat(path, &st), 0);
+	assert_int_equal(st.st_mode & 0777, 0640);
+	pkgbuild_edit_release(edit);
+}
+
+void test_edit_conditional(void **directory)
+{
+	pkgbuild_edit_t *edit;
+	pkgbuild_t *pkgbuild;
+	char *path;
+
+	/* Values assigned within conditionals require parsing again */
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=foo\n"
+		"pkgver=1.0\n"
+		"pkgrel=1\n"
+		"if [ \"$CARCH\" = \"x86_64\" ]; then\n"
+		"  pkgver=2.0\n"
+		"fi\n"
+		"source=(foo-$pkgver.tar.gz)\n");
+	edit = pkgbuild_edit_new(path);
+	assert_true(edit != NULL);
+	assert_true(pkgbuild_edit_set(edit, "pkgver", "1.5"));
+	assert_true(strstr(pkgbuild_edit_text(edit, NULL), "pkgver=1.5\n") != NULL);
+	assert_true(strstr(pkgbuild_edit_text(edit, NULL), "pkgver=2.0\n") != NULL);
+	pkgbuild = pkgbuild_edit_pkgbuild(edit);
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.5");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0], "foo-1.5.tar.gz");
+	pkgbuild_edit_release(edit);
+
+	assert_true(pkgbuild_edit_new("nonexistent/PKGBUILD") == NULL);
+}
+
+/* Bump the version of a PKGBUILD of a batch. */
+static int _bump_version(pkgbuild_edit_t *edit, size_t index, void *data)
+{
+	return pkgbuild_edit_set(edit, "pkgver", data)
+		&& pkgbuild_edit_set(edit, "pkgrel", "1");
+}
+
+void test_edit_batch(void **directory)
+{
+	const char *paths[4];
+	char *contents;
+	char *foo;
+	char *bar;
+	char *baz;
+
+	foo = strdup(write_pkgbuild_file(*directory, "foo",
+		"pkgname=foo\npkgver=1\npkgrel=2\n"));
+	bar = strdup(write_pkgbuild_file(*directory, "bar",
+		"pkgname=bar\npkgver='1'\npkgrel=2\n"));
+	baz = strdup(write_pkgbuild_file(*directory, "baz",
+		"pkgname=baz\npkgrel=2\n"));
+	paths[0] = foo;
+	paths[1] = bar;
+	paths[2] = baz;
+	paths[3] = "nonexistent/PKGBUILD";
+
+	assert_int_equal(pkgbuild_edit_batch(paths, 4, 2, _bump_version, "2.0"),
+		2);
+	contents = _read_file(foo);
+	assert_string_equal(contents, "pkgname=foo\npkgver=2.0\npkgrel=1\n");
+	free(contents);
+	contents = _read_file(bar);
+	assert_string_equal(contents, "pkgname=bar\npkgver='2.0'\npkgrel=1\n");
+	free(contents);
+	/* PKGBUILDs which fail to be edited are left alone */
+	contents = _read_file(baz);
+	assert_string_equal(contents, "pkgname=baz\npkgrel=2\n");
+	free(contents);
+	free(foo);
+	free(bar);
+	free(baz);
+}
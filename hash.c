@@ -0,0 +1,508 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef PKGPARSE_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+#include "hash.h"
+
+size_t hash_length(hash_algorithm_t algorithm)
+{
+	switch(algorithm) {
+		case kHashMd5:
+			return 16;
+		case kHashSha1:
+			return 20;
+		case kHashSha256:
+			return 32;
+		case kHashSha384:
+			return 48;
+		case kHashSha512:
+			return 64;
+	}
+	return 0;
+}
+
+#ifdef PKGPARSE_OPENSSL
+
+/* Retrieve the libcrypto implementation of an algorithm. */
+static const EVP_MD *_hash_md(hash_algorithm_t algorithm)
+{
+	switch(algorithm) {
+		case kHashMd5:
+			return EVP_md5();
+		case kHashSha1:
+			return EVP_sha1();
+		case kHashSha256:
+			return EVP_sha256();
+		case kHashSha384:
+			return EVP_sha384();
+		case kHashSha512:
+			return EVP_sha512();
+	}
+	return NULL;
+}
+
+int hash_init(hash_t *hash, hash_algorithm_t algorithm)
+{
+	hash->algorithm = algorithm;
+	hash->context = EVP_MD_CTX_new();
+	if(hash->context == NULL) {
+		return 0;
+	}
+	if(!EVP_DigestInit_ex(hash->context, _hash_md(algorithm), NULL)) {
+		EVP_MD_CTX_free(hash->context);
+		hash->context = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+void hash_update(hash_t *hash, const void *data, size_t length)
+{
+	EVP_DigestUpdate(hash->context, data, length);
+}
+
+size_t hash_final(hash_t *hash, unsigned char *digest)
+{
+	unsigned int length = 0;
+
+	EVP_DigestFinal_ex(hash->context, digest, &length);
+	EVP_MD_CTX_free(hash->context);
+	hash->context = NULL;
+	return length;
+}
+
+#else
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static const uint32_t _md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+	0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+	0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+	0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+	0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+	0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const unsigned char _md5_shift[16] = {
+	7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21
+};
+
+static const uint32_t _sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t _sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static uint32_t _load32_le(const unsigned char *ptr)
+{
+	return (uint32_t)ptr[0] | (uint32_t)ptr[1] << 8 | (uint32_t)ptr[2] << 16
+		| (uint32_t)ptr[3] << 24;
+}
+
+static uint32_t _load32_be(const unsigned char *ptr)
+{
+	return (uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16
+		| (uint32_t)ptr[2] << 8 | (uint32_t)ptr[3];
+}
+
+static uint64_t _load64_be(const unsigned char *ptr)
+{
+	return (uint64_t)_load32_be(ptr) << 32 | _load32_be(ptr + 4);
+}
+
+static void _store32_le(unsigned char *ptr, uint32_t value)
+{
+	ptr[0] = value;
+	ptr[1] = value >> 8;
+	ptr[2] = value >> 16;
+	ptr[3] = value >> 24;
+}
+
+static void _store32_be(unsigned char *ptr, uint32_t value)
+{
+	ptr[0] = value >> 24;
+	ptr[1] = value >> 16;
+	ptr[2] = value >> 8;
+	ptr[3] = value;
+}
+
+static void _store64_be(unsigned char *ptr, uint64_t value)
+{
+	_store32_be(ptr, value >> 32);
+	_store32_be(ptr + 4, value);
+}
+
+static void _md5_block(uint32_t *state, const unsigned char *block)
+{
+	uint32_t w[16];
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t f;
+	uint32_t temp;
+	int g;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = _load32_le(block + 4 * i);
+	}
+	for(i = 0; i < 64; i++) {
+		if(i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if(i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+		} else if(i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+		}
+		temp = d;
+		d = c;
+		c = b;
+		f += a + _md5_k[i] + w[g];
+		b += ROTL32(f, _md5_shift[(i / 16) * 4 + i % 4]);
+		a = temp;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+static void _sha1_block(uint32_t *state, const unsigned char *block)
+{
+	uint32_t w[80];
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+	uint32_t f;
+	uint32_t k;
+	uint32_t temp;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = _load32_be(block + 4 * i);
+	}
+	for(i = 16; i < 80; i++) {
+		w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+	for(i = 0; i < 80; i++) {
+		if(i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if(i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if(i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		temp = ROTL32(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROTL32(b, 30);
+		b = a;
+		a = temp;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+static void _sha256_block(uint32_t *state, const unsigned char *block)
+{
+	uint32_t w[64];
+	uint32_t v[8];
+	uint32_t s0;
+	uint32_t s1;
+	uint32_t t1;
+	uint32_t t2;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = _load32_be(block + 4 * i);
+	}
+	for(i = 16; i < 64; i++) {
+		s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	memcpy(v, state, sizeof(v));
+	for(i = 0; i < 64; i++) {
+		s1 = ROTR32(v[4], 6) ^ ROTR32(v[4], 11) ^ ROTR32(v[4], 25);
+		t1 = v[7] + s1 + ((v[4] & v[5]) ^ (~v[4] & v[6])) + _sha256_k[i] + w[i];
+		s0 = ROTR32(v[0], 2) ^ ROTR32(v[0], 13) ^ ROTR32(v[0], 22);
+		t2 = s0 + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+		memmove(v + 1, v, 7 * sizeof(*v));
+		v[4] += t1;
+		v[0] = t1 + t2;
+	}
+	for(i = 0; i < 8; i++) {
+		state[i] += v[i];
+	}
+}
+
+static void _sha512_block(uint64_t *state, const unsigned char *block)
+{
+	uint64_t w[80];
+	uint64_t v[8];
+	uint64_t s0;
+	uint64_t s1;
+	uint64_t t1;
+	uint64_t t2;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = _load64_be(block + 8 * i);
+	}
+	for(i = 16; i < 80; i++) {
+		s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	memcpy(v, state, sizeof(v));
+	for(i = 0; i < 80; i++) {
+		s1 = ROTR64(v[4], 14) ^ ROTR64(v[4], 18) ^ ROTR64(v[4], 41);
+		t1 = v[7] + s1 + ((v[4] & v[5]) ^ (~v[4] & v[6])) + _sha512_k[i] + w[i];
+		s0 = ROTR64(v[0], 28) ^ ROTR64(v[0], 34) ^ ROTR64(v[0], 39);
+		t2 = s0 + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+		memmove(v + 1, v, 7 * sizeof(*v));
+		v[4] += t1;
+		v[0] = t1 + t2;
+	}
+	for(i = 0; i < 8; i++) {
+		state[i] += v[i];
+	}
+}
+
+/* Retrieve the size of the blocks an algorithm processes. */
+static size_t _block_size(hash_algorithm_t algorithm)
+{
+	return algorithm == kHashSha384 || algorithm == kHashSha512 ? 128 : 64;
+}
+
+/* Process a block of data. */
+static void _hash_block(hash_t *hash, const unsigned char *block)
+{
+	switch(hash->algorithm) {
+		case kHashMd5:
+			_md5_block(hash->state.words, block);
+			break;
+		case kHashSha1:
+			_sha1_block(hash->state.words, block);
+			break;
+		case kHashSha256:
+			_sha256_block(hash->state.words, block);
+			break;
+		case kHashSha384:
+		case kHashSha512:
+			_sha512_block(hash->state.longs, block);
+			break;
+	}
+}
+
+int hash_init(hash_t *hash, hash_algorithm_t algorithm)
+{
+	static const uint32_t md5[4] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+	};
+	static const uint32_t sha1[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	static const uint32_t sha256[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	static const uint64_t sha384[8] = {
+		0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+		0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+		0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+		0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+	};
+	static const uint64_t sha512[8] = {
+		0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+		0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+		0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+		0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+	};
+
+	memset(hash, 0, sizeof(*hash));
+	hash->algorithm = algorithm;
+	switch(algorithm) {
+		case kHashMd5:
+			memcpy(hash->state.words, md5, sizeof(md5));
+			break;
+		case kHashSha1:
+			memcpy(hash->state.words, sha1, sizeof(sha1));
+			break;
+		case kHashSha256:
+			memcpy(hash->state.words, sha256, sizeof(sha256));
+			break;
+		case kHashSha384:
+			memcpy(hash->state.longs, sha384, sizeof(sha384));
+			break;
+		case kHashSha512:
+			memcpy(hash->state.longs, sha512, sizeof(sha512));
+			break;
+		default:
+			return 0;
+	}
+	return 1;
+}
+
+void hash_update(hash_t *hash, const void *data, size_t length)
+{
+	const unsigned char *ptr = data;
+	size_t block_size = _block_size(hash->algorithm);
+	size_t count;
+
+	hash->length += length;
+	if(hash->block_length > 0) {
+		count = block_size - hash->block_length;
+		if(count > length) {
+			count = length;
+		}
+		memcpy(hash->block + hash->block_length, ptr, count);
+		hash->block_length += count;
+		ptr += count;
+		length -= count;
+		if(hash->block_length < block_size) {
+			return;
+		}
+		_hash_block(hash, hash->block);
+		hash->block_length = 0;
+	}
+	/* Whole blocks are processed in place */
+	for(; length >= block_size; ptr += block_size, length -= block_size) {
+		_hash_block(hash, ptr);
+	}
+	memcpy(hash->block, ptr, length);
+	hash->block_length = length;
+}
+
+size_t hash_final(hash_t *hash, unsigned char *digest)
+{
+	size_t block_size = _block_size(hash->algorithm);
+	/* The length is appended as 64 bits, or 128 with SHA-384 and SHA-512 */
+	size_t length_size = block_size / 8;
+	uint64_t bits = hash->length * 8;
+	size_t length = hash_length(hash->algorithm);
+	size_t i;
+
+	hash->block[hash->block_length++] = 0x80;
+	if(hash->block_length > block_size - length_size) {
+		memset(hash->block + hash->block_length, 0,
+			block_size - hash->block_length);
+		_hash_block(hash, hash->block);
+		hash->block_length = 0;
+	}
+	memset(hash->block + hash->block_length, 0,
+		block_size - hash->block_length);
+	if(hash->algorithm == kHashMd5) {
+		_store32_le(hash->block + block_size - 8, bits);
+		_store32_le(hash->block + block_size - 4, bits >> 32);
+	} else {
+		_store64_be(hash->block + block_size - 8, bits);
+	}
+	_hash_block(hash, hash->block);
+
+	if(hash->algorithm == kHashMd5) {
+		for(i = 0; i < length / 4; i++) {
+			_store32_le(digest + 4 * i, hash->state.words[i]);
+		}
+	} else if(hash->algorithm == kHashSha1 || hash->algorithm == kHashSha256) {
+		for(i = 0; i < length / 4; i++) {
+			_store32_be(digest + 4 * i, hash->state.words[i]);
+		}
+	} else {
+		for(i = 0; i < length / 8; i++) {
+			_store64_be(digest + 8 * i, hash->state.longs[i]);
+		}
+	}
+	return length;
+}
+
+#endif
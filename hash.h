@@ -0,0 +1,133 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef HASH_H
+#define HASH_H
+
+/* File: hash.h
+Message digests of the algorithms PKGBUILD checksum arrays use. Digests are
+computed with OpenSSL's libcrypto when pkgparse is built with
+PKGPARSE_OPENSSL, which selects SHA-NI, AVX2 and similar implementations at
+run time, and with portable C otherwise.
+
+Example:
+	(start code)
+	unsigned char digest[kHashMaxLength];
+	hash_t hash;
+
+	hash_init(&hash, kHashSha256);
+	hash_update(&hash, data, length);
+	length = hash_final(&hash, digest);
+	(end)
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The length of the longest digest, that of SHA-512 */
+#define kHashMaxLength 64
+
+/* Enumeration: hash_algorithm_t
+The digest algorithms.
+
+kHashMd5 - MD5, for md5sums.
+kHashSha1 - SHA-1, for sha1sums.
+kHashSha256 - SHA-256, for sha256sums.
+kHashSha384 - SHA-384, for sha384sums.
+kHashSha512 - SHA-512, for sha512sums.
+*/
+typedef enum {
+	kHashMd5,
+	kHashSha1,
+	kHashSha256,
+	kHashSha384,
+	kHashSha512,
+} hash_algorithm_t;
+
+/* Type: hash_t
+The state of a digest being computed. It is meant to be allocated by the
+caller, such as on the stack, and is only valid between <hash_init()> and
+<hash_final()>.
+*/
+typedef struct {
+	hash_algorithm_t algorithm;
+#ifdef PKGPARSE_OPENSSL
+	void *context;
+#else
+	union {
+		uint32_t words[8];
+		uint64_t longs[8];
+	} state;
+	unsigned char block[128];
+	size_t block_length;
+	uint64_t length;
+#endif
+} hash_t;
+
+/* Function: hash_init
+Start computing a digest.
+
+Parameters:
+	hash - The state to be initialized.
+	algorithm - The digest algorithm.
+
+Returns:
+	True (1) on success or false (0) on error.
+*/
+int hash_init(hash_t *hash, hash_algorithm_t algorithm);
+
+/* Function: hash_update
+Add data to a digest.
+
+Parameters:
+	hash - The state of the digest.
+	data - The data to be added.
+	length - The length of the data.
+*/
+void hash_update(hash_t *hash, const void *data, size_t length);
+
+/* Function: hash_final
+Finish computing a digest, releasing any resources held by the state.
+
+Parameters:
+	hash - The state of the digest.
+	digest - The buffer the digest is stored in, of at least
+		<hash_length()> bytes.
+
+Returns:
+	The length of the digest.
+*/
+size_t hash_final(hash_t *hash, unsigned char *digest);
+
+/* Function: hash_length
+Retrieve the length of the digests of an algorithm.
+
+Parameters:
+	algorithm - The digest algorithm.
+
+Returns:
+	The length of the digests in bytes.
+*/
+size_t hash_length(hash_algorithm_t algorithm);
+
+#endif
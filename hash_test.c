@@ -0,0 +1,97 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: hash_test.c
+Unit tests for message digests.
+
+See Also:
+	<hash.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+/* Compute a digest of a message, fed a given amount of bytes at a time, and
+ * compare it with the expected digest in hexadecimal. */
+static void _assert_digest(hash_algorithm_t algorithm, const char *message,
+	size_t step, const char *expected)
+{
+	unsigned char digest[kHashMaxLength];
+	char hex[2 * kHashMaxLength + 1];
+	hash_t hash;
+	size_t length = strlen(message);
+	size_t offset;
+	size_t i;
+
+	assert_true(hash_init(&hash, algorithm));
+	for(offset = 0; offset < length; offset += step) {
+		hash_update(&hash, message + offset,
+			length - offset < step ? length - offset : step);
+	}
+	assert_int_equal(hash_final(&hash, digest), hash_length(algorithm));
+	for(i = 0; i < hash_length(algorithm); i++) {
+		sprintf(hex + 2 * i, "%02x", digest[i]);
+	}
+	assert_string_equal(hex, expected);
+}
+
+void test_hash_digests(void **state)
+{
+	_assert_digest(kHashMd5, "abc", 3, "900150983cd24fb0d6963f7d28e17f72");
+	_assert_digest(kHashSha1, "abc", 3,
+		"a9993e364706816aba3e25717850c26c9cd0d89d");
+	_assert_digest(kHashSha256, "abc", 3,
+		"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	_assert_digest(kHashSha384, "abc", 3,
+		"cb00753f45a35e8bb5a03d699ac65007272c32ab0eded163"
+		"1a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7");
+	_assert_digest(kHashSha512, "abc", 3,
+		"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+		"2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+	_assert_digest(kHashSha256, "", 1,
+		"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+void test_hash_incremental(void **state)
+{
+	/* Spans several blocks, and is fed across block boundaries */
+	const char *message =
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+	_assert_digest(kHashMd5, message, 7, "cefbb1840101eb050ec96cd853c9c90e");
+	_assert_digest(kHashSha1, message, 1,
+		"beaed16d658ec7929edfd62bfafeac299f0d744d");
+	_assert_digest(kHashSha256, message, 63,
+		"50ea825d9684f4229ca29f1fec511593e281e46a140d81e0005f8f688669a06c");
+	_assert_digest(kHashSha384, message, 129,
+		"d1ec278f9b7f2f8c2ca965b3950117d978e5a60d36253cc1"
+		"addd76644199a081df40d41b893bdca795979108ab57ad7b");
+	_assert_digest(kHashSha512, message, 5,
+		"33dd4ac487bcba1462df408fd383ebd5bfb2bfa4e7dd3572d752887d1ae78852"
+		"5f53b12fd1fd9a6a61e6607823e9a30028be4845276bd0e93411b42d3d084cf5");
+}
@@ -0,0 +1,743 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef PKGPARSE_IO_URING
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "ingest.h"
+#include "pkgparse.h"
+
+/* The amount of files read at once */
+#define kIngestBatch 64
+/* The size of the buffer each file of a batch is first read into. Longer
+files are read on with pread(). */
+#define kIngestBufferSize (32 * 1024)
+/* The amount of groups read ahead of the threads handling them */
+#define kIngestQueueSize (4 * kIngestBatch)
+
+/* Type: _group_t
+A group of files waiting to be handed to the callback.
+*/
+typedef struct {
+	ingest_file_t *files;
+	size_t index;
+} _group_t;
+
+/* Type: _queue_t
+The groups read, shared by the thread reading them and those handling them.
+
+mutex - Guards the queue.
+available - Signalled when a group is queued, or reading has finished.
+space - Signalled when a group is taken from the queue.
+groups - A ring of queued groups.
+head - The index of the next group to be handled.
+tail - The index following the last group queued.
+finished - Whether every group has been queued.
+workers - The amount of threads which have started, from which each takes
+	its index.
+group - The amount of files of a group.
+callback - The function handed the groups.
+data - Data passed to callback.
+*/
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t available;
+	pthread_cond_t space;
+	_group_t groups[kIngestQueueSize];
+	size_t head;
+	size_t tail;
+	int finished;
+	size_t workers;
+	size_t group;
+	ingest_callback_t callback;
+	void *data;
+} _queue_t;
+
+/*
+Read the remainder of an open file, from the length read so far on.
+
+Returns:
+	True (1) on success, otherwise false (0) with the data of the file
+	deallocated.
+*/
+static int _read_rest(int fd, ingest_file_t *file)
+{
+	ssize_t count;
+
+	for(;;) {
+		file->data = realloc(file->data, file->length + kIngestBufferSize + 2);
+		count = pread(fd, file->data + file->length, kIngestBufferSize,
+			file->length);
+		if(count < 0 && errno == EINTR) {
+			continue;
+		} else if(count < 0) {
+			file->error = errno;
+			free(file->data);
+			file->data = NULL;
+			return 0;
+		} else if(count == 0) {
+			break;
+		}
+		file->length += count;
+	}
+	file->data[file->length] = '\0';
+	file->data[file->length + 1] = '\0';
+	return 1;
+}
+
+/* Read a file with a system call per operation. */
+static void _pread_file(const char *path, int mtime, ingest_file_t *file)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		file->error = errno;
+		return;
+	}
+	if(mtime && fstat(fd, &st) == 0) {
+		file->mtime = st.st_mtime;
+	}
+	_read_rest(fd, file);
+	close(fd);
+}
+
+#ifdef PKGPARSE_IO_URING
+/* Type: _ring_t
+An io_uring instance, with the buffers registered with it.
+*/
+typedef struct {
+	int fd;
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	/* The amount of entries prepared, not yet submitted */
+	unsigned int pending;
+	char *buffers;
+} _ring_t;
+
+static void _ring_destroy(_ring_t *ring)
+{
+	if(ring->buffers != MAP_FAILED && ring->buffers != NULL) {
+		munmap(ring->buffers, kIngestBatch * kIngestBufferSize);
+	}
+	if(ring->sqes != MAP_FAILED && ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if(ring->cq_ring != ring->sq_ring && ring->cq_ring != MAP_FAILED
+			&& ring->cq_ring != NULL) {
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	}
+	if(ring->sq_ring != MAP_FAILED && ring->sq_ring != NULL) {
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	}
+	close(ring->fd);
+}
+
+/* Whether the kernel supports every operation a batch is read with, which
+ * depends on its version rather than on the presence of io_uring. */
+static int _ring_probe(_ring_t *ring)
+{
+	static const int opcodes[] = {
+		IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ_FIXED,
+		IORING_OP_CLOSE,
+	};
+	struct io_uring_probe *probe;
+	size_t i;
+	int supported;
+
+	probe = calloc(1, sizeof(*probe)
+		+ IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+	supported = syscall(__NR_io_uring_register, ring->fd,
+		IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+	for(i = 0; supported && i < sizeof(opcodes) / sizeof(*opcodes); i++) {
+		supported = opcodes[i] <= probe->last_op
+			&& (probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED);
+	}
+	free(probe);
+	return supported;
+}
+
+/*
+Set up an io_uring instance with room for opening and querying a batch of
+files at once, and register a buffer for each file of a batch.
+
+Returns:
+	True (1) on success, or false (0) if io_uring is unavailable, or lacks
+	one of the operations used.
+*/
+static int _ring_init(_ring_t *ring)
+{
+	struct io_uring_params params;
+	struct iovec iovecs[kIngestBatch];
+	size_t i;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, 2 * kIngestBatch, &params);
+	if(ring->fd < 0) {
+		return 0;
+	}
+	ring->sq_ring_size = params.sq_off.array
+		+ params.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = params.cq_off.cqes
+		+ params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		if(ring->cq_ring_size > ring->sq_ring_size) {
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	ring->buffers = mmap(NULL, kIngestBatch * kIngestBufferSize,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED
+			|| ring->sqes == MAP_FAILED || ring->buffers == MAP_FAILED) {
+		_ring_destroy(ring);
+		return 0;
+	}
+
+	ring->sq_tail = (unsigned int *)((char *)ring->sq_ring
+		+ params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)((char *)ring->sq_ring
+		+ params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)((char *)ring->sq_ring
+		+ params.sq_off.array);
+	ring->cq_head = (unsigned int *)((char *)ring->cq_ring
+		+ params.cq_off.head);
+	ring->cq_tail = (unsigned int *)((char *)ring->cq_ring
+		+ params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)((char *)ring->cq_ring
+		+ params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring
+		+ params.cq_off.cqes);
+
+	/* Reads into registered buffers need not map them each time */
+	for(i = 0; i < kIngestBatch; i++) {
+		iovecs[i].iov_base = ring->buffers + i * kIngestBufferSize;
+		iovecs[i].iov_len = kIngestBufferSize;
+	}
+	if(!_ring_probe(ring) || syscall(__NR_io_uring_register, ring->fd,
+			IORING_REGISTER_BUFFERS, iovecs, kIngestBatch) != 0) {
+		_ring_destroy(ring);
+		return 0;
+	}
+	return 1;
+}
+
+/* Prepare a submission queue entry, which is cleared. */
+static struct io_uring_sqe *_ring_prepare(_ring_t *ring, int opcode, int fd,
+	uint64_t user_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int index;
+
+	index = (*ring->sq_tail + ring->pending) & *ring->sq_mask;
+	ring->sq_array[index] = index;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = user_data;
+	ring->pending++;
+	return sqe;
+}
+
+/*
+Submit the prepared entries, and wait for all of them to complete.
+
+Parameters:
+	ring - The ring.
+	results - The results of the entries, indexed by their user data.
+
+Returns:
+	True (1) on success, otherwise false (0).
+*/
+static int _ring_run(_ring_t *ring, int *results)
+{
+	const struct io_uring_cqe *cqe;
+	unsigned int count = ring->pending;
+	unsigned int submitted = 0;
+	unsigned int completed = 0;
+	unsigned int head;
+	unsigned int tail;
+	long result;
+
+	ring->pending = 0;
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + count, __ATOMIC_RELEASE);
+	while(completed < count) {
+		result = syscall(__NR_io_uring_enter, ring->fd, count - submitted,
+			count - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		if(result < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		submitted += result;
+		head = *ring->cq_head;
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		for(; head != tail; head++) {
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			results[cqe->user_data] = cqe->res;
+			completed++;
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	return 1;
+}
+
+/*
+Read a batch of files with io_uring. The files are opened, queried if
+needed, read and closed with a system call each.
+
+Returns:
+	True (1) on success, or false (0) if io_uring failed, in which case no
+	file was read, and every file opened is closed.
+*/
+static int _ring_read(_ring_t *ring, const char **paths, size_t count,
+	int mtime, ingest_file_t *files)
+{
+	struct statx stats[kIngestBatch];
+	struct io_uring_sqe *sqe;
+	int results[2 * kIngestBatch];
+	int fds[kIngestBatch];
+	size_t i;
+
+	for(i = 0; i < count; i++) {
+		results[i] = -ECANCELED;
+		results[kIngestBatch + i] = -ECANCELED;
+		sqe = _ring_prepare(ring, IORING_OP_OPENAT, AT_FDCWD, i);
+		sqe->addr = (uintptr_t)paths[i];
+		sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		if(mtime) {
+			sqe = _ring_prepare(ring, IORING_OP_STATX, AT_FDCWD,
+				kIngestBatch + i);
+			sqe->addr = (uintptr_t)paths[i];
+			sqe->len = STATX_MTIME;
+			sqe->off = (uintptr_t)&stats[i];
+		}
+	}
+	if(!_ring_run(ring, results)) {
+		for(i = 0; i < count; i++) {
+			if(results[i] >= 0) {
+				close(results[i]);
+			}
+		}
+		return 0;
+	}
+
+	for(i = 0; i < count; i++) {
+		fds[i] = results[i];
+		if(fds[i] < 0) {
+			files[i].error = -fds[i];
+			continue;
+		}
+		if(mtime && results[kIngestBatch + i] == 0) {
+			files[i].mtime = stats[i].stx_mtime.tv_sec;
+		}
+		results[i] = -ECANCELED;
+		sqe = _ring_prepare(ring, IORING_OP_READ_FIXED, fds[i], i);
+		sqe->addr = (uintptr_t)(ring->buffers + i * kIngestBufferSize);
+		sqe->len = kIngestBufferSize;
+		sqe->buf_index = i;
+	}
+	if(!_ring_run(ring, results)) {
+		for(i = 0; i < count; i++) {
+			if(fds[i] >= 0) {
+				close(fds[i]);
+			}
+		}
+		return 0;
+	}
+
+	for(i = 0; i < count; i++) {
+		if(fds[i] < 0) {
+			continue;
+		}
+		if(results[i] < 0) {
+			files[i].error = -results[i];
+		} else {
+			files[i].length = results[i];
+			files[i].data = malloc(files[i].length + 2);
+			memcpy(files[i].data, ring->buffers + i * kIngestBufferSize,
+				files[i].length);
+			files[i].data[files[i].length] = '\0';
+			files[i].data[files[i].length + 1] = '\0';
+			/* A file filling its buffer may continue */
+			if(files[i].length == kIngestBufferSize) {
+				_read_rest(fds[i], &files[i]);
+			}
+		}
+		results[i] = -ECANCELED;
+		_ring_prepare(ring, IORING_OP_CLOSE, fds[i], i);
+	}
+	if(!_ring_run(ring, results)) {
+		for(i = 0; i < count; i++) {
+			/* Descriptors are released by a close which completed, even
+			if it failed */
+			if(fds[i] >= 0 && results[i] == -ECANCELED) {
+				close(fds[i]);
+			}
+			free(files[i].data);
+			files[i].data = NULL;
+		}
+		return 0;
+	}
+	return 1;
+}
+#endif
+
+/* Hand the groups read to the callback until every group has been read. */
+static void *_ingest_worker(void *data)
+{
+	_queue_t *queue = data;
+	_group_t group;
+	size_t thread;
+	size_t i;
+
+	thread = __sync_fetch_and_add(&queue->workers, 1);
+	for(;;) {
+		pthread_mutex_lock(&queue->mutex);
+		while(queue->head == queue->tail && !queue->finished) {
+			pthread_cond_wait(&queue->available, &queue->mutex);
+		}
+		if(queue->head == queue->tail) {
+			pthread_mutex_unlock(&queue->mutex);
+			break;
+		}
+		group = queue->groups[queue->head++ % kIngestQueueSize];
+		pthread_cond_signal(&queue->space);
+		pthread_mutex_unlock(&queue->mutex);
+
+		queue->callback(group.files, group.index, thread, queue->data);
+		for(i = 0; i < queue->group; i++) {
+			free(group.files[i].data);
+		}
+		free(group.files);
+	}
+	return NULL;
+}
+
+/* Queue the groups of a batch of files which were read. */
+static void _ingest_queue(_queue_t *queue, ingest_file_t *files,
+	size_t count, size_t first)
+{
+	_group_t group;
+	size_t i;
+
+	for(i = 0; i < count; i += queue->group) {
+		group.files = malloc(queue->group * sizeof(*group.files));
+		memcpy(group.files, files + i, queue->group * sizeof(*group.files));
+		group.index = (first + i) / queue->group;
+		pthread_mutex_lock(&queue->mutex);
+		while(queue->tail - queue->head == kIngestQueueSize) {
+			pthread_cond_wait(&queue->space, &queue->mutex);
+		}
+		queue->groups[queue->tail++ % kIngestQueueSize] = group;
+		pthread_cond_signal(&queue->available);
+		pthread_mutex_unlock(&queue->mutex);
+	}
+}
+
+size_t ingest_threads(size_t count, size_t group, size_t threads)
+{
+	long cpus;
+
+	if(threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (size_t)cpus : 1;
+	}
+	if(group > 0 && threads > count / group) {
+		threads = count / group;
+	}
+	return threads > 0 ? threads : 1;
+}
+
+int ingest_files(const char **paths, size_t count, size_t group, int mtime,
+	size_t threads, ingest_callback_t callback, void *data)
+{
+	ingest_file_t files[kIngestBatch];
+	_queue_t *queue;
+	pthread_t *workers;
+	size_t worker_count = 0;
+	size_t batch;
+	size_t first;
+	size_t length;
+	size_t i;
+	int uring = 0;
+#ifdef PKGPARSE_IO_URING
+	_ring_t ring;
+#endif
+
+	if(paths == NULL || callback == NULL || group == 0
+			|| group > kIngestBatch || count % group != 0) {
+		return 0;
+	}
+	if(count == 0) {
+		return 1;
+	}
+	threads = ingest_threads(count, group, threads);
+	queue = calloc(1, sizeof(*queue));
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->available, NULL);
+	pthread_cond_init(&queue->space, NULL);
+	queue->group = group;
+	queue->callback = callback;
+	queue->data = data;
+	workers = malloc(threads * sizeof(*workers));
+	for(i = 0; i < threads; i++) {
+		if(pthread_create(&workers[worker_count], NULL, _ingest_worker,
+				queue) == 0) {
+			worker_count++;
+		}
+	}
+
+#ifdef PKGPARSE_IO_URING
+	uring = _ring_init(&ring);
+#endif
+	/* Groups are not split across batches */
+	batch = kIngestBatch - kIngestBatch % group;
+	for(first = 0; first < count; first += length) {
+		length = count - first < batch ? count - first : batch;
+		memset(files, 0, length * sizeof(*files));
+#ifdef PKGPARSE_IO_URING
+		if(uring && !_ring_read(&ring, paths + first, length, mtime, files)) {
+			/* The batch is read again without io_uring */
+			_ring_destroy(&ring);
+			uring = 0;
+			memset(files, 0, length * sizeof(*files));
+		}
+#endif
+		if(!uring) {
+			for(i = 0; i < length; i++) {
+				_pread_file(paths[first + i], mtime, &files[i]);
+			}
+		}
+		if(worker_count > 0) {
+			_ingest_queue(queue, files, length, first);
+		} else {
+			for(i = 0; i < length; i += group) {
+				callback(files + i, (first + i) / group, 0, data);
+			}
+			for(i = 0; i < length; i++) {
+				free(files[i].data);
+			}
+		}
+	}
+#ifdef PKGPARSE_IO_URING
+	if(uring) {
+		_ring_destroy(&ring);
+	}
+#endif
+
+	pthread_mutex_lock(&queue->mutex);
+	queue->finished = 1;
+	pthread_cond_broadcast(&queue->available);
+	pthread_mutex_unlock(&queue->mutex);
+	for(i = 0; i < worker_count; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	pthread_cond_destroy(&queue->space);
+	pthread_cond_destroy(&queue->available);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue);
+	return 1;
+}
+
+int ingest_uring_available()
+{
+#ifdef PKGPARSE_IO_URING
+	_ring_t ring;
+
+	if(_ring_init(&ring)) {
+		_ring_destroy(&ring);
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+/* Type: _parse_batch_t
+A batch of PKGBUILDs being parsed, see <pkgbuild_parse_files()>.
+*/
+typedef struct {
+	const char **paths;
+	int options;
+	pkgbuild_pool_t *pool;
+	pkgbuild_t **results;
+	/* The parser of each thread, created on its first PKGBUILD and reset by
+	each parse, which share the sourced files evaluated */
+	pkgbuild_parser_t **parsers;
+	pkgbuild_includes_t *includes;
+	/* Whether each PKGBUILD is read together with its .SRCINFO */
+	int srcinfo;
+	int failures;
+} _parse_batch_t;
+
+/* Parse a PKGBUILD, or its .SRCINFO, which were read. */
+static void _parse_files(ingest_file_t *files, size_t index, size_t thread,
+	void *data)
+{
+	_parse_batch_t *batch = data;
+	const char *path = batch->paths[index];
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild = NULL;
+	pkgbuild_t *evaluated;
+	char *directory;
+	char *slash;
+	FILE *fp;
+
+	/* As with pkgbuild_parse_file(), a .SRCINFO at least as recent as the
+	PKGBUILD is preferred */
+	if(batch->srcinfo && files[0].data != NULL && files[1].data != NULL
+			&& files[1].length > 0 && files[1].mtime >= files[0].mtime) {
+		fp = fmemopen(files[1].data, files[1].length, "r");
+		if(fp != NULL) {
+			pkgbuild = pkgbuild_parse_srcinfo(fp);
+			fclose(fp);
+		}
+	}
+	if(pkgbuild == NULL && files[0].data != NULL) {
+		parser = batch->parsers[thread];
+		if(parser == NULL) {
+			parser = pkgbuild_parser_new_with_options(batch->options);
+			pkgbuild_parser_set_includes(parser, batch->includes);
+			batch->parsers[thread] = parser;
+		}
+		directory = strdup(path);
+		slash = strrchr(directory, '/');
+		if(slash == NULL) {
+			pkgbuild_parser_set_directory(parser, ".");
+		} else {
+			/* The root directory keeps its slash */
+			slash[slash == directory] = '\0';
+			pkgbuild_parser_set_directory(parser, directory);
+		}
+		free(directory);
+		pkgbuild_parser_feed(parser, files[0].data, files[0].length);
+		pkgbuild = pkgbuild_parser_finish(parser);
+
+		if(pkgbuild != NULL && batch->pool != NULL
+				&& pkgbuild_unsupported(pkgbuild)) {
+			evaluated = pkgbuild_pool_evaluate(batch->pool, path);
+			if(evaluated != NULL) {
+				pkgbuild_release(pkgbuild);
+				pkgbuild = evaluated;
+			}
+		}
+	}
+	batch->results[index] = pkgbuild;
+	if(pkgbuild == NULL) {
+		__sync_add_and_fetch(&batch->failures, 1);
+	}
+}
+
+int pkgbuild_parse_files(const char **paths, size_t count, int options,
+	pkgbuild_pool_t *pool, size_t threads, pkgbuild_t **results)
+{
+	_parse_batch_t batch;
+	const char **files;
+	const char *slash;
+	size_t thread_count;
+	size_t length;
+	size_t i;
+	int ingested;
+
+	if(paths == NULL || results == NULL) {
+		return -1;
+	}
+	memset(&batch, 0, sizeof(batch));
+	batch.paths = paths;
+	batch.options = options;
+	batch.pool = pool;
+	batch.results = results;
+	batch.srcinfo = !(options & kPkgbuildOptionIgnoreSrcinfo);
+	thread_count = ingest_threads(count, 1, threads);
+	batch.parsers = calloc(thread_count, sizeof(*batch.parsers));
+	batch.includes = pkgbuild_includes_new();
+	if(!batch.srcinfo) {
+		ingested = ingest_files(paths, count, 1, 0, threads, _parse_files,
+			&batch);
+	} else {
+		/* Each PKGBUILD is followed by the .SRCINFO of its directory */
+		files = malloc(2 * count * sizeof(*files));
+		for(i = 0; i < count; i++) {
+			slash = strrchr(paths[i], '/');
+			length = slash != NULL ? (size_t)(slash - paths[i] + 1) : 0;
+			files[2 * i] = paths[i];
+			files[2 * i + 1] = malloc(length + sizeof(".SRCINFO"));
+			memcpy((char *)files[2 * i + 1], paths[i], length);
+			strcpy((char *)files[2 * i + 1] + length, ".SRCINFO");
+		}
+		ingested = ingest_files(files, 2 * count, 2, 1, threads, _parse_files,
+			&batch);
+		for(i = 0; i < count; i++) {
+			free((char *)files[2 * i + 1]);
+		}
+		free(files);
+	}
+
+	for(i = 0; i < thread_count; i++) {
+		pkgbuild_parser_release(batch.parsers[i]);
+	}
+	free(batch.parsers);
+	pkgbuild_includes_release(batch.includes);
+	return ingested ? batch.failures : -1;
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef INGEST_H
+#define INGEST_H
+
+/* File: ingest.h
+Reading of many small files at once, such as the PKGBUILDs of a tree. Files
+are read in batches with io_uring when pkgparse is built with
+PKGPARSE_IO_URING and the kernel allows it: the opens, reads into registered
+buffers and closes of a batch each take a single system call. Otherwise each
+file is read with open(), pread() and close().
+
+Files are handed to a callback as soon as their batch has been read, on one
+of several threads, while the next batch is being read.
+*/
+
+#include <stddef.h>
+
+/* Type: ingest_file_t
+A file which was read.
+
+data - The contents, followed by two NUL characters, or NULL if the file
+	could not be read. It is owned by the caller of the callback.
+length - The length of the contents.
+mtime - The modification time of the file, if requested.
+error - The errno value describing why the file could not be read, or 0.
+*/
+typedef struct {
+	char *data;
+	size_t length;
+	long long mtime;
+	int error;
+} ingest_file_t;
+
+/* Type: ingest_callback_t
+A function handed a group of consecutive files which were read, see
+<ingest_files()>. It is passed the index of the group, and the index of the
+thread calling it, which is less than the amount given by <ingest_threads()>.
+It may be called from several threads at once, but never twice at once with
+the same thread index.
+*/
+typedef void (*ingest_callback_t)(ingest_file_t *files, size_t index,
+	size_t thread, void *data);
+
+/* Function: ingest_threads
+Determine the amount of threads <ingest_files()> calls the callback from.
+
+Parameters:
+	count - The amount of paths.
+	group - The amount of consecutive files handed to the callback at once.
+	threads - The amount of threads requested, or 0 for one per processor.
+
+Returns:
+	The amount of threads, which is at least 1.
+*/
+size_t ingest_threads(size_t count, size_t group, size_t threads);
+
+/* Function: ingest_files
+Read files in batches, and hand them to a callback in groups.
+
+Parameters:
+	paths - The paths of the files.
+	count - The amount of paths, a multiple of group.
+	group - The amount of consecutive files handed to the callback at once,
+		such as a PKGBUILD and its .SRCINFO.
+	mtime - Whether the modification times of the files are needed.
+	threads - The amount of threads calling the callback, or 0 for one per
+		processor.
+	callback - The function handed the files.
+	data - Data passed to callback.
+
+Returns:
+	True (1) on success, or false (0) if the arguments are invalid.
+*/
+int ingest_files(const char **paths, size_t count, size_t group, int mtime,
+	size_t threads, ingest_callback_t callback, void *data);
+
+/* Function: ingest_uring_available
+Determine whether files are read with io_uring.
+
+Returns:
+	True (1) if pkgparse was built with io_uring support and the kernel
+	allows it, otherwise false (0).
+*/
+int ingest_uring_available();
+
+#endif
@@ -0,0 +1,132 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: ingest_test.c
+Unit tests for parsing batches of PKGBUILD files.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include "pkgparse.h"
+
+#define kBatchCount 150
+
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+
+void test_parse_files(void **directory)
+{
+	pkgbuild_t *results[kBatchCount];
+	const char *paths[kBatchCount];
+	char *large;
+	char *one;
+	char *two;
+	char *three;
+	size_t i;
+
+	/* The helper is evaluated once for the threads of the batch */
+	write_pkgbuild_file(*directory, "common.sh", "pkgdesc=Shared\n");
+	one = strdup(write_pkgbuild_file(*directory, "one",
+		"pkgname=one\npkgver=1\nsource common.sh\n"));
+	/* Longer than the buffer a file is first read into */
+	large = malloc(100000);
+	strcpy(large, "pkgname=two\n");
+	for(i = 0; i < 2000; i++) {
+		strcat(large, "# A comment padding the PKGBUILD out\n");
+	}
+	strcat(large, "pkgver=2\n");
+	two = strdup(write_pkgbuild_file(*directory, "two", large));
+	free(large);
+	three = strdup(write_pkgbuild_file(*directory, "three", ""));
+	remove(three);
+
+	for(i = 0; i < kBatchCount; i++) {
+		paths[i] = i % 3 == 0 ? one : i % 3 == 1 ? two : three;
+	}
+	assert_int_equal(pkgbuild_parse_files(paths, kBatchCount,
+		kPkgbuildOptionIgnoreSrcinfo, NULL, 4, results), kBatchCount / 3);
+	for(i = 0; i < kBatchCount; i++) {
+		if(i % 3 == 2) {
+			assert_true(results[i] == NULL);
+		} else {
+			assert_string_equal(pkgbuild_version(results[i]),
+				i % 3 == 0 ? "1" : "2");
+		}
+		if(i % 3 == 0) {
+			assert_string_equal(pkgbuild_desc(results[i]), "Shared");
+		}
+		pkgbuild_release(results[i]);
+	}
+
+	assert_int_equal(pkgbuild_parse_files(paths, 0, kPkgbuildOptionNone,
+		NULL, 0, results), 0);
+	assert_int_equal(pkgbuild_parse_files(NULL, 1, kPkgbuildOptionNone,
+		NULL, 0, results), -1);
+	remove(one);
+	remove(two);
+	free(one);
+	free(two);
+	free(three);
+}
+
+void test_parse_files_srcinfo(void **directory)
+{
+	pkgbuild_t *results[2];
+	const char *paths[2];
+	struct utimbuf times;
+	char *srcinfo;
+
+	srcinfo = strdup(write_pkgbuild_file(*directory, ".SRCINFO",
+		"pkgbase = foo\n"
+		"\tpkgver = 2\n"
+		"\n"
+		"pkgname = foo\n"));
+	paths[0] = write_pkgbuild_file(*directory, "PKGBUILD", "pkgname=foo\npkgver=3\n");
+	paths[1] = paths[0];
+
+	/* The .SRCINFO is preferred, as with pkgbuild_parse_file() */
+	assert_int_equal(pkgbuild_parse_files(paths, 2, kPkgbuildOptionNone, NULL,
+		0, results), 0);
+	assert_string_equal(pkgbuild_version(results[0]), "2");
+	assert_string_equal(pkgbuild_version(results[1]), "2");
+	pkgbuild_release(results[0]);
+	pkgbuild_release(results[1]);
+
+	/* Unless it is older than the PKGBUILD */
+	times.actime = 0;
+	times.modtime = 0;
+	assert_int_equal(utime(srcinfo, &times), 0);
+	assert_int_equal(pkgbuild_parse_files(paths, 1, kPkgbuildOptionNone, NULL,
+		0, results), 0);
+	assert_string_equal(pkgbuild_version(results[0]), "3");
+	pkgbuild_release(results[0]);
+	free(srcinfo);
+}
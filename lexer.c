@@ -0,0 +1,1168 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+
+#include "pkgbuild_parse.h"
+
+/* Character classes. Each character maps to a set of flags, so that the
+ * inner loops of the lexer are a single table lookup per character. */
+enum {
+	kClassNameStart = 1 << 0,
+	kClassName = 1 << 1,
+	kClassBlank = 1 << 2,
+	kClassValue = 1 << 3,
+};
+
+#define NS (kClassNameStart | kClassName | kClassValue)
+#define NC (kClassName | kClassValue)
+#define BL (kClassBlank | kClassValue)
+#define VA kClassValue
+
+/* NUL, '\n', '#', quotes and backslashes belong to no class, so that every
+ * scan stops at the sentinel, and values stop wherever quoting, the end of
+ * line or a comment has to be taken into account. */
+static const unsigned char _classes[256] = {
+	/* 0x00 */ 0, VA, VA, VA, VA, VA, VA, VA, VA, BL, 0, VA, VA, VA, VA, VA,
+	/* 0x10 */ VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	/* ' ' */ BL, VA, 0, 0, VA, VA, VA, 0, VA, VA, VA, VA, VA, NC, VA, VA,
+	/* '0' */ NC, NC, NC, NC, NC, NC, NC, NC, NC, NC, VA, VA, VA, VA, VA, VA,
+	/* '@' */ VA, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS,
+	/* 'P' */ NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, VA, 0, VA, VA, NS,
+	/* '`' */ VA, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS,
+	/* 'p' */ NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, NS, VA, VA, VA, VA, VA,
+	/* 0x80 */ VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+	VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA, VA,
+};
+
+#undef NS
+#undef NC
+#undef BL
+#undef VA
+
+/* What is expected within a case clause, see lexer_t */
+enum {
+	kCaseCommand = 0,
+	kCaseWord,
+	kCaseIn,
+	kCasePattern,
+};
+
+/* Whether a character ends a reserved word. */
+static int _is_delimiter(char c)
+{
+	return c == '\0' || strchr(" \t\n;&|()", c) != NULL;
+}
+
+/* Determine the token type of a NAME, which may be a reserved word. */
+static int _keyword(lexer_t *lexer, const char *start, size_t length)
+{
+	switch(length) {
+		case 2:
+			if(memcmp(start, "fi", 2) == 0) {
+				return FI;
+			}
+			if(memcmp(start, "if", 2) == 0 && _is_delimiter(start[2])) {
+				lexer->test = start[2] == ' ' && start[3] == '[';
+				return IF;
+			}
+			break;
+		case 4:
+			if(memcmp(start, "case", 4) == 0
+					&& (_classes[(unsigned char)start[4]] & kClassBlank)) {
+				lexer->cases++;
+				lexer->case_state = kCaseWord;
+				return CASE;
+			} else if(memcmp(start, "esac", 4) == 0 && lexer->cases > 0
+					&& _is_delimiter(start[4])) {
+				lexer->cases--;
+				return ESAC;
+			} else if(memcmp(start, "then", 4) == 0) {
+				return THEN;
+			} else if(memcmp(start, "else", 4) == 0) {
+				return ELSE;
+			} else if(memcmp(start, "elif", 4) == 0) {
+				lexer->test = start[4] == ' ' && start[5] == '[';
+				return ELIF;
+			}
+			break;
+		case 6:
+			if(memcmp(start, "source", 6) == 0
+					&& (_classes[(unsigned char)start[6]] & kClassBlank)) {
+				return SOURCE;
+			}
+			break;
+		default:
+			break;
+	}
+	return NAME;
+}
+
+/* Whether a function of the given name can define package metadata. Only
+ * package() and package_*() are taken into account by the parser. */
+static int _is_metadata_function(const char *name, size_t length)
+{
+	return (length == 7 && memcmp(name, "package", 7) == 0)
+		|| (length > 8 && memcmp(name, "package_", 8) == 0);
+}
+
+/* Characters of significance when matching braces. NUL is included so that
+ * the scan stops at the sentinel. */
+static const unsigned char _brace_special[256] = {
+	['\0'] = 1, ['\n'] = 1, ['{'] = 1, ['}'] = 1, ['\''] = 1, ['"'] = 1,
+	['`'] = 1, ['\\'] = 1, ['$'] = 1, ['#'] = 1, ['<'] = 1,
+};
+
+/* Count the newlines within a range. */
+static int _count_lines(const char *start, const char *end)
+{
+	int lines = 0;
+	while(start < end && (start = memchr(start, '\n', end - start)) != NULL) {
+		lines++;
+		start++;
+	}
+	return lines;
+}
+
+/* Locate the end of a quoted string starting at start, which must point to
+ * the opening quote. Backslash escapes are honoured unless the quote is a
+ * single quote. Returns NULL if the string is not terminated. */
+static char *_match_quote(char *start, char *end)
+{
+	char quote = *start;
+	char *ptr;
+
+	if(quote == '\'') {
+		return memchr(start + 1, '\'', end - start - 1);
+	}
+	for(ptr = start + 1; ptr < end; ptr++) {
+		if(*ptr == '\\') {
+			ptr++;
+		} else if(*ptr == quote) {
+			return ptr;
+		}
+	}
+	return NULL;
+}
+
+/* Skip the body of a here-document, starting at the line following the
+ * redirection. Returns the newline terminating the delimiter line, or end if
+ * the delimiter is never found. */
+static char *_skip_heredoc(char *line, char *end, const char *delimiter,
+	size_t length, int strip_tabs, int *lines)
+{
+	char *eol;
+	char *ptr;
+
+	while(line < end) {
+		eol = memchr(line, '\n', end - line);
+		if(eol == NULL) {
+			eol = end;
+		}
+		ptr = line;
+		while(strip_tabs && ptr < eol && *ptr == '\t') {
+			ptr++;
+		}
+		if((size_t)(eol - ptr) == length && memcmp(ptr, delimiter, length) == 0) {
+			return eol;
+		}
+		if(eol < end) {
+			(*lines)++;
+		}
+		line = eol + 1;
+	}
+	return end;
+}
+
+/*
+Locate the brace closing the group opened at start, without tokenizing its
+contents. Braces within quoted strings, comments and here-documents are not
+counted.
+
+Parameters:
+	start - The opening brace.
+	end - The end of the input.
+	lines - The address of a line counter, which is incremented for every
+		newline up to the closing brace.
+
+Returns:
+	The closing brace, or NULL if the group is not closed.
+*/
+static char *_match_brace(char *start, char *end, int *lines)
+{
+	char *ptr;
+	char *close;
+	char *delimiter = NULL;
+	size_t delimiter_length = 0;
+	int strip_tabs = 0;
+	int depth = 0;
+	int newlines = 0;
+
+	for(ptr = start; ptr < end; ptr++) {
+		/* Skip insignificant characters */
+		while(!_brace_special[(unsigned char)*ptr]) {
+			ptr++;
+		}
+		if(ptr >= end) {
+			break;
+		}
+
+		switch(*ptr) {
+			case '{':
+				depth++;
+				break;
+			case '}':
+				if(--depth == 0) {
+					*lines += newlines;
+					return ptr;
+				}
+				break;
+			case '\\':
+				if(ptr + 1 < end && *(++ptr) == '\n') {
+					newlines++;
+				}
+				break;
+			case '$':
+				/* ANSI-C quoting, $'...', honours backslash escapes */
+				if(ptr[1] != '\'') {
+					break;
+				}
+				ptr++;
+				close = ptr;
+				do {
+					close = memchr(close + 1, '\'', end - close - 1);
+				} while(close != NULL && *(close - 1) == '\\' && *(close - 2) != '\\');
+				if(close == NULL) {
+					return NULL;
+				}
+				newlines += _count_lines(ptr, close);
+				ptr = close;
+				break;
+			case '\'':
+			case '"':
+			case '`':
+				close = _match_quote(ptr, end);
+				if(close == NULL) {
+					return NULL;
+				}
+				newlines += _count_lines(ptr, close);
+				ptr = close;
+				break;
+			case '#':
+				/* Only a word beginning with '#' starts a comment */
+				if(ptr == start || strchr(" \t\n;", *(ptr - 1)) == NULL) {
+					break;
+				}
+				close = memchr(ptr, '\n', end - ptr);
+				ptr = (close != NULL ? close : end) - 1;
+				break;
+			case '<':
+				/* Here-strings (<<<) are ordinary words */
+				if(ptr[1] != '<' || ptr[2] == '<') {
+					break;
+				}
+				ptr += 2;
+				strip_tabs = *ptr == '-';
+				if(strip_tabs) {
+					ptr++;
+				}
+				while(*ptr == ' ' || *ptr == '\t') {
+					ptr++;
+				}
+				if(*ptr == '\'' || *ptr == '"') {
+					close = _match_quote(ptr, end);
+					if(close == NULL) {
+						return NULL;
+					}
+					delimiter = ptr + 1;
+					delimiter_length = close - delimiter;
+					ptr = close;
+				} else {
+					delimiter = ptr;
+					while(ptr < end && strchr(" \t\n;&|<>()", *ptr) == NULL) {
+						ptr++;
+					}
+					delimiter_length = ptr - delimiter;
+					ptr--;
+				}
+				break;
+			case '\n':
+				newlines++;
+				if(delimiter != NULL) {
+					ptr = _skip_heredoc(ptr + 1, end, delimiter,
+						delimiter_length, strip_tabs, &newlines);
+					delimiter = NULL;
+					if(ptr < end) {
+						newlines++;
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return NULL;
+}
+
+/*
+Locate the end of a simple command, or of a pipeline or list of them, without
+tokenizing it. The command ends at an unquoted ";", newline, comment or ")"
+outside of parentheses and braces, unless a newline follows "&&", "||" or "|".
+The bodies of here-documents are part of the command.
+
+Parameters:
+	start - The first character of the command.
+	end - The end of the input.
+	lines - The address of a line counter, which is incremented for every
+		newline within the command.
+
+Returns:
+	The character ending the command, or NULL if the command is not
+	terminated.
+*/
+static char *_match_command(char *start, char *end, int *lines)
+{
+	char *ptr;
+	char *close;
+	char *delimiter = NULL;
+	size_t delimiter_length = 0;
+	int strip_tabs = 0;
+	int depth = 0;
+	int newlines = 0;
+
+	for(ptr = start; ptr < end; ptr++) {
+		switch(*ptr) {
+			case '(':
+			case '{':
+				depth++;
+				break;
+			case ')':
+				if(depth == 0) {
+					*lines += newlines;
+					return ptr;
+				}
+				depth--;
+				break;
+			case '}':
+				/* A brace which does not close a group is a word */
+				if(depth > 0) {
+					depth--;
+				}
+				break;
+			case '\\':
+				if(ptr + 1 < end && *(++ptr) == '\n') {
+					newlines++;
+				}
+				break;
+			case '$':
+				/* ANSI-C quoting, $'...', honours backslash escapes */
+				if(ptr[1] != '\'') {
+					break;
+				}
+				for(close = ptr + 2; close < end && *close != '\''; close++) {
+					close += *close == '\\';
+				}
+				if(close >= end) {
+					return NULL;
+				}
+				newlines += _count_lines(ptr, close);
+				ptr = close;
+				break;
+			case '\'':
+			case '"':
+			case '`':
+				close = _match_quote(ptr, end);
+				if(close == NULL) {
+					return NULL;
+				}
+				newlines += _count_lines(ptr, close);
+				ptr = close;
+				break;
+			case '#':
+				/* Only a word beginning with '#' starts a comment */
+				if(ptr > start && strchr(" \t\n;&|(", ptr[-1]) == NULL) {
+					break;
+				}
+				if(depth == 0) {
+					*lines += newlines;
+					return ptr;
+				}
+				close = memchr(ptr, '\n', end - ptr);
+				ptr = (close != NULL ? close : end) - 1;
+				break;
+			case '<':
+				/* Here-strings, <<<, are ordinary words */
+				if(ptr[1] != '<' || ptr[2] == '<') {
+					ptr += ptr[1] == '<' ? 2 : 0;
+					break;
+				}
+				ptr += 2;
+				strip_tabs = *ptr == '-';
+				ptr += strip_tabs;
+				while(_classes[(unsigned char)*ptr] & kClassBlank) {
+					ptr++;
+				}
+				if(*ptr == '\'' || *ptr == '"') {
+					close = _match_quote(ptr, end);
+					if(close == NULL) {
+						return NULL;
+					}
+					delimiter = ptr + 1;
+					delimiter_length = close - delimiter;
+					ptr = close;
+				} else {
+					for(delimiter = ptr; ptr < end
+						&& strchr(" \t\n;&|<>()", *ptr) == NULL; ptr++);
+					delimiter_length = ptr - delimiter;
+					ptr--;
+				}
+				break;
+			case ';':
+				if(depth == 0) {
+					*lines += newlines;
+					return ptr;
+				}
+				break;
+			case '\n':
+				if(delimiter != NULL) {
+					newlines++;
+					ptr = _skip_heredoc(ptr + 1, end, delimiter, delimiter_length,
+						strip_tabs, &newlines);
+					delimiter = NULL;
+					if(ptr >= end) {
+						return NULL;
+					}
+				}
+				if(depth == 0) {
+					/* A pipeline or list may continue on the next line */
+					for(close = ptr; close > start
+						&& (_classes[(unsigned char)close[-1]] & kClassBlank); close--);
+					if(close == start || (close[-1] != '|' && (close[-1] != '&'
+							|| close - 1 == start || close[-2] != '&'))) {
+						*lines += newlines;
+						return ptr;
+					}
+				}
+				newlines++;
+				break;
+			default:
+				break;
+		}
+	}
+	return NULL;
+}
+
+/*
+Locate the end of the value of an assignment, which is the end of line or a
+comment. Quoted strings may span lines and contain '#', and a NUL within the
+input is part of the value, as is a '#' which does not begin a word, such as
+that of ${#var}.
+
+Parameters:
+	start - The first character of the value.
+	end - The end of the input.
+	lines - The address of a line counter, which is incremented for every
+		newline within the value.
+
+Returns:
+	The newline or '#' ending the value, or end.
+*/
+static char *_match_value(char *start, char *end, int *lines)
+{
+	char *ptr;
+	char quote = '\0';
+
+	for(ptr = start; ptr < end; ptr++) {
+		/* Skip insignificant characters */
+		while(_classes[(unsigned char)*ptr] & kClassValue) {
+			ptr++;
+		}
+		if(ptr >= end) {
+			break;
+		}
+		if(*ptr == '\n') {
+			if(quote == '\0') {
+				break;
+			}
+			(*lines)++;
+		} else if(quote == '\'') {
+			quote = *ptr == '\'' ? '\0' : quote;
+		} else if(*ptr == '\\' && ptr + 1 < end) {
+			*lines += *(++ptr) == '\n';
+		} else if(quote != '\0') {
+			quote = *ptr == quote ? '\0' : quote;
+		} else if(*ptr == '\'' || *ptr == '"') {
+			quote = *ptr;
+		} else if(*ptr == '#' && (_classes[(unsigned char)ptr[-1]] & kClassBlank)) {
+			break;
+		}
+	}
+	return ptr;
+}
+
+/* Read a command which the parser does not interpret, such as
+ * "make DESTDIR="$pkgdir" install", as a single COMMAND token. The token
+ * excludes the blanks following the command. */
+static int _lexer_next_command(lexer_t *lexer, token_t *token)
+{
+	char *input = lexer->input;
+	char *end = input + lexer->length;
+	char *ptr;
+	int lines = 0;
+
+	ptr = _match_command(input + token->offset, end, &lines);
+	if(ptr == NULL && lexer->partial) {
+		token->type = kTokenNeedInput;
+		return token->type;
+	}
+	if(ptr == NULL) {
+		ptr = end;
+	}
+	lexer->pos = ptr - input;
+	lexer->line += lines;
+	while(ptr > input + token->offset
+			&& (_classes[(unsigned char)ptr[-1]] & kClassBlank)) {
+		ptr--;
+	}
+	token->length = ptr - input - token->offset;
+	token->type = COMMAND;
+	return token->type;
+}
+
+/*
+Read a test command, "[ expression ]" or "[[ expression ]]", as a single TEST
+token. Further test commands joined by "&&" or "||" are part of the token. An
+expression extends to the first unquoted "]" or "]]" preceded by a blank, and
+blanks following the commands are skipped.
+
+Parameters:
+	lexer - The lexer to read from, positioned at the opening bracket.
+	token - The address where the token should be stored.
+
+Returns:
+	TEST, '[' if a command is not terminated on the same line, or
+	<kTokenNeedInput>.
+*/
+static int _lexer_next_test(lexer_t *lexer, token_t *token)
+{
+	char *input = lexer->input;
+	char *end = input + lexer->length;
+	char *ptr = input + lexer->pos;
+	char *close = NULL;
+	char quote;
+	int extended;
+
+	/* The commands are within a single line */
+	if(lexer->partial && memchr(ptr, '\n', end - ptr) == NULL) {
+		token->type = kTokenNeedInput;
+		return token->type;
+	}
+
+	for(;;) {
+		extended = ptr[1] == '[';
+		close = NULL;
+		quote = '\0';
+		for(ptr += extended ? 2 : 1; ptr < end && *ptr != '\n'; ptr++) {
+			if(quote != '\0') {
+				if(*ptr == quote) {
+					quote = '\0';
+				} else if(*ptr == '\\' && quote == '"' && ptr + 1 < end) {
+					ptr++;
+				}
+			} else if(*ptr == '\'' || *ptr == '"') {
+				quote = *ptr;
+			} else if(*ptr == '\\' && ptr + 1 < end) {
+				ptr++;
+			} else if(*ptr == ']' && (!extended || ptr[1] == ']')
+					&& (_classes[(unsigned char)ptr[-1]] & kClassBlank)) {
+				close = ptr + extended;
+				break;
+			}
+		}
+		if(close == NULL) {
+			break;
+		}
+		for(ptr = close + 1; _classes[(unsigned char)*ptr] & kClassBlank; ptr++);
+		if((ptr[0] != '&' || ptr[1] != '&') && (ptr[0] != '|' || ptr[1] != '|')) {
+			break;
+		}
+		for(ptr += 2; _classes[(unsigned char)*ptr] & kClassBlank; ptr++);
+		if(*ptr != '[') {
+			close = NULL;
+			break;
+		}
+	}
+
+	lexer->test = 0;
+	if(close == NULL) {
+		lexer->pos++;
+		token->type = '[';
+		token->length = 1;
+		return token->type;
+	}
+	token->length = close + 1 - input - token->offset;
+	for(ptr = close + 1; _classes[(unsigned char)*ptr] & kClassBlank; ptr++);
+	lexer->pos = ptr - input;
+	token->type = TEST;
+	return token->type;
+}
+
+/*
+Read the next token of the head of a case clause, or of the pattern of one of
+its items.
+
+Parameters:
+	lexer - The lexer to read from, whose case_state is not kCaseCommand.
+	token - The address where the token should be stored.
+
+Returns:
+	WORD, IN, PATTERN, ESAC, an unexpected character, 0 at the end of input,
+	or <kTokenNeedInput>.
+*/
+static int _lexer_next_case(lexer_t *lexer, token_t *token)
+{
+	char *input = lexer->input;
+	char *end = input + lexer->length;
+	char *ptr = input + lexer->pos;
+	char *close;
+	char quote = '\0';
+
+	/* Blanks are insignificant, and so are newlines and comments between
+	 * items */
+	for(;;) {
+		if(ptr < end && (_classes[(unsigned char)*ptr] & kClassBlank)) {
+			ptr++;
+		} else if(lexer->case_state == kCasePattern && ptr < end && *ptr == '\n') {
+			ptr++;
+			lexer->line++;
+		} else if(lexer->case_state == kCasePattern && ptr < end && *ptr == '#') {
+			close = memchr(ptr, '\n', end - ptr);
+			if(close == NULL && lexer->partial) {
+				break;
+			}
+			ptr = close != NULL ? close : end;
+		} else {
+			break;
+		}
+		lexer->pos = ptr - input;
+	}
+	token->offset = lexer->pos;
+	token->length = 0;
+	if(ptr >= end || (*ptr == '#' && lexer->partial)) {
+		token->type = lexer->partial ? kTokenNeedInput : 0;
+		return token->type;
+	}
+
+	switch(lexer->case_state) {
+		case kCaseWord:
+			for(; ptr < end && (quote != '\0' || !_is_delimiter(*ptr)); ptr++) {
+				if(quote != '\0') {
+					quote = *ptr == quote ? '\0' : quote;
+				} else if(*ptr == '\'' || *ptr == '"') {
+					quote = *ptr;
+				} else if(*ptr == '\\' && ptr + 1 < end) {
+					ptr++;
+				}
+			}
+			if(ptr >= end && lexer->partial) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			token->length = ptr - input - token->offset;
+			if(token->length > 0) {
+				lexer->pos = ptr - input;
+				lexer->case_state = kCaseIn;
+				token->type = WORD;
+				return token->type;
+			}
+			break;
+		case kCaseIn:
+			if(lexer->partial && ptr + 3 > end) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			if(ptr[0] == 'i' && ptr[1] == 'n' && _is_delimiter(ptr[2])) {
+				lexer->pos += 2;
+				lexer->case_state = kCasePattern;
+				token->type = IN;
+				token->length = 2;
+				return token->type;
+			}
+			break;
+		case kCasePattern:
+			if(lexer->partial && ptr + 5 > end) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			if(memcmp(ptr, "esac", 4) == 0 && _is_delimiter(ptr[4])) {
+				lexer->pos += 4;
+				lexer->cases--;
+				lexer->case_state = kCaseCommand;
+				lexer->bol = 1;
+				token->type = ESAC;
+				token->length = 4;
+				return token->type;
+			}
+			/* The pattern excludes the parentheses around it */
+			if(*ptr == '(') {
+				token->offset++;
+				ptr++;
+			}
+			for(; ptr < end && *ptr != '\n' && (quote != '\0' || *ptr != ')'); ptr++) {
+				if(quote != '\0') {
+					quote = *ptr == quote ? '\0' : quote;
+				} else if(*ptr == '\'' || *ptr == '"') {
+					quote = *ptr;
+				} else if(*ptr == '\\' && ptr + 1 < end) {
+					ptr++;
+				}
+			}
+			if(ptr >= end && lexer->partial) {
+				token->offset = lexer->pos;
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			if(*ptr == ')') {
+				for(close = ptr; close > input + token->offset
+					&& (_classes[(unsigned char)close[-1]] & kClassBlank); close--);
+				token->length = close - input - token->offset;
+				lexer->pos = ptr + 1 - input;
+				lexer->case_state = kCaseCommand;
+				lexer->bol = 1;
+				token->type = PATTERN;
+				return token->type;
+			}
+			token->offset = lexer->pos;
+			break;
+		default:
+			break;
+	}
+
+	/* The clause is malformed */
+	lexer->case_state = kCaseCommand;
+	lexer->pos++;
+	token->type = input[token->offset];
+	token->length = 1;
+	return token->type;
+}
+
+/*
+Locate the ";;" terminating an item of a case clause within the value of an
+assignment, such as "_arch=amd64 ;;".
+
+Parameters:
+	start - The first character of the value.
+	end - The end of the line.
+
+Returns:
+	The first ';' of the terminator, or NULL if the value is not followed by
+	one.
+*/
+static char *_find_dsemi(char *start, char *end)
+{
+	char quote = '\0';
+	char *ptr;
+
+	for(ptr = start; ptr < end; ptr++) {
+		if(quote != '\0') {
+			quote = *ptr == quote ? '\0' : quote;
+		} else if(*ptr == '\'' || *ptr == '"') {
+			quote = *ptr;
+		} else if(*ptr == '\\' && ptr + 1 < end) {
+			ptr++;
+		} else if(*ptr == ';' && ptr[1] == ';') {
+			return ptr;
+		}
+	}
+	return NULL;
+}
+
+/*
+Read the next token within an array literal, which is either an element or
+the closing parenthesis.
+
+Parameters:
+	lexer - The lexer to read from, positioned within an array literal.
+	token - The address where the token should be stored.
+
+Returns:
+	ELEMENT, ARRAY_CLOSE, 0 at the end of input, or <kTokenNeedInput>.
+*/
+static int _lexer_next_element(lexer_t *lexer, token_t *token)
+{
+	char *input = lexer->input;
+	char *end = input + lexer->length;
+	char *ptr;
+	char *close;
+	int depth = 0;
+	int lines = 0;
+
+	for(;;) {
+		ptr = input + lexer->pos;
+		token->offset = lexer->pos;
+		token->length = 0;
+		if(ptr >= end) {
+			token->type = lexer->partial ? kTokenNeedInput : 0;
+			return token->type;
+		}
+
+		switch(*ptr) {
+			case ' ':
+			case '\t':
+				lexer->pos++;
+				continue;
+			case '\n':
+				lexer->pos++;
+				lexer->line++;
+				continue;
+			case '#':
+				close = memchr(ptr, '\n', end - ptr);
+				if(close == NULL && lexer->partial) {
+					token->type = kTokenNeedInput;
+					return token->type;
+				}
+				lexer->pos = close != NULL ? (size_t)(close - input) : lexer->length;
+				continue;
+			case ')':
+				lexer->pos++;
+				lexer->in_array = 0;
+				/* Blanks may separate the assignment from what follows */
+				lexer->bol = 1;
+				token->type = ARRAY_CLOSE;
+				token->length = 1;
+				return token->type;
+			case '\\':
+				/* A line continuation separates elements */
+				if(ptr + 1 >= end && lexer->partial) {
+					token->type = kTokenNeedInput;
+					return token->type;
+				}
+				if(ptr + 1 < end && ptr[1] == '\n') {
+					lexer->pos += 2;
+					lexer->line++;
+					continue;
+				}
+				break;
+			default:
+				break;
+		}
+		break;
+	}
+
+	/* Quoted strings and command substitutions are part of the element */
+	while(ptr < end) {
+		switch(*ptr) {
+			case '\'':
+			case '"':
+			case '`':
+				close = _match_quote(ptr, end);
+				if(close == NULL) {
+					ptr = end;
+					continue;
+				}
+				lines += _count_lines(ptr, close);
+				ptr = close + 1;
+				continue;
+			case '\\':
+				if(ptr + 1 < end && ptr[1] == '\n') {
+					lines++;
+				}
+				ptr += ptr + 1 < end ? 2 : 1;
+				continue;
+			case '(':
+				depth++;
+				break;
+			case ')':
+				if(depth == 0) {
+					goto element_end;
+				}
+				depth--;
+				break;
+			case '\n':
+				if(depth == 0) {
+					goto element_end;
+				}
+				lines++;
+				break;
+			case ' ':
+			case '\t':
+				if(depth == 0) {
+					goto element_end;
+				}
+				break;
+			default:
+				break;
+		}
+		ptr++;
+	}
+element_end:
+	if(ptr >= end && lexer->partial) {
+		token->type = kTokenNeedInput;
+		return token->type;
+	}
+	lexer->pos = ptr - input;
+	lexer->line += lines;
+	token->type = ELEMENT;
+	token->length = lexer->pos - token->offset;
+	return token->type;
+}
+
+/* Read the file name following "source" or ".", which is produced as the
+ * SOURCE token. The name is a single word, possibly quoted, and any blanks
+ * following it are skipped. */
+static int _lexer_next_source(lexer_t *lexer, token_t *token, char *ptr)
+{
+	char *input = lexer->input;
+	char *end = input + lexer->length;
+	char *close;
+	int lines = 0;
+
+	while(_classes[(unsigned char)*ptr] & kClassBlank) {
+		ptr++;
+	}
+	token->offset = ptr - input;
+	while(ptr < end && !(_classes[(unsigned char)*ptr] & kClassBlank)
+			&& strchr("\n;&|()#", *ptr) == NULL) {
+		if(*ptr == '\'' || *ptr == '"') {
+			close = _match_quote(ptr, end);
+			if(close == NULL) {
+				ptr = end;
+				break;
+			}
+			lines += _count_lines(ptr, close);
+			ptr = close + 1;
+		} else {
+			ptr += *ptr == '\\' && ptr + 1 < end ? 2 : 1;
+		}
+	}
+	token->length = ptr - input - token->offset;
+	while(_classes[(unsigned char)*ptr] & kClassBlank) {
+		ptr++;
+	}
+	if(lexer->partial && ptr >= end) {
+		token->type = kTokenNeedInput;
+		return token->type;
+	}
+	lexer->pos = ptr - input;
+	lexer->line += lines;
+	token->type = SOURCE;
+	return token->type;
+}
+
+void lexer_init(lexer_t *lexer, char *input, size_t length)
+{
+	lexer->input = input;
+	lexer->length = length;
+	lexer->pos = 0;
+	lexer->line = 1;
+	lexer->bol = 1;
+	lexer->skip_functions = 0;
+	lexer->skip_package_functions = 0;
+	lexer->skip_body = 0;
+	lexer->partial = 0;
+	lexer->in_array = 0;
+	lexer->test = 0;
+	lexer->cases = 0;
+	lexer->case_state = kCaseCommand;
+}
+
+int lexer_next(lexer_t *lexer, token_t *token)
+{
+	char *input = lexer->input;
+	char *ptr;
+	char *end;
+	unsigned char c;
+	int command;
+	int lines;
+
+	if(lexer->in_array) {
+		return _lexer_next_element(lexer, token);
+	} else if(lexer->case_state != kCaseCommand) {
+		return _lexer_next_case(lexer, token);
+	}
+
+	for(;;) {
+		ptr = input + lexer->pos;
+		token->offset = lexer->pos;
+		token->length = 0;
+		if(lexer->pos >= lexer->length) {
+			token->type = lexer->partial ? kTokenNeedInput : 0;
+			return token->type;
+		}
+
+		c = *ptr;
+		/* Leading whitespace is insignificant */
+		if(lexer->bol && (_classes[c] & kClassBlank)) {
+			while(_classes[(unsigned char)*ptr] & kClassBlank) {
+				ptr++;
+			}
+			if(lexer->partial && ptr >= input + lexer->length) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			lexer->pos = ptr - input;
+			continue;
+		}
+		command = lexer->bol;
+		lexer->bol = 0;
+
+		if(c == '[' && lexer->test) {
+			return _lexer_next_test(lexer, token);
+		} else if(c == '#') {
+			/* Comments extend to, but do not include, the end of line */
+			end = memchr(ptr, '\n', lexer->length - lexer->pos);
+			if(end == NULL && lexer->partial) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			lexer->pos = end != NULL ? (size_t)(end - input) : lexer->length;
+			continue;
+		} else if(c == '\n') {
+			lexer->pos++;
+			lexer->line++;
+			lexer->bol = 1;
+			token->type = NEWLINE;
+			token->length = 1;
+		} else if(c == '{' && lexer->skip_body
+				&& (end = _match_brace(ptr, input + lexer->length, &lexer->line)) != NULL) {
+			/* The whole body of the function is a single token */
+			lexer->pos = end + 1 - input;
+			lexer->skip_body = 0;
+			token->type = FUNCTION_BODY;
+			token->length = lexer->pos - token->offset;
+		} else if(c == '{' && lexer->skip_body && lexer->partial) {
+			/* The closing brace may be yet to come */
+			token->type = kTokenNeedInput;
+			return token->type;
+		} else if(c == '+' && lexer->partial && lexer->pos + 1 >= lexer->length) {
+			/* Whether an assignment follows is yet to be seen */
+			token->type = kTokenNeedInput;
+			return token->type;
+		} else if(c == '+' && ptr[1] == '=') {
+			/* The assignment itself is produced by the following '=' */
+			lexer->pos++;
+			token->type = APPEND;
+			token->length = 1;
+		} else if(c == '=' && lexer->partial && lexer->pos + 1 >= lexer->length) {
+			/* Whether an array follows is yet to be seen */
+			token->type = kTokenNeedInput;
+			return token->type;
+		} else if(c == '=' && ptr[1] == '(') {
+			lexer->skip_body = 0;
+			lexer->pos += 2;
+			lexer->in_array = 1;
+			token->offset++;
+			token->type = ARRAY_OPEN;
+			token->length = 1;
+		} else if(c == '=') {
+			lexer->skip_body = 0;
+			ptr++;
+			token->offset = ptr - input;
+			lines = 0;
+			ptr = _match_value(ptr, input + lexer->length, &lines);
+			if(lexer->partial && ptr >= input + lexer->length) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			token->length = ptr - input - token->offset;
+			lexer->pos = ptr - input;
+			lexer->line += lines;
+			/* Within a case clause, the value may be followed by ";;" */
+			if(lexer->cases > 0
+					&& (end = _find_dsemi(input + token->offset, ptr)) != NULL) {
+				lexer->pos = end - input;
+				while(end > input + token->offset
+						&& (_classes[(unsigned char)end[-1]] & kClassBlank)) {
+					end--;
+				}
+				token->length = end - input - token->offset;
+			}
+			token->type = ASSIGNMENT;
+		} else if(_classes[c] & kClassNameStart) {
+			ptr++;
+			while(_classes[(unsigned char)*ptr] & kClassName) {
+				ptr++;
+			}
+			/* Reserved words and function declarations are recognised by
+			 * the two characters following the name */
+			if(lexer->partial && ptr + 2 > input + lexer->length) {
+				token->type = kTokenNeedInput;
+				return token->type;
+			}
+			token->length = ptr - input - token->offset;
+			token->type = _keyword(lexer, input + token->offset, token->length);
+			if(token->type == SOURCE) {
+				return _lexer_next_source(lexer, token, ptr);
+			}
+			/* A name which is not assigned or declared as a function begins
+			 * a command */
+			if(token->type == NAME && ptr[0] != '=' && ptr[0] != '('
+					&& (ptr[0] != '+' || ptr[1] != '=')) {
+				return _lexer_next_command(lexer, token);
+			}
+			lexer->pos = ptr - input;
+			/* A command may follow a keyword, so blanks are skipped */
+			lexer->bol = token->type != NAME;
+			/* Skip the body of a function which cannot define metadata */
+			lexer->skip_body = lexer->skip_functions && token->type == NAME
+				&& ptr[0] == '(' && ptr[1] == ')'
+				&& (lexer->skip_package_functions
+					|| !_is_metadata_function(input + token->offset, token->length));
+		} else if(c == '.' && lexer->partial && lexer->pos + 1 >= lexer->length) {
+			/* Whether a file is sourced is yet to be seen */
+			token->type = kTokenNeedInput;
+			return token->type;
+		} else if(c == '.' && (_classes[(unsigned char)ptr[1]] & kClassBlank)) {
+			return _lexer_next_source(lexer, token, ptr + 1);
+		} else if(c == ';' && lexer->cases > 0 && lexer->partial
+				&& lexer->pos + 1 >= lexer->length) {
+			/* Whether the item of a case clause ends is yet to be seen */
+			token->type = kTokenNeedInput;
+			return token->type;
+		} else if(c == ';' && lexer->cases > 0 && ptr[1] == ';') {
+			lexer->pos += 2;
+			lexer->case_state = kCasePattern;
+			token->type = DSEMI;
+			token->length = 2;
+		} else if(command && strchr("{});&|", c) == NULL) {
+			return _lexer_next_command(lexer, token);
+		} else {
+			lexer->pos++;
+			/* A command follows a separator or an opening brace, so blanks
+			 * are skipped */
+			lexer->bol = c == ';' || c == '{';
+			token->type = c;
+			token->length = 1;
+		}
+		return token->type;
+	}
+}
@@ -0,0 +1,174 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef LEXER_H
+#define LEXER_H
+
+/* File: lexer.h
+A hand-written lexer for PKGBUILDs. It operates on an in-memory buffer and
+produces tokens as spans into that buffer instead of copying their text.
+
+It replaces the flex scanner, pkgbuild_scanner.l, which is kept so that the
+unit tests can compare the tokens of both when configured with
+-DPKGPARSE_FLEX_SCANNER=ON.
+*/
+
+#include <stddef.h>
+
+/* Type: span_t
+A range of characters within the input, used as the semantic value of tokens
+in place of copies of their text. The characters are not NUL terminated.
+
+start - The first character of the range.
+length - The amount of characters in the range.
+*/
+typedef struct {
+	char *start;
+	size_t length;
+} span_t;
+
+/* Constant: kTokenNeedInput
+The token type returned by <lexer_next()> when the input of a partial lexer is
+exhausted before a token can be recognised.
+*/
+#define kTokenNeedInput (-1)
+
+/* Type: token_t
+A token recognised by the lexer.
+
+type - The token type, as defined by the grammar (NAME, ASSIGNMENT, ...), a
+	literal character, 0 at the end of input, or <kTokenNeedInput>.
+offset - The offset of the token text within the input.
+length - The length of the token text. The text of an ASSIGNMENT excludes the
+	leading '='.
+*/
+typedef struct {
+	int type;
+	size_t offset;
+	size_t length;
+} token_t;
+
+/* Type: lexer_t
+The state of a lexer. It is initialized with <lexer_init()>.
+*/
+typedef struct {
+	/* The input, terminated by a NUL sentinel at input[length]. It is not
+	modified by the lexer, but the parser may terminate spans in place. */
+	char *input;
+	size_t length;
+	/* The offset of the next character to be read */
+	size_t pos;
+	/* The current line number, starting at 1 */
+	int line;
+	/* Whether pos is at the beginning of a line or command, where blanks
+	are insignificant */
+	int bol;
+	/* Whether bodies of functions other than package() and package_*() are
+	to be skipped, see <lexer_init()> */
+	int skip_functions;
+	/* Whether bodies of package() and package_*() are to be skipped as well,
+	if skip_functions is set */
+	int skip_package_functions;
+	/* Whether the next brace group is the body of a skipped function */
+	int skip_body;
+	/* Whether more input may follow, see <lexer_next()> */
+	int partial;
+	/* Whether pos is within an array literal */
+	int in_array;
+	/* Whether a test command, "[ expression ]", may follow */
+	int test;
+	/* The amount of case clauses pos is within */
+	int cases;
+	/* Whether pos is within the head of a case clause, or between its
+	items, rather than at a command */
+	int case_state;
+} lexer_t;
+
+/* Function: lexer_init
+Initialize a lexer to read from a buffer.
+
+Parameters:
+	lexer - The lexer to be initialized.
+	input - The buffer to be read. It must remain valid while the lexer is in
+		use, and input[length] must be a NUL character.
+	length - The length of the input, excluding the NUL sentinel.
+
+The lexer can be made to skip the bodies of functions other than package() and
+package_*() by setting skip_functions after initialization, and those of all
+functions by additionally setting skip_package_functions. Each such body is
+then produced as a single FUNCTION_BODY token spanning its braces, matched
+without tokenizing the contents.
+*/
+void lexer_init(lexer_t *lexer, char *input, size_t length);
+
+/* Function: lexer_next
+Read the next token from the input.
+
+Parameters:
+	lexer - The lexer to read from.
+	token - The address where the token should be stored.
+
+If the partial flag of the lexer is set, the input is assumed to be followed
+by more input. A token which may continue beyond the end of the available
+input is then not recognised, and <kTokenNeedInput> is returned instead of the
+end of input. The lexer does not advance in that case, so the token is read
+again once input has been appended and length updated.
+
+An assignment, such as "pkgdesc="A foo" # comment", is produced as a NAME
+token followed by an ASSIGNMENT token for the value, which extends to the end
+of line or an unquoted comment. A quoted value may span lines. An append
+assignment, such as "depends+=foo", is produced as an APPEND token for "+"
+followed by the tokens of a plain assignment.
+
+The test commands of an if or elif clause, such as "if [ $CARCH = i686 ]" or
+"if [[ -n $_opt ]] && [ $CARCH = i686 ]", are produced as a single TEST token
+spanning the commands, including their brackets.
+
+Any other command, such as "make DESTDIR="$pkgdir" install" or the condition
+of "if grep -q foo Makefile", is produced as a single COMMAND token without
+tokenizing it. The token extends to an unquoted ";", newline or comment
+outside of parentheses and braces, and includes the lines of a pipeline or
+list continued after "|", "||" or "&&", and the bodies of here-documents.
+Trailing blanks are excluded.
+
+A case clause is produced as a CASE token, a WORD token for its subject, an IN
+token, and for each item a PATTERN token spanning the patterns without their
+parentheses, the tokens of its commands, and a DSEMI token for ";;". The
+clause ends with an ESAC token. Newlines and comments between items do not
+produce tokens.
+
+A command sourcing a file, such as "source ../common.sh" or ". ./vars.sh", is
+produced as a single SOURCE token spanning the file name, as written.
+
+An array assignment, such as "source=(a b)", is produced as an ARRAY_OPEN
+token for "(", an ELEMENT token for each element, and an ARRAY_CLOSE token for
+")". Elements are separated by whitespace, newlines and comments, none of
+which produce tokens within the array. An element extends to unquoted
+whitespace, or an unquoted parenthesis which is not part of a command
+substitution, and its quotes are retained.
+
+Returns:
+	The type of the token, which is 0 at the end of input.
+*/
+int lexer_next(lexer_t *lexer, token_t *token);
+
+#endif
@@ -0,0 +1,405 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: lexer_test.c
+Unit tests for the hand-written lexer.
+
+See Also:
+	<lexer.h>
+*/
+
+#include "cmockery.h"
+#include <string.h>
+
+#include "lexer.h"
+#include "pkgbuild_parse.h"
+
+void test_lexer_assignment(void **state)
+{
+	char input[] = "  pkgname=foo # comment\nn=${#a}\nif [";
+	char quoted[] = "pkgdesc=\"A thing # x\" # c\nb='1\n#2'\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(token.offset, 2);
+	assert_int_equal(token.length, 7);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.offset, 10);
+	assert_int_equal(token.length, 4);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer.line, 2);
+	/* A '#' within a word does not start a comment */
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.offset, 26);
+	assert_int_equal(token.length, 5);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), IF);
+	/* The test command is not terminated */
+	assert_int_equal(lexer_next(&lexer, &token), '[');
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+
+	/* A quoted '#' does not start a comment, and quotes may span lines */
+	lexer_init(&lexer, quoted, strlen(quoted));
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.length, 14);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.length, 6);
+	assert_int_equal(lexer.line, 3);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_function(void **state)
+{
+	char input[] = "package_foo() {\n\tfi\n}";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(token.length, 11);
+	assert_int_equal(lexer_next(&lexer, &token), '(');
+	assert_int_equal(lexer_next(&lexer, &token), ')');
+	assert_int_equal(lexer_next(&lexer, &token), ' ');
+	assert_int_equal(lexer_next(&lexer, &token), '{');
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), FI);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), '}');
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_skip_function(void **state)
+{
+	char input[] =
+		"build() {\n"
+		"  echo '}' \"${x}}\" # }\n"
+		"  cat <<-EOF\n"
+		"\t}\n"
+		"\tEOF\n"
+		"}\n"
+		"package() {\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+	lexer.skip_functions = 1;
+
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), '(');
+	assert_int_equal(lexer_next(&lexer, &token), ')');
+	assert_int_equal(lexer_next(&lexer, &token), ' ');
+	assert_int_equal(lexer_next(&lexer, &token), FUNCTION_BODY);
+	assert_int_equal(token.offset, 8);
+	assert_int_equal(input[token.offset + token.length - 1], '}');
+	assert_int_equal(lexer.line, 6);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), '(');
+	assert_int_equal(lexer_next(&lexer, &token), ')');
+	assert_int_equal(lexer_next(&lexer, &token), ' ');
+	assert_int_equal(lexer_next(&lexer, &token), '{');
+}
+
+void test_lexer_partial(void **state)
+{
+	char input[] = "pkgname=foo\npkgver=1.0\0";
+	lexer_t lexer;
+	token_t token;
+
+	/* Only "pkgname=foo\npkgv" is available */
+	lexer_init(&lexer, input, 16);
+	lexer.partial = 1;
+
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), kTokenNeedInput);
+	assert_int_equal(lexer.pos, 12);
+
+	lexer.length = strlen(input);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(token.length, 6);
+	assert_int_equal(lexer_next(&lexer, &token), kTokenNeedInput);
+
+	lexer.partial = 0;
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.length, 3);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_array(void **state)
+{
+	char input[] = "source=( # sources\n"
+		"  \"foo bar\" $(echo a b) \\\n"
+		"  'baz)'\n"
+		")\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_OPEN);
+	assert_int_equal(lexer_next(&lexer, &token), ELEMENT);
+	assert_int_equal(token.length, 9);
+	assert_int_equal(lexer_next(&lexer, &token), ELEMENT);
+	assert_int_equal(token.length, 11);
+	assert_int_equal(lexer_next(&lexer, &token), ELEMENT);
+	assert_int_equal(token.length, 6);
+	assert_int_equal(lexer.line, 3);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_CLOSE);
+	assert_int_equal(lexer.line, 4);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_test(void **state)
+{
+	char input[] = "if [ \"$CARCH\" = 'a ]' ]; then\nelif [ -n x ]\n"
+		"elif [[ $a == b* ]] && [ c ] ; then\nfi";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), IF);
+	assert_int_equal(lexer_next(&lexer, &token), TEST);
+	assert_int_equal(token.offset, 3);
+	assert_int_equal(token.length, 20);
+	assert_int_equal(lexer_next(&lexer, &token), ';');
+	assert_int_equal(lexer_next(&lexer, &token), THEN);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), ELIF);
+	assert_int_equal(lexer_next(&lexer, &token), TEST);
+	assert_int_equal(token.length, 8);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), ELIF);
+	assert_int_equal(lexer_next(&lexer, &token), TEST);
+	assert_int_equal(token.length, 23);
+	assert_int_equal(lexer_next(&lexer, &token), ';');
+	assert_int_equal(lexer_next(&lexer, &token), THEN);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), FI);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_case(void **state)
+{
+	char input[] = "case \"$CARCH\" in\n  # comment\n  (i686|arm*) a=b ;;\n"
+		"  x86_64)\n    a=(c) ;;\n  *) esac\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), CASE);
+	assert_int_equal(lexer_next(&lexer, &token), WORD);
+	assert_int_equal(token.length, 8);
+	assert_int_equal(lexer_next(&lexer, &token), IN);
+	assert_int_equal(lexer_next(&lexer, &token), PATTERN);
+	assert_int_equal(token.offset, 32);
+	assert_int_equal(token.length, 9);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ASSIGNMENT);
+	assert_int_equal(token.length, 1);
+	assert_int_equal(lexer_next(&lexer, &token), DSEMI);
+	assert_int_equal(lexer_next(&lexer, &token), PATTERN);
+	assert_int_equal(token.length, 6);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_OPEN);
+	assert_int_equal(lexer_next(&lexer, &token), ELEMENT);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_CLOSE);
+	assert_int_equal(lexer_next(&lexer, &token), DSEMI);
+	assert_int_equal(lexer_next(&lexer, &token), PATTERN);
+	assert_int_equal(token.length, 1);
+	assert_int_equal(lexer_next(&lexer, &token), ESAC);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+	assert_int_equal(lexer.line, 7);
+}
+
+void test_lexer_source(void **state)
+{
+	char input[] = "source ../common.sh\n  . \"./my vars.sh\" # comment\n"
+		"source=(a)\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), SOURCE);
+	assert_int_equal(token.offset, 7);
+	assert_int_equal(token.length, 12);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), SOURCE);
+	assert_int_equal(token.offset, 24);
+	assert_int_equal(token.length, 14);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), NAME);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_OPEN);
+	assert_int_equal(lexer_next(&lexer, &token), ELEMENT);
+	assert_int_equal(lexer_next(&lexer, &token), ARRAY_CLOSE);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+}
+
+void test_lexer_command(void **state)
+{
+	char input[] = "  make DESTDIR=\"$pkgdir\" install  # done\n"
+		"if grep -q x f &&\n  true; then\ncat <<EOF\n;\nEOF\nfi\n";
+	lexer_t lexer;
+	token_t token;
+
+	lexer_init(&lexer, input, strlen(input));
+
+	assert_int_equal(lexer_next(&lexer, &token), COMMAND);
+	assert_int_equal(token.offset, 2);
+	assert_int_equal(token.length, 30);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), IF);
+	/* A list continues on the next line after "&&" */
+	assert_int_equal(lexer_next(&lexer, &token), COMMAND);
+	assert_int_equal(token.length, 21);
+	assert_int_equal(lexer.line, 3);
+	assert_int_equal(lexer_next(&lexer, &token), ';');
+	assert_int_equal(lexer_next(&lexer, &token), THEN);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	/* The here-document is part of the command */
+	assert_int_equal(lexer_next(&lexer, &token), COMMAND);
+	assert_int_equal(token.length, 15);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer.line, 7);
+	assert_int_equal(lexer_next(&lexer, &token), FI);
+	assert_int_equal(lexer_next(&lexer, &token), NEWLINE);
+	assert_int_equal(lexer_next(&lexer, &token), 0);
+
+	/* An unterminated command waits for more input */
+	lexer_init(&lexer, input, 18);
+	lexer.partial = 1;
+	assert_int_equal(lexer_next(&lexer, &token), kTokenNeedInput);
+	lexer.length = strlen(input);
+	assert_int_equal(lexer_next(&lexer, &token), COMMAND);
+}
+
+#ifdef PKGPARSE_FLEX_SCANNER
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_buffer(char *base, size_t size);
+void yy_delete_buffer(YY_BUFFER_STATE buffer);
+int yylex();
+extern YYSTYPE yylval;
+extern int line;
+extern int cases;
+
+/* PKGBUILDs using only constructs recognised by both scanners */
+static const char *_flex_inputs[] = {
+	"# Maintainer: Foo <foo@example.org>\n"
+	"pkgname=foo\n"
+	"pkgver=1.0 # upstream\n"
+	"pkgdesc=\"A thing # not a comment\"\n"
+	"url='https://example.org/\n#top'\n"
+	"_n=${#pkgname}\n"
+	"depends+=(glibc 'zlib' # compression\n"
+	"  \"$(echo bar)\")\n"
+	"source=()\n",
+
+	"if [[ -n $_opt ]] && [ $CARCH = i686 ]; then\n"
+	"  depends=(a)\n"
+	"elif [ \"$CARCH\" = \"x86_64\" ]; then\n"
+	"  depends=(b)\n"
+	"else\n"
+	"  depends=(c)\n"
+	"fi\n",
+
+	"case $CARCH in\n"
+	"  i686|arm*) _bits=32 ;;\n"
+	"  # comment\n"
+	"  (x86_64)\n"
+	"    _bits=64\n"
+	"    ;;\n"
+	"esac\n",
+
+	"source ../common.sh\n"
+	"  . \"./my vars.sh\" # comment\n"
+	"package_foo() {\n"
+	"    pkgdesc=\"some foo\"\n"
+	"    pkgver=0.7\n"
+	"}\n",
+};
+
+void test_lexer_flex(void **state)
+{
+	YY_BUFFER_STATE buffer;
+	lexer_t lexer;
+	token_t token;
+	char input[256];
+	char scanned[256];
+	size_t length;
+	size_t i;
+	int type;
+
+	for(i = 0; i < sizeof(_flex_inputs) / sizeof(*_flex_inputs); i++) {
+		length = strlen(_flex_inputs[i]);
+		assert_true(length + 2 <= sizeof(input));
+		memcpy(input, _flex_inputs[i], length + 1);
+		lexer_init(&lexer, input, length);
+		/* Flex scans in place, up to two NUL characters */
+		memcpy(scanned, _flex_inputs[i], length + 1);
+		scanned[length + 1] = '\0';
+		buffer = yy_scan_buffer(scanned, length + 2);
+		line = 1;
+		cases = 0;
+		do {
+			type = yylex();
+			assert_int_equal(lexer_next(&lexer, &token), type);
+			assert_int_equal(lexer.line, line);
+			switch(type) {
+				case NAME:
+				case ASSIGNMENT:
+				case APPEND:
+				case ARRAY_OPEN:
+				case ELEMENT:
+				case ARRAY_CLOSE:
+				case TEST:
+				case WORD:
+				case PATTERN:
+				case SOURCE:
+					assert_int_equal(token.offset, yylval.start - scanned);
+					assert_int_equal(token.length, yylval.length);
+					break;
+				default:
+					break;
+			}
+		} while(type != 0);
+		yy_delete_buffer(buffer);
+	}
+}
+#endif
@@ -19,11 +19,14 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "condition.h"
 #include "pkgparse.h"
 #include "pkgbuild_private.h"
+#include "symbol.h"
 
 static void _free_array(char **array)
 {
@@ -48,6 +51,33 @@ static void _free_splitpkgs(pkgbuild_t **splitpkgs)
 	}
 }
 
+static void _free_branches(arch_branch_t *branches, size_t count)
+{
+	size_t i;
+	size_t j;
+	for(i = 0; i < count; i++) {
+		for(j = 0; j < branches[i].test_count; j++) {
+			free(branches[i].tests[j].pattern);
+		}
+		free(branches[i].tests);
+		table_release(branches[i].table);
+	}
+	free(branches);
+}
+
+/*
+Release the table of a pkgbuild, together with the arena it is allocated
+within, if the pkgbuild owns one.
+
+Parameters:
+	pkgbuild - The pkgbuild. It must not be NULL.
+*/
+static void _pkgbuild_release_table(pkgbuild_t *pkgbuild)
+{
+	pkgbuild_set_table(pkgbuild, NULL);
+	pkgbuild_set_arena(pkgbuild, NULL);
+}
+
 /*
 Free a pkgbuild_t structure
 
@@ -59,6 +89,7 @@ static void _pkgbuild_free(pkgbuild_t *pkgbuild)
 	free(pkgbuild->basename);
 	_free_array(pkgbuild->names);
 	free(pkgbuild->version);
+	free(pkgbuild->epoch);
 	free(pkgbuild->desc);
 	free(pkgbuild->url);
 	_free_array(pkgbuild->licenses);
@@ -75,12 +106,20 @@ static void _pkgbuild_free(pkgbuild_t *pkgbuild)
 	_free_array(pkgbuild->backup);
 	_free_array(pkgbuild->depends);
 	_free_array(pkgbuild->makedepends);
+	_free_array(pkgbuild->checkdepends);
 	_free_array(pkgbuild->optdepends);
 	_free_array(pkgbuild->conflicts);
 	_free_array(pkgbuild->provides);
 	_free_array(pkgbuild->replaces);
 	_free_array(pkgbuild->options);
 	_free_splitpkgs(pkgbuild->splitpkgs);
+	_free_branches(pkgbuild->branches, pkgbuild->branch_count);
+	table_release(pkgbuild->arch_variables);
+	pkgbuild_release(pkgbuild->base);
+	free(pkgbuild->arch);
+	_pkgbuild_release_table(pkgbuild);
+	derivations_free(pkgbuild->derivations, pkgbuild->derivation_count);
+	parse_index_free(pkgbuild->index);
 	free(pkgbuild);
 }
 
@@ -94,32 +133,222 @@ pkgbuild_t *pkgbuild_new()
 
 void pkgbuild_release(pkgbuild_t *pkgbuild)
 {
-	if(pkgbuild != NULL) {
-		pkgbuild->refcount--;
-		if(pkgbuild->refcount == 0) {
-			_pkgbuild_free(pkgbuild);
-		}
+	/* The count is atomic, so that cached pkgbuilds may be shared between
+	threads, see pkgbuild_cache_get() */
+	if(pkgbuild != NULL && __sync_sub_and_fetch(&pkgbuild->refcount, 1) == 0) {
+		_pkgbuild_free(pkgbuild);
 	}
 }
 
 pkgbuild_t *pkgbuild_retain(pkgbuild_t *pkgbuild)
 {
 	if(pkgbuild != NULL) {
-		pkgbuild->refcount++;
+		__sync_add_and_fetch(&pkgbuild->refcount, 1);
 	}
 	return pkgbuild;
 }
 
+/*
+Load the specified fields if they have not been loaded yet.
+
+Parameters:
+	pkgbuild - The pkgbuild being accessed. It must not be NULL.
+	fields - A combination of <pkgbuild_field_t> flags.
+*/
+static void _pkgbuild_resolve(pkgbuild_t *pkgbuild, unsigned int fields)
+{
+	if(pkgbuild->table != NULL && (fields & ~pkgbuild->loaded) != 0) {
+		pkgbuild_load_fields(pkgbuild, fields);
+	}
+}
+
+void pkgbuild_set_table(pkgbuild_t *pkgbuild, table_t *table)
+{
+	if(pkgbuild != NULL) {
+		table_retain(table);
+		table_release(pkgbuild->table);
+		pkgbuild->table = table;
+	}
+}
+
+void pkgbuild_set_arena(pkgbuild_t *pkgbuild, arena_t *arena)
+{
+	if(pkgbuild != NULL) {
+		arena_retain(arena);
+		arena_release(pkgbuild->arena);
+		pkgbuild->arena = arena;
+	}
+}
+
+void pkgbuild_detach(pkgbuild_t *pkgbuild)
+{
+	int i;
+	if(pkgbuild != NULL) {
+		_pkgbuild_release_table(pkgbuild);
+		if(pkgbuild->splitpkgs != NULL) {
+			for(i = 0; pkgbuild->splitpkgs[i] != NULL; i++) {
+				pkgbuild_detach(pkgbuild->splitpkgs[i]);
+			}
+		}
+	}
+}
+
+void pkgbuild_add_branch(pkgbuild_t *pkgbuild, arch_test_t *tests,
+	size_t test_count, table_t *table)
+{
+	arch_branch_t *branch;
+	size_t i;
+
+	if(pkgbuild == NULL) {
+		return;
+	}
+	pkgbuild->branches = realloc(pkgbuild->branches,
+		(pkgbuild->branch_count + 1) * sizeof(*pkgbuild->branches));
+	branch = &pkgbuild->branches[pkgbuild->branch_count++];
+	branch->tests = malloc(test_count * sizeof(*branch->tests));
+	branch->test_count = test_count;
+	for(i = 0; i < test_count; i++) {
+		branch->tests[i].pattern = strdup(tests[i].pattern);
+		branch->tests[i].match = tests[i].match;
+	}
+	branch->table = table_new();
+	table_copy(branch->table, table, NULL);
+}
+
+/* Copy a variable of a table or, failing that, of its parents. */
+static int _copy_variable(table_t *table, table_t *source, char *name)
+{
+	if(source == NULL) {
+		return 0;
+	}
+	return table_copy(table, source, name)
+		|| _copy_variable(table, table_parent(source), name);
+}
+
+/*
+Copy the architecture specific variables of the architectures listed in a
+table, see pkgbuild_copy_arch_variables().
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	table - The table holding the variables.
+	inherit - Whether variables of the parents of table are copied as well,
+		unlike those of the PKGBUILD for a split package.
+*/
+static void _copy_arch_variables(pkgbuild_t *pkgbuild, table_t *table,
+	int inherit)
+{
+	table_t *variables;
+	char **arches;
+	char name[64];
+	unsigned int field;
+	size_t i;
+	int copied = 0;
+
+	if(pkgbuild == NULL) {
+		return;
+	}
+	arches = symbol_array(table_lookupr(table,
+		(char *)pkgbuild_field_lvalue(kPkgbuildFieldArchitectures)));
+	if(arches == NULL) {
+		return;
+	}
+	variables = table_new();
+	for(field = 1; field & kPkgbuildFieldAll; field <<= 1) {
+		if(!(field & kPkgbuildFieldArchSpecific)) {
+			continue;
+		}
+		for(i = 0; arches[i] != NULL; i++) {
+			if((size_t)snprintf(name, sizeof(name), "%s_%s",
+					pkgbuild_field_lvalue(field), arches[i]) < sizeof(name)) {
+				copied |= inherit ? _copy_variable(variables, table, name)
+					: table_copy(variables, table, name);
+			}
+		}
+	}
+	if(copied) {
+		table_release(pkgbuild->arch_variables);
+		pkgbuild->arch_variables = table_retain(variables);
+	}
+	table_release(variables);
+}
+
+void pkgbuild_copy_arch_variables(pkgbuild_t *pkgbuild, table_t *table)
+{
+	_copy_arch_variables(pkgbuild, table, 1);
+}
+
+void pkgbuild_set_unsupported(pkgbuild_t *pkgbuild, int unsupported)
+{
+	if(pkgbuild != NULL) {
+		pkgbuild->unsupported = unsupported;
+	}
+}
+
+int pkgbuild_unsupported(pkgbuild_t *pkgbuild)
+{
+	if(pkgbuild == NULL) {
+		return 0;
+	}
+	/* A view relies on whatever the pkgbuild it is based on relies on */
+	if(pkgbuild->base != NULL) {
+		return pkgbuild_unsupported(pkgbuild->base);
+	}
+	return pkgbuild->unsupported;
+}
+
+/* Determine whether a branch is taken when building for an architecture. */
+static int _branch_taken(arch_branch_t *branch, const char *arch)
+{
+	size_t i;
+	for(i = 0; i < branch->test_count; i++) {
+		if(condition_match(branch->tests[i].pattern, arch) != branch->tests[i].match) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+pkgbuild_t *pkgbuild_for_arch(pkgbuild_t *pkgbuild, const char *arch)
+{
+	pkgbuild_t *view;
+	table_t *table;
+	size_t i;
+
+	if(pkgbuild == NULL || arch == NULL) {
+		return NULL;
+	}
+
+	table = table_new();
+	if(pkgbuild->arch_variables != NULL) {
+		table_copy(table, pkgbuild->arch_variables, NULL);
+	}
+	for(i = 0; i < pkgbuild->branch_count; i++) {
+		if(_branch_taken(&pkgbuild->branches[i], arch)) {
+			table_copy(table, pkgbuild->branches[i].table, NULL);
+		}
+	}
+
+	view = pkgbuild_new();
+	view->base = pkgbuild_retain(pkgbuild);
+	view->arch = strdup(arch);
+	pkgbuild_set_table(view, table);
+	table_release(table);
+	return view;
+}
+
 void pkgbuild_set_rel(struct _pkgbuild_t *pkgbuild, float rel)
 {
 	if(pkgbuild != NULL) {
 		pkgbuild->rel = rel;
+		pkgbuild->loaded |= kPkgbuildFieldRel;
 	}
 }
 
 float pkgbuild_rel(pkgbuild_t *pkgbuild) {
 	float rel = 0;
 	if(pkgbuild != NULL) {
+		_pkgbuild_resolve(pkgbuild, kPkgbuildFieldRel);
 		rel = pkgbuild->rel;
 	}
 	return rel;
@@ -128,16 +357,19 @@ float pkgbuild_rel(pkgbuild_t *pkgbuild) {
 void pkgbuild_set_basename(struct _pkgbuild_t *pkgbuild, char *basename)
 {
 	if(pkgbuild != NULL) {
-		pkgbuild->basename = strdup(basename);
+		free(pkgbuild->basename);
+		pkgbuild->basename = basename != NULL ? strdup(basename) : NULL;
+		pkgbuild->loaded |= kPkgbuildFieldBasename;
 	}
 }
 
 char *pkgbuild_basename(pkgbuild_t *pkgbuild) {
 	char *basename = NULL;
 	if(pkgbuild != NULL) {
+		_pkgbuild_resolve(pkgbuild, kPkgbuildFieldBasename | kPkgbuildFieldNames);
 		if(pkgbuild->basename != NULL) {
 			basename = pkgbuild->basename;
-		} else {
+		} else if(pkgbuild->names != NULL) {
 			basename = pkgbuild->names[0];
 		}
 	}
@@ -148,6 +380,7 @@ pkgbuild_t **pkgbuild_splitpkgs(pkgbuild_t *pkgbuild)
 {
 	pkgbuild_t **splitpkgs = NULL;
 	if(pkgbuild != NULL) {
+		_pkgbuild_resolve(pkgbuild, kPkgbuildFieldSplitpkgs);
 		splitpkgs = pkgbuild->splitpkgs;
 	}
 	return splitpkgs;
@@ -156,48 +389,55 @@ pkgbuild_t **pkgbuild_splitpkgs(pkgbuild_t *pkgbuild)
 void pkgbuild_set_splitpkgs(struct _pkgbuild_t *pkgbuild, pkgbuild_t **splitpkgs)
 {
 	if(pkgbuild != NULL) {
+		_free_splitpkgs(pkgbuild->splitpkgs);
 		pkgbuild->splitpkgs = splitpkgs;
+		pkgbuild->loaded |= kPkgbuildFieldSplitpkgs;
 	}
 }
 
 /* Some preprocessing magic to get rid of code duplication. The macros below
  * will define setter and getter functions for fields in a structure. */
 
-#define MK_STRING_GETTER(object, field) \
+#define MK_STRING_GETTER(object, field, flag) \
 char *object ## _ ## field(object ## _t *object) \
 { \
-	char *field; \
+	char *field = NULL; \
 	if(object != NULL) { \
+		_ ## object ## _resolve(object, flag); \
 		field = object->field; \
 	} \
 	return field; \
 }
 
-#define MK_STRING_SETTER(object, field) \
+#define MK_STRING_SETTER(object, field, flag) \
 void object ## _set_ ## field(struct _ ## object ## _t *object, char *field) \
 { \
 	if(object == NULL) { \
 		return; \
 	} \
 	free(object->field); \
-	object->field = strdup(field); \
+	object->field = field != NULL ? strdup(field) : NULL; \
+	object->loaded |= flag; \
 }
 
-#define MK_ARRAY_GETTER(object, field) \
+#define MK_ARRAY_GETTER(object, field, flag) \
 char **object ## _ ## field(object ## _t *object) \
 { \
 	char **field = NULL; \
 	if(object != NULL) { \
+		_ ## object ## _resolve(object, flag); \
 		field = object->field; \
 	} \
 	return field; \
 }
 
-#define MK_ARRAY_SETTER(object, field) \
+#define MK_ARRAY_SETTER(object, field, flag) \
 void object ## _set_ ## field(struct _ ## object ## _t *object, char **field) \
 { \
 	int i; \
 	if(object != NULL) { \
+		_free_array(object->field); \
+		object->loaded |= flag; \
 		if(field == NULL) { \
 			object->field = NULL; \
 		} else { \
@@ -213,34 +453,416 @@ void object ## _set_ ## field(struct _ ## object ## _t *object, char **field) \
 }
 
 /* While we're at it, why not make them "properties"? */
-#define MK_STRING_PROPERTY(object, field) \
-	MK_STRING_SETTER(object, field) \
-	MK_STRING_GETTER(object, field)
-#define MK_ARRAY_PROPERTY(object, field) \
-	MK_ARRAY_SETTER(object, field) \
-	MK_ARRAY_GETTER(object, field)
-
-
-MK_ARRAY_PROPERTY(pkgbuild, names)
-MK_STRING_PROPERTY(pkgbuild, version)
-MK_STRING_PROPERTY(pkgbuild, desc)
-MK_STRING_PROPERTY(pkgbuild, url)
-MK_ARRAY_PROPERTY(pkgbuild, licenses)
-MK_STRING_PROPERTY(pkgbuild, install)
-MK_ARRAY_PROPERTY(pkgbuild, sources)
-MK_ARRAY_PROPERTY(pkgbuild, noextract)
-MK_ARRAY_PROPERTY(pkgbuild, md5sums)
-MK_ARRAY_PROPERTY(pkgbuild, sha1sums)
-MK_ARRAY_PROPERTY(pkgbuild, sha256sums)
-MK_ARRAY_PROPERTY(pkgbuild, sha384sums)
-MK_ARRAY_PROPERTY(pkgbuild, sha512sums)
-MK_ARRAY_PROPERTY(pkgbuild, groups)
-MK_ARRAY_PROPERTY(pkgbuild, architectures)
-MK_ARRAY_PROPERTY(pkgbuild, backup)
-MK_ARRAY_PROPERTY(pkgbuild, depends)
-MK_ARRAY_PROPERTY(pkgbuild, makedepends)
-MK_ARRAY_PROPERTY(pkgbuild, optdepends)
-MK_ARRAY_PROPERTY(pkgbuild, conflicts)
-MK_ARRAY_PROPERTY(pkgbuild, provides)
-MK_ARRAY_PROPERTY(pkgbuild, replaces)
-MK_ARRAY_PROPERTY(pkgbuild, options)
+#define MK_STRING_PROPERTY(object, field, flag) \
+	MK_STRING_SETTER(object, field, flag) \
+	MK_STRING_GETTER(object, field, flag)
+#define MK_ARRAY_PROPERTY(object, field, flag) \
+	MK_ARRAY_SETTER(object, field, flag) \
+	MK_ARRAY_GETTER(object, field, flag)
+
+
+MK_ARRAY_PROPERTY(pkgbuild, names, kPkgbuildFieldNames)
+MK_STRING_PROPERTY(pkgbuild, version, kPkgbuildFieldVersion)
+MK_STRING_PROPERTY(pkgbuild, epoch, kPkgbuildFieldEpoch)
+MK_STRING_PROPERTY(pkgbuild, desc, kPkgbuildFieldDesc)
+MK_STRING_PROPERTY(pkgbuild, url, kPkgbuildFieldUrl)
+MK_ARRAY_PROPERTY(pkgbuild, licenses, kPkgbuildFieldLicenses)
+MK_STRING_PROPERTY(pkgbuild, install, kPkgbuildFieldInstall)
+MK_ARRAY_PROPERTY(pkgbuild, sources, kPkgbuildFieldSources)
+MK_ARRAY_PROPERTY(pkgbuild, noextract, kPkgbuildFieldNoextract)
+MK_ARRAY_PROPERTY(pkgbuild, md5sums, kPkgbuildFieldMd5sums)
+MK_ARRAY_PROPERTY(pkgbuild, sha1sums, kPkgbuildFieldSha1sums)
+MK_ARRAY_PROPERTY(pkgbuild, sha256sums, kPkgbuildFieldSha256sums)
+MK_ARRAY_PROPERTY(pkgbuild, sha384sums, kPkgbuildFieldSha384sums)
+MK_ARRAY_PROPERTY(pkgbuild, sha512sums, kPkgbuildFieldSha512sums)
+MK_ARRAY_PROPERTY(pkgbuild, groups, kPkgbuildFieldGroups)
+MK_ARRAY_PROPERTY(pkgbuild, architectures, kPkgbuildFieldArchitectures)
+MK_ARRAY_PROPERTY(pkgbuild, backup, kPkgbuildFieldBackup)
+MK_ARRAY_PROPERTY(pkgbuild, depends, kPkgbuildFieldDepends)
+MK_ARRAY_PROPERTY(pkgbuild, makedepends, kPkgbuildFieldMakedepends)
+MK_ARRAY_PROPERTY(pkgbuild, checkdepends, kPkgbuildFieldCheckdepends)
+MK_ARRAY_PROPERTY(pkgbuild, optdepends, kPkgbuildFieldOptdepends)
+MK_ARRAY_PROPERTY(pkgbuild, conflicts, kPkgbuildFieldConflicts)
+MK_ARRAY_PROPERTY(pkgbuild, provides, kPkgbuildFieldProvides)
+MK_ARRAY_PROPERTY(pkgbuild, replaces, kPkgbuildFieldReplaces)
+MK_ARRAY_PROPERTY(pkgbuild, options, kPkgbuildFieldOptions)
+
+pkgbuild_t *pkgbuild_copy(pkgbuild_t *pkgbuild)
+{
+	pkgbuild_t *copy;
+	size_t count;
+	size_t i;
+
+	if(pkgbuild == NULL) {
+		return NULL;
+	}
+	copy = pkgbuild_new();
+	pkgbuild_set_basename(copy, pkgbuild->basename);
+	pkgbuild_set_names(copy, pkgbuild->names);
+	pkgbuild_set_version(copy, pkgbuild->version);
+	pkgbuild_set_rel(copy, pkgbuild->rel);
+	pkgbuild_set_epoch(copy, pkgbuild->epoch);
+	pkgbuild_set_desc(copy, pkgbuild->desc);
+	pkgbuild_set_url(copy, pkgbuild->url);
+	pkgbuild_set_licenses(copy, pkgbuild->licenses);
+	pkgbuild_set_install(copy, pkgbuild->install);
+	pkgbuild_set_sources(copy, pkgbuild->sources);
+	pkgbuild_set_noextract(copy, pkgbuild->noextract);
+	pkgbuild_set_md5sums(copy, pkgbuild->md5sums);
+	pkgbuild_set_sha1sums(copy, pkgbuild->sha1sums);
+	pkgbuild_set_sha256sums(copy, pkgbuild->sha256sums);
+	pkgbuild_set_sha384sums(copy, pkgbuild->sha384sums);
+	pkgbuild_set_sha512sums(copy, pkgbuild->sha512sums);
+	pkgbuild_set_groups(copy, pkgbuild->groups);
+	pkgbuild_set_architectures(copy, pkgbuild->architectures);
+	pkgbuild_set_backup(copy, pkgbuild->backup);
+	pkgbuild_set_depends(copy, pkgbuild->depends);
+	pkgbuild_set_makedepends(copy, pkgbuild->makedepends);
+	pkgbuild_set_checkdepends(copy, pkgbuild->checkdepends);
+	pkgbuild_set_optdepends(copy, pkgbuild->optdepends);
+	pkgbuild_set_conflicts(copy, pkgbuild->conflicts);
+	pkgbuild_set_provides(copy, pkgbuild->provides);
+	pkgbuild_set_replaces(copy, pkgbuild->replaces);
+	pkgbuild_set_options(copy, pkgbuild->options);
+	if(pkgbuild->splitpkgs != NULL) {
+		for(count = 0; pkgbuild->splitpkgs[count] != NULL; count++);
+		copy->splitpkgs = malloc((count + 1) * sizeof(*copy->splitpkgs));
+		for(i = 0; i < count; i++) {
+			copy->splitpkgs[i] = pkgbuild_copy(pkgbuild->splitpkgs[i]);
+		}
+		copy->splitpkgs[count] = NULL;
+	}
+	/* Fields which have not been loaded are loaded from the same table */
+	copy->loaded = pkgbuild->loaded;
+	pkgbuild_set_table(copy, pkgbuild->table);
+	pkgbuild_set_arena(copy, pkgbuild->arena);
+
+	for(i = 0; i < pkgbuild->branch_count; i++) {
+		pkgbuild_add_branch(copy, pkgbuild->branches[i].tests,
+			pkgbuild->branches[i].test_count, pkgbuild->branches[i].table);
+	}
+	if(pkgbuild->arch_variables != NULL) {
+		copy->arch_variables = table_new();
+		table_copy(copy->arch_variables, pkgbuild->arch_variables, NULL);
+	}
+	copy->base = pkgbuild_retain(pkgbuild->base);
+	copy->arch = pkgbuild->arch != NULL ? strdup(pkgbuild->arch) : NULL;
+	copy->unsupported = pkgbuild->unsupported;
+	copy->split = pkgbuild->split;
+	if(pkgbuild->derivations != NULL) {
+		copy->derivations = malloc(pkgbuild->derivation_count
+			* sizeof(*copy->derivations));
+		for(i = 0; i < pkgbuild->derivation_count; i++) {
+			derivation_copy(&copy->derivations[i], &pkgbuild->derivations[i]);
+		}
+		copy->derivation_count = pkgbuild->derivation_count;
+	}
+	copy->index = parse_index_copy(pkgbuild->index);
+	return copy;
+}
+
+/*
+Create a pkgbuild for each package_* function of a split package. Each split
+package is associated with the function's symbol table.
+
+Parameters:
+	pkgbuild - The pkgbuild being loaded. It must not be NULL.
+	table - The table holding the package functions.
+	fields - The fields to be loaded into each split package.
+*/
+static void _load_splitpkgs(pkgbuild_t *pkgbuild, table_t *table,
+	unsigned int fields)
+{
+	#define FNAME_LENTH 32
+	int i;
+	size_t size = 0;
+	symbol_t *symbol;
+	pkgbuild_t **splitpkgs;
+	char *ptr;
+	char **names;
+	char function_name[FNAME_LENTH] = {'\0'};
+	const char *function_prefix = "package_";
+
+	ptr = function_name;
+	names = pkgbuild_names(pkgbuild);
+	if(names == NULL) {
+		return;
+	}
+	for(i = 0; names[i] != NULL; i++) {
+		size++;
+	}
+
+	splitpkgs = malloc(sizeof(*splitpkgs) * (size + 1));
+	splitpkgs = memset(splitpkgs, 0, sizeof(*splitpkgs) * (size + 1));
+	splitpkgs[size] = NULL;
+
+	for(i = 0; names[i] != NULL; i++) {
+		ptr = strncat(ptr, function_prefix, FNAME_LENTH - 1);
+		ptr = strncat(ptr, names[i], FNAME_LENTH - 1 - strlen(ptr));
+		symbol = symbol_retain(table_lookup(table, ptr));
+		ptr[0] = '\0';
+		if(symbol != NULL) {
+			splitpkgs[i] = pkgbuild_new();
+			splitpkgs[i]->split = 1;
+			pkgbuild_set_table(splitpkgs[i], symbol_function(symbol));
+			pkgbuild_set_arena(splitpkgs[i], pkgbuild->arena);
+			/* Such as depends_x86_64 within package_foo() */
+			_copy_arch_variables(splitpkgs[i], symbol_function(symbol), 0);
+			pkgbuild_load_fields(splitpkgs[i], fields);
+		}
+		symbol_release(symbol);
+	}
+
+	pkgbuild_set_splitpkgs(pkgbuild, splitpkgs);
+}
+
+/* Names of the variables fields are loaded from, indexed by the bit position
+ * of their pkgbuild_field_t flag. */
+static const char *_field_lvalues[] = {
+	"pkgname", "pkgbase", "pkgver", "pkgrel", "pkgdesc", "url", "license",
+	"install", "source", "noextract", "md5sums", "sha1sums", "sha256sums",
+	"sha384sums", "sha512sums", "groups", "arch", "backup", "depends",
+	"makedepends", "optdepends", "conflicts", "provides", "replaces", "options",
+	NULL, /* splitpkgs */
+	"epoch", "checkdepends",
+};
+
+const char *pkgbuild_field_lvalue(pkgbuild_field_t field)
+{
+	unsigned int i;
+	for(i = 0; i < sizeof(_field_lvalues) / sizeof(*_field_lvalues); i++) {
+		if(field == 1u << i) {
+			return _field_lvalues[i];
+		}
+	}
+	return NULL;
+}
+
+/* Find the variable a field is loaded from. The variables of a PKGBUILD
+ * include those of a sourced helper script, which is the parent of its
+ * table, while those of split packages do not extend to the PKGBUILD. */
+static symbol_t *_lookup(pkgbuild_t *pkgbuild, table_t *table, const char *name)
+{
+	if(pkgbuild->split) {
+		return table_lookup(table, (char *)name);
+	}
+	return table_lookupr(table, (char *)name);
+}
+
+/* Load a field from a string or array symbol. */
+#define LOAD_STRING(flag, setter) \
+	if(fields & flag) { \
+		symbol = _lookup(pkgbuild, table, (char *)pkgbuild_field_lvalue(flag)); \
+		if(symbol != NULL) { \
+			setter(pkgbuild, symbol_string(symbol)); \
+		} \
+	}
+#define LOAD_ARRAY(flag, setter) \
+	if(fields & flag) { \
+		symbol = _lookup(pkgbuild, table, (char *)pkgbuild_field_lvalue(flag)); \
+		if(symbol != NULL) { \
+			setter(pkgbuild, symbol_array(symbol)); \
+		} \
+	}
+
+/* Copy a field of the pkgbuild a view is based on. */
+#define INHERIT(flag, field) \
+	if(fields & flag) { \
+		pkgbuild_set_ ## field(pkgbuild, base->field); \
+	}
+
+/*
+Copy fields of the pkgbuild a view is based on, to be overridden by the
+variables of the view.
+
+Parameters:
+	pkgbuild - The view being loaded.
+	fields - The fields to be copied.
+*/
+static void _inherit_fields(pkgbuild_t *pkgbuild, unsigned int fields)
+{
+	pkgbuild_t *base = pkgbuild->base;
+
+	_pkgbuild_resolve(base, fields);
+	INHERIT(kPkgbuildFieldNames, names)
+	INHERIT(kPkgbuildFieldBasename, basename)
+	INHERIT(kPkgbuildFieldVersion, version)
+	INHERIT(kPkgbuildFieldEpoch, epoch)
+	INHERIT(kPkgbuildFieldRel, rel)
+	INHERIT(kPkgbuildFieldDesc, desc)
+	INHERIT(kPkgbuildFieldUrl, url)
+	INHERIT(kPkgbuildFieldLicenses, licenses)
+	INHERIT(kPkgbuildFieldInstall, install)
+	INHERIT(kPkgbuildFieldSources, sources)
+	INHERIT(kPkgbuildFieldNoextract, noextract)
+	INHERIT(kPkgbuildFieldMd5sums, md5sums)
+	INHERIT(kPkgbuildFieldSha1sums, sha1sums)
+	INHERIT(kPkgbuildFieldSha256sums, sha256sums)
+	INHERIT(kPkgbuildFieldSha384sums, sha384sums)
+	INHERIT(kPkgbuildFieldSha512sums, sha512sums)
+	INHERIT(kPkgbuildFieldGroups, groups)
+	INHERIT(kPkgbuildFieldArchitectures, architectures)
+	INHERIT(kPkgbuildFieldBackup, backup)
+	INHERIT(kPkgbuildFieldDepends, depends)
+	INHERIT(kPkgbuildFieldMakedepends, makedepends)
+	INHERIT(kPkgbuildFieldCheckdepends, checkdepends)
+	INHERIT(kPkgbuildFieldOptdepends, optdepends)
+	INHERIT(kPkgbuildFieldConflicts, conflicts)
+	INHERIT(kPkgbuildFieldProvides, provides)
+	INHERIT(kPkgbuildFieldReplaces, replaces)
+	INHERIT(kPkgbuildFieldOptions, options)
+}
+
+/*
+Append the architecture specific variable of a field to it, such as
+source_x86_64 to source.
+
+Parameters:
+	table - The table holding the variables of the view.
+	field - The field being loaded.
+	arch - The architecture of the view.
+	array - The address of the array holding the field.
+*/
+static void _load_arch_specific(table_t *table, pkgbuild_field_t field,
+	const char *arch, char ***array)
+{
+	char name[64];
+	char *str_array[2] = {NULL, NULL};
+	char **suffix;
+	symbol_t *symbol;
+	size_t length = 0;
+	size_t count;
+	size_t i;
+
+	if((size_t)snprintf(name, sizeof(name), "%s_%s", pkgbuild_field_lvalue(field),
+			arch) >= sizeof(name)) {
+		return;
+	}
+	symbol = table_lookup(table, name);
+	if(symbol == NULL) {
+		return;
+	}
+	if(symbol_type(symbol) == kSymbolTypeArray) {
+		suffix = symbol_array(symbol);
+	} else {
+		str_array[0] = symbol_string(symbol);
+		suffix = str_array;
+	}
+	if(suffix == NULL || suffix[0] == NULL) {
+		return;
+	}
+
+	for(length = 0; *array != NULL && (*array)[length] != NULL; length++);
+	for(count = 0; suffix[count] != NULL; count++);
+	*array = realloc(*array, (length + count + 1) * sizeof(**array));
+	for(i = 0; i < count; i++) {
+		(*array)[length + i] = strdup(suffix[i]);
+	}
+	(*array)[length + count] = NULL;
+}
+
+/* Append architecture specific variables to the fields of a view. */
+#define LOAD_ARCH_SPECIFIC(flag, field) \
+	if(fields & flag) { \
+		_load_arch_specific(table, flag, pkgbuild->arch, &pkgbuild->field); \
+	}
+
+void pkgbuild_load_fields(pkgbuild_t *pkgbuild, unsigned int fields)
+{
+	symbol_t *symbol;
+	table_t *table;
+	char *str_array[2] = {NULL, NULL};
+
+	if(pkgbuild == NULL || pkgbuild->table == NULL) {
+		return;
+	}
+	table = table_retain(pkgbuild->table);
+	fields &= ~pkgbuild->loaded;
+
+	/* The variables of a view override those of the pkgbuild it is based
+	on, which are copied first */
+	if(pkgbuild->base != NULL) {
+		pkgbuild->loaded |= fields & kPkgbuildFieldSplitpkgs;
+		fields &= ~kPkgbuildFieldSplitpkgs;
+		_inherit_fields(pkgbuild, fields);
+	}
+
+	/* Split packages can only be located by name */
+	if(fields & kPkgbuildFieldSplitpkgs) {
+		fields |= kPkgbuildFieldNames & ~pkgbuild->loaded;
+	}
+
+	if(fields & kPkgbuildFieldNames) {
+		symbol = _lookup(pkgbuild, table, (char *)pkgbuild_field_lvalue(kPkgbuildFieldNames));
+		if(symbol != NULL) {
+			if(symbol_type(symbol) == kSymbolTypeArray) {
+				pkgbuild_set_names(pkgbuild, symbol_array(symbol));
+			} else {
+				str_array[0] = symbol_string(symbol);
+				pkgbuild_set_names(pkgbuild, str_array);
+			}
+		}
+	}
+
+	LOAD_STRING(kPkgbuildFieldBasename, pkgbuild_set_basename)
+	LOAD_STRING(kPkgbuildFieldVersion, pkgbuild_set_version)
+	LOAD_STRING(kPkgbuildFieldEpoch, pkgbuild_set_epoch)
+
+	if(fields & kPkgbuildFieldRel) {
+		symbol = _lookup(pkgbuild, table, (char *)pkgbuild_field_lvalue(kPkgbuildFieldRel));
+		if(symbol != NULL && symbol_string(symbol) != NULL) {
+			/* FIXME: Why doesn't it work with atoif()? */
+			pkgbuild_set_rel(pkgbuild, atoi(symbol_string(symbol)));
+		}
+	}
+
+	LOAD_STRING(kPkgbuildFieldDesc, pkgbuild_set_desc)
+	LOAD_STRING(kPkgbuildFieldUrl, pkgbuild_set_url)
+	LOAD_ARRAY(kPkgbuildFieldLicenses, pkgbuild_set_licenses)
+	LOAD_STRING(kPkgbuildFieldInstall, pkgbuild_set_install)
+	LOAD_ARRAY(kPkgbuildFieldSources, pkgbuild_set_sources)
+	LOAD_ARRAY(kPkgbuildFieldNoextract, pkgbuild_set_noextract)
+	LOAD_ARRAY(kPkgbuildFieldMd5sums, pkgbuild_set_md5sums)
+	LOAD_ARRAY(kPkgbuildFieldSha1sums, pkgbuild_set_sha1sums)
+	LOAD_ARRAY(kPkgbuildFieldSha256sums, pkgbuild_set_sha256sums)
+	LOAD_ARRAY(kPkgbuildFieldSha384sums, pkgbuild_set_sha384sums)
+	LOAD_ARRAY(kPkgbuildFieldSha512sums, pkgbuild_set_sha512sums)
+	LOAD_ARRAY(kPkgbuildFieldGroups, pkgbuild_set_groups)
+	LOAD_ARRAY(kPkgbuildFieldArchitectures, pkgbuild_set_architectures)
+	LOAD_ARRAY(kPkgbuildFieldBackup, pkgbuild_set_backup)
+	LOAD_ARRAY(kPkgbuildFieldDepends, pkgbuild_set_depends)
+	LOAD_ARRAY(kPkgbuildFieldMakedepends, pkgbuild_set_makedepends)
+	LOAD_ARRAY(kPkgbuildFieldCheckdepends, pkgbuild_set_checkdepends)
+	LOAD_ARRAY(kPkgbuildFieldOptdepends, pkgbuild_set_optdepends)
+	LOAD_ARRAY(kPkgbuildFieldConflicts, pkgbuild_set_conflicts)
+	LOAD_ARRAY(kPkgbuildFieldProvides, pkgbuild_set_provides)
+	LOAD_ARRAY(kPkgbuildFieldReplaces, pkgbuild_set_replaces)
+	LOAD_ARRAY(kPkgbuildFieldOptions, pkgbuild_set_options)
+
+	if(pkgbuild->arch != NULL) {
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldSources, sources)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldMd5sums, md5sums)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldSha1sums, sha1sums)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldSha256sums, sha256sums)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldSha384sums, sha384sums)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldSha512sums, sha512sums)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldDepends, depends)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldMakedepends, makedepends)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldCheckdepends, checkdepends)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldOptdepends, optdepends)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldConflicts, conflicts)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldProvides, provides)
+		LOAD_ARCH_SPECIFIC(kPkgbuildFieldReplaces, replaces)
+	}
+
+	if(fields & kPkgbuildFieldSplitpkgs) {
+		_load_splitpkgs(pkgbuild, table, fields);
+	}
+
+	/* Absent variables leave their fields unset, but still loaded */
+	pkgbuild->loaded |= fields;
+	if((pkgbuild->loaded & kPkgbuildFieldAll) == kPkgbuildFieldAll) {
+		pkgbuild_set_table(pkgbuild, NULL);
+	}
+	table_release(table);
+}
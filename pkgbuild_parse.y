@@ -19,35 +19,243 @@
  * SOFTWARE.
  */
 
-%{
+%code requires {
+	#include "pkgparse.h"
+	#include "lexer.h"
+
+	#define YYSTYPE span_t
+}
+
+%code {
+	#include <pthread.h>
 	#include <stdlib.h>
 	#include <string.h>
+	#include <sys/stat.h>
 
+	#include "condition.h"
 	#include "pkgparse.h"
 	#include "pkgbuild_private.h"
 	#include "symbol.h"
 	#include "utility.h"
 
-	#define YYSTYPE char *
-
-	extern FILE *yyin;
 	extern int yydebug;
-	extern int line;
 
-	static void _handle_assignment(char *lvalue, char *rvalue);
-	static void _set_splitpkgs_from_table(pkgbuild_t *pkgbuild, table_t *table);
-	static void _set_pkgbuild_fields_from_table(pkgbuild_t *pkgbuild, table_t *g_table);
-	static void _enter_function(char *name);
-	static void _exit_function();
+	/* A conditional being parsed */
+	typedef struct {
+		/* The length of the guard of the parser before the conditional */
+		size_t guard_length;
+		/* Whether the test of the current branch is part of the guard */
+		int tested;
+		/* Whether the current branch has a namespace of its own */
+		int scoped;
+		/* Whether the current branch is never taken */
+		int dead;
+		/* Whether the current branch may or may not be taken */
+		int uncertain;
+		/* Whether a preceding branch is taken whenever it is reached, so
+		that the remaining ones never are */
+		int taken;
+		/* Whether the test of a preceding branch could not be evaluated */
+		int unknown;
+		/* The word following "case", or NULL for an if clause */
+		char *subject;
+	} _conditional_t;
+
+	/* A helper script sourced by PKGBUILDs, evaluated once for all of them */
+	typedef struct {
+		/* The canonical path to the script */
+		char *path;
+		/* The file the script was evaluated from, so that changes are
+		noticed */
+		dev_t device;
+		ino_t inode;
+		time_t mtime;
+		off_t size;
+		/* The variables assigned by the script, or NULL if it cannot be
+		evaluated on its own */
+		table_t *table;
+	} _include_t;
+
+	struct _pkgbuild_includes_t {
+		/* The amount of references held, by parsers of any thread */
+		unsigned int refcount;
+		/* Held while a script is looked up or evaluated, so that it is
+		evaluated only once */
+		pthread_mutex_t mutex;
+		_include_t *includes;
+		size_t count;
+		size_t size;
+	};
+
+	/* A token waiting to be pushed to the parser */
+	typedef struct {
+		token_t token;
+		int line;
+	} _queued_token_t;
+
+	struct _pkgbuild_parser_t {
+		/* The amount of references held for this parser */
+		unsigned int refcount;
+		/* The state of the bison push parser */
+		yypstate *pstate;
+		/* The result of the last push, YYPUSH_MORE while parsing */
+		int status;
+		/* Options, see pkgbuild_option_t */
+		int options;
+		/* Fields to be loaded, see pkgbuild_parse_fields() */
+		unsigned int fields;
+		/* Requested fields whose variables have been assigned at the top
+		level */
+		unsigned int assigned;
+		/* The namespace assignments are made in */
+		table_t *table;
+		/* The arena symbols are allocated within, which is reset between
+		PKGBUILDs, or NULL if the table is part of the result */
+		arena_t *arena;
+		/* Input which has not been parsed yet, followed by two NUL characters */
+		char *buffer;
+		size_t length;
+		size_t size;
+		lexer_t lexer;
+		/* Tokens read, but not pushed to the parser yet. Their offsets are
+		relative to buffer. */
+		_queued_token_t *queue;
+		size_t queued;
+		size_t queue_size;
+		/* The line of the token last pushed, for error messages */
+		int line;
+		/* Whether the assignment being handled appends to the variable */
+		int append;
+		/* The parsed elements of the array being assigned */
+		char **elements;
+		size_t element_count;
+		size_t element_size;
+		/* The unexpanded elements of the deferred array being assigned */
+		char *raw;
+		size_t raw_length;
+		size_t raw_size;
+		/* The amount of function definitions being parsed */
+		int functions;
+		/* The conditionals being parsed, innermost last */
+		_conditional_t *conditionals;
+		size_t conditional_count;
+		size_t conditional_size;
+		/* The tests on the architecture guarding the current branch */
+		arch_test_t *guard;
+		size_t guard_length;
+		size_t guard_size;
+		/* Branches guarded on the architecture, which are assigned within
+		namespaces of their own and recorded in the result */
+		arch_branch_t *branches;
+		size_t branch_count;
+		size_t branch_size;
+		/* Whether an architecture specific variable, such as source_x86_64,
+		may have been assigned */
+		int arch_specific;
+		/* The amount of enclosing branches which are never taken, whose
+		assignments are discarded */
+		int dead;
+		/* The amount of enclosing branches which may or may not be taken */
+		int uncertain;
+		/* Variables assigned within branches which may not be taken, whose
+		values are not known to tests */
+		char **unknown;
+		size_t unknown_count;
+		size_t unknown_size;
+		/* Whether a construct which is not evaluated, such as a command
+		substitution, may affect the result */
+		int unsupported;
+		/* The directory names of sourced files are relative to, or NULL */
+		char *directory;
+		/* Helper scripts sourced so far, kept for the PKGBUILDs to come, or
+		NULL until a script is sourced */
+		pkgbuild_includes_t *includes;
+		/* Whether the parser evaluates a helper script, whose values must
+		not depend on the PKGBUILD sourcing it */
+		int include;
+		/* Whether assignments outside of functions are recorded, see
+		pkgbuild_parser_set_recording() */
+		int recording;
+		assignment_record_t *records;
+		size_t record_count;
+		size_t record_size;
+		/* The offset and length of each element of the array being
+		assigned, while recording */
+		size_t *record_elements;
+		size_t record_element_count;
+		size_t record_element_size;
+		/* The amount of input discarded from the start of buffer, so that
+		offsets of records are relative to the start of the input */
+		size_t discarded;
+		/* The unexpanded assignments at the top level, with
+		kPkgbuildOptionTrackDependencies */
+		derivation_t *derivations;
+		size_t derivation_count;
+		size_t derivation_size;
+		/* The unexpanded elements of the array being assigned, while
+		tracking dependencies */
+		char **derivation_elements;
+		size_t derivation_element_count;
+		size_t derivation_element_size;
+		/* Whether a value may be assigned other than by the tracked
+		assignments, so that the result cannot be derived again */
+		int underivable;
+		/* The amount of function definitions being parsed when package() or
+		package_*() was entered, or 0 */
+		int package_function;
+		/* The layout of the PKGBUILD while tracking dependencies, see
+		parse_index_t */
+		size_t *checkpoints;
+		size_t checkpoint_count;
+		size_t checkpoint_size;
+		size_t last_checkpoint;
+		function_range_t *function_ranges;
+		size_t function_range_count;
+		size_t function_range_size;
+		/* Whether the last function range has yet to end */
+		int open_function;
+	};
+
+	static char _span_terminate(span_t span);
+	static void _span_restore(span_t span, char hold);
+	static void _handle_assignment(pkgbuild_parser_t *parser, span_t lvalue,
+		span_t rvalue);
+	static void _handle_element(pkgbuild_parser_t *parser, span_t element);
+	static void _handle_array_assignment(pkgbuild_parser_t *parser,
+		span_t lvalue);
+	static void _handle_source(pkgbuild_parser_t *parser, span_t word);
+	static void _handle_command(pkgbuild_parser_t *parser);
+	static void _record_assignment(pkgbuild_parser_t *parser, span_t lvalue,
+		span_t value, int array);
+	static void _record_array(pkgbuild_parser_t *parser, span_t lvalue,
+		span_t open, span_t close);
+	static void _track_assignment(pkgbuild_parser_t *parser,
+		const char *lvalue, const char *value);
+	static table_t *_include(pkgbuild_parser_t *parser, const char *path);
+	static int _projection_complete(pkgbuild_parser_t *parser, span_t rvalue);
+	static void _enter_function(pkgbuild_parser_t *parser, span_t name);
+	static void _exit_function(pkgbuild_parser_t *parser);
+	static void _enter_conditional(pkgbuild_parser_t *parser);
+	static void _enter_branch(pkgbuild_parser_t *parser, span_t *test,
+		span_t *pattern);
+	static void _enter_case(pkgbuild_parser_t *parser, span_t subject);
+	static void _exit_conditional(pkgbuild_parser_t *parser);
+	static void yyerror(pkgbuild_parser_t *parser, char *msg);
+}
 
-	/* TODO: Make this local somehow. */
-	table_t *g_table;
-%}
+%define api.pure full
+%define api.push-pull push
+%parse-param {pkgbuild_parser_t *parser}
 
 %token NAME
 %token NEWLINE
-%token ASSIGNMENT
-%token IF THEN ELSE ELIF FI
+%token ASSIGNMENT APPEND
+%token FUNCTION_BODY
+%token ARRAY_OPEN ELEMENT ARRAY_CLOSE
+%token IF THEN ELSE ELIF FI TEST
+%token CASE ESAC IN WORD PATTERN DSEMI
+%token SOURCE
+%token COMMAND
 
 %start compound_list
 
@@ -55,13 +263,50 @@
 
 compound_command: brace_group
 	| if_clause
+	| case_clause
 	;
 
-command: NAME ASSIGNMENT { _handle_assignment($1, $2); free($1); free($2); }
+command: NAME ASSIGNMENT {
+		_record_assignment(parser, $1, $2, 0);
+		_handle_assignment(parser, $1, $2);
+		if(_projection_complete(parser, $2)) {
+			YYACCEPT;
+		}
+	}
+	| NAME ARRAY_OPEN element_list ARRAY_CLOSE {
+		_record_array(parser, $1, $2, $4);
+		_handle_array_assignment(parser, $1);
+		if(_projection_complete(parser, $4)) {
+			YYACCEPT;
+		}
+	}
+	| NAME append ASSIGNMENT {
+		_record_assignment(parser, $1, $3, 0);
+		_handle_assignment(parser, $1, $3);
+		if(_projection_complete(parser, $3)) {
+			YYACCEPT;
+		}
+	}
+	| NAME append ARRAY_OPEN element_list ARRAY_CLOSE {
+		_record_array(parser, $1, $3, $5);
+		_handle_array_assignment(parser, $1);
+		if(_projection_complete(parser, $5)) {
+			YYACCEPT;
+		}
+	}
+	| SOURCE { _handle_source(parser, $1); }
+	| COMMAND { _handle_command(parser); }
 	| compound_command
 	| function_definition
 	;
 
+append: APPEND { parser->append = 1; }
+	;
+
+element_list: element_list ELEMENT { _handle_element(parser, $2); }
+	| /* empty */
+	;
+
 compound_list: term
 	| newline_list term
 	| term separator
@@ -72,20 +317,61 @@ term: command
 	| term separator command
 	;
 
-if_clause: IF compound_list THEN compound_list else_part FI
-	| IF compound_list THEN compound_list FI
+if_clause: if_test separator THEN compound_list else_part FI {
+		_exit_conditional(parser);
+	}
+	| if_test separator THEN compound_list FI { _exit_conditional(parser); }
+	;
+
+if_test: IF TEST {
+		_enter_conditional(parser);
+		_enter_branch(parser, &$2, NULL);
+	}
+	| IF COMMAND {
+		_enter_conditional(parser);
+		_enter_branch(parser, &$2, NULL);
+	}
+	;
+
+else_part: elif_test separator THEN compound_list else_part
+	| elif_test separator THEN compound_list
+	| else_keyword compound_list
+	;
+
+elif_test: ELIF TEST { _enter_branch(parser, &$2, NULL); }
+	| ELIF COMMAND { _enter_branch(parser, &$2, NULL); }
+	;
+
+else_keyword: ELSE { _enter_branch(parser, NULL, NULL); }
+	;
+
+case_clause: case_head case_list ESAC { _exit_conditional(parser); }
+	| case_head ESAC { _exit_conditional(parser); }
+	;
+
+case_head: CASE WORD IN { _enter_case(parser, $2); }
 	;
 
-else_part: ELIF compound_list THEN else_part
-	| ELSE compound_list
+case_list: case_item
+	| case_list case_item
 	;
 
-function_declaration : NAME '(' ')' { _enter_function($1); free($1); }
+case_item: case_pattern linebreak DSEMI
+	| case_pattern compound_list DSEMI
+	| case_pattern linebreak
+	| case_pattern compound_list
+	;
+
+case_pattern: PATTERN { _enter_branch(parser, NULL, &$1); }
+	;
+
+function_declaration : NAME '(' ')' { _enter_function(parser, $1); }
 
 function_definition : function_declaration whitespace linebreak function_body
 	;
 
-function_body: compound_command { _exit_function(); }
+function_body: compound_command { _exit_function(parser); }
+	| FUNCTION_BODY { _exit_function(parser); }
 	;
 
 brace_group: '{' compound_list '}'
@@ -110,265 +396,1691 @@ whitespace: whitespace ' '
 
 %%
 
-static void _set_splitpkgs_from_table(pkgbuild_t *pkgbuild, table_t *table)
+/*
+Terminate a span in place, so that it can be used as a string without being
+copied. This is the same technique flex uses for yytext.
+
+Parameters:
+	span - The span to be terminated.
+
+Returns:
+	The character replaced by the terminator, which must be passed to
+	<_span_restore()> once the string is no longer used.
+*/
+static char _span_terminate(span_t span)
 {
-	#define FNAME_LENTH 32
-	int i;
-	size_t size = 0;
-	symbol_t *symbol;
-	pkgbuild_t **splitpkgs;
+	char hold = span.start[span.length];
+	span.start[span.length] = '\0';
+	return hold;
+}
+
+static void _span_restore(span_t span, char hold)
+{
+	span.start[span.length] = hold;
+}
+
+/*
+Find the field loaded from a variable.
+
+Parameters:
+	lvalue - The name of the variable.
+
+Returns:
+	The <pkgbuild_field_t> flag of the field, or 0 if the variable is not a
+	field.
+*/
+static unsigned int _field_of_lvalue(char *lvalue)
+{
+	unsigned int field;
+	const char *name;
+	for(field = 1; field & kPkgbuildFieldAll; field <<= 1) {
+		name = pkgbuild_field_lvalue(field);
+		if(name != NULL && strcmp(name, lvalue) == 0) {
+			return field;
+		}
+	}
+	return 0;
+}
+
+/*
+Determine whether a variable may be assigned between start and end. Any
+occurrence of "name=" or "name+=" at the beginning of a word counts, even
+within a function body or a quoted string, so the result is conservative.
+*/
+static int _may_assign(const char *name, char *start, char *end)
+{
+	size_t len = strlen(name);
 	char *ptr;
-	char **names;
-	char function_name[FNAME_LENTH] = {'\0'};
-	const char *function_prefix = "package_";
 
-	if(pkgbuild == NULL) {
+	for(ptr = start; ptr < end && (ptr = memchr(ptr, name[0], end - ptr)) != NULL; ptr++) {
+		if((size_t)(end - ptr) > len && memcmp(ptr, name, len) == 0
+				&& (ptr[len] == '=' || (ptr[len] == '+' && ptr[len + 1] == '='))
+				&& strchr(" \t\n;&|(", *(ptr - 1)) != NULL) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Determine whether a file may be sourced between start and end, which may
+ * assign any variable. This is as conservative as <_may_assign()>. */
+static int _may_source(char *start, char *end)
+{
+	char *ptr;
+
+	for(ptr = start; ptr < end; ptr++) {
+		if(((*ptr == '.' && end - ptr > 1 && (ptr[1] == ' ' || ptr[1] == '\t'))
+				|| (end - ptr > 6 && memcmp(ptr, "source", 6) == 0))
+				&& strchr(" \t\n;&|(", *(ptr - 1)) != NULL) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+Determine whether a parse started by <pkgbuild_parse_fields()> can stop after
+an assignment. This is the case when every requested variable has been
+assigned at the top level, and none can be reassigned in the remaining input.
+Since the remaining input is unknown until the parser is finished, parsing
+never stops while chunks are being fed.
+
+Parameters:
+	parser - The parser which handled the assignment.
+	rvalue - The value of the assignment just handled.
+
+Returns:
+	True (1) if parsing can stop, otherwise false (0).
+*/
+static int _projection_complete(pkgbuild_parser_t *parser, span_t rvalue)
+{
+	unsigned int field;
+	unsigned int top_level;
+
+	/* Split packages are defined by functions, which may follow anywhere */
+	if(parser->fields == 0 || (parser->fields & kPkgbuildFieldSplitpkgs)
+			|| parser->lexer.partial) {
+		return 0;
+	}
+	top_level = 0;
+	for(field = 1; field & kPkgbuildFieldAll; field <<= 1) {
+		if((parser->fields & field) && pkgbuild_field_lvalue(field) != NULL) {
+			top_level |= field;
+		}
+	}
+	if((parser->assigned & top_level) != top_level) {
+		return 0;
+	}
+
+	for(field = 1; field & kPkgbuildFieldAll; field <<= 1) {
+		if((top_level & field) && _may_assign(pkgbuild_field_lvalue(field),
+				rvalue.start + rvalue.length, parser->buffer + parser->length)) {
+			return 0;
+		}
+	}
+	return !_may_source(rvalue.start + rvalue.length,
+		parser->buffer + parser->length);
+}
+
+/* Keep tests from relying on the value of a variable, which depends on
+ * whether a branch is taken. */
+static void _forget_value(pkgbuild_parser_t *parser, char *lvalue)
+{
+	size_t i;
+
+	for(i = 0; i < parser->unknown_count; i++) {
+		if(strcmp(parser->unknown[i], lvalue) == 0) {
+			return;
+		}
+	}
+	if(parser->unknown_count == parser->unknown_size) {
+		parser->unknown_size = parser->unknown_size > 0 ? parser->unknown_size * 2 : 8;
+		parser->unknown = realloc(parser->unknown,
+			parser->unknown_size * sizeof(*parser->unknown));
+	}
+	parser->unknown[parser->unknown_count++] = arena_strdup(parser->arena, lvalue);
+}
+
+/*
+Insert a symbol into the current namespace, or append its value to the
+variable of the same name, keeping track of the requested variables which
+have been assigned.
+
+Parameters:
+	parser - The parser handling the assignment.
+	symbol - The symbol to be inserted. The reference of the caller is
+		released.
+*/
+static void _assign(pkgbuild_parser_t *parser, symbol_t *symbol)
+{
+	if(parser->append) {
+		table_append(parser->table, symbol);
+		parser->append = 0;
+	} else {
+		table_insert(parser->table, symbol);
+	}
+
+	/* Keep track of requested variables assigned at the top level */
+	if(parser->fields != kPkgbuildFieldAll && table_parent(parser->table) == NULL) {
+		parser->assigned |= _field_of_lvalue(symbol_name(symbol)) & parser->fields;
+	}
+	if(table_parent(parser->table) == NULL && strchr(symbol_name(symbol) + 1, '_') != NULL) {
+		parser->arch_specific = 1;
+	}
+	if(parser->uncertain > 0 && parser->dead == 0) {
+		_forget_value(parser, symbol_name(symbol));
+	}
+	symbol_release(symbol);
+}
+
+/*
+Determine whether every variable referenced by a value is defined. Quoting is
+only taken into account as far as single quotes prevent expansion.
+*/
+static int _is_defined(table_t *table, const char *value)
+{
+	const char *ptr;
+	char name[64];
+	size_t length;
+	int quoted = 0;
+
+	for(ptr = value; *ptr != '\0'; ptr++) {
+		if(*ptr == '\\' && ptr[1] != '\0') {
+			ptr++;
+		} else if(*ptr == '"') {
+			quoted = !quoted;
+		} else if(*ptr == '\'' && !quoted) {
+			ptr = strchr(ptr + 1, '\'');
+			if(ptr == NULL) {
+				break;
+			}
+		} else if(*ptr == '$') {
+			ptr++;
+			if(*ptr == '{') {
+				ptr += ptr[1] == '#' || ptr[1] == '!' ? 2 : 1;
+			}
+			length = strspn(ptr, "abcdefghijklmnopqrstuvwxyz"
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+			/* Positional and special parameters are never defined */
+			if(length == 0 || length >= sizeof(name)) {
+				return 0;
+			}
+			memcpy(name, ptr, length);
+			name[length] = '\0';
+			if(table_lookupr(table, name) == NULL) {
+				return 0;
+			}
+			ptr += length - 1;
+		}
+	}
+	return 1;
+}
+
+/* Whether the current scope can define package metadata, which is the top
+ * level and package() or package_*(). */
+static int _defines_metadata(pkgbuild_parser_t *parser)
+{
+	return parser->functions == 0 || parser->package_function > 0;
+}
+
+/*
+Flag values whose expansion runs commands, which the parser cannot do. Values
+of a helper script must not depend on variables of the PKGBUILD sourcing it
+either, since its result is shared.
+
+Returns:
+	True (1) if the value can be expanded, otherwise false (0).
+*/
+static int _check_value(pkgbuild_parser_t *parser, const char *value)
+{
+	if(parser->dead > 0 || !_defines_metadata(parser)) {
+		return 1;
+	}
+	if(strstr(value, "$(") != NULL || strchr(value, '`') != NULL
+			|| (parser->include && !_is_defined(parser->table, value))) {
+		parser->unsupported = 1;
+		return 0;
+	}
+	return 1;
+}
+
+/* Remove the blanks a word is followed by, such as before a comment, unless
+ * they are escaped. */
+static span_t _span_trim(span_t span)
+{
+	while(span.length > 0 && (span.start[span.length - 1] == ' '
+			|| span.start[span.length - 1] == '\t')
+			&& (span.length < 2 || span.start[span.length - 2] != '\\')) {
+		span.length--;
+	}
+	return span;
+}
+
+/* Retrieve the offset of a span from the start of the input. */
+static size_t _span_offset(pkgbuild_parser_t *parser, span_t span)
+{
+	return parser->discarded + (span.start - parser->buffer);
+}
+
+/* Append a cleared record to those of a recording parser. */
+static assignment_record_t *_record_new(pkgbuild_parser_t *parser)
+{
+	assignment_record_t *record;
+
+	if(parser->record_count == parser->record_size) {
+		parser->record_size = parser->record_size == 0 ? 16
+			: parser->record_size * 2;
+		parser->records = realloc(parser->records,
+			parser->record_size * sizeof(*parser->records));
+	}
+	record = &parser->records[parser->record_count++];
+	memset(record, 0, sizeof(*record));
+	return record;
+}
+
+/*
+Record an assignment outside of functions, if the parser is recording, see
+<pkgbuild_parser_set_recording()>.
+
+Parameters:
+	parser - The parser handling the assignment.
+	lvalue - The name of the variable.
+	value - The value as written, which is an array literal including its
+		parentheses if array is true. Trailing blanks are not recorded.
+	array - Whether an array is assigned, whose elements have been recorded
+		by <_handle_element()>.
+*/
+static void _record_assignment(pkgbuild_parser_t *parser, span_t lvalue,
+	span_t value, int array)
+{
+	assignment_record_t *record;
+	size_t size;
+
+	if(!parser->recording || parser->functions > 0) {
+		parser->record_element_count = 0;
 		return;
 	}
+	record = _record_new(parser);
+	record->name = strndup(lvalue.start, lvalue.length);
+	value = _span_trim(value);
+	record->offset = _span_offset(parser, value);
+	record->length = value.length;
+	record->array = array;
+	record->append = parser->append;
+	record->conditional = parser->conditional_count > 0;
+	if(array && parser->record_element_count > 0) {
+		size = parser->record_element_count * sizeof(*record->elements);
+		record->elements = malloc(size);
+		memcpy(record->elements, parser->record_elements, size);
+		record->element_count = parser->record_element_count / 2;
+	}
+	parser->record_element_count = 0;
+}
+
+/* Record an array assignment, whose literal extends from the opening to the
+ * closing parenthesis. */
+static void _record_array(pkgbuild_parser_t *parser, span_t lvalue,
+	span_t open, span_t close)
+{
+	span_t value;
+
+	value.start = open.start;
+	value.length = close.start + close.length - open.start;
+	_record_assignment(parser, lvalue, value, 1);
+}
+
+/* Discard the unexpanded elements of an array, once it has been assigned. */
+static void _clear_derivation_elements(pkgbuild_parser_t *parser)
+{
+	while(parser->derivation_element_count > 0) {
+		free(parser->derivation_elements[--parser->derivation_element_count]);
+	}
+}
+
+/*
+Keep an assignment unexpanded, if dependencies are tracked. Values which are
+not assigned at the top level, or are only assigned under conditions, make
+the result underivable.
+
+Parameters:
+	parser - The parser handling the assignment.
+	lvalue - The name of the variable.
+	value - The value as written, or NULL for an array, whose elements have
+		been collected by <_handle_element()>.
+*/
+static void _track_assignment(pkgbuild_parser_t *parser,
+	const char *lvalue, const char *value)
+{
+	derivation_t *derivation;
+	char **elements = NULL;
+	size_t i;
 
-	ptr = function_name;
-	names = pkgbuild_names(pkgbuild);
-	if(names == NULL) {
+	if(!(parser->options & kPkgbuildOptionTrackDependencies)
+			|| parser->include || parser->dead > 0) {
+		_clear_derivation_elements(parser);
+		return;
+	}
+	if(parser->functions > 0) {
+		/* Only package functions define metadata, which is derived again
+		unless it depends on variables */
+		if(parser->package_function > 0) {
+			if(value != NULL && strchr(value, '$') != NULL) {
+				parser->underivable = 1;
+			}
+			for(i = 0; i < parser->derivation_element_count; i++) {
+				if(strchr(parser->derivation_elements[i], '$') != NULL) {
+					parser->underivable = 1;
+				}
+			}
+		}
+		_clear_derivation_elements(parser);
 		return;
 	}
-	for(i = 0; names[i] != NULL; i++) {
-		size++;
+	if(parser->conditional_count > 0) {
+		parser->underivable = 1;
+		_clear_derivation_elements(parser);
+		return;
 	}
 
-	splitpkgs = malloc(sizeof(*splitpkgs) * (size + 1));
-	splitpkgs = memset(splitpkgs, 0, sizeof(*splitpkgs) * (size + 1));
-	splitpkgs[size] = NULL;
+	if(value == NULL) {
+		elements = malloc((parser->derivation_element_count + 1)
+			* sizeof(*elements));
+		memcpy(elements, parser->derivation_elements,
+			parser->derivation_element_count * sizeof(*elements));
+		elements[parser->derivation_element_count] = NULL;
+		parser->derivation_element_count = 0;
+	}
+	if(parser->derivation_count == parser->derivation_size) {
+		parser->derivation_size = parser->derivation_size == 0 ? 16
+			: parser->derivation_size * 2;
+		parser->derivations = realloc(parser->derivations,
+			parser->derivation_size * sizeof(*parser->derivations));
+	}
+	derivation = &parser->derivations[parser->derivation_count++];
+	derivation_init(derivation, lvalue, value, elements, parser->append);
+	derivation->offset = parser->discarded + (lvalue - parser->buffer);
+}
 
-	for(i = 0; names[i] != NULL; i++) {
-		ptr = strncat(ptr, function_prefix, FNAME_LENTH);
-		ptr = strncat(ptr, names[i], FNAME_LENTH);
-		symbol = symbol_retain(table_lookup(table, ptr));
-		ptr[0] = '\0';
-		if(symbol != NULL) {
-			splitpkgs[i] = pkgbuild_new();
-			_set_pkgbuild_fields_from_table(splitpkgs[i], symbol_function(symbol));
+static void _handle_assignment(pkgbuild_parser_t *parser, span_t lvalue_span,
+	span_t rvalue_span)
+{
+	symbol_t *symbol;
+	char *rvalue;
+	char lvalue_hold;
+	char rvalue_hold;
+	char *str;
+
+	rvalue_span = _span_trim(rvalue_span);
+	lvalue_hold = _span_terminate(lvalue_span);
+	rvalue_hold = _span_terminate(rvalue_span);
+	rvalue = rvalue_span.start;
+	_check_value(parser, rvalue);
+	_track_assignment(parser, lvalue_span.start, rvalue);
+
+	symbol = symbol_new_with_arena(lvalue_span.start, parser->arena);
+	/* Appended values are needed at once, so they are never deferred */
+	if((parser->options & kPkgbuildOptionLazy) && !parser->append) {
+		/* Only values which are referenced need a scope */
+		symbol_set_deferred(symbol, kSymbolTypeString, rvalue,
+			strchr(rvalue, '$') != NULL ? parser->table : NULL);
+	} else {
+		str = sh_parse_word_with_arena(parser->table, rvalue, parser->arena);
+		symbol_set_string(symbol, str);
+		arena_free(parser->arena, str);
+	}
+	_assign(parser, symbol);
+
+	_span_restore(rvalue_span, rvalue_hold);
+	_span_restore(lvalue_span, lvalue_hold);
+}
+
+/* Append text to the unexpanded value of a deferred array. */
+static void _raw_append(pkgbuild_parser_t *parser, const char *text,
+	size_t length)
+{
+	if(parser->raw_size < parser->raw_length + length + 1) {
+		while(parser->raw_size < parser->raw_length + length + 1) {
+			parser->raw_size *= 2;
 		}
-		symbol_release(symbol);
+		parser->raw = realloc(parser->raw, parser->raw_size);
 	}
+	memcpy(parser->raw + parser->raw_length, text, length);
+	parser->raw_length += length;
+	parser->raw[parser->raw_length] = '\0';
+}
 
-	pkgbuild_set_splitpkgs(pkgbuild, splitpkgs);
+/*
+Handle an element of an array literal. Elements are parsed as they are read,
+unless the assignment is deferred, in which case they are collected
+unexpanded.
+
+Parameters:
+	parser - The parser handling the assignment.
+	element - The element, as written.
+*/
+static void _handle_element(pkgbuild_parser_t *parser, span_t element)
+{
+	char hold;
+
+	hold = _span_terminate(element);
+	_check_value(parser, element.start);
+	_span_restore(element, hold);
+
+	if(parser->recording) {
+		if(parser->record_element_count + 2 > parser->record_element_size) {
+			parser->record_element_size = parser->record_element_size == 0 ? 32
+				: parser->record_element_size * 2;
+			parser->record_elements = realloc(parser->record_elements,
+				parser->record_element_size * sizeof(*parser->record_elements));
+		}
+		parser->record_elements[parser->record_element_count++] =
+			_span_offset(parser, element);
+		parser->record_elements[parser->record_element_count++] =
+			element.length;
+	}
+	if(parser->options & kPkgbuildOptionTrackDependencies) {
+		if(parser->derivation_element_count + 2
+				> parser->derivation_element_size) {
+			parser->derivation_element_size =
+				parser->derivation_element_size == 0 ? 16
+				: parser->derivation_element_size * 2;
+			parser->derivation_elements = realloc(parser->derivation_elements,
+				parser->derivation_element_size
+				* sizeof(*parser->derivation_elements));
+		}
+		parser->derivation_elements[parser->derivation_element_count++] =
+			strndup(element.start, element.length);
+		parser->derivation_elements[parser->derivation_element_count] = NULL;
+	}
+
+	if((parser->options & kPkgbuildOptionLazy) && !parser->append) {
+		_raw_append(parser, parser->raw_length == 0 ? "(" : " ", 1);
+		_raw_append(parser, element.start, element.length);
+		return;
+	}
+
+	if(parser->element_count + 1 >= parser->element_size) {
+		parser->element_size *= 2;
+		parser->elements = realloc(parser->elements,
+			parser->element_size * sizeof(*parser->elements));
+	}
+	hold = _span_terminate(element);
+	parser->elements[parser->element_count++] = sh_parse_word_with_arena(
+		parser->table, element.start, parser->arena);
+	_span_restore(element, hold);
 }
 
-static void _set_pkgbuild_fields_from_table(pkgbuild_t *pkgbuild, table_t *table)
+/*
+Assign the elements handled by <_handle_element()> to an array.
+
+Parameters:
+	parser - The parser handling the assignment.
+	lvalue_span - The name of the array.
+*/
+static void _handle_array_assignment(pkgbuild_parser_t *parser,
+	span_t lvalue_span)
 {
 	symbol_t *symbol;
-	char **str_array = NULL;
-	table_retain(table);
+	char hold;
+	size_t i;
 
-	symbol = table_lookup(table, "pkgname");
-	if(symbol != NULL) {
-		if(symbol_type(symbol) == kSymbolTypeArray) {
-			pkgbuild_set_names(pkgbuild, symbol_array(symbol));
-		} else {
-			str_array = malloc(sizeof(*str_array) * 2);
-			str_array[0] = symbol_string(symbol);
-			str_array[1] = NULL;
-			pkgbuild_set_names(pkgbuild, str_array);
-			free(str_array);
+	hold = _span_terminate(lvalue_span);
+	symbol = symbol_new_with_arena(lvalue_span.start, parser->arena);
+	_track_assignment(parser, lvalue_span.start, NULL);
+	_span_restore(lvalue_span, hold);
+
+	if((parser->options & kPkgbuildOptionLazy) && !parser->append) {
+		if(parser->raw_length == 0) {
+			_raw_append(parser, "(", 1);
 		}
+		_raw_append(parser, ")", 1);
+		symbol_set_deferred(symbol, kSymbolTypeArray, parser->raw,
+			strchr(parser->raw, '$') != NULL ? parser->table : NULL);
+		parser->raw_length = 0;
+	} else {
+		parser->elements[parser->element_count] = NULL;
+		symbol_set_array(symbol, parser->elements);
+		for(i = 0; i < parser->element_count; i++) {
+			arena_free(parser->arena, parser->elements[i]);
+		}
+		parser->element_count = 0;
 	}
+	_assign(parser, symbol);
+}
 
-	symbol = table_lookup(table, "pkgbase");
-	if(symbol != NULL) {
-		pkgbuild_set_basename(pkgbuild, symbol_string(symbol));
+/*
+Handle a helper script sourced by the PKGBUILD, whose variables are then
+visible as if they had been assigned at this point. Names are resolved
+against the directory of the PKGBUILD, from which makepkg sources it, and
+absolute names are never followed, nor is anything with
+kPkgbuildOptionIgnoreSourced. A script which is sourced conditionally, by an
+absolute name, or cannot be evaluated on its own, makes the PKGBUILD
+unsupported.
+
+Parameters:
+	parser - The parser handling the command.
+	word - The name of the file, as written.
+*/
+static void _handle_source(pkgbuild_parser_t *parser, span_t word)
+{
+	table_t *table = NULL;
+	char *name;
+	char *path;
+	char hold;
+	int expandable;
+
+	if(parser->dead > 0) {
+		return;
+	}
+	hold = _span_terminate(word);
+	expandable = _check_value(parser, word.start);
+	name = sh_parse_word_with_arena(parser->table, word.start, parser->arena);
+	_span_restore(word, hold);
+
+	if(expandable && !parser->include && parser->functions == 0
+			&& parser->uncertain == 0 && parser->directory != NULL
+			&& !(parser->options & kPkgbuildOptionIgnoreSourced)
+			&& name != NULL && name[0] != '\0' && name[0] != '/') {
+		path = malloc(strlen(parser->directory) + strlen(name) + 2);
+		sprintf(path, "%s/%s", parser->directory, name);
+		table = _include(parser, path);
+		free(path);
 	}
 
-	symbol = table_lookup(table, "pkgver");
-	if(symbol != NULL) {
-		pkgbuild_set_version(pkgbuild, symbol_string(symbol));
+	if(_defines_metadata(parser)) {
+		parser->underivable = 1;
 	}
 
-	symbol = table_lookup(table, "pkgrel");
-	if(symbol != NULL) {
-		/* FIXME: Why doesn't it work with atoif()? */
-		pkgbuild_set_rel(pkgbuild, atoi(symbol_string(symbol)));
+	/* Variables of sourced files are not recorded, which is marked by a
+	record without a name */
+	if(parser->recording && parser->functions == 0) {
+		_record_new(parser)->conditional = parser->conditional_count > 0;
 	}
 
-	symbol = table_lookup(table, "pkgdesc");
-	if(symbol != NULL) {
-		pkgbuild_set_desc(pkgbuild, symbol_string(symbol));
+	if(table != NULL) {
+		if(parser->options & kPkgbuildOptionLazy) {
+			/* Deferred values capture the variables in scope, which must not
+			reference the script from within the arena of the result */
+			table_copy(parser->table, table, NULL);
+		} else {
+			table_include(parser->table, table);
+		}
+		/* The script may define architecture specific variables */
+		parser->arch_specific = 1;
+		table_release(table);
+	} else {
+		parser->unsupported = 1;
 	}
+	arena_free(parser->arena, name);
+}
 
-	symbol = table_lookup(table, "url");
-	if(symbol != NULL) {
-		pkgbuild_set_url(pkgbuild, symbol_string(symbol));
+/* Handle a command the parser does not interpret. A command at the top level
+ * may have effects the parser cannot see, which makes the PKGBUILD
+ * unsupported. Commands within functions, such as "make install", are
+ * ignored. */
+static void _handle_command(pkgbuild_parser_t *parser)
+{
+	if(parser->dead == 0 && parser->functions == 0) {
+		parser->unsupported = 1;
+		parser->underivable = 1;
 	}
+}
 
-	symbol = table_lookup(table, "license");
-	if(symbol != NULL) {
-		pkgbuild_set_licenses(pkgbuild, symbol_array(symbol));
+static void _enter_function(pkgbuild_parser_t *parser, span_t name)
+{
+	table_t *table;
+	symbol_t *symbol;
+	char hold;
+
+	table = table_new_with_parent(parser->table);
+
+	hold = _span_terminate(name);
+	symbol = symbol_new_with_arena(name.start, parser->arena);
+	_span_restore(name, hold);
+	symbol_set_function(symbol, table);
+	table_insert(parser->table, symbol);
+
+	table_release(parser->table);
+	parser->table = table;
+	parser->functions++;
+	if(parser->package_function == 0 && name.length >= 7
+			&& strncmp(name.start, "package", 7) == 0) {
+		parser->package_function = parser->functions;
 	}
 
-	symbol = table_lookup(table, "install");
-	if(symbol != NULL) {
-		pkgbuild_set_install(pkgbuild, symbol_string(symbol));
+	if((parser->options & kPkgbuildOptionTrackDependencies)
+			&& parser->functions == 1 && parser->conditional_count == 0) {
+		if(parser->function_range_count == parser->function_range_size) {
+			parser->function_range_size = parser->function_range_size == 0 ? 8
+				: parser->function_range_size * 2;
+			parser->function_ranges = realloc(parser->function_ranges,
+				parser->function_range_size * sizeof(*parser->function_ranges));
+		}
+		parser->function_ranges[parser->function_range_count].offset =
+			parser->last_checkpoint;
+		parser->function_ranges[parser->function_range_count].end = 0;
+		parser->function_ranges[parser->function_range_count].package =
+			parser->package_function > 0;
+		parser->function_range_count++;
+		parser->open_function = 1;
+	}
+}
+
+/* Return to the namespace enclosing the current one. */
+static void _leave_namespace(pkgbuild_parser_t *parser)
+{
+	table_t *table;
+
+	table = table_retain(table_parent(parser->table));
+	table_release(parser->table);
+	parser->table = table;
+}
+
+static void _exit_function(pkgbuild_parser_t *parser)
+{
+	if(parser->package_function == parser->functions) {
+		parser->package_function = 0;
 	}
+	parser->functions--;
+	_leave_namespace(parser);
+}
+
+static void _enter_conditional(pkgbuild_parser_t *parser)
+{
+	_conditional_t *conditional;
 
-	symbol = table_lookup(table, "source");
-	if(symbol != NULL) {
-		pkgbuild_set_sources(pkgbuild, symbol_array(symbol));
+	if(parser->conditional_count == parser->conditional_size) {
+		parser->conditional_size = parser->conditional_size > 0
+			? parser->conditional_size * 2 : 4;
+		parser->conditionals = realloc(parser->conditionals,
+			parser->conditional_size * sizeof(*parser->conditionals));
 	}
+	conditional = &parser->conditionals[parser->conditional_count++];
+	memset(conditional, 0, sizeof(*conditional));
+	conditional->guard_length = parser->guard_length;
+}
+
+static void _enter_case(pkgbuild_parser_t *parser, span_t subject)
+{
+	_enter_conditional(parser);
+	parser->conditionals[parser->conditional_count - 1].subject =
+		arena_strndup(parser->arena, subject.start, subject.length);
+}
 
-	symbol = table_lookup(table, "noextract");
-	if(symbol != NULL) {
-		pkgbuild_set_noextract(pkgbuild, symbol_array(symbol));
+/*
+Record the current branch, guarded by the tests of the parser, so that it is
+part of the result.
+*/
+static void _record_branch(pkgbuild_parser_t *parser)
+{
+	arch_branch_t *branch;
+	size_t i;
+
+	if(parser->branch_count == parser->branch_size) {
+		parser->branch_size = parser->branch_size > 0 ? parser->branch_size * 2 : 4;
+		parser->branches = realloc(parser->branches,
+			parser->branch_size * sizeof(*parser->branches));
+	}
+	branch = &parser->branches[parser->branch_count++];
+	branch->tests = malloc(parser->guard_length * sizeof(*branch->tests));
+	branch->test_count = parser->guard_length;
+	for(i = 0; i < parser->guard_length; i++) {
+		branch->tests[i].pattern = arena_strdup(parser->arena,
+			parser->guard[i].pattern);
+		branch->tests[i].match = parser->guard[i].match;
 	}
+	branch->table = table_retain(parser->table);
+}
 
-	symbol = table_lookup(table, "md5sums");
-	if(symbol != NULL) {
-		pkgbuild_set_md5sums(pkgbuild, symbol_array(symbol));
+/* Leave the current branch of a conditional. */
+static void _leave_branch(pkgbuild_parser_t *parser,
+	_conditional_t *conditional)
+{
+	if(conditional->scoped) {
+		_leave_namespace(parser);
+		conditional->scoped = 0;
+	}
+	if(conditional->dead) {
+		parser->dead--;
+		conditional->dead = 0;
 	}
+	if(conditional->uncertain) {
+		parser->uncertain--;
+		conditional->uncertain = 0;
+	}
+}
 
-	symbol = table_lookup(table, "sha1sums");
-	if(symbol != NULL) {
-		pkgbuild_set_sha1sums(pkgbuild, symbol_array(symbol));
+/*
+Evaluate the test of a branch, see <condition_test()>.
+
+Parameters:
+	parser - The parser handling the branch.
+	conditional - The conditional the branch is part of.
+	test - The test commands of an if or elif clause, or NULL.
+	pattern - The patterns of an item of a case clause, or NULL.
+	arch - The address where a test on the architecture is stored.
+
+Returns:
+	The result of the test, which is <kConditionTrue> for an else branch.
+*/
+static condition_t _evaluate_branch(pkgbuild_parser_t *parser,
+	_conditional_t *conditional, span_t *test, span_t *pattern,
+	arch_test_t *arch)
+{
+	condition_context_t context;
+	condition_t result = kConditionTrue;
+	char hold;
+
+	context.table = parser->table;
+	context.unknown = parser->unknown;
+	context.unknown_count = parser->unknown_count;
+	context.arena = parser->arena;
+	if(test != NULL) {
+		hold = _span_terminate(*test);
+		result = condition_test(&context, test->start, arch);
+		_span_restore(*test, hold);
+	} else if(pattern != NULL) {
+		hold = _span_terminate(*pattern);
+		result = condition_case(&context, conditional->subject, pattern->start,
+			arch);
+		_span_restore(*pattern, hold);
 	}
+	return result;
+}
+
+/*
+Enter a branch of the innermost conditional. Its test is evaluated where it
+only depends on known variables. A branch which is never taken is given a
+namespace of its own, which is discarded, and so is a branch which only
+applies to some architectures, so that its assignments do not affect the
+unconditional variables. Branches whose test cannot be evaluated are assumed
+to be taken.
+
+Parameters:
+	parser - The parser handling the branch.
+	test - The test commands of an if or elif clause, or NULL.
+	pattern - The patterns of an item of a case clause, or NULL. Else
+		branches have neither a test nor a pattern.
+*/
+static void _enter_branch(pkgbuild_parser_t *parser, span_t *test,
+	span_t *pattern)
+{
+	_conditional_t *conditional;
+	arch_test_t arch;
+	condition_t result;
+	table_t *table;
 
-	symbol = table_lookup(table, "sha256sums");
-	if(symbol != NULL) {
-		pkgbuild_set_sha256sums(pkgbuild, symbol_array(symbol));
+	conditional = &parser->conditionals[parser->conditional_count - 1];
+	_leave_branch(parser, conditional);
+	/* The branch is only reached if the test of the previous one failed */
+	if(conditional->tested) {
+		parser->guard[parser->guard_length - 1].match ^= 1;
+		conditional->tested = 0;
 	}
 
-	symbol = table_lookup(table, "sha384sums");
-	if(symbol != NULL) {
-		pkgbuild_set_sha384sums(pkgbuild, symbol_array(symbol));
+	result = _evaluate_branch(parser, conditional, test, pattern, &arch);
+	if(conditional->taken) {
+		if(result == kConditionArch) {
+			arena_free(parser->arena, arch.pattern);
+		}
+		result = kConditionFalse;
+	} else if(conditional->unknown && result == kConditionTrue) {
+		result = kConditionUnknown;
 	}
 
-	symbol = table_lookup(table, "sha512sums");
-	if(symbol != NULL) {
-		pkgbuild_set_sha512sums(pkgbuild, symbol_array(symbol));
+	if(result == kConditionArch) {
+		if(parser->guard_length == parser->guard_size) {
+			parser->guard_size = parser->guard_size > 0 ? parser->guard_size * 2 : 4;
+			parser->guard = realloc(parser->guard,
+				parser->guard_size * sizeof(*parser->guard));
+		}
+		parser->guard[parser->guard_length++] = arch;
+		conditional->tested = 1;
+	} else if(result == kConditionTrue) {
+		conditional->taken = 1;
+	} else if(result == kConditionUnknown) {
+		conditional->unknown = 1;
+		if(parser->dead == 0 && _defines_metadata(parser)) {
+			parser->unsupported = 1;
+		}
+	}
+	if(result == kConditionArch || result == kConditionUnknown
+			|| parser->guard_length > conditional->guard_length) {
+		parser->uncertain++;
+		conditional->uncertain = 1;
 	}
 
-	symbol = table_lookup(table, "groups");
-	if(symbol != NULL) {
-		pkgbuild_set_groups(pkgbuild, symbol_array(symbol));
+	if(result == kConditionFalse || parser->guard_length > 0) {
+		table = table_new_with_parent(parser->table);
+		table_release(parser->table);
+		parser->table = table;
+		conditional->scoped = 1;
 	}
+	if(result == kConditionFalse) {
+		parser->dead++;
+		conditional->dead = 1;
+	} else if(parser->guard_length > 0 && parser->functions == 0
+			&& parser->dead == 0) {
+		/* Branches within functions only apply to split packages, which
+		views do not cover */
+		_record_branch(parser);
+	}
+}
 
-	symbol = table_lookup(table, "arch");
-	if(symbol != NULL) {
-		pkgbuild_set_architectures(pkgbuild, symbol_array(symbol));
+static void _exit_conditional(pkgbuild_parser_t *parser)
+{
+	_conditional_t *conditional;
+
+	conditional = &parser->conditionals[--parser->conditional_count];
+	_leave_branch(parser, conditional);
+	while(parser->guard_length > conditional->guard_length) {
+		arena_free(parser->arena, parser->guard[--parser->guard_length].pattern);
 	}
+	arena_free(parser->arena, conditional->subject);
+}
 
-	symbol = table_lookup(table, "backup");
-	if(symbol != NULL) {
-		pkgbuild_set_backup(pkgbuild, symbol_array(symbol));
+static void yyerror(pkgbuild_parser_t *parser, char *msg)
+{
+	fprintf(stderr, "ERROR:%d: %s\n", parser->line, msg);
+	parser->unsupported = 1;
+}
+
+/*
+Make room for more input in the buffer of a parser, including the two NUL
+characters terminating it.
+
+Parameters:
+	parser - The parser whose buffer is to be grown.
+	len - The amount of characters to be appended.
+*/
+static void _parser_reserve(pkgbuild_parser_t *parser, size_t len)
+{
+	if(parser->size < parser->length + len + 2) {
+		while(parser->size < parser->length + len + 2) {
+			parser->size *= 2;
+		}
+		parser->buffer = realloc(parser->buffer, parser->size);
+		parser->lexer.input = parser->buffer;
 	}
+}
+
+/* Terminate the input after it has been appended to. */
+static void _parser_terminate(pkgbuild_parser_t *parser)
+{
+	parser->buffer[parser->length] = '\0';
+	parser->buffer[parser->length + 1] = '\0';
+	parser->lexer.length = parser->length;
+}
 
-	symbol = table_lookup(table, "depends");
-	if(symbol != NULL) {
-		pkgbuild_set_depends(pkgbuild, symbol_array(symbol));
+static void _parser_push(pkgbuild_parser_t *parser, int type, span_t *span,
+	int line)
+{
+	if(parser->status == YYPUSH_MORE) {
+		parser->line = line;
+		parser->status = yypush_parse(parser->pstate, type, span, parser);
 	}
+}
+
+/*
+Note the end of a line, at which parsing may resume if it ends a statement at
+the top level, while tracking dependencies.
 
-	symbol = table_lookup(table, "makedepends");
-	if(symbol != NULL) {
-		pkgbuild_set_makedepends(pkgbuild, symbol_array(symbol));
+Parameters:
+	parser - The parser.
+	offset - The offset following the line, relative to buffer.
+*/
+static void _parser_checkpoint(pkgbuild_parser_t *parser, size_t offset)
+{
+	if(!(parser->options & kPkgbuildOptionTrackDependencies)
+			|| parser->status != YYPUSH_MORE || parser->functions > 0
+			|| parser->conditional_count > 0 || parser->lexer.in_array
+			|| parser->lexer.cases > 0) {
+		return;
 	}
+	if(parser->checkpoint_count == parser->checkpoint_size) {
+		parser->checkpoint_size = parser->checkpoint_size == 0 ? 64
+			: parser->checkpoint_size * 2;
+		parser->checkpoints = realloc(parser->checkpoints,
+			parser->checkpoint_size * sizeof(*parser->checkpoints));
+	}
+	parser->last_checkpoint = parser->discarded + offset;
+	parser->checkpoints[parser->checkpoint_count++] = parser->last_checkpoint;
+	if(parser->open_function) {
+		parser->function_ranges[parser->function_range_count - 1].end =
+			parser->last_checkpoint;
+		parser->open_function = 0;
+	}
+}
 
-	symbol = table_lookup(table, "optdepends");
-	if(symbol != NULL) {
-		pkgbuild_set_optdepends(pkgbuild, symbol_array(symbol));
+/*
+Push the queued tokens to the parser. Tokens are only pushed once the line
+they are on is complete, so that the spans of a command remain within the
+buffer while its action is executed.
+*/
+static void _parser_flush(pkgbuild_parser_t *parser)
+{
+	_queued_token_t *queued;
+	span_t span;
+	size_t i;
+
+	for(i = 0; i < parser->queued; i++) {
+		queued = &parser->queue[i];
+		span.start = parser->buffer + queued->token.offset;
+		span.length = queued->token.length;
+		_parser_push(parser, queued->token.type, &span, queued->line);
+	}
+	if(parser->queued > 0 && queued->token.type == NEWLINE) {
+		_parser_checkpoint(parser,
+			queued->token.offset + queued->token.length);
 	}
+	parser->queued = 0;
+}
 
-	symbol = table_lookup(table, "conflicts");
-	if(symbol != NULL) {
-		pkgbuild_set_conflicts(pkgbuild, symbol_array(symbol));
+/* Read the tokens of the available input. */
+static void _parser_lex(pkgbuild_parser_t *parser)
+{
+	_queued_token_t *queued;
+	int line;
+
+	while(parser->status == YYPUSH_MORE) {
+		if(parser->queued == parser->queue_size) {
+			parser->queue_size *= 2;
+			parser->queue = realloc(parser->queue,
+				parser->queue_size * sizeof(*parser->queue));
+		}
+		queued = &parser->queue[parser->queued];
+		line = parser->lexer.line;
+		if(lexer_next(&parser->lexer, &queued->token) == kTokenNeedInput) {
+			break;
+		}
+		queued->line = line;
+		parser->queued++;
+		if(queued->token.type == NEWLINE || queued->token.type == 0) {
+			_parser_flush(parser);
+		}
 	}
+}
+
+/*
+Discard the input which has been parsed, keeping only the incomplete line at
+the end of the buffer.
+*/
+static void _parser_compact(pkgbuild_parser_t *parser)
+{
+	size_t discard;
+	size_t i;
 
-	symbol = table_lookup(table, "provides");
-	if(symbol != NULL) {
-		pkgbuild_set_provides(pkgbuild, symbol_array(symbol));
+	discard = parser->queued > 0 ? parser->queue[0].token.offset
+		: parser->lexer.pos;
+	if(discard == 0) {
+		return;
 	}
+	memmove(parser->buffer, parser->buffer + discard,
+		parser->length - discard);
+	parser->length -= discard;
+	parser->discarded += discard;
+	parser->lexer.pos -= discard;
+	for(i = 0; i < parser->queued; i++) {
+		parser->queue[i].token.offset -= discard;
+	}
+	_parser_terminate(parser);
+}
 
-	symbol = table_lookup(table, "replaces");
-	if(symbol != NULL) {
-		pkgbuild_set_replaces(pkgbuild, symbol_array(symbol));
+/* Discard the conditionals and branches of the last PKGBUILD. */
+static void _parser_clear_branches(pkgbuild_parser_t *parser)
+{
+	arch_branch_t *branch;
+	size_t i;
+
+	while(parser->branch_count > 0) {
+		branch = &parser->branches[--parser->branch_count];
+		for(i = 0; i < branch->test_count; i++) {
+			arena_free(parser->arena, branch->tests[i].pattern);
+		}
+		free(branch->tests);
+		table_release(branch->table);
+	}
+	while(parser->guard_length > 0) {
+		arena_free(parser->arena, parser->guard[--parser->guard_length].pattern);
 	}
+	while(parser->conditional_count > 0) {
+		arena_free(parser->arena,
+			parser->conditionals[--parser->conditional_count].subject);
+	}
+	while(parser->unknown_count > 0) {
+		arena_free(parser->arena, parser->unknown[--parser->unknown_count]);
+	}
+	parser->functions = 0;
+	parser->arch_specific = 0;
+	parser->dead = 0;
+	parser->uncertain = 0;
+}
 
-	symbol = table_lookup(table, "options");
-	if(symbol != NULL) {
-		pkgbuild_set_options(pkgbuild, symbol_array(symbol));
+/*
+Prepare a parser for a new PKGBUILD. Memory is retained for reuse, so that a
+parser which is reset no longer allocates, except for the table returned by a
+lazy parse.
+*/
+static void _parser_reset(pkgbuild_parser_t *parser)
+{
+	/* The parser state resets itself once a parse is complete */
+	if(parser->pstate == NULL) {
+		parser->pstate = yypstate_new();
+	}
+	parser->status = YYPUSH_MORE;
+	/* An array may have been left incomplete by an error */
+	while(parser->element_count > 0) {
+		arena_free(parser->arena, parser->elements[--parser->element_count]);
 	}
+	parser->raw_length = 0;
+	parser->append = 0;
+	_parser_clear_branches(parser);
+	/* A helper script included as the parent of the table outlives the
+	arena, and references between function tables may keep the table
+	alive */
+	table_set_parent(parser->table, NULL);
+	table_release(parser->table);
+	/* Every symbol of the previous PKGBUILD was allocated within the arena,
+	including any kept alive by references between function tables */
+	arena_reset(parser->arena);
+	parser->table = table_new_with_arena(parser->arena);
+	parser->assigned = 0;
+	parser->unsupported = 0;
+	parser->length = 0;
+	parser->discarded = 0;
+	parser->record_element_count = 0;
+	_clear_derivation_elements(parser);
+	derivations_free(parser->derivations, parser->derivation_count);
+	parser->derivations = NULL;
+	parser->derivation_count = 0;
+	parser->derivation_size = 0;
+	parser->underivable = 0;
+	parser->package_function = 0;
+	parser->checkpoint_count = 0;
+	parser->last_checkpoint = 0;
+	parser->function_range_count = 0;
+	parser->open_function = 0;
+	parser->queued = 0;
+	parser->line = 1;
+	lexer_init(&parser->lexer, parser->buffer, 0);
+	parser->lexer.partial = 1;
+	parser->lexer.skip_functions = parser->options & kPkgbuildOptionSkipFunctions;
+	/* package_*() only matters for split packages */
+	parser->lexer.skip_package_functions =
+		!(parser->fields & kPkgbuildFieldSplitpkgs);
+	_parser_terminate(parser);
+}
+
+/*
+Create a parser.
+
+Parameters:
+	options - A combination of <pkgbuild_option_t> flags.
+	fields - The fields to be extracted, as a combination of
+		<pkgbuild_field_t> flags. Parsing stops early when the variables of
+		these fields can no longer change, unless all fields are requested.
+
+Returns:
+	A new parser.
+*/
+static pkgbuild_parser_t *_parser_new(int options, unsigned int fields)
+{
+	pkgbuild_parser_t *parser;
+#if DEBUG
+		yydebug = 1;
+#endif
 
-	_set_splitpkgs_from_table(pkgbuild, table);
-	table_release(table);
+	parser = malloc(sizeof(*parser));
+	parser = memset(parser, 0, sizeof(*parser));
+	parser->options = options;
+	parser->fields = fields;
+	parser->arena = arena_new();
+	parser->size = BUFSIZ;
+	parser->buffer = malloc(parser->size);
+	parser->queue_size = 64;
+	parser->queue = malloc(parser->queue_size * sizeof(*parser->queue));
+	parser->element_size = 16;
+	parser->elements = malloc(parser->element_size * sizeof(*parser->elements));
+	parser->raw_size = 256;
+	parser->raw = malloc(parser->raw_size);
+	_parser_reset(parser);
+	return pkgbuild_parser_retain(parser);
 }
 
-static void _handle_assignment(char *lvalue, char *rvalue)
+pkgbuild_parser_t *pkgbuild_parser_new()
 {
-	symbol_t *symbol;
-	char *str;
-	char **array;
-	char **array_ptr;
-
-	symbol = symbol_new(lvalue);
-	/* Are we assigning an array or string? */
-	if(*rvalue == '(') {
-		array = sh_parse_array(g_table, rvalue);
-		symbol_set_array(symbol, array);
-		if(array != NULL) {
-			for(array_ptr = array; *array_ptr != NULL; array_ptr++) {
-				free(*array_ptr);
-			}
-			free(array);
+	return _parser_new(kPkgbuildOptionNone, kPkgbuildFieldAll);
+}
+
+pkgbuild_parser_t *pkgbuild_parser_new_with_options(int options)
+{
+	return _parser_new(options, kPkgbuildFieldAll);
+}
+
+pkgbuild_parser_t *pkgbuild_parser_retain(pkgbuild_parser_t *parser)
+{
+	if(parser != NULL) {
+		parser->refcount++;
+	}
+	return parser;
+}
+
+void pkgbuild_parser_release(pkgbuild_parser_t *parser)
+{
+	if(parser != NULL) {
+		parser->refcount--;
+		if(parser->refcount == 0) {
+			yypstate_delete(parser->pstate);
+			_parser_clear_branches(parser);
+			free(parser->branches);
+			free(parser->guard);
+			free(parser->conditionals);
+			free(parser->unknown);
+			table_release(parser->table);
+			pkgbuild_includes_release(parser->includes);
+			free(parser->directory);
+			assignment_records_free(parser->records, parser->record_count);
+			free(parser->record_elements);
+			_clear_derivation_elements(parser);
+			free(parser->derivation_elements);
+			derivations_free(parser->derivations, parser->derivation_count);
+			free(parser->checkpoints);
+			free(parser->function_ranges);
+			arena_release(parser->arena);
+			free(parser->queue);
+			free(parser->elements);
+			free(parser->raw);
+			free(parser->buffer);
+			free(parser);
 		}
+	}
+}
+
+int pkgbuild_parser_feed(pkgbuild_parser_t *parser, const char *chunk,
+	size_t len)
+{
+	/* Input following an early stop is of no interest */
+	if(parser->status == YYPUSH_MORE) {
+		_parser_reserve(parser, len);
+		memcpy(parser->buffer + parser->length, chunk, len);
+		parser->length += len;
+		_parser_terminate(parser);
+		_parser_lex(parser);
+		_parser_compact(parser);
+	}
+	return parser->status == YYPUSH_MORE || parser->status == 0;
+}
+
+void pkgbuild_parser_resume(pkgbuild_parser_t *parser, table_t *table,
+	size_t offset)
+{
+	table_copy(parser->table, table, NULL);
+	parser->discarded = offset;
+	parser->last_checkpoint = offset;
+	/* Architecture specific variables may have been assigned before */
+	parser->arch_specific = 1;
+}
+
+void pkgbuild_parser_set_recording(pkgbuild_parser_t *parser, int recording)
+{
+	if(parser != NULL) {
+		parser->recording = recording;
+	}
+}
+
+assignment_record_t *pkgbuild_parser_take_records(pkgbuild_parser_t *parser,
+	size_t *count)
+{
+	assignment_record_t *records;
+
+	if(parser == NULL) {
+		*count = 0;
+		return NULL;
+	}
+	records = parser->records;
+	*count = parser->record_count;
+	parser->records = NULL;
+	parser->record_count = 0;
+	parser->record_size = 0;
+	return records;
+}
+
+void assignment_records_free(assignment_record_t *records, size_t count)
+{
+	size_t i;
+
+	for(i = 0; i < count; i++) {
+		free(records[i].name);
+		free(records[i].elements);
+	}
+	free(records);
+}
+
+/*
+Copy the branches guarded on the architecture, and the architecture specific
+variables, into the result, so that they outlive the arena of the parser.
+Only the variables of architectures listed in the arch array are copied.
+
+Parameters:
+	parser - The parser being finished.
+	pkgbuild - The result of the parser.
+*/
+static void _parser_export_arch(pkgbuild_parser_t *parser, pkgbuild_t *pkgbuild)
+{
+	arch_branch_t *branch;
+
+	for(branch = parser->branches;
+			branch < parser->branches + parser->branch_count; branch++) {
+		pkgbuild_add_branch(pkgbuild, branch->tests, branch->test_count,
+			branch->table);
+	}
+
+	if(parser->arch_specific) {
+		pkgbuild_copy_arch_variables(pkgbuild, parser->table);
+	}
+}
+
+/*
+Move the derivations and the layout of the PKGBUILD into the result, unless
+it cannot be derived again.
+
+Parameters:
+	parser - The parser being finished.
+	pkgbuild - The result of the parser.
+*/
+static void _parser_export_index(pkgbuild_parser_t *parser,
+	pkgbuild_t *pkgbuild)
+{
+	parse_index_t *index;
+
+	index = calloc(1, sizeof(*index));
+	index->options = parser->options;
+	index->length = parser->discarded + parser->length;
+	if(!parser->underivable && !parser->unsupported) {
+		pkgbuild_set_derivations(pkgbuild, parser->derivations,
+			parser->derivation_count);
+		parser->derivations = NULL;
+		parser->derivation_count = 0;
+		parser->derivation_size = 0;
+		index->checkpoints = parser->checkpoints;
+		index->checkpoint_count = parser->checkpoint_count;
+		parser->checkpoints = NULL;
+		parser->checkpoint_size = 0;
+		index->functions = parser->function_ranges;
+		index->function_count = parser->function_range_count;
+		parser->function_ranges = NULL;
+		parser->function_range_size = 0;
+	}
+	pkgbuild_set_index(pkgbuild, index);
+}
+
+/* Parse the remainder of the input, once all of it has been read. */
+static void _parser_complete(pkgbuild_parser_t *parser)
+{
+	parser->lexer.partial = 0;
+	_parser_lex(parser);
+
+	/* An error or an early stop may leave conditionals and functions
+	unterminated, whose scopes are left for the top-level table */
+	while(parser->conditional_count > 0) {
+		_exit_conditional(parser);
+	}
+	while(parser->functions > 0) {
+		_exit_function(parser);
+	}
+}
+
+pkgbuild_t *pkgbuild_parser_finish(pkgbuild_parser_t *parser)
+{
+	pkgbuild_t *pkgbuild;
+
+	_parser_complete(parser);
+	pkgbuild = pkgbuild_new();
+	pkgbuild_set_table(pkgbuild, parser->table);
+	_parser_export_arch(parser, pkgbuild);
+	pkgbuild_set_unsupported(pkgbuild, parser->unsupported);
+	if(parser->options & kPkgbuildOptionTrackDependencies) {
+		_parser_export_index(parser, pkgbuild);
+	}
+	if(parser->fields != kPkgbuildFieldAll) {
+		pkgbuild_load_fields(pkgbuild, parser->fields);
+	} else if(!(parser->options & kPkgbuildOptionLazy)) {
+		pkgbuild_load_fields(pkgbuild, kPkgbuildFieldAll);
+	}
+	if(parser->fields == kPkgbuildFieldAll
+			&& (parser->options & kPkgbuildOptionLazy)) {
+		/* The table of a lazy parse is retained by the result, which takes
+		over the arena it is allocated within */
+		pkgbuild_set_arena(pkgbuild, parser->arena);
+		arena_release(parser->arena);
+		parser->arena = arena_new();
 	} else {
-		str = sh_parse_word(g_table, rvalue);
-		symbol_set_string(symbol, str);
-		free(str);
+		/* The arena is about to be reset, so fields which were not requested
+		remain unset */
+		pkgbuild_detach(pkgbuild);
 	}
-	table_insert(g_table, symbol);
-	symbol_release(symbol);
+
+	_parser_reset(parser);
+	return pkgbuild;
 }
 
-static void _enter_function(char *name)
+/*
+Read the remainder of a file into the buffer of a parser.
+
+Parameters:
+	parser - The parser to read into.
+	fp - The file to be read.
+*/
+static void _parser_read_file(pkgbuild_parser_t *parser, FILE *fp)
 {
-	table_t *table;
-	symbol_t *symbol;
+	while(!feof(fp) && !ferror(fp)) {
+		_parser_reserve(parser, BUFSIZ);
+		parser->length += fread(parser->buffer + parser->length, 1,
+			parser->size - parser->length - 2, fp);
+	}
+	_parser_terminate(parser);
+}
 
-	table = table_new_with_parent(g_table);
+/*
+Evaluate a helper script on its own, so that the result can be shared by
+every PKGBUILD sourcing it. The script must not depend on variables of the
+PKGBUILD, see <_check_value()>, nor on the architecture.
 
-	symbol = symbol_new(name);
-	symbol_set_function(symbol, table);
-	table_insert(g_table, symbol);
+Parameters:
+	path - The path to the script.
+
+Returns:
+	A table holding the variables assigned by the script, or NULL if it
+	cannot be evaluated on its own.
+*/
+static table_t *_parse_include(const char *path)
+{
+	pkgbuild_parser_t *parser;
+	table_t *table = NULL;
+	FILE *fp;
 
-	table_release(g_table);
-	g_table = table;
+	fp = fopen(path, "r");
+	if(fp == NULL) {
+		return NULL;
+	}
+	/* Functions defined by helper scripts, such as shared build steps, do
+	not define metadata */
+	parser = _parser_new(kPkgbuildOptionSkipFunctions, kPkgbuildFieldAll);
+	parser->include = 1;
+	_parser_read_file(parser, fp);
+	fclose(fp);
+	_parser_complete(parser);
+
+	if(!parser->unsupported && parser->branch_count == 0) {
+		/* Copied out of the arena of the parser */
+		table = table_new();
+		table_copy(table, parser->table, NULL);
+	}
+	pkgbuild_parser_release(parser);
+	return table;
 }
 
-static void _exit_function()
+/*
+Retrieve the variables of a helper script, which is only evaluated the first
+time it is sourced by a parser sharing the includes of the parser, and again
+whenever the file changes.
+
+Parameters:
+	parser - The parser handling the PKGBUILD sourcing the script.
+	path - The path to the script.
+
+Returns:
+	The table holding the variables of the script, which must be released
+	with <table_release()>, or NULL if it cannot be evaluated on its own.
+*/
+static table_t *_include(pkgbuild_parser_t *parser, const char *path)
 {
+	pkgbuild_includes_t *includes;
+	_include_t *include = NULL;
 	table_t *table;
+	struct stat st;
+	char *canonical;
+	int current = 0;
+	size_t i;
+
+	canonical = realpath(path, NULL);
+	if(canonical == NULL || stat(canonical, &st) != 0) {
+		free(canonical);
+		return NULL;
+	}
+	if(parser->includes == NULL) {
+		parser->includes = pkgbuild_includes_new();
+	}
+	includes = parser->includes;
 
-	table = table_retain(table_parent(g_table));
-	table_release(g_table);
-	g_table = table;
+	pthread_mutex_lock(&includes->mutex);
+	for(i = 0; i < includes->count && include == NULL; i++) {
+		if(strcmp(includes->includes[i].path, canonical) == 0) {
+			include = &includes->includes[i];
+		}
+	}
 
+	if(include == NULL) {
+		if(includes->count == includes->size) {
+			includes->size = includes->size > 0 ? includes->size * 2 : 4;
+			includes->includes = realloc(includes->includes,
+				includes->size * sizeof(*includes->includes));
+		}
+		include = &includes->includes[includes->count++];
+		include->path = canonical;
+		include->table = NULL;
+	} else {
+		free(canonical);
+		current = include->device == st.st_dev && include->inode == st.st_ino
+			&& include->mtime == st.st_mtime && include->size == st.st_size;
+	}
+	if(!current) {
+		table_release(include->table);
+		include->device = st.st_dev;
+		include->inode = st.st_ino;
+		include->mtime = st.st_mtime;
+		include->size = st.st_size;
+		include->table = _parse_include(include->path);
+	}
+	/* The script may change while the table is in use by the parser */
+	table = table_retain(include->table);
+	pthread_mutex_unlock(&includes->mutex);
+	return table;
 }
 
-pkgbuild_t *pkgbuild_parse(FILE *fp)
+pkgbuild_includes_t *pkgbuild_includes_new()
 {
+	pkgbuild_includes_t *includes;
+
+	includes = calloc(1, sizeof(*includes));
+	pthread_mutex_init(&includes->mutex, NULL);
+	return pkgbuild_includes_retain(includes);
+}
+
+pkgbuild_includes_t *pkgbuild_includes_retain(pkgbuild_includes_t *includes)
+{
+	if(includes != NULL) {
+		__sync_add_and_fetch(&includes->refcount, 1);
+	}
+	return includes;
+}
+
+void pkgbuild_includes_release(pkgbuild_includes_t *includes)
+{
+	size_t i;
+
+	if(includes != NULL && __sync_sub_and_fetch(&includes->refcount, 1) == 0) {
+		for(i = 0; i < includes->count; i++) {
+			free(includes->includes[i].path);
+			table_release(includes->includes[i].table);
+		}
+		free(includes->includes);
+		pthread_mutex_destroy(&includes->mutex);
+		free(includes);
+	}
+}
+
+void pkgbuild_parser_set_includes(pkgbuild_parser_t *parser,
+	pkgbuild_includes_t *includes)
+{
+	if(parser != NULL) {
+		pkgbuild_includes_retain(includes);
+		pkgbuild_includes_release(parser->includes);
+		parser->includes = includes;
+	}
+}
+
+void pkgbuild_parser_set_directory(pkgbuild_parser_t *parser,
+	const char *directory)
+{
+	if(parser != NULL) {
+		free(parser->directory);
+		parser->directory = directory != NULL ? strdup(directory) : NULL;
+	}
+}
+
+pkgbuild_t *pkgbuild_parser_parse_file(pkgbuild_parser_t *parser,
+	const char *path)
+{
+	pkgbuild_t *pkgbuild;
+	char *directory;
+	char *slash;
+	FILE *fp;
+
+	if(parser == NULL || path == NULL) {
+		return NULL;
+	}
+	fp = fopen(path, "r");
+	if(fp == NULL) {
+		return NULL;
+	}
+	directory = strdup(path);
+	slash = strrchr(directory, '/');
+	if(slash == NULL) {
+		pkgbuild_parser_set_directory(parser, ".");
+	} else {
+		/* The root directory keeps its slash */
+		slash[slash == directory] = '\0';
+		pkgbuild_parser_set_directory(parser, directory);
+	}
+	free(directory);
+
+	_parser_read_file(parser, fp);
+	fclose(fp);
+	pkgbuild = pkgbuild_parser_finish(parser);
+	return pkgbuild;
+}
+
+/*
+Parse a PKGBUILD file. The whole file is read before it is parsed, so that
+parsing can stop early.
+
+Parameters:
+	fp - A file pointer to the PKGBUILD.
+	options - A combination of <pkgbuild_option_t> flags.
+	fields - The fields to be extracted, see <_parser_new()>.
+
+Returns:
+	An initialized pkgbuild_t structure, or NULL on error.
+*/
+static pkgbuild_t *_parse(FILE *fp, int options, unsigned int fields)
+{
+	pkgbuild_parser_t *parser;
 	pkgbuild_t *pkgbuild = NULL;
-#if DEBUG
-		yydebug = 1;
-#endif
 
 	if(fp != NULL) {
-		g_table = table_new();
+		parser = _parser_new(options, fields);
 		fseek(fp, 0, SEEK_SET);
-		yyin = fp;
-		yyparse();
+		_parser_read_file(parser, fp);
+		pkgbuild = pkgbuild_parser_finish(parser);
+		pkgbuild_parser_release(parser);
+	}
 
-		pkgbuild = pkgbuild_new();
-		_set_pkgbuild_fields_from_table(pkgbuild, g_table);
+	return pkgbuild;
+}
 
-		table_release(g_table);
-		g_table = NULL;
+pkgbuild_t *pkgbuild_parse(FILE *fp)
+{
+	return _parse(fp, kPkgbuildOptionNone, kPkgbuildFieldAll);
+}
+
+pkgbuild_t *pkgbuild_parse_with_options(FILE *fp, int options)
+{
+	return _parse(fp, options, kPkgbuildFieldAll);
+}
+
+pkgbuild_t *pkgbuild_parse_fields(FILE *fp, unsigned int fields)
+{
+	return _parse(fp, kPkgbuildOptionLazy | kPkgbuildOptionSkipFunctions,
+		fields);
+}
+
+/*
+Parse the .SRCINFO in the directory of a PKGBUILD, unless it is older than
+the PKGBUILD, in which case it may be out of date.
+
+Parameters:
+	path - The path to the PKGBUILD.
+
+Returns:
+	An initialized pkgbuild_t structure, or NULL if there is no usable
+	.SRCINFO.
+*/
+static pkgbuild_t *_parse_srcinfo(const char *path)
+{
+	pkgbuild_t *pkgbuild = NULL;
+	struct stat pkgbuild_stat;
+	struct stat srcinfo_stat;
+	const char *slash;
+	char *srcinfo;
+	size_t length;
+	FILE *fp;
+
+	slash = strrchr(path, '/');
+	length = slash != NULL ? (size_t)(slash - path + 1) : 0;
+	srcinfo = malloc(length + sizeof(".SRCINFO"));
+	memcpy(srcinfo, path, length);
+	strcpy(srcinfo + length, ".SRCINFO");
+
+	if(stat(path, &pkgbuild_stat) == 0 && stat(srcinfo, &srcinfo_stat) == 0
+			&& srcinfo_stat.st_mtime >= pkgbuild_stat.st_mtime) {
+		fp = fopen(srcinfo, "r");
+		if(fp != NULL) {
+			pkgbuild = pkgbuild_parse_srcinfo(fp);
+			fclose(fp);
+		}
 	}
+	free(srcinfo);
+	return pkgbuild;
+}
 
+pkgbuild_t *pkgbuild_parse_file(const char *path, int options,
+	pkgbuild_pool_t *pool)
+{
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *evaluated;
+
+	if(path == NULL) {
+		return NULL;
+	}
+	if(!(options & kPkgbuildOptionIgnoreSrcinfo)) {
+		pkgbuild = _parse_srcinfo(path);
+		if(pkgbuild != NULL) {
+			return pkgbuild;
+		}
+	}
+
+	parser = _parser_new(options, kPkgbuildFieldAll);
+	pkgbuild = pkgbuild_parser_parse_file(parser, path);
+	pkgbuild_parser_release(parser);
+
+	if(pkgbuild != NULL && pool != NULL && pkgbuild_unsupported(pkgbuild)) {
+		evaluated = pkgbuild_pool_evaluate(pool, path);
+		if(evaluated != NULL) {
+			pkgbuild_release(pkgbuild);
+			pkgbuild = evaluated;
+		}
+	}
 	return pkgbuild;
 }
@@ -22,12 +22,119 @@
 #ifndef PKGBUILD_PRIVATE_H
 #define PKGBUILD_PRIVATE_H
 
+#include "pkgparse.h"
+#include "symbol.h"
+
+/* Type: arch_test_t
+A comparison of the architecture being built for, such as
+[ "$CARCH" = "x86_64" ] or an item of case $CARCH in.
+
+pattern - The shell patterns the architecture is matched against, separated by
+	'|', see <condition_match()>.
+match - Whether the architecture must match pattern (1), or must not (0).
+*/
+typedef struct {
+	char *pattern;
+	int match;
+} arch_test_t;
+
+/* Type: arch_branch_t
+A branch of a conditional which only applies to some architectures.
+
+tests - The tests which must all hold for the branch to be taken. They include
+	those of the enclosing branches, and negations of the preceding branches of
+	the same conditional.
+test_count - The amount of tests.
+table - The variables assigned within the branch.
+*/
+typedef struct {
+	arch_test_t *tests;
+	size_t test_count;
+	table_t *table;
+} arch_branch_t;
+
+/* Fields which may be extended by architecture specific variables, such as
+source_x86_64 */
+#define kPkgbuildFieldArchSpecific (kPkgbuildFieldSources \
+	| kPkgbuildFieldMd5sums | kPkgbuildFieldSha1sums | kPkgbuildFieldSha256sums \
+	| kPkgbuildFieldSha384sums | kPkgbuildFieldSha512sums \
+	| kPkgbuildFieldDepends | kPkgbuildFieldMakedepends \
+	| kPkgbuildFieldCheckdepends \
+	| kPkgbuildFieldOptdepends | kPkgbuildFieldConflicts \
+	| kPkgbuildFieldProvides | kPkgbuildFieldReplaces)
+
+/* Type: derivation_t
+An assignment at the top level of a PKGBUILD, kept unexpanded so that the
+values depending on it can be derived again, see <pkgbuild_set_variable()>.
+
+name - The name of the variable.
+offset - The offset of the assignment from the start of the input.
+value - The value as written, or NULL for an array.
+elements - The elements of an array as written, terminated by NULL, or NULL
+	for a string.
+append - Whether the value is appended, as with "depends+=(foo)".
+references - The variables referenced by the value, see <sh_references()>.
+*/
+typedef struct {
+	char *name;
+	size_t offset;
+	char *value;
+	char **elements;
+	int append;
+	char **references;
+} derivation_t;
+
+/* Type: function_range_t
+A function defined at the top level of a PKGBUILD.
+
+offset - The offset of the line the definition starts on.
+end - The offset following the line the definition ends on.
+package - Whether the function is package() or package_*().
+*/
+typedef struct {
+	size_t offset;
+	size_t end;
+	int package;
+} function_range_t;
+
+/* Type: parse_index_t
+The layout of a parsed PKGBUILD, kept with kPkgbuildOptionTrackDependencies
+so that it can be parsed again incrementally, see <pkgbuild_reparse()>.
+
+options - The options the PKGBUILD was parsed with.
+length - The length of the input.
+checkpoints - The offsets following lines which end a statement at the top
+	level, in order, at which parsing may resume. They are only known if
+	the pkgbuild has derivations.
+checkpoint_count - The amount of checkpoints.
+functions - The functions defined at the top level, in order.
+function_count - The amount of functions.
+*/
+typedef struct {
+	int options;
+	size_t length;
+	size_t *checkpoints;
+	size_t checkpoint_count;
+	function_range_t *functions;
+	size_t function_count;
+} parse_index_t;
+
 struct _pkgbuild_t {
 	unsigned int refcount;
+	/* The symbol table fields are loaded from on access, or NULL once every
+	field has been loaded */
+	table_t *table;
+	/* The arena the table of a lazy parse is allocated within, or NULL.
+	Tables of functions and their parents reference each other, so they are
+	only reclaimed together with the arena */
+	arena_t *arena;
+	/* Fields which have been loaded or explicitly set */
+	unsigned int loaded;
 	char *basename;
 	char **names;
 	char *version;
 	float rel;
+	char *epoch;
 	char *desc;
 	char *url;
 	char **licenses;
@@ -44,19 +151,304 @@ struct _pkgbuild_t {
 	char **backup;
 	char **depends;
 	char **makedepends;
+	char **checkdepends;
 	char **optdepends;
 	char **conflicts;
 	char **provides;
 	char **replaces;
 	char **options;
 	pkgbuild_t **splitpkgs;
+	/* Branches of conditionals on the architecture, in order of appearance */
+	arch_branch_t *branches;
+	size_t branch_count;
+	/* Architecture specific variables, such as source_x86_64, or NULL */
+	table_t *arch_variables;
+	/* The pkgbuild a view created by pkgbuild_for_arch() is based on, and
+	the architecture of the view */
+	pkgbuild_t *base;
+	char *arch;
+	/* Whether the PKGBUILD relies on constructs the parser does not
+	evaluate, see pkgbuild_unsupported() */
+	int unsupported;
+	/* Whether the pkgbuild is a split package, whose fields are only loaded
+	from the table of its function */
+	int split;
+	/* The assignments at the top level, in order, if dependencies are
+	tracked and every value is derived from them */
+	derivation_t *derivations;
+	size_t derivation_count;
+	/* The layout of the PKGBUILD, if dependencies are tracked */
+	parse_index_t *index;
 };
 
+/* Type: assignment_record_t
+An assignment outside of functions, recorded by a parser for editing the
+PKGBUILD in place. Offsets are relative to the start of the input.
+
+name - The name of the variable, or NULL if the record marks a file sourced
+	outside of functions, whose variables are not recorded.
+offset - The offset of the value as written, which is the word of a string
+	assignment, or the array literal including its parentheses.
+length - The length of the value, without trailing blanks.
+elements - The offset and length of each element of an array, in pairs, or
+	NULL.
+element_count - The amount of elements.
+array - Whether an array is assigned.
+append - Whether the value is appended, as with "depends+=(foo)".
+conditional - Whether the assignment is within a conditional.
+*/
+typedef struct {
+	char *name;
+	size_t offset;
+	size_t length;
+	size_t *elements;
+	size_t element_count;
+	int array;
+	int append;
+	int conditional;
+} assignment_record_t;
+
 pkgbuild_t *pkgbuild_new();
 
+/* Function: pkgbuild_set_table
+Associate a symbol table with the pkgbuild. Fields which have not been set are
+loaded from the table when first accessed.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	table - The table holding the PKGBUILD variables. It is retained until all
+		fields have been loaded, or the pkgbuild is deallocated.
+*/
+void pkgbuild_set_table(pkgbuild_t *pkgbuild, table_t *table);
+
+/* Function: pkgbuild_detach
+Release the tables associated with the pkgbuild and its split packages, so
+that none of them refers to the parser any longer. Fields which have not been
+loaded remain unset.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+*/
+void pkgbuild_detach(pkgbuild_t *pkgbuild);
+
+/* Function: pkgbuild_copy
+Create a pkgbuild holding copies of the fields, split packages, derivations
+and layout of another. Fields which have not been loaded yet are loaded from
+the same table.
+
+Parameters:
+	pkgbuild - The pkgbuild to be copied.
+
+Returns:
+	A new pkgbuild, or NULL if pkgbuild is NULL.
+*/
+pkgbuild_t *pkgbuild_copy(pkgbuild_t *pkgbuild);
+
+/* Function: pkgbuild_add_branch
+Record a branch of a conditional on the architecture, for use by
+<pkgbuild_for_arch()>.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	tests - The tests which must hold for the branch to be taken. They are
+		copied.
+	test_count - The amount of tests.
+	table - The table of variables assigned within the branch. Its variables
+		are copied, so that it can be released along with the parser.
+*/
+void pkgbuild_add_branch(pkgbuild_t *pkgbuild, arch_test_t *tests,
+	size_t test_count, table_t *table);
+
+/* Function: pkgbuild_copy_arch_variables
+Copy the architecture specific variables, such as source_x86_64, of the
+architectures listed in a table, for use by <pkgbuild_for_arch()>.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	table - The table holding the PKGBUILD variables. The variables are
+		copied, so that it can be released along with the parser.
+*/
+void pkgbuild_copy_arch_variables(pkgbuild_t *pkgbuild, table_t *table);
+
+/* Function: pkgbuild_set_unsupported
+Mark the pkgbuild as relying on constructs the parser does not evaluate.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	unsupported - True (1) if metadata may be missing or incorrect.
+
+See Also:
+	<pkgbuild_unsupported()>
+*/
+void pkgbuild_set_unsupported(pkgbuild_t *pkgbuild, int unsupported);
+
+/* Function: pkgbuild_load_fields
+Load fields from the table associated with <pkgbuild_set_table()>. Fields
+which have already been loaded are left untouched. Split packages are loaded
+with the same set of fields.
+
+Parameters:
+	pkgbuild - The pkgbuild being modified.
+	fields - A combination of <pkgbuild_field_t> flags.
+*/
+void pkgbuild_load_fields(pkgbuild_t *pkgbuild, unsigned int fields);
+
+/* Function: pkgbuild_field_lvalue
+Retrieve the name of the PKGBUILD variable a field is loaded from.
+
+Parameters:
+	field - A single <pkgbuild_field_t> flag.
+
+Returns:
+	The name of the variable, such as "pkgver", or NULL if the field is not
+	loaded from a variable.
+*/
+const char *pkgbuild_field_lvalue(pkgbuild_field_t field);
+
+/* Function: pkgbuild_parser_set_recording
+Set whether a parser records the assignments outside of functions of the
+PKGBUILDs it parses. Records accumulate until they are taken with
+<pkgbuild_parser_take_records()>.
+
+Parameters:
+	parser - The parser to be modified.
+	recording - True (1) to record assignments.
+*/
+void pkgbuild_parser_set_recording(pkgbuild_parser_t *parser, int recording);
+
+/* Function: pkgbuild_parser_take_records
+Take the assignments recorded by a parser, in order of appearance.
+
+Parameters:
+	parser - The recording parser.
+	count - Set to the amount of records.
+
+Returns:
+	The records, which must be deallocated with <assignment_records_free()>.
+*/
+assignment_record_t *pkgbuild_parser_take_records(pkgbuild_parser_t *parser,
+	size_t *count);
+
+/* Function: assignment_records_free
+Deallocate records taken from a parser.
+
+Parameters:
+	records - The records, or NULL.
+	count - The amount of records.
+*/
+void assignment_records_free(assignment_record_t *records, size_t count);
+
+/* Function: derivation_init
+Initialize a derivation, finding the variables its value references.
+
+Parameters:
+	derivation - The derivation to be initialized.
+	name - The name of the variable, which is copied.
+	value - The value as written, which is copied, or NULL for an array.
+	elements - The elements of an array as written, which are taken over by
+		the derivation, or NULL for a string.
+	append - Whether the value is appended.
+*/
+void derivation_init(derivation_t *derivation, const char *name,
+	const char *value, char **elements, int append);
+
+/* Function: derivation_copy
+Initialize a derivation as a copy of another.
+
+Parameters:
+	derivation - The derivation to be initialized.
+	source - The derivation to be copied.
+*/
+void derivation_copy(derivation_t *derivation, derivation_t *source);
+
+/* Function: derivations_replay
+Expand derivations in order, as the parser would.
+
+Parameters:
+	derivations - The derivations.
+	count - The amount of derivations.
+
+Returns:
+	A table holding the variables assigned, which must be deallocated using
+	<table_release()>.
+*/
+table_t *derivations_replay(derivation_t *derivations, size_t count);
+
+/* Function: derivations_free
+Deallocate the derivations of a pkgbuild.
+
+Parameters:
+	derivations - The derivations, or NULL.
+	count - The amount of derivations.
+*/
+void derivations_free(derivation_t *derivations, size_t count);
+
+/* Function: pkgbuild_set_derivations
+Set the assignments the values of a pkgbuild are derived from, see
+<derivation_t>.
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	derivations - The derivations, which are taken over by the pkgbuild.
+	count - The amount of derivations.
+*/
+void pkgbuild_set_derivations(pkgbuild_t *pkgbuild,
+	derivation_t *derivations, size_t count);
+
+/* Function: parse_index_free
+Deallocate the layout of a PKGBUILD.
+
+Parameters:
+	index - The layout, or NULL.
+*/
+void parse_index_free(parse_index_t *index);
+
+/* Function: parse_index_copy
+Copy the layout of a PKGBUILD.
+
+Parameters:
+	index - The layout, or NULL.
+
+Returns:
+	A copy of the layout, or NULL if index is NULL.
+*/
+parse_index_t *parse_index_copy(parse_index_t *index);
+
+/* Function: pkgbuild_set_index
+Set the layout of the PKGBUILD a pkgbuild was parsed from.
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	index - The layout, which is taken over by the pkgbuild.
+*/
+void pkgbuild_set_index(pkgbuild_t *pkgbuild, parse_index_t *index);
+
+/* Function: pkgbuild_set_arena
+Make a pkgbuild own the arena its table is allocated within, which is kept
+until the table is no longer needed.
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	arena - The arena, which is retained.
+*/
+void pkgbuild_set_arena(pkgbuild_t *pkgbuild, arena_t *arena);
+
+/* Function: pkgbuild_parser_resume
+Prepare a parser to parse the remainder of a PKGBUILD, from a checkpoint of
+its <parse_index_t> on. Offsets are relative to the start of the PKGBUILD.
+
+Parameters:
+	parser - A parser which has not been fed yet.
+	table - The variables assigned before the checkpoint, which are copied.
+	offset - The offset of the checkpoint.
+*/
+void pkgbuild_parser_resume(pkgbuild_parser_t *parser, table_t *table,
+	size_t offset);
+
 void pkgbuild_set_names(struct _pkgbuild_t *pkgbuild, char **names);
 void pkgbuild_set_basename(struct _pkgbuild_t *pkgbuild, char *basename);
 void pkgbuild_set_version(struct _pkgbuild_t *pkgbuild, char *version);
+void pkgbuild_set_epoch(pkgbuild_t *pkgbuild, char *epoch);
 void pkgbuild_set_rel(struct _pkgbuild_t *pkgbuild, float rel);
 void pkgbuild_set_desc(struct _pkgbuild_t *pkgbuild, char *desc);
 void pkgbuild_set_url(struct _pkgbuild_t *pkgbuild, char *url);
@@ -74,6 +466,7 @@ void pkgbuild_set_architectures(pkgbuild_t *pkgbuild, char **architectures);
 void pkgbuild_set_backup(pkgbuild_t *pkgbuild, char **backup);
 void pkgbuild_set_depends(pkgbuild_t *pkgbuild, char **depends);
 void pkgbuild_set_makedepends(pkgbuild_t *pkgbuild, char **makedepends);
+void pkgbuild_set_checkdepends(pkgbuild_t *pkgbuild, char **checkdepends);
 void pkgbuild_set_optdepends(pkgbuild_t *pkgbuild, char **optdepends);
 void pkgbuild_set_conflicts(pkgbuild_t *pkgbuild, char **conflicts);
 void pkgbuild_set_provides(pkgbuild_t *pkgbuild, char **provides);
@@ -29,9 +29,13 @@ See Also:
 #include "cmockery.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "pkgparse.h"
 
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+
 void test_parse_pkgbuild_minimal(void **state)
 {
 	FILE *fp;
@@ -42,7 +46,8 @@ void test_parse_pkgbuild_minimal(void **state)
 		"pkgname=foobar\n"
 		"pkgver=1.0\n"
 		"pkgrel=1\n"
-		"pkgdesc=\"dummy package\"\n");
+		"pkgdesc=\"dummy package\"\n"
+		"url=\"https://example.org/ #top\" # home\n");
 	fseek(fp, 0, SEEK_SET);
 	pkgbuild = pkgbuild_parse(fp);
 	fclose(fp);
@@ -51,6 +56,7 @@ void test_parse_pkgbuild_minimal(void **state)
 	assert_string_equal(pkgbuild_version(pkgbuild), "1.0");
 	assert_true(pkgbuild_rel(pkgbuild) == 1);
 	assert_string_equal(pkgbuild_desc(pkgbuild), "dummy package");
+	assert_string_equal(pkgbuild_url(pkgbuild), "https://example.org/ #top");
 	pkgbuild_release(pkgbuild);
 }
 
@@ -158,3 +164,485 @@ void test_parse_pkgbuild_splitpkg(void **state)
 
 	pkgbuild_release(pkgbuild);
 }
+
+void test_parse_pkgbuild_lazy(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	char **array;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=patch\n"
+		"pkgver=2.5.4\n"
+		"pkgrel=3\n"
+		"_mirror=ftp://ftp.gnu.org/gnu\n"
+		"source=($_mirror/$pkgname/$pkgname-$pkgver.tar.gz)\n"
+		"depends=(a  bc d)\n"
+		"pkgver=2.6\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_with_options(fp, kPkgbuildOptionLazy);
+	fclose(fp);
+
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "patch");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2.6");
+	assert_true(pkgbuild_rel(pkgbuild) == 3.0f);
+	array = pkgbuild_sources(pkgbuild);
+	assert_string_equal(array[0],
+		"ftp://ftp.gnu.org/gnu/patch/patch-2.5.4.tar.gz");
+	/* Single character elements are kept, and repeated blanks skipped */
+	array = pkgbuild_depends(pkgbuild);
+	assert_string_equal(array[0], "a");
+	assert_string_equal(array[1], "bc");
+	assert_string_equal(array[2], "d");
+	assert_true(array[3] == NULL);
+	assert_true(pkgbuild_desc(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+
+	/* Fields are found when the input ends within a function, as with an
+	eager parse */
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"package() {\n"
+		"    pkgdesc=\"A foo\"\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_with_options(fp, kPkgbuildOptionLazy);
+	fclose(fp);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1");
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_skip_functions(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"build() {\n"
+		"    if [[ -n $x ]]; then { echo \"}\"; }; fi\n"
+		"}\n"
+		"package() {\n"
+		"    pkgdesc=\"a foo\"\n"
+		"}\n"
+		"pkgrel=2\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_with_options(fp, kPkgbuildOptionSkipFunctions);
+	fclose(fp);
+
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1");
+	assert_true(pkgbuild_rel(pkgbuild) == 2.0f);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_fields(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"pkgdesc=\"A foo\"\n"
+		"pkgver=2\n"
+		"depends=(bar)\n"
+		"unsupported $(syntax)\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_fields(fp,
+		kPkgbuildFieldNames | kPkgbuildFieldVersion);
+	fclose(fp);
+
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	assert_true(pkgbuild_desc(pkgbuild) == NULL);
+	assert_true(pkgbuild_depends(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_chunked(void **state)
+{
+	const char *input =
+		"# comment\n"
+		"  pkgname=foo\n"
+		"pkgver=1\n"
+		"build() {\n"
+		"    echo \"}\"\n"
+		"}\n"
+		"pkgrel=2\n"
+		"arch=('i686' \"$pkgname\")";
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+	size_t length = strlen(input);
+	size_t i;
+
+	parser = pkgbuild_parser_new_with_options(kPkgbuildOptionSkipFunctions);
+	/* Split tokens at every possible position */
+	for(i = 0; i < length; i += 3) {
+		assert_true(pkgbuild_parser_feed(parser, input + i,
+			length - i < 3 ? length - i : 3));
+	}
+	pkgbuild = pkgbuild_parser_finish(parser);
+
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1");
+	assert_true(pkgbuild_rel(pkgbuild) == 2.0f);
+	assert_string_equal(pkgbuild_architectures(pkgbuild)[1], "foo");
+	pkgbuild_release(pkgbuild);
+
+	/* The parser is reusable once finished */
+	assert_true(pkgbuild_parser_feed(parser, "pkgname=bar\n", 12));
+	pkgbuild = pkgbuild_parser_finish(parser);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	assert_true(pkgbuild_version(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+
+	pkgbuild_parser_release(parser);
+}
+
+void test_parse_pkgbuild_multiline_array(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	char **array;
+	int options[] = {kPkgbuildOptionNone, kPkgbuildOptionLazy};
+	int i;
+
+	for(i = 0; i < 2; i++) {
+		fp = tmpfile();
+		fprintf(fp,
+			"pkgname=foo\n"
+			"pkgver=1\n"
+			"source=( # comment\n"
+			"  \"$pkgname-$pkgver.tar.gz\"\n"
+			"  # another comment\n"
+			"  'foo bar'\n"
+			")\n"
+			"depends=()\n"
+			"pkgrel=2\n");
+		fseek(fp, 0, SEEK_SET);
+		pkgbuild = pkgbuild_parse_with_options(fp, options[i]);
+		fclose(fp);
+
+		array = pkgbuild_sources(pkgbuild);
+		assert_true(array != NULL);
+		assert_string_equal(array[0], "foo-1.tar.gz");
+		assert_string_equal(array[1], "foo bar");
+		assert_true(array[2] == NULL);
+		assert_true(pkgbuild_depends(pkgbuild)[0] == NULL);
+		assert_true(pkgbuild_rel(pkgbuild) == 2.0f);
+		pkgbuild_release(pkgbuild);
+	}
+}
+
+void test_parse_pkgbuild_append(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t **splitpkgs;
+	char **array;
+	int options[] = {kPkgbuildOptionNone, kPkgbuildOptionLazy};
+	int i;
+
+	for(i = 0; i < 2; i++) {
+		fp = tmpfile();
+		fprintf(fp,
+			"pkgbase=foo\n"
+			"pkgname=(foo bar)\n"
+			"pkgver=1\n"
+			"pkgver+=.2\n"
+			"pkgdesc=\"A foo\"\n"
+			"depends=(glibc)\n"
+			"depends+=(zlib\n"
+			"  \"$pkgbase-libs\")\n"
+			"package_foo() {\n"
+			"    depends+=(bzip2)\n"
+			"}\n"
+			"package_bar() {\n"
+			"    pkgdesc+=\" bar\"\n"
+			"}\n");
+		fseek(fp, 0, SEEK_SET);
+		pkgbuild = pkgbuild_parse_with_options(fp, options[i]);
+		fclose(fp);
+
+		assert_string_equal(pkgbuild_version(pkgbuild), "1.2");
+		array = pkgbuild_depends(pkgbuild);
+		assert_string_equal(array[0], "glibc");
+		assert_string_equal(array[1], "zlib");
+		assert_string_equal(array[2], "foo-libs");
+		assert_true(array[3] == NULL);
+
+		splitpkgs = pkgbuild_splitpkgs(pkgbuild);
+		array = pkgbuild_depends(splitpkgs[0]);
+		assert_string_equal(array[2], "foo-libs");
+		assert_string_equal(array[3], "bzip2");
+		assert_true(array[4] == NULL);
+		assert_string_equal(pkgbuild_desc(splitpkgs[1]), "A foo bar");
+		pkgbuild_release(pkgbuild);
+	}
+}
+
+void test_parse_pkgbuild_for_arch(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *view;
+	char **array;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"arch=('i686' 'x86_64' 'aarch64')\n"
+		"source=(\"foo-$pkgver.tar.gz\")\n"
+		"source_x86_64=(\"foo-$pkgver-x86_64.patch\")\n"
+		"depends=(glibc)\n"
+		"if [ \"$CARCH\" = \"x86_64\" ]; then\n"
+		"    depends+=(lib32-glibc)\n"
+		"elif [ \"$CARCH\" == aarch64 ]; then\n"
+		"    pkgdesc=\"A foo for ARM\"\n"
+		"else\n"
+		"    if [ $CARCH != i686 ]; then depends=(); fi\n"
+		"fi\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	/* Conditional assignments are left out of the pkgbuild itself */
+	assert_true(pkgbuild_desc(pkgbuild) == NULL);
+	assert_true(pkgbuild_depends(pkgbuild)[1] == NULL);
+
+	view = pkgbuild_for_arch(pkgbuild, "x86_64");
+	array = pkgbuild_sources(view);
+	assert_string_equal(array[0], "foo-1.tar.gz");
+	assert_string_equal(array[1], "foo-1-x86_64.patch");
+	assert_true(array[2] == NULL);
+	array = pkgbuild_depends(view);
+	assert_string_equal(array[0], "glibc");
+	assert_string_equal(array[1], "lib32-glibc");
+	assert_true(array[2] == NULL);
+	assert_true(pkgbuild_desc(view) == NULL);
+	pkgbuild_release(view);
+
+	view = pkgbuild_for_arch(pkgbuild, "aarch64");
+	assert_true(pkgbuild_sources(view)[1] == NULL);
+	assert_true(pkgbuild_depends(view)[1] == NULL);
+	assert_string_equal(pkgbuild_desc(view), "A foo for ARM");
+	assert_string_equal(pkgbuild_version(view), "1");
+	pkgbuild_release(view);
+
+	view = pkgbuild_for_arch(pkgbuild, "i686");
+	assert_string_equal(pkgbuild_depends(view)[0], "glibc");
+	pkgbuild_release(view);
+
+	view = pkgbuild_for_arch(pkgbuild, "armv7h");
+	assert_true(pkgbuild_depends(view)[0] == NULL);
+	pkgbuild_release(view);
+
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_case(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *view;
+	char **array;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"_flavor=full\n"
+		"_bits=0\n"
+		"arch=('i686' 'x86_64' 'armv7h')\n"
+		"depends=(glibc)\n"
+		"if [[ $_flavor == f* && -n $pkgver ]]; then\n"
+		"    depends+=(zlib)\n"
+		"elif [ \"$_flavor\" = minimal ]; then\n"
+		"    depends=()\n"
+		"fi\n"
+		"case $_flavor in\n"
+		"  minimal) pkgdesc=\"A small foo\" ;;\n"
+		"  *) pkgdesc=\"A foo\" ;;\n"
+		"esac\n"
+		"case \"$CARCH\" in\n"
+		"  i686|arm*)\n"
+		"    pkgdesc=\"A 32-bit foo\" ;;\n"
+		"  # 64-bit\n"
+		"  x86_64)\n"
+		"    _bits=64\n"
+		"    depends+=(lib32-glibc)\n"
+		"    ;;\n"
+		"esac\n"
+		"if [ $_bits != 0 ]; then\n"
+		"    optdepends=(bar)\n"
+		"fi\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	/* Branches which are never taken are left out */
+	assert_string_equal(pkgbuild_desc(pkgbuild), "A foo");
+	array = pkgbuild_depends(pkgbuild);
+	assert_string_equal(array[0], "glibc");
+	assert_string_equal(array[1], "zlib");
+	assert_true(array[2] == NULL);
+	/* _bits depends on the architecture, so the test is assumed to hold */
+	assert_string_equal(pkgbuild_optdepends(pkgbuild)[0], "bar");
+
+	view = pkgbuild_for_arch(pkgbuild, "x86_64");
+	array = pkgbuild_depends(view);
+	assert_string_equal(array[2], "lib32-glibc");
+	assert_string_equal(pkgbuild_desc(view), "A foo");
+	pkgbuild_release(view);
+
+	view = pkgbuild_for_arch(pkgbuild, "armv7h");
+	assert_true(pkgbuild_depends(view)[2] == NULL);
+	assert_string_equal(pkgbuild_desc(view), "A 32-bit foo");
+	pkgbuild_release(view);
+
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_commands(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"depends=(glibc)\n"
+		"build() {\n"
+		"  cd \"$srcdir/$pkgname-$pkgver\"\n"
+		"  local _jobs=$(nproc)\n"
+		"  if grep -q foo Makefile; then\n"
+		"    ./configure --prefix=/usr &&\n"
+		"      make -j$_jobs\n"
+		"  elif [ -f meson.build ]; then\n"
+		"    meson setup build # configure\n"
+		"  fi\n"
+		"  for _f in *.patch; do patch -p1 < \"$_f\"; done\n"
+		"}\n"
+		"package() {\n"
+		"  cd \"$srcdir\"; make DESTDIR=\"$pkgdir\" install\n"
+		"  (cd docs && install -Dm644 README \"$pkgdir/usr/share/doc/foo\")\n"
+		"  cat > \"$pkgdir/foo.conf\" <<-EOF\n"
+		"\t} ; ) fi\n"
+		"\tEOF\n"
+		"  [[ -d extra ]] && cp -r extra \"$pkgdir\" || true\n"
+		"}\n"
+		"depends+=(zlib)\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	/* Commands within functions are not evaluated */
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "zlib");
+	pkgbuild_release(pkgbuild);
+
+	/* A command at the top level may have any effect */
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgname=foo\n"
+		"pkgver=1\n"
+		"eval \"pkgver=2\"\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_version(pkgbuild), "1");
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_pkgbuild_source(void **directory)
+{
+	pkgbuild_includes_t *includes;
+	pkgbuild_parser_t *parser;
+	pkgbuild_parser_t *other;
+	pkgbuild_t *pkgbuild;
+	char absolute[160];
+	char *path;
+
+	write_pkgbuild_file(*directory, "common.sh",
+		"_base=foo\n"
+		"pkgver=2\n"
+		"url=\"https://example.org/$_base\"\n"
+		"makedepends=(git)\n");
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=foo-git\n"
+		"pkgver=1\n"
+		"source ./common.sh\n"
+		"depends=(\"${makedepends[@]}\" \"$_base\")\n");
+	parser = pkgbuild_parser_new();
+	pkgbuild = pkgbuild_parser_parse_file(parser, path);
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo-git");
+	/* The helper overrides variables assigned before it is sourced */
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	assert_string_equal(pkgbuild_url(pkgbuild), "https://example.org/foo");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[0], "git");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "foo");
+	pkgbuild_release(pkgbuild);
+
+	/* The helper is shared with the next PKGBUILD, and with parsers sharing
+	the includes */
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=bar\n"
+		". common.sh\n"
+		"pkgver=3\n");
+	pkgbuild = pkgbuild_parser_parse_file(parser, path);
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_version(pkgbuild), "3");
+	assert_string_equal(pkgbuild_makedepends(pkgbuild)[0], "git");
+	pkgbuild_release(pkgbuild);
+	includes = pkgbuild_includes_new();
+	other = pkgbuild_parser_new();
+	pkgbuild_parser_set_includes(parser, includes);
+	pkgbuild_parser_set_includes(other, includes);
+	pkgbuild_includes_release(includes);
+	pkgbuild = pkgbuild_parser_parse_file(other, path);
+	assert_string_equal(pkgbuild_makedepends(pkgbuild)[0], "git");
+	pkgbuild_release(pkgbuild);
+	pkgbuild_parser_release(other);
+
+	/* Nothing is followed when sourced files are ignored */
+	other = pkgbuild_parser_new_with_options(kPkgbuildOptionIgnoreSourced);
+	pkgbuild = pkgbuild_parser_parse_file(other, path);
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	assert_true(pkgbuild_makedepends(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+	pkgbuild_parser_release(other);
+
+	/* Only names relative to the directory of the PKGBUILD are followed */
+	snprintf(absolute, sizeof(absolute), "pkgname=bar\nsource %s/common.sh\n",
+		(char *)*directory);
+	path = write_pkgbuild_file(*directory, "PKGBUILD", absolute);
+	pkgbuild = pkgbuild_parser_parse_file(parser, path);
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	assert_true(pkgbuild_makedepends(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+
+	/* A helper depending on the PKGBUILD cannot be evaluated on its own */
+	write_pkgbuild_file(*directory, "common.sh",
+		"url=\"https://example.org/$pkgname\"\n");
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=baz\n"
+		"source common.sh\n");
+	pkgbuild = pkgbuild_parser_parse_file(parser, path);
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "baz");
+	pkgbuild_release(pkgbuild);
+	pkgbuild_parser_release(parser);
+}
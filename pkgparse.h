@@ -74,6 +74,530 @@ Returns:
 */
 pkgbuild_t *pkgbuild_parse(FILE *fp);
 
+/* Enumeration: pkgbuild_option_t
+Flags altering the behaviour of <pkgbuild_parse_with_options()>.
+
+kPkgbuildOptionNone - Expand every value while parsing.
+kPkgbuildOptionLazy - Store values unexpanded, together with a snapshot of
+	the variables in scope, and expand only those retrieved through the
+	pkgbuild_* accessors. This is faster when only a few fields are needed.
+kPkgbuildOptionSkipFunctions - Skip the bodies of functions other than
+	package() and package_*(), such as build(), without parsing them. They
+	cannot define metadata.
+kPkgbuildOptionIgnoreSrcinfo - Parse the PKGBUILD even if a .SRCINFO is
+	available, see <pkgbuild_parse_file()>.
+kPkgbuildOptionTrackDependencies - Keep the assignments at the top level
+	unexpanded, so that the fields depending on a variable can be derived
+	again when it is changed, see <pkgbuild_set_variable()>.
+kPkgbuildOptionIgnoreSourced - Read no files sourced by the PKGBUILD, even
+	if the directory of the parser is set, see
+	<pkgbuild_parser_set_directory()>. This is meant for PKGBUILDs which are
+	not trusted.
+*/
+typedef enum {
+	kPkgbuildOptionNone = 0,
+	kPkgbuildOptionLazy = 1 << 0,
+	kPkgbuildOptionSkipFunctions = 1 << 1,
+	kPkgbuildOptionIgnoreSrcinfo = 1 << 2,
+	kPkgbuildOptionTrackDependencies = 1 << 3,
+	kPkgbuildOptionIgnoreSourced = 1 << 4,
+} pkgbuild_option_t;
+
+/* Enumeration: pkgbuild_field_t
+Flags identifying the fields of a <pkgbuild_t>, one for each accessor. They
+are combined to specify which fields are to be extracted.
+
+See Also:
+	<pkgbuild_parse_fields()>
+*/
+typedef enum {
+	kPkgbuildFieldNames = 1 << 0,
+	kPkgbuildFieldBasename = 1 << 1,
+	kPkgbuildFieldVersion = 1 << 2,
+	kPkgbuildFieldRel = 1 << 3,
+	kPkgbuildFieldDesc = 1 << 4,
+	kPkgbuildFieldUrl = 1 << 5,
+	kPkgbuildFieldLicenses = 1 << 6,
+	kPkgbuildFieldInstall = 1 << 7,
+	kPkgbuildFieldSources = 1 << 8,
+	kPkgbuildFieldNoextract = 1 << 9,
+	kPkgbuildFieldMd5sums = 1 << 10,
+	kPkgbuildFieldSha1sums = 1 << 11,
+	kPkgbuildFieldSha256sums = 1 << 12,
+	kPkgbuildFieldSha384sums = 1 << 13,
+	kPkgbuildFieldSha512sums = 1 << 14,
+	kPkgbuildFieldGroups = 1 << 15,
+	kPkgbuildFieldArchitectures = 1 << 16,
+	kPkgbuildFieldBackup = 1 << 17,
+	kPkgbuildFieldDepends = 1 << 18,
+	kPkgbuildFieldMakedepends = 1 << 19,
+	kPkgbuildFieldOptdepends = 1 << 20,
+	kPkgbuildFieldConflicts = 1 << 21,
+	kPkgbuildFieldProvides = 1 << 22,
+	kPkgbuildFieldReplaces = 1 << 23,
+	kPkgbuildFieldOptions = 1 << 24,
+	kPkgbuildFieldSplitpkgs = 1 << 25,
+	kPkgbuildFieldEpoch = 1 << 26,
+	kPkgbuildFieldCheckdepends = 1 << 27,
+	kPkgbuildFieldAll = (1 << 28) - 1,
+} pkgbuild_field_t;
+
+/* Function: pkgbuild_parse_with_options
+Initialize and return a pkgbuild_t structure by parsing a PKGBUILD file, as
+with <pkgbuild_parse()>.
+
+Parameters:
+	fp - A file pointer to the PKGBUILD. The file must be opened in read
+       mode, and closed, by the caller.
+	options - A combination of <pkgbuild_option_t> flags.
+
+Returns:
+	An initialized pkgbuild_t structure containing metadata found in the
+       PKGBUILD. This object must be deallocated using <pkgbuild_release()>.
+*/
+pkgbuild_t *pkgbuild_parse_with_options(FILE *fp, int options);
+
+/* Function: pkgbuild_parse_fields
+Initialize and return a pkgbuild_t structure holding only the specified
+fields. Values are expanded lazily, bodies of functions are skipped unless
+split packages are requested, and parsing stops as soon as every requested
+variable has been assigned and cannot be reassigned later in the file.
+
+Example:
+	(start code)
+	pkgbuild = pkgbuild_parse_fields(fp,
+		kPkgbuildFieldNames | kPkgbuildFieldVersion);
+	(end)
+
+Parameters:
+	fp - A file pointer to the PKGBUILD. The file must be opened in read
+       mode, and closed, by the caller.
+	fields - A combination of <pkgbuild_field_t> flags. Accessors of other
+		fields return NULL.
+
+Returns:
+	An initialized pkgbuild_t structure containing the requested metadata
+       found in the PKGBUILD. This object must be deallocated using
+       <pkgbuild_release()>.
+*/
+pkgbuild_t *pkgbuild_parse_fields(FILE *fp, unsigned int fields);
+
+/* Function: pkgbuild_parse_srcinfo
+Initialize and return a pkgbuild_t structure from a .SRCINFO, the flat
+"key = value" summary of a PKGBUILD generated by makepkg --printsrcinfo.
+No shell semantics are involved, which makes this much faster than parsing
+the PKGBUILD.
+
+The keys of the pkgbase section set the fields of the pkgbuild, and each
+pkgname section adds a name. The keys of a pkgname section override those of
+the pkgbase section for that package. If there are several, each is a split
+package, see <pkgbuild_splitpkgs()>. Architecture specific keys of the
+pkgbase section, such as source_x86_64, are used by <pkgbuild_for_arch()>.
+Keys which do not correspond to a field, such as validpgpkeys, are ignored.
+
+Parameters:
+	fp - A file pointer to the .SRCINFO. The file must be opened in read
+       mode, and closed, by the caller.
+
+Returns:
+	An initialized pkgbuild_t structure containing metadata found in the
+       .SRCINFO, which must be deallocated using <pkgbuild_release()>, or
+       NULL if it has no pkgname section.
+*/
+pkgbuild_t *pkgbuild_parse_srcinfo(FILE *fp);
+
+/* Function: pkgbuild_format_srcinfo
+Format the metadata of a pkgbuild as a .SRCINFO, in the layout of makepkg
+--printsrcinfo. The fields of split packages, including their architecture
+specific variables, are written to their pkgname sections. Values makepkg
+writes which pkgparse does not extract, such as validpgpkeys, are omitted.
+
+As with snprintf(), the output is truncated to fit the buffer, and the
+length of the whole output is returned, so that the required size can be
+determined by passing a size of 0.
+
+Parameters:
+	pkgbuild - The pkgbuild to be formatted.
+	buffer - The buffer to write to, which is always NUL terminated unless
+		size is 0.
+	size - The size of the buffer.
+
+Returns:
+	The length of the .SRCINFO, excluding the terminating NUL.
+*/
+size_t pkgbuild_format_srcinfo(pkgbuild_t *pkgbuild, char *buffer,
+	size_t size);
+
+/* Function: pkgbuild_write_srcinfo
+Write the metadata of a pkgbuild to a file as a .SRCINFO, as with
+<pkgbuild_format_srcinfo()>.
+
+Parameters:
+	pkgbuild - The pkgbuild to be written.
+	fp - A file pointer opened in write mode.
+
+Returns:
+	True (1) on success or false (0) on error.
+*/
+int pkgbuild_write_srcinfo(pkgbuild_t *pkgbuild, FILE *fp);
+
+/* Type: pkgbuild_parser_t
+An opaque data type holding the state of an incremental parse, for PKGBUILDs
+which are not available as a file, or arrive in chunks, such as from a
+socket.
+
+Example:
+	(start code)
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+	char chunk[BUFSIZ];
+	ssize_t len;
+
+	parser = pkgbuild_parser_new();
+	while((len = read(fd, chunk, sizeof(chunk))) > 0) {
+	    if(!pkgbuild_parser_feed(parser, chunk, len)) {
+	        fprintf(stderr, "Unable to parse PKGBUILD\n");
+	        break;
+	    }
+	}
+	pkgbuild = pkgbuild_parser_finish(parser);
+	pkgbuild_parser_release(parser);
+	(end)
+*/
+typedef struct _pkgbuild_parser_t pkgbuild_parser_t;
+
+/* Function: pkgbuild_parser_new
+Create a parser which expands every value while parsing.
+
+Returns:
+	A new parser, which must be deallocated using
+       <pkgbuild_parser_release()>.
+*/
+pkgbuild_parser_t *pkgbuild_parser_new();
+
+/* Function: pkgbuild_parser_new_with_options
+Create a parser, as with <pkgbuild_parser_new()>.
+
+Parameters:
+	options - A combination of <pkgbuild_option_t> flags.
+
+Returns:
+	A new parser, which must be deallocated using
+       <pkgbuild_parser_release()>.
+*/
+pkgbuild_parser_t *pkgbuild_parser_new_with_options(int options);
+
+/* Function: pkgbuild_parser_feed
+Parse the next chunk of a PKGBUILD. Chunks may be split at any byte. Complete
+lines are parsed immediately, while the remainder is kept until the next
+chunk arrives, so the call never blocks.
+
+Parameters:
+	parser - The parser to be fed.
+	chunk - The data to be parsed. It is copied, and need not remain valid
+		after the call.
+	len - The length of chunk.
+
+Returns:
+	True (1) on success, or false (0) if the PKGBUILD is malformed.
+*/
+int pkgbuild_parser_feed(pkgbuild_parser_t *parser, const char *chunk,
+	size_t len);
+
+/* Function: pkgbuild_parser_finish
+Parse the remainder of the PKGBUILD, and retrieve the result. The parser is
+then ready to parse another PKGBUILD.
+
+As with <pkgbuild_parse()>, metadata found before a syntax error is
+retained.
+
+Parameters:
+	parser - The parser to be finished.
+
+Returns:
+	An initialized pkgbuild_t structure containing metadata found in the
+       PKGBUILD. This object must be deallocated using <pkgbuild_release()>.
+*/
+pkgbuild_t *pkgbuild_parser_finish(pkgbuild_parser_t *parser);
+
+/* Function: pkgbuild_parser_set_directory
+Set the directory relative names of files sourced by PKGBUILDs, such as
+"source ../common.sh", are resolved against. It applies to the PKGBUILDs
+parsed until it is changed.
+
+Helper scripts sourced this way are evaluated once, and their variables are
+shared by every PKGBUILD the parser parses which sources them, until the
+file changes, see <pkgbuild_includes_t>. A helper script whose values depend
+on variables of the PKGBUILD, or on the architecture, is not evaluated, and
+neither are files sourced by absolute names, or within functions or
+conditionals. Such PKGBUILDs are reported by <pkgbuild_unsupported()>.
+
+Parameters:
+	parser - The parser to be modified.
+	directory - The directory of the PKGBUILD, or NULL to follow no sourced
+		files. It is ignored with kPkgbuildOptionIgnoreSourced.
+*/
+void pkgbuild_parser_set_directory(pkgbuild_parser_t *parser,
+	const char *directory);
+
+/* Type: pkgbuild_includes_t
+An opaque data type holding the helper scripts sourced by PKGBUILDs, together
+with their variables. Each parser has includes of its own, which may be
+replaced with includes shared by several parsers, so that a script sourced
+by a batch of PKGBUILDs is only evaluated once for all of them. Parsers of
+different threads may share includes.
+
+Example:
+	(start code)
+	pkgbuild_includes_t *includes = pkgbuild_includes_new();
+
+	pkgbuild_parser_set_includes(first, includes);
+	pkgbuild_parser_set_includes(second, includes);
+	pkgbuild_includes_release(includes);
+	(end)
+*/
+typedef struct _pkgbuild_includes_t pkgbuild_includes_t;
+
+/* Function: pkgbuild_includes_new
+Create includes without any helper script.
+
+Returns:
+	New includes, which must be deallocated using
+	<pkgbuild_includes_release()>.
+*/
+pkgbuild_includes_t *pkgbuild_includes_new();
+
+/* Function: pkgbuild_includes_retain
+Increment the reference count of includes.
+
+Parameters:
+	includes - A reference to the includes to be retained.
+
+Returns:
+	A reference to the includes.
+
+See Also:
+	<pkgbuild_includes_release()>
+*/
+pkgbuild_includes_t *pkgbuild_includes_retain(pkgbuild_includes_t *includes);
+
+/* Function: pkgbuild_includes_release
+Decrement the reference count of includes. The includes are deallocated,
+together with the variables of their helper scripts, when it reaches 0.
+
+Parameters:
+	includes - A reference to the includes to be released.
+
+See Also:
+	<pkgbuild_includes_retain()>
+*/
+void pkgbuild_includes_release(pkgbuild_includes_t *includes);
+
+/* Function: pkgbuild_parser_set_includes
+Replace the includes helper scripts sourced by the PKGBUILDs of a parser are
+looked up in and added to.
+
+Parameters:
+	parser - The parser to be modified.
+	includes - The includes, which are retained, or NULL to start over with
+		includes of the parser's own.
+*/
+void pkgbuild_parser_set_includes(pkgbuild_parser_t *parser,
+	pkgbuild_includes_t *includes);
+
+/* Function: pkgbuild_parser_parse_file
+Parse a PKGBUILD file with a parser, which is then ready to parse another
+one. Names of files it sources are relative to its directory, see
+<pkgbuild_parser_set_directory()>. Parsing a batch of PKGBUILDs with the same
+parser evaluates each helper script they share only once.
+
+Parameters:
+	parser - The parser to parse with. It must not hold input fed with
+		<pkgbuild_parser_feed()>.
+	path - The path to the PKGBUILD.
+
+Returns:
+	An initialized pkgbuild_t structure containing metadata found in the
+	PKGBUILD, which must be deallocated using <pkgbuild_release()>, or NULL
+	if the file cannot be read.
+*/
+pkgbuild_t *pkgbuild_parser_parse_file(pkgbuild_parser_t *parser,
+	const char *path);
+
+/* Function: pkgbuild_parser_retain
+Increment the parser's reference count.
+
+Parameters:
+	parser - A reference to the parser to be retained.
+
+Returns:
+	A reference to the parser.
+
+See Also:
+	<pkgbuild_parser_release()>
+*/
+pkgbuild_parser_t *pkgbuild_parser_retain(pkgbuild_parser_t *parser);
+
+/* Function: pkgbuild_parser_release
+Decrement the parser's reference count. The parser is deallocated, together
+with any input not yet parsed, when its reference count reaches 0.
+
+Parameters:
+	parser - A reference to the parser to be released.
+
+See Also:
+	<pkgbuild_parser_retain()>
+*/
+void pkgbuild_parser_release(pkgbuild_parser_t *parser);
+
+/* Function: pkgbuild_unsupported
+Determine whether a PKGBUILD relies on constructs the parser does not
+evaluate, such as command substitutions, commands outside of functions, tests
+it cannot decide, or syntax it does not understand. Commands within functions,
+such as those of build() and package(), are not evaluated. Metadata of such a
+PKGBUILD may be missing or incorrect, and can be retrieved by bash instead, see
+<pkgbuild_pool_t>.
+
+Parameters:
+	pkgbuild - The pkgbuild to query.
+
+Returns:
+	True (1) if the PKGBUILD relies on unsupported constructs, otherwise
+	false (0).
+*/
+int pkgbuild_unsupported(pkgbuild_t *pkgbuild);
+
+/* Type: pkgbuild_pool_t
+An opaque data type managing a pool of bash processes, which source
+PKGBUILDs the parser cannot handle, see <pkgbuild_unsupported()>. Workers are
+started when first needed, and serve one PKGBUILD after another, each within
+a subshell of its own, so that no state leaks between PKGBUILDs. The pool may
+be used from several threads at once.
+
+PKGBUILDs are sourced, which runs any command they contain. They must be
+trusted.
+
+Example:
+	(start code)
+	pkgbuild_pool_t *pool;
+	pkgbuild_t *pkgbuild;
+
+	pool = pkgbuild_pool_new(4, 5000);
+	pkgbuild = pkgbuild_parse_file("PKGBUILD", kPkgbuildOptionNone, pool);
+	pkgbuild_pool_release(pool);
+	(end)
+*/
+typedef struct _pkgbuild_pool_t pkgbuild_pool_t;
+
+/* Function: pkgbuild_pool_new
+Create a pool of bash workers.
+
+Parameters:
+	workers - The maximum amount of PKGBUILDs sourced at once.
+	timeout - The amount of milliseconds a PKGBUILD may take, or 0 to wait
+		indefinitely. A worker which exceeds it is killed, together with
+		any process it started.
+
+Returns:
+	A new pool, which must be deallocated using <pkgbuild_pool_release()>,
+	or NULL on error.
+*/
+pkgbuild_pool_t *pkgbuild_pool_new(size_t workers, unsigned int timeout);
+
+/* Function: pkgbuild_pool_evaluate
+Source a PKGBUILD with bash, and extract its metadata from the resulting
+variables. The PKGBUILD is sourced from its directory, with a minimal
+environment in which $CARCH is not set, so conditionals on the architecture
+are not recorded for <pkgbuild_for_arch()>. Blocks until a worker is
+available.
+
+Parameters:
+	pool - The pool to evaluate the PKGBUILD with.
+	path - The path to the PKGBUILD.
+
+Returns:
+	An initialized pkgbuild_t structure, which must be deallocated using
+	<pkgbuild_release()>, or NULL if the PKGBUILD could not be sourced in
+	time.
+*/
+pkgbuild_t *pkgbuild_pool_evaluate(pkgbuild_pool_t *pool, const char *path);
+
+/* Function: pkgbuild_pool_retain
+Increment the pool's reference count.
+
+Parameters:
+	pool - A reference to the pool to be retained.
+
+Returns:
+	A reference to the pool.
+
+See Also:
+	<pkgbuild_pool_release()>
+*/
+pkgbuild_pool_t *pkgbuild_pool_retain(pkgbuild_pool_t *pool);
+
+/* Function: pkgbuild_pool_release
+Decrement the pool's reference count. The workers are stopped when it
+reaches 0. No PKGBUILD may be being evaluated at that point.
+
+Parameters:
+	pool - A reference to the pool to be released.
+
+See Also:
+	<pkgbuild_pool_retain()>
+*/
+void pkgbuild_pool_release(pkgbuild_pool_t *pool);
+
+/* Function: pkgbuild_parse_file
+Parse a PKGBUILD file, as with <pkgbuild_parser_parse_file()>, falling back
+to bash if the PKGBUILD relies on constructs the parser does not evaluate.
+
+If a .SRCINFO which is at least as recent as the PKGBUILD is found in the same
+directory, it is parsed with <pkgbuild_parse_srcinfo()> instead, unless
+kPkgbuildOptionIgnoreSrcinfo is given.
+
+Parameters:
+	path - The path to the PKGBUILD.
+	options - A combination of <pkgbuild_option_t> flags.
+	pool - The pool to evaluate unsupported PKGBUILDs with, or NULL to keep
+		the result of the parser.
+
+Returns:
+	An initialized pkgbuild_t structure containing metadata found in the
+	PKGBUILD, which must be deallocated using <pkgbuild_release()>, or NULL
+	if the file cannot be read. The result of the parser is kept if bash
+	fails.
+*/
+pkgbuild_t *pkgbuild_parse_file(const char *path, int options,
+	pkgbuild_pool_t *pool);
+
+/* Function: pkgbuild_parse_files
+Parse a batch of PKGBUILD files in parallel, as with <pkgbuild_parse_file()>,
+such as every PKGBUILD of a tree. Files are read in batches while earlier
+ones are parsed. On Linux, when pkgparse is built with PKGPARSE_IO_URING,
+they are read with io_uring, which opens, reads and closes the files of a
+batch with a system call each. Each thread parses its PKGBUILDs with a parser
+of its own, and files sourced by several PKGBUILDs are evaluated once for the
+batch, see <pkgbuild_includes_t>.
+
+Parameters:
+	paths - The paths to the PKGBUILDs.
+	count - The amount of paths.
+	options - A combination of <pkgbuild_option_t> flags.
+	pool - The pool to evaluate unsupported PKGBUILDs with, or NULL to keep
+		the result of the parser.
+	threads - The maximum amount of PKGBUILDs parsed at once, or 0 for one
+		per processor.
+	results - An array of count pkgbuilds, set to the pkgbuild of each
+		path, which must be deallocated using <pkgbuild_release()>, or NULL
+		if the file cannot be read.
+
+Returns:
+	The amount of PKGBUILDs which could not be read, or -1 on error.
+*/
+int pkgbuild_parse_files(const char **paths, size_t count, int options,
+	pkgbuild_pool_t *pool, size_t threads, pkgbuild_t **results);
+
 /* Function: pkgbuild_release
 Decrement the pkgbuild's reference count.
 
@@ -165,6 +689,18 @@ Returns:
 */
 float pkgbuild_rel(pkgbuild_t *pkgbuild);
 
+/* Function: pkgbuild_epoch
+Retrieve the epoch of a package, which takes precedence over its version
+when versions are compared.
+
+Parameters:
+	pkgbuild - The pkgbuild to query.
+
+Returns:
+	A string representing the epoch, or NULL if it is not set.
+*/
+char *pkgbuild_epoch(pkgbuild_t *pkgbuild);
+
 /* Function: pkgbuild_desc
 Retrieve the description of a package.
 
@@ -350,6 +886,20 @@ See Also:
 */
 char **pkgbuild_makedepends(pkgbuild_t *pkgbuild);
 
+/* Function: pkgbuild_checkdepends
+Retrieve the dependencies of a package needed to run its test suite.
+
+Parameters:
+	pkgbuild - The pkgbuild to query.
+
+Returns:
+	An array of strings, each representing a dependency, or NULL on error.
+
+See Also:
+	<pkgbuild_depends()>
+*/
+char **pkgbuild_checkdepends(pkgbuild_t *pkgbuild);
+
 /* Function: pkgbuild_optdepends
 Retrieve the optional dependencies of a package.
 
@@ -429,4 +979,705 @@ Returns:
 */
 pkgbuild_t **pkgbuild_splitpkgs(pkgbuild_t *pkgbuild);
 
+/* Function: pkgbuild_for_arch
+Create a view of a package as built for an architecture.
+
+Conditionals testing $CARCH, such as [ "$CARCH" = "x86_64" ] or
+case $CARCH in, are recorded while parsing rather than evaluated, and the
+variables they assign are left out of the pkgbuild itself. A view takes the
+branches which apply to the architecture into account, with assignments of
+the branches overriding unconditional ones. Architecture specific variables
+of the architecture, such as source_x86_64 or depends_aarch64, are appended
+to the corresponding fields, as is the case with makepkg.
+
+Fields of the view are resolved when first accessed, so that any amount of
+views can be created from a single parse. Split packages are not part of the
+view.
+
+Parameters:
+	pkgbuild - The pkgbuild to create a view of. It is retained by the view.
+	arch - The architecture, such as "x86_64".
+
+Returns:
+	A pkgbuild_t structure, which must be deallocated using
+	<pkgbuild_release()>, or NULL on error.
+*/
+pkgbuild_t *pkgbuild_for_arch(pkgbuild_t *pkgbuild, const char *arch);
+
+/* Enumeration: pkgbuild_checksum_status_t
+The result of verifying a source, see <pkgbuild_verify_sources()>.
+
+kPkgbuildChecksumPassed - Every checksum of the source matches.
+kPkgbuildChecksumSkipped - Every checksum of the source is SKIP, or there is
+	none.
+kPkgbuildChecksumFailed - A checksum does not match, or a checksum array has
+	no entry for the source.
+kPkgbuildChecksumMissing - The file of the source cannot be read.
+*/
+typedef enum {
+	kPkgbuildChecksumPassed,
+	kPkgbuildChecksumSkipped,
+	kPkgbuildChecksumFailed,
+	kPkgbuildChecksumMissing,
+} pkgbuild_checksum_status_t;
+
+/* Type: pkgbuild_checksum_t
+The result of verifying a source.
+
+status - The outcome of the verification.
+failed - The checksum arrays whose entry for the source failed, as a
+	combination of <pkgbuild_field_t> flags such as kPkgbuildFieldSha256sums.
+*/
+typedef struct {
+	pkgbuild_checksum_status_t status;
+	unsigned int failed;
+} pkgbuild_checksum_t;
+
+/* Function: pkgbuild_verify_sources
+Verify downloaded sources against the checksum arrays of a pkgbuild, such as
+<pkgbuild_sha256sums()>. Each source is paired with the entries of the
+checksum arrays at the same index, and its file is named as makepkg names it:
+"name" for a source renamed with "name::url", and the last component of the
+URL otherwise. Checksums which are SKIP are not verified.
+
+Files are hashed in parallel, each with every algorithm it has a checksum for
+in a single pass. Sources specific to an architecture are verified with a view
+created by <pkgbuild_for_arch()>.
+
+Example:
+	(start code)
+	pkgbuild_checksum_t *results;
+	size_t count;
+
+	for(count = 0; pkgbuild_sources(pkgbuild)[count] != NULL; count++);
+	results = malloc(count * sizeof(*results));
+	if(pkgbuild_verify_sources(pkgbuild, "src", 0, results) > 0) {
+	    fprintf(stderr, "Integrity check failed\n");
+	}
+	free(results);
+	(end)
+
+Parameters:
+	pkgbuild - The pkgbuild whose sources are verified.
+	directory - The directory the sources have been downloaded to.
+	threads - The maximum amount of files hashed at once, or 0 for one per
+		processor.
+	results - An array receiving the result of each source, with an element
+		for each element of <pkgbuild_sources()>.
+
+Returns:
+	The amount of sources which failed or are missing, or -1 on error.
+*/
+int pkgbuild_verify_sources(pkgbuild_t *pkgbuild, const char *directory,
+	size_t threads, pkgbuild_checksum_t *results);
+
+/* Function: pkgbuild_dependencies
+Retrieve the variables the value of a field is derived from, directly or
+through other variables. For example, a source of "$_name-$pkgver.tar.gz"
+depends on pkgver and _name, and on pkgname if _name is "${pkgname}".
+
+Dependencies are only known for pkgbuilds parsed with
+kPkgbuildOptionTrackDependencies, see <pkgbuild_set_variable()>.
+
+Parameters:
+	pkgbuild - The pkgbuild.
+	field - The field, such as kPkgbuildFieldSources.
+
+Returns:
+	A NULL-terminated array of the names of the variables, or NULL if the
+	dependencies are not known. The array and its strings must be
+	deallocated by the caller.
+*/
+char **pkgbuild_dependencies(pkgbuild_t *pkgbuild, pkgbuild_field_t field);
+
+/* Function: pkgbuild_dependents
+Retrieve the fields derived from a variable, directly or through other
+variables, including the field of the variable itself.
+
+Parameters:
+	pkgbuild - The pkgbuild.
+	name - The name of the variable, such as "pkgver".
+
+Returns:
+	A combination of <pkgbuild_field_t> flags, which is 0 if the dependencies
+	are not known.
+*/
+unsigned int pkgbuild_dependents(pkgbuild_t *pkgbuild, const char *name);
+
+/* Function: pkgbuild_set_variable
+Change the value of a variable of a pkgbuild, and derive the fields depending
+on it again, without parsing the PKGBUILD. The value replaces that of the
+last assignment of the variable which does not append to it, and is expanded
+as the assignment would be. Other fields are left as they are.
+
+Only pkgbuilds parsed with kPkgbuildOptionTrackDependencies can be changed,
+and only if every value is derived from assignments at the top level. Values
+assigned within conditionals, or by sourced files, as well as those of split
+packages which reference variables, are only known to a parse.
+
+Like any other variable, pkgname is changed with the function matching its
+assignment: "pkgname=foo" with <pkgbuild_set_variable()>, and "pkgname=(foo
+bar)" with <pkgbuild_set_variable_array()>. The names of split packages with
+package_* functions cannot be changed, as the functions are located by them.
+
+Example:
+	(start code)
+	pkgbuild = pkgbuild_parse_with_options(fp,
+	    kPkgbuildOptionTrackDependencies);
+	if(pkgbuild_set_variable(pkgbuild, "pkgver", "1.2")) {
+	    // The sources referencing $pkgver are updated
+	    printf("%s\n", pkgbuild_sources(pkgbuild)[0]);
+	}
+	(end)
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	name - The name of a string variable.
+	value - The new value, as it would be written in the PKGBUILD.
+
+Returns:
+	True (1) on success, or false (0) if the variable is not assigned a
+	string, or the pkgbuild cannot be derived again.
+*/
+int pkgbuild_set_variable(pkgbuild_t *pkgbuild, const char *name,
+	const char *value);
+
+/* Function: pkgbuild_set_variable_array
+Change the value of an array variable of a pkgbuild, as with
+<pkgbuild_set_variable()>.
+
+Parameters:
+	pkgbuild - The pkgbuild to be modified.
+	name - The name of an array variable.
+	values - The new elements, as they would be written in the PKGBUILD,
+		terminated by NULL.
+
+Returns:
+	True (1) on success, or false (0) if the variable is not assigned an
+	array, or the pkgbuild cannot be derived again.
+*/
+int pkgbuild_set_variable_array(pkgbuild_t *pkgbuild, const char *name,
+	const char **values);
+
+/* Function: pkgbuild_reparse
+Parse a PKGBUILD again after its buffer has been edited, such as by an editor
+on each keystroke. Parsing resumes at the last top-level statement preceding
+the edit, with the variables assigned before it, so only the remainder of the
+buffer is scanned. An edit within the body of a function other than package()
+is not parsed at all with kPkgbuildOptionSkipFunctions.
+
+Only pkgbuilds parsed with kPkgbuildOptionTrackDependencies, whose variables
+are not assigned within conditionals or by sourced files, are parsed
+incrementally, otherwise the whole buffer is parsed with the same options.
+Pkgbuilds parsed without it are parsed with kPkgbuildOptionTrackDependencies
+and kPkgbuildOptionSkipFunctions, so that further edits are incremental.
+Sourced files are not read.
+
+Example:
+	(start code)
+	// "pkgver=1.0" at offset 0 became "pkgver=1.0.1", inserting ".1" at
+	// offset 10
+	updated = pkgbuild_reparse(pkgbuild, buffer, length, 10, 0, 2);
+	pkgbuild_release(pkgbuild);
+	pkgbuild = updated;
+	(end)
+
+Parameters:
+	pkgbuild - The pkgbuild parsed from the buffer before it was edited.
+	buffer - The edited buffer.
+	length - The length of the edited buffer.
+	offset - The offset of the edit.
+	removed - The amount of characters removed at the offset.
+	inserted - The amount of characters inserted at the offset.
+
+Returns:
+	A new pkgbuild, to be released with <pkgbuild_release()>, or NULL if an
+	argument is NULL. The pkgbuild given is left unchanged.
+*/
+pkgbuild_t *pkgbuild_reparse(pkgbuild_t *pkgbuild, const char *buffer,
+	size_t length, size_t offset, size_t removed, size_t inserted);
+
+/* Type: pkgbuild_edit_t
+An opaque data type holding a PKGBUILD being edited in place, such as to bump
+its version. Only the values of edited assignments are rewritten, so the
+formatting and comments of the PKGBUILD are preserved.
+
+Example:
+	(start code)
+	pkgbuild_edit_t *edit;
+	const char *sums[] = {"SKIP", NULL};
+
+	edit = pkgbuild_edit_new("PKGBUILD");
+	if(edit != NULL && pkgbuild_edit_set(edit, "pkgver", "1.2")
+	        && pkgbuild_edit_set(edit, "pkgrel", "1")
+	        && pkgbuild_edit_set_array(edit, "sha256sums", sums)) {
+	    printf("%s\n", pkgbuild_sources(pkgbuild_edit_pkgbuild(edit))[0]);
+	    pkgbuild_edit_write(edit);
+	}
+	pkgbuild_edit_release(edit);
+	(end)
+*/
+typedef struct _pkgbuild_edit_t pkgbuild_edit_t;
+
+/* Function: pkgbuild_edit_new
+Read and parse a PKGBUILD to be edited.
+
+Parameters:
+	path - The path to the PKGBUILD.
+
+Returns:
+	A new edit, which must be deallocated using <pkgbuild_edit_release()>,
+	or NULL if the PKGBUILD cannot be read or is malformed.
+*/
+pkgbuild_edit_t *pkgbuild_edit_new(const char *path);
+
+/* Function: pkgbuild_edit_retain
+Increment the reference count of an edit.
+
+Parameters:
+	edit - The edit to be retained.
+
+Returns:
+	The edit.
+*/
+pkgbuild_edit_t *pkgbuild_edit_retain(pkgbuild_edit_t *edit);
+
+/* Function: pkgbuild_edit_release
+Decrement the reference count of an edit, deallocating it once it drops to
+zero. Edits which have not been written are discarded.
+
+Parameters:
+	edit - The edit to be released, or NULL.
+*/
+void pkgbuild_edit_release(pkgbuild_edit_t *edit);
+
+/* Function: pkgbuild_edit_set
+Replace the value of a string variable, such as pkgver. The last assignment
+of the variable outside of functions and conditionals is rewritten, keeping
+the quotes of the original value. The value is taken literally, and is quoted
+as needed.
+
+Parameters:
+	edit - The edit to be modified.
+	name - The name of the variable.
+	value - The new value.
+
+Returns:
+	True (1) on success, or false (0) if there is no such assignment, or the
+	variable is assigned an array.
+*/
+int pkgbuild_edit_set(pkgbuild_edit_t *edit, const char *name,
+	const char *value);
+
+/* Function: pkgbuild_edit_set_array
+Replace the value of an array variable, such as sha256sums, as with
+<pkgbuild_edit_set()>. If the amount of elements is unchanged, each element
+is rewritten in place, so that any comments and line breaks between elements
+are preserved. Otherwise the elements are separated as the first two of the
+original value were.
+
+Parameters:
+	edit - The edit to be modified.
+	name - The name of the variable.
+	values - The new elements, terminated by NULL.
+
+Returns:
+	True (1) on success, or false (0) if there is no such assignment, or the
+	variable is assigned a string.
+*/
+int pkgbuild_edit_set_array(pkgbuild_edit_t *edit, const char *name,
+	const char **values);
+
+/* Function: pkgbuild_edit_pkgbuild
+Retrieve the metadata of an edited PKGBUILD. Fields depending on edited
+variables, such as a source URL referencing $pkgver, are derived again
+without parsing the PKGBUILD, as with <pkgbuild_set_variable()>. PKGBUILDs
+which cannot be derived again that way are parsed again instead.
+
+Parameters:
+	edit - The edit.
+
+Returns:
+	The pkgbuild, which is owned by the edit and remains valid until the edit
+	is modified or released.
+*/
+pkgbuild_t *pkgbuild_edit_pkgbuild(pkgbuild_edit_t *edit);
+
+/* Function: pkgbuild_edit_text
+Retrieve the edited text of a PKGBUILD.
+
+Parameters:
+	edit - The edit.
+	length - Set to the length of the text, unless it is NULL.
+
+Returns:
+	The NUL terminated text, which is owned by the edit and remains valid
+	until the edit is modified or released.
+*/
+const char *pkgbuild_edit_text(pkgbuild_edit_t *edit, size_t *length);
+
+/* Function: pkgbuild_edit_write
+Write an edited PKGBUILD back to its file with a single write, replacing the
+file atomically. Nothing is written if the PKGBUILD has not been modified.
+
+Parameters:
+	edit - The edit to be written.
+
+Returns:
+	True (1) on success, otherwise false (0).
+*/
+int pkgbuild_edit_write(pkgbuild_edit_t *edit);
+
+/* Type: pkgbuild_edit_callback_t
+A function applying edits to a PKGBUILD of a batch, see
+<pkgbuild_edit_batch()>. It returns true (1) for the PKGBUILD to be written,
+or false (0) on failure. It may be called from several threads at once.
+*/
+typedef int (*pkgbuild_edit_callback_t)(pkgbuild_edit_t *edit, size_t index,
+	void *data);
+
+/* Function: pkgbuild_edit_batch
+Edit a batch of PKGBUILDs in parallel, such as to bump the version of many
+packages at once. Each PKGBUILD is read, passed to a callback which edits it,
+and written back.
+
+Parameters:
+	paths - The paths to the PKGBUILDs.
+	count - The amount of paths.
+	threads - The maximum amount of PKGBUILDs edited at once, or 0 for one
+		per processor.
+	callback - The function applying the edits, which is passed the index
+		of the path of each PKGBUILD.
+	data - Data passed to callback.
+
+Returns:
+	The amount of PKGBUILDs which could not be read, edited or written, or
+	-1 on error.
+*/
+int pkgbuild_edit_batch(const char **paths, size_t count, size_t threads,
+	pkgbuild_edit_callback_t callback, void *data);
+
+/* Type: pkgbuild_tree_t
+An opaque data type holding an immutable snapshot of the PKGBUILDs under a
+directory, see <pkgbuild_watch_tree()>. A tree may be retained, read and
+released from any thread, while its watch publishes newer trees. Its
+pkgbuilds are fully loaded, and must only be read; retain the tree to keep
+them.
+*/
+typedef struct _pkgbuild_tree_t pkgbuild_tree_t;
+
+/* Function: pkgbuild_tree_count
+Retrieve the amount of PKGBUILDs in a tree.
+
+Parameters:
+	tree - The tree.
+
+Returns:
+	The amount of PKGBUILDs.
+*/
+size_t pkgbuild_tree_count(pkgbuild_tree_t *tree);
+
+/* Function: pkgbuild_tree_path
+Retrieve the path of a PKGBUILD of a tree. PKGBUILDs are in order of their
+paths, which start with the root of the watch.
+
+Parameters:
+	tree - The tree.
+	index - The index of the PKGBUILD, less than <pkgbuild_tree_count()>.
+
+Returns:
+	The path, which remains valid as long as the tree, or NULL if the index
+	is out of range.
+*/
+const char *pkgbuild_tree_path(pkgbuild_tree_t *tree, size_t index);
+
+/* Function: pkgbuild_tree_pkgbuild
+Retrieve a pkgbuild of a tree.
+
+Parameters:
+	tree - The tree.
+	index - The index of the PKGBUILD, less than <pkgbuild_tree_count()>.
+
+Returns:
+	The pkgbuild, which remains valid as long as the tree, or NULL if the
+	index is out of range.
+*/
+pkgbuild_t *pkgbuild_tree_pkgbuild(pkgbuild_tree_t *tree, size_t index);
+
+/* Function: pkgbuild_tree_find
+Retrieve the pkgbuild of a PKGBUILD of a tree by its path.
+
+Parameters:
+	tree - The tree.
+	path - The path of the PKGBUILD, such as "root/foo/PKGBUILD".
+
+Returns:
+	The pkgbuild, which remains valid as long as the tree, or NULL if the
+	tree holds no such PKGBUILD.
+*/
+pkgbuild_t *pkgbuild_tree_find(pkgbuild_tree_t *tree, const char *path);
+
+/* Function: pkgbuild_tree_retain
+Increment the tree's reference count.
+
+Parameters:
+	tree - A reference to the tree to be retained.
+
+Returns:
+	A reference to the tree.
+
+See Also:
+	<pkgbuild_tree_release()>
+*/
+pkgbuild_tree_t *pkgbuild_tree_retain(pkgbuild_tree_t *tree);
+
+/* Function: pkgbuild_tree_release
+Decrement the tree's reference count. The tree is deallocated when it reaches
+0, together with the pkgbuilds no newer tree shares.
+
+Parameters:
+	tree - A reference to the tree to be released.
+
+See Also:
+	<pkgbuild_tree_retain()>
+*/
+void pkgbuild_tree_release(pkgbuild_tree_t *tree);
+
+/* Type: pkgbuild_watch_t
+An opaque data type keeping an index of the PKGBUILDs under a directory, such
+as a repository of packages, fresh. The directory is watched with inotify,
+and only PKGBUILDs which were added, changed or removed are parsed again.
+Bursts of changes, such as those of a checkout, are handled at once, once
+they have settled. Each update publishes a new <pkgbuild_tree_t>, sharing the
+pkgbuilds which did not change. Only available on Linux.
+
+Hidden directories, such as .git, and symbolic links to directories are not
+followed.
+
+Example:
+	(start code)
+	pkgbuild_watch_t *watch;
+	pkgbuild_tree_t *tree;
+
+	watch = pkgbuild_watch_new("packages", kPkgbuildOptionSkipFunctions,
+	    NULL);
+	while(pkgbuild_watch_update(watch, -1, NULL, NULL) >= 0) {
+	    // Usually done by other threads
+	    tree = pkgbuild_watch_tree(watch);
+	    printf("%zu PKGBUILDs\n", pkgbuild_tree_count(tree));
+	    pkgbuild_tree_release(tree);
+	}
+	pkgbuild_watch_release(watch);
+	(end)
+*/
+typedef struct _pkgbuild_watch_t pkgbuild_watch_t;
+
+/* Type: pkgbuild_watch_callback_t
+A function notified of a PKGBUILD which was added, changed or removed, see
+<pkgbuild_watch_update()>. It is passed the path of the PKGBUILD, its new
+pkgbuild or NULL if it was removed, and the data given to the update.
+*/
+typedef void (*pkgbuild_watch_callback_t)(const char *path,
+	pkgbuild_t *pkgbuild, void *data);
+
+/* Function: pkgbuild_watch_new
+Parse every PKGBUILD under a directory, and start watching it for changes.
+
+Parameters:
+	root - The path of the directory.
+	options - A combination of <pkgbuild_option_t> flags, with which
+		PKGBUILDs are parsed as with <pkgbuild_parse_file()>.
+		kPkgbuildOptionLazy is ignored.
+	pool - The pool to evaluate unsupported PKGBUILDs with, or NULL.
+
+Returns:
+	A new watch, which must be deallocated using <pkgbuild_watch_release()>,
+	or NULL if the directory cannot be watched.
+*/
+pkgbuild_watch_t *pkgbuild_watch_new(const char *root, int options,
+	pkgbuild_pool_t *pool);
+
+/* Function: pkgbuild_watch_fd
+Retrieve the file descriptor of a watch, which is readable when
+<pkgbuild_watch_update()> has changes to handle, such as for poll().
+
+Parameters:
+	watch - The watch.
+
+Returns:
+	The file descriptor, or -1 if the watch is NULL.
+*/
+int pkgbuild_watch_fd(pkgbuild_watch_t *watch);
+
+/* Function: pkgbuild_watch_update
+Wait for changes under the directory of a watch, parse the PKGBUILDs which
+changed, and publish the resulting tree. A watch must only be updated by one
+thread at a time.
+
+Parameters:
+	watch - The watch.
+	timeout - The amount of milliseconds to wait for the first change, 0 to
+		only handle pending changes, or -1 to wait indefinitely.
+	callback - The function notified of each PKGBUILD which changed, or
+		NULL.
+	data - Data passed to callback.
+
+Returns:
+	The amount of PKGBUILDs added, changed or removed, or -1 on error.
+*/
+int pkgbuild_watch_update(pkgbuild_watch_t *watch, int timeout,
+	pkgbuild_watch_callback_t callback, void *data);
+
+/* Function: pkgbuild_watch_tree
+Retrieve the latest tree of a watch. It may be called from any thread.
+
+Parameters:
+	watch - The watch.
+
+Returns:
+	The tree, which must be released using <pkgbuild_tree_release()>.
+*/
+pkgbuild_tree_t *pkgbuild_watch_tree(pkgbuild_watch_t *watch);
+
+/* Function: pkgbuild_watch_retain
+Increment the watch's reference count.
+
+Parameters:
+	watch - A reference to the watch to be retained.
+
+Returns:
+	A reference to the watch.
+
+See Also:
+	<pkgbuild_watch_release()>
+*/
+pkgbuild_watch_t *pkgbuild_watch_retain(pkgbuild_watch_t *watch);
+
+/* Function: pkgbuild_watch_release
+Decrement the watch's reference count. The directory is no longer watched
+when it reaches 0. Trees retained from it remain valid.
+
+Parameters:
+	watch - A reference to the watch to be released.
+
+See Also:
+	<pkgbuild_watch_retain()>
+*/
+void pkgbuild_watch_release(pkgbuild_watch_t *watch);
+
+/* Type: pkgbuild_cache_t
+An opaque data type caching pkgbuilds by a key, such as the path of a
+PKGBUILD or a digest of its contents, for a service answering many requests
+at once. Lookups take no lock, and are not blocked by insertions. Once the
+cache holds as many pkgbuilds as its capacity, inserting one evicts a
+pkgbuild which was not looked up recently, as chosen by the CLOCK algorithm.
+
+Cached pkgbuilds are shared between threads, and must only be read. Reference
+counts of pkgbuilds are atomic, so they may be retained and released from
+any thread.
+
+Example:
+	(start code)
+	pkgbuild = pkgbuild_cache_get(cache, path);
+	if(pkgbuild == NULL) {
+	    pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, NULL);
+	    pkgbuild_cache_put(cache, path, pkgbuild);
+	}
+	// ...
+	pkgbuild_release(pkgbuild);
+	(end)
+*/
+typedef struct _pkgbuild_cache_t pkgbuild_cache_t;
+
+/* Function: pkgbuild_cache_new
+Create an empty cache.
+
+Parameters:
+	capacity - The maximum amount of pkgbuilds held.
+
+Returns:
+	A new cache, which must be deallocated using <pkgbuild_cache_release()>,
+	or NULL if the capacity is 0.
+*/
+pkgbuild_cache_t *pkgbuild_cache_new(size_t capacity);
+
+/* Function: pkgbuild_cache_get
+Look up a pkgbuild in a cache. It may be called from any thread.
+
+Parameters:
+	cache - The cache.
+	key - The key of the pkgbuild.
+
+Returns:
+	The pkgbuild, which must be released using <pkgbuild_release()>, or
+	NULL if the cache holds none for the key.
+*/
+pkgbuild_t *pkgbuild_cache_get(pkgbuild_cache_t *cache, const char *key);
+
+/* Function: pkgbuild_cache_put
+Insert a pkgbuild into a cache, replacing the one of the same key. The cache
+retains the pkgbuild, which must not be modified afterwards. Fields of a
+pkgbuild parsed with kPkgbuildOptionLazy are loaded first, and its symbol
+table is released, so that it can be shared between threads. It may be called
+from any thread.
+
+Parameters:
+	cache - The cache.
+	key - The key of the pkgbuild.
+	pkgbuild - The pkgbuild, which is ignored if it is NULL.
+*/
+void pkgbuild_cache_put(pkgbuild_cache_t *cache, const char *key,
+	pkgbuild_t *pkgbuild);
+
+/* Function: pkgbuild_cache_remove
+Remove a pkgbuild from a cache, such as once its PKGBUILD changed. It may be
+called from any thread.
+
+Parameters:
+	cache - The cache.
+	key - The key of the pkgbuild.
+
+Returns:
+	True (1) if the cache held a pkgbuild for the key, otherwise false (0).
+*/
+int pkgbuild_cache_remove(pkgbuild_cache_t *cache, const char *key);
+
+/* Function: pkgbuild_cache_count
+Retrieve the amount of pkgbuilds held by a cache.
+
+Parameters:
+	cache - The cache.
+
+Returns:
+	The amount of pkgbuilds.
+*/
+size_t pkgbuild_cache_count(pkgbuild_cache_t *cache);
+
+/* Function: pkgbuild_cache_retain
+Increment the cache's reference count.
+
+Parameters:
+	cache - A reference to the cache to be retained.
+
+Returns:
+	A reference to the cache.
+
+See Also:
+	<pkgbuild_cache_release()>
+*/
+pkgbuild_cache_t *pkgbuild_cache_retain(pkgbuild_cache_t *cache);
+
+/* Function: pkgbuild_cache_release
+Decrement the cache's reference count. The cache is deallocated when it
+reaches 0, releasing the pkgbuilds it holds. No thread may be using it at that
+point.
+
+Parameters:
+	cache - A reference to the cache to be released.
+
+See Also:
+	<pkgbuild_cache_retain()>
+*/
+void pkgbuild_cache_release(pkgbuild_cache_t *cache);
+
 #endif
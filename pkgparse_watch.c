@@ -0,0 +1,98 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: pkgparse_watch.c
+The pkgparse-watch command, which keeps an index of the PKGBUILDs under a
+directory fresh, and prints each PKGBUILD which is added, changed or removed.
+
+Usage:
+	pkgparse-watch [-i] [-s] DIRECTORY
+
+	-i - Ignore .SRCINFO files, see kPkgbuildOptionIgnoreSrcinfo.
+	-s - Skip the bodies of functions, see kPkgbuildOptionSkipFunctions.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+
+/* Print a PKGBUILD, or that it was removed. */
+static void _print(const char *path, pkgbuild_t *pkgbuild, void *data)
+{
+	if(pkgbuild == NULL) {
+		printf("%s removed\n", path);
+	} else {
+		printf("%s %s %s-%g\n", path, pkgbuild_basename(pkgbuild),
+			pkgbuild_version(pkgbuild), pkgbuild_rel(pkgbuild));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	pkgbuild_watch_t *watch;
+	pkgbuild_tree_t *tree;
+	int options = kPkgbuildOptionNone;
+	size_t i;
+	int opt;
+
+	while((opt = getopt(argc, argv, "is")) != -1) {
+		switch(opt) {
+			case 'i':
+				options |= kPkgbuildOptionIgnoreSrcinfo;
+				break;
+			case 's':
+				options |= kPkgbuildOptionSkipFunctions;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-i] [-s] DIRECTORY\n", argv[0]);
+				return 2;
+		}
+	}
+	if(optind + 1 != argc) {
+		fprintf(stderr, "usage: %s [-i] [-s] DIRECTORY\n", argv[0]);
+		return 2;
+	}
+
+	watch = pkgbuild_watch_new(argv[optind], options, NULL);
+	if(watch == NULL) {
+		perror(argv[optind]);
+		return 1;
+	}
+	tree = pkgbuild_watch_tree(watch);
+	for(i = 0; i < pkgbuild_tree_count(tree); i++) {
+		_print(pkgbuild_tree_path(tree, i), pkgbuild_tree_pkgbuild(tree, i),
+			NULL);
+	}
+	pkgbuild_tree_release(tree);
+	fflush(stdout);
+
+	while(pkgbuild_watch_update(watch, -1, _print, NULL) >= 0) {
+		fflush(stdout);
+	}
+	perror("inotify");
+	pkgbuild_watch_release(watch);
+	return 1;
+}
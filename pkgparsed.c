@@ -0,0 +1,659 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: pkgparsed.c
+The pkgparsed daemon, which keeps the PKGBUILDs under a directory parsed and
+fresh, see <pkgbuild_watch_t>, and answers requests over a Unix domain
+socket. Buffers sent to be parsed are cached by the digest of their contents,
+see <pkgbuild_cache_t>.
+
+Usage:
+	pkgparsed [-i] [-s] [-c CAPACITY] [-m MODE] SOCKET DIRECTORY
+
+	-i - Ignore .SRCINFO files, see kPkgbuildOptionIgnoreSrcinfo.
+	-s - Skip the bodies of functions, see kPkgbuildOptionSkipFunctions.
+	-c - The amount of parsed buffers cached, 1024 by default.
+	-m - The octal permissions of the socket, 0600 by default, so that only
+		the owner may connect.
+
+Protocol:
+	Each request and response is a frame, made of a 32-bit big-endian
+	length, followed by as many bytes. The first byte of a request is its
+	type, followed by its argument:
+
+	'n' - Look up the PKGBUILDs with a pkgname or pkgbase, given as the
+		argument.
+	'p' - Look up the PKGBUILDs providing a name, given as the argument,
+		without a version.
+	'b' - Parse the PKGBUILD given as the argument. Sourced files are not
+		read, see kPkgbuildOptionIgnoreSourced.
+	's' - Retrieve the counters of the daemon, as lines of a name and a
+		value separated by a space.
+
+	The first byte of a response is 0 on success, 1 if no PKGBUILD was
+	found and 2 if the request is invalid. PKGBUILDs are sent in the format
+	of a .SRCINFO, each preceded by a comment holding its path, if any.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "pkgparse.h"
+
+/* The length of the longest request accepted */
+#define kMaxRequest (16 * 1024 * 1024)
+
+/* Enumeration: _status_t
+The first byte of a response.
+
+kStatusOk - The request succeeded.
+kStatusNotFound - No PKGBUILD was found.
+kStatusInvalid - The request is malformed.
+*/
+typedef enum {
+	kStatusOk = 0,
+	kStatusNotFound = 1,
+	kStatusInvalid = 2,
+} _status_t;
+
+/* Type: _name_t
+A name a PKGBUILD of a tree is known by.
+
+name - The name.
+index - The index of the PKGBUILD in the tree.
+*/
+typedef struct {
+	char *name;
+	size_t index;
+} _name_t;
+
+/* Type: _index_t
+The names of the PKGBUILDs of a tree, in order, shared by the requests
+looking them up.
+*/
+typedef struct {
+	unsigned int refcount;
+	pkgbuild_tree_t *tree;
+	_name_t *names;
+	size_t name_count;
+	_name_t *provides;
+	size_t provide_count;
+} _index_t;
+
+/* Type: _stats_t
+Counters of the daemon, updated atomically.
+*/
+typedef struct {
+	unsigned long connections;
+	unsigned long requests;
+	unsigned long name_lookups;
+	unsigned long provide_lookups;
+	unsigned long parses;
+	unsigned long cache_hits;
+	unsigned long cache_misses;
+	unsigned long invalid;
+	unsigned long updates;
+} _stats_t;
+
+static pkgbuild_watch_t *_watch;
+static pkgbuild_cache_t *_cache;
+static int _options;
+static time_t _started;
+static _stats_t _stats;
+/* Guards _index, which is replaced whenever the tree changes */
+static pthread_mutex_t _index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _index_t *_index;
+
+/* Type: _buffer_t
+A growing buffer a response is built in.
+*/
+typedef struct {
+	char *data;
+	size_t length;
+	size_t size;
+} _buffer_t;
+
+static void _buffer_reserve(_buffer_t *buffer, size_t length)
+{
+	if(buffer->length + length > buffer->size) {
+		while(buffer->length + length > buffer->size) {
+			buffer->size = buffer->size == 0 ? 4096 : buffer->size * 2;
+		}
+		buffer->data = realloc(buffer->data, buffer->size);
+	}
+}
+
+static void _buffer_append(_buffer_t *buffer, const char *data, size_t length)
+{
+	_buffer_reserve(buffer, length);
+	memcpy(buffer->data + buffer->length, data, length);
+	buffer->length += length;
+}
+
+/* Append a PKGBUILD, as a .SRCINFO preceded by its path, to a response. */
+static void _buffer_append_pkgbuild(_buffer_t *buffer, const char *path,
+	pkgbuild_t *pkgbuild)
+{
+	size_t length;
+
+	if(path != NULL) {
+		_buffer_append(buffer, "# ", 2);
+		_buffer_append(buffer, path, strlen(path));
+		_buffer_append(buffer, "\n", 1);
+	}
+	length = pkgbuild_format_srcinfo(pkgbuild, NULL, 0);
+	_buffer_reserve(buffer, length + 1);
+	pkgbuild_format_srcinfo(pkgbuild, buffer->data + buffer->length,
+		length + 1);
+	buffer->length += length;
+}
+
+static int _name_compare(const void *a, const void *b)
+{
+	const _name_t *x = a;
+	const _name_t *y = b;
+	int order;
+
+	order = strcmp(x->name, y->name);
+	if(order == 0 && x->index != y->index) {
+		order = x->index < y->index ? -1 : 1;
+	}
+	return order;
+}
+
+static void _names_add(_name_t **names, size_t *count, size_t *size,
+	const char *name, size_t length, size_t index)
+{
+	if(*count == *size) {
+		*size = *size == 0 ? 256 : *size * 2;
+		*names = realloc(*names, *size * sizeof(**names));
+	}
+	(*names)[*count].name = strndup(name, length);
+	(*names)[*count].index = index;
+	(*count)++;
+}
+
+/* Add the provides of a pkgbuild to an index, without their versions. */
+static void _index_add_provides(_index_t *index, size_t *size,
+	pkgbuild_t *pkgbuild, size_t i)
+{
+	char **provides = pkgbuild_provides(pkgbuild);
+	size_t j;
+
+	for(j = 0; provides != NULL && provides[j] != NULL; j++) {
+		_names_add(&index->provides, &index->provide_count, size,
+			provides[j], strcspn(provides[j], "<>="), i);
+	}
+}
+
+/* Index the names of the PKGBUILDs of a tree, which the index takes. */
+static _index_t *_index_new(pkgbuild_tree_t *tree)
+{
+	_index_t *index;
+	pkgbuild_t **splitpkgs;
+	pkgbuild_t *pkgbuild;
+	size_t name_size = 0;
+	size_t provide_size = 0;
+	char **names;
+	size_t i, j;
+
+	index = calloc(1, sizeof(*index));
+	index->refcount = 1;
+	index->tree = tree;
+	for(i = 0; i < pkgbuild_tree_count(tree); i++) {
+		pkgbuild = pkgbuild_tree_pkgbuild(tree, i);
+		if(pkgbuild_basename(pkgbuild) != NULL) {
+			_names_add(&index->names, &index->name_count, &name_size,
+				pkgbuild_basename(pkgbuild),
+				strlen(pkgbuild_basename(pkgbuild)), i);
+		}
+		names = pkgbuild_names(pkgbuild);
+		for(j = 0; names != NULL && names[j] != NULL; j++) {
+			_names_add(&index->names, &index->name_count, &name_size,
+				names[j], strlen(names[j]), i);
+		}
+		_index_add_provides(index, &provide_size, pkgbuild, i);
+		splitpkgs = pkgbuild_splitpkgs(pkgbuild);
+		for(j = 0; splitpkgs != NULL && splitpkgs[j] != NULL; j++) {
+			_index_add_provides(index, &provide_size, splitpkgs[j], i);
+		}
+	}
+	qsort(index->names, index->name_count, sizeof(*index->names),
+		_name_compare);
+	qsort(index->provides, index->provide_count, sizeof(*index->provides),
+		_name_compare);
+	return index;
+}
+
+static void _index_release(_index_t *index)
+{
+	size_t i;
+
+	if(index != NULL && __sync_sub_and_fetch(&index->refcount, 1) == 0) {
+		for(i = 0; i < index->name_count; i++) {
+			free(index->names[i].name);
+		}
+		for(i = 0; i < index->provide_count; i++) {
+			free(index->provides[i].name);
+		}
+		free(index->names);
+		free(index->provides);
+		pkgbuild_tree_release(index->tree);
+		free(index);
+	}
+}
+
+/* Retrieve the current index, which must be released. */
+static _index_t *_index_current()
+{
+	_index_t *index;
+
+	pthread_mutex_lock(&_index_mutex);
+	index = _index;
+	__sync_add_and_fetch(&index->refcount, 1);
+	pthread_mutex_unlock(&_index_mutex);
+	return index;
+}
+
+/* Publish an index of the latest tree of the watch. */
+static void _index_publish()
+{
+	_index_t *index;
+	_index_t *previous;
+
+	index = _index_new(pkgbuild_watch_tree(_watch));
+	pthread_mutex_lock(&_index_mutex);
+	previous = _index;
+	_index = index;
+	pthread_mutex_unlock(&_index_mutex);
+	_index_release(previous);
+}
+
+/* Update the tree of the watch as the directory changes. */
+static void *_watch_thread(void *data)
+{
+	int changed;
+
+	while((changed = pkgbuild_watch_update(_watch, -1, NULL, NULL)) >= 0) {
+		if(changed > 0) {
+			__sync_add_and_fetch(&_stats.updates, 1);
+			_index_publish();
+		}
+	}
+	perror("inotify");
+	exit(1);
+	return NULL;
+}
+
+/*
+Answer a lookup of the PKGBUILDs known by a name.
+
+Parameters:
+	names - The names or provides of an index.
+	count - The amount of names.
+	index - The index.
+	name - The name looked up.
+	length - The length of the name.
+	response - The response the PKGBUILDs are appended to.
+
+Returns:
+	The status of the response.
+*/
+static _status_t _lookup(_name_t *names, size_t count, _index_t *index,
+	const char *name, size_t length, _buffer_t *response)
+{
+	size_t low = 0;
+	size_t high = count;
+	size_t middle;
+	size_t previous = (size_t)-1;
+	_status_t status = kStatusNotFound;
+	char *key;
+
+	key = strndup(name, length);
+	while(low < high) {
+		middle = low + (high - low) / 2;
+		if(strcmp(names[middle].name, key) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	for(; low < count && strcmp(names[low].name, key) == 0; low++) {
+		/* A PKGBUILD may be known by the same name more than once */
+		if(names[low].index != previous) {
+			previous = names[low].index;
+			_buffer_append_pkgbuild(response,
+				pkgbuild_tree_path(index->tree, previous),
+				pkgbuild_tree_pkgbuild(index->tree, previous));
+			status = kStatusOk;
+		}
+	}
+	free(key);
+	return status;
+}
+
+/* Answer a request to parse a buffer, caching the result by its digest. */
+static _status_t _parse(const char *buffer, size_t length,
+	_buffer_t *response)
+{
+	unsigned char digest[kHashMaxLength];
+	char key[2 * kHashMaxLength + 1];
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+	hash_t hash;
+	size_t digest_length;
+	size_t i;
+
+	if(!hash_init(&hash, kHashSha256)) {
+		return kStatusInvalid;
+	}
+	hash_update(&hash, buffer, length);
+	digest_length = hash_final(&hash, digest);
+	for(i = 0; i < digest_length; i++) {
+		sprintf(key + 2 * i, "%02x", digest[i]);
+	}
+
+	pkgbuild = pkgbuild_cache_get(_cache, key);
+	if(pkgbuild != NULL) {
+		__sync_add_and_fetch(&_stats.cache_hits, 1);
+	} else {
+		__sync_add_and_fetch(&_stats.cache_misses, 1);
+		parser = pkgbuild_parser_new_with_options(_options
+			| kPkgbuildOptionIgnoreSourced);
+		pkgbuild_parser_feed(parser, buffer, length);
+		pkgbuild = pkgbuild_parser_finish(parser);
+		pkgbuild_parser_release(parser);
+		pkgbuild_cache_put(_cache, key, pkgbuild);
+	}
+	_buffer_append_pkgbuild(response, NULL, pkgbuild);
+	pkgbuild_release(pkgbuild);
+	return kStatusOk;
+}
+
+/* Answer a request for the counters of the daemon. */
+static _status_t _stats_format(_buffer_t *response)
+{
+	_index_t *index;
+	char line[64];
+
+	index = _index_current();
+#define _STAT(name, value) \
+	_buffer_append(response, line, snprintf(line, sizeof(line), \
+		"%s %lu\n", name, (unsigned long)(value)))
+	_STAT("uptime", time(NULL) - _started);
+	_STAT("connections", _stats.connections);
+	_STAT("requests", _stats.requests);
+	_STAT("name_lookups", _stats.name_lookups);
+	_STAT("provide_lookups", _stats.provide_lookups);
+	_STAT("parses", _stats.parses);
+	_STAT("cache_hits", _stats.cache_hits);
+	_STAT("cache_misses", _stats.cache_misses);
+	_STAT("cache_entries", pkgbuild_cache_count(_cache));
+	_STAT("invalid_requests", _stats.invalid);
+	_STAT("tree_updates", _stats.updates);
+	_STAT("pkgbuilds", pkgbuild_tree_count(index->tree));
+#undef _STAT
+	_index_release(index);
+	return kStatusOk;
+}
+
+/* Answer a request, appending the payload of the response to a buffer. */
+static _status_t _answer(const char *request, size_t length,
+	_buffer_t *response)
+{
+	_index_t *index;
+	_status_t status;
+
+	__sync_add_and_fetch(&_stats.requests, 1);
+	if(length == 0) {
+		__sync_add_and_fetch(&_stats.invalid, 1);
+		return kStatusInvalid;
+	}
+	switch(request[0]) {
+		case 'n':
+		case 'p':
+			index = _index_current();
+			if(request[0] == 'n') {
+				__sync_add_and_fetch(&_stats.name_lookups, 1);
+				status = _lookup(index->names, index->name_count, index,
+					request + 1, length - 1, response);
+			} else {
+				__sync_add_and_fetch(&_stats.provide_lookups, 1);
+				status = _lookup(index->provides, index->provide_count, index,
+					request + 1, length - 1, response);
+			}
+			_index_release(index);
+			return status;
+		case 'b':
+			__sync_add_and_fetch(&_stats.parses, 1);
+			return _parse(request + 1, length - 1, response);
+		case 's':
+			return _stats_format(response);
+		default:
+			__sync_add_and_fetch(&_stats.invalid, 1);
+			return kStatusInvalid;
+	}
+}
+
+static int _read_full(int fd, void *data, size_t length)
+{
+	ssize_t count;
+
+	while(length > 0) {
+		count = read(fd, data, length);
+		if(count < 0 && errno == EINTR) {
+			continue;
+		} else if(count <= 0) {
+			return 0;
+		}
+		data = (char *)data + count;
+		length -= count;
+	}
+	return 1;
+}
+
+static int _write_full(int fd, const void *data, size_t length)
+{
+	ssize_t count;
+
+	while(length > 0) {
+		count = write(fd, data, length);
+		if(count < 0 && errno == EINTR) {
+			continue;
+		} else if(count <= 0) {
+			return 0;
+		}
+		data = (const char *)data + count;
+		length -= count;
+	}
+	return 1;
+}
+
+/* Serve the requests of a client until it disconnects. */
+static void *_client_thread(void *data)
+{
+	int fd = (int)(intptr_t)data;
+	_buffer_t response = {NULL, 0, 0};
+	unsigned char header[4];
+	char *request = NULL;
+	size_t length;
+
+	while(_read_full(fd, header, sizeof(header))) {
+		length = (size_t)header[0] << 24 | header[1] << 16 | header[2] << 8
+			| header[3];
+		if(length > kMaxRequest) {
+			__sync_add_and_fetch(&_stats.invalid, 1);
+			break;
+		}
+		request = realloc(request, length + 1);
+		if(!_read_full(fd, request, length)) {
+			break;
+		}
+
+		/* The length of the response is filled in once it is known */
+		response.length = 0;
+		_buffer_reserve(&response, 5);
+		response.length = 5;
+		response.data[4] = _answer(request, length, &response);
+		length = response.length - 4;
+		response.data[0] = length >> 24;
+		response.data[1] = length >> 16;
+		response.data[2] = length >> 8;
+		response.data[3] = length;
+		if(!_write_full(fd, response.data, response.length)) {
+			break;
+		}
+	}
+	free(request);
+	free(response.data);
+	close(fd);
+	return NULL;
+}
+
+/* Listen on a Unix domain socket with the given permissions, replacing a
+stale one. */
+static int _listen(const char *path, mode_t mode)
+{
+	struct sockaddr_un address;
+	struct stat st;
+	mode_t mask;
+	int bound;
+	int fd;
+
+	if(strlen(path) >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if(lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path);
+	}
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0) {
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	/* Nobody else may connect before the permissions are set */
+	mask = umask(0177);
+	bound = bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+	umask(mask);
+	if(!bound || chmod(path, mode) != 0 || listen(fd, 64) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void _usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-i] [-s] [-c CAPACITY] [-m MODE] SOCKET "
+		"DIRECTORY\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_attr_t attributes;
+	pthread_t thread;
+	size_t capacity = 1024;
+	mode_t mode = 0600;
+	char *end;
+	int listener;
+	int fd;
+	int opt;
+
+	_options = kPkgbuildOptionNone;
+	while((opt = getopt(argc, argv, "isc:m:")) != -1) {
+		switch(opt) {
+			case 'i':
+				_options |= kPkgbuildOptionIgnoreSrcinfo;
+				break;
+			case 's':
+				_options |= kPkgbuildOptionSkipFunctions;
+				break;
+			case 'c':
+				capacity = strtoul(optarg, NULL, 10);
+				break;
+			case 'm':
+				mode = strtoul(optarg, &end, 8);
+				if(*end != '\0' || mode > 0777) {
+					_usage(argv[0]);
+					return 2;
+				}
+				break;
+			default:
+				_usage(argv[0]);
+				return 2;
+		}
+	}
+	if(optind + 2 != argc || capacity == 0) {
+		_usage(argv[0]);
+		return 2;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	_started = time(NULL);
+	_cache = pkgbuild_cache_new(capacity);
+	_watch = pkgbuild_watch_new(argv[optind + 1], _options, NULL);
+	if(_watch == NULL) {
+		perror(argv[optind + 1]);
+		return 1;
+	}
+	_index_publish();
+	listener = _listen(argv[optind], mode);
+	if(listener < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	pthread_create(&thread, NULL, _watch_thread, NULL);
+
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	for(;;) {
+		fd = accept(listener, NULL, NULL);
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			perror("accept");
+			return 1;
+		}
+		__sync_add_and_fetch(&_stats.connections, 1);
+		if(pthread_create(&thread, &attributes, _client_thread,
+				(void *)(intptr_t)fd) != 0) {
+			close(fd);
+		}
+	}
+}
@@ -0,0 +1,505 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+#include "symbol.h"
+
+/* The initial size of the buffer a response is read into */
+#define kPoolBufferSize 4096
+
+/*
+The loop run by each worker. It reads NUL terminated paths, and sources each
+PKGBUILD within a subshell, so that the variables, functions, options and
+working directory of one PKGBUILD never affect the next. Variables are
+written as NUL terminated records:
+
+	s<name> <value> - A string.
+	a<name> <count> <elements...> - An array.
+	f<name> - A package_* function, whose variables follow. Its assignments
+		are evaluated in a subshell, as makepkg does for split packages.
+	z<status> - The end of the response, with the status of the subshell.
+*/
+static const char *_worker_script =
+	"_pp_emit() {\n"
+	"	local _pp_v\n"
+	"	local -a _pp_a\n"
+	"	for _pp_v in \"$@\"; do\n"
+	"		case ${!_pp_v@a} in\n"
+	"		*A*) ;;\n"
+	"		*a*)\n"
+	"			eval \"_pp_a=(\\\"\\${$_pp_v[@]}\\\")\"\n"
+	"			printf 'a%s\\0%d\\0' \"$_pp_v\" \"${#_pp_a[@]}\"\n"
+	"			(( ${#_pp_a[@]} == 0 )) || printf '%s\\0' \"${_pp_a[@]}\"\n"
+	"			;;\n"
+	"		*)\n"
+	"			[[ ! -v $_pp_v ]] || printf 's%s\\0%s\\0' \"$_pp_v\" \"${!_pp_v}\"\n"
+	"			;;\n"
+	"		esac\n"
+	"	done\n"
+	"}\n"
+	"_pp_names() {\n"
+	"	local _pp_v\n"
+	"	for _pp_v in $(compgen -v); do\n"
+	"		[[ $_pp_v != [a-z_]* || $_pp_v == _pp_* || $_pp_v == _ ]] ||\n"
+	"			printf '%s\\n' \"$_pp_v\"\n"
+	"	done\n"
+	"}\n"
+	"while IFS= read -r -d '' _pp_path; do\n"
+	"	(\n"
+	"		cd -- \"${_pp_path%/*}\" || exit\n"
+	"		source -- \"$_pp_path\" </dev/null >/dev/null 2>&1\n"
+	"		set +eu\n"
+	"		IFS=$' \\t\\n'\n"
+	"		_pp_emit $(_pp_names)\n"
+	"		for _pp_f in $(compgen -A function package_); do\n"
+	"			printf 'f%s\\0' \"$_pp_f\"\n"
+	"			(\n"
+	"				_pp_l=()\n"
+	"				while IFS= read -r _pp_line; do\n"
+	"					[[ $_pp_line =~ ^[[:space:]]*([a-z_][a-z0-9_]*)\\+?= ]] || continue\n"
+	"					_pp_l+=(\"${BASH_REMATCH[1]}\")\n"
+	"					eval \"$_pp_line\" </dev/null >/dev/null 2>&1\n"
+	"				done < <(declare -f \"$_pp_f\")\n"
+	"				_pp_emit \"${_pp_l[@]}\"\n"
+	"			)\n"
+	"		done\n"
+	"	)\n"
+	"	printf 'z%d\\0' \"$?\"\n"
+	"done\n";
+
+/* A bash process serving requests */
+typedef struct {
+	/* The process, which leads a process group of its own, or 0 if it is
+	not running */
+	pid_t pid;
+	/* The socket connected to both stdin and stdout of the process */
+	int fd;
+	/* Whether the worker is evaluating a PKGBUILD */
+	int busy;
+} _worker_t;
+
+struct _pkgbuild_pool_t {
+	unsigned int refcount;
+	/* Protects the busy flags of the workers */
+	pthread_mutex_t mutex;
+	/* Signalled whenever a worker becomes available */
+	pthread_cond_t available;
+	_worker_t *workers;
+	size_t worker_count;
+	/* Milliseconds a PKGBUILD may take, or 0 */
+	unsigned int timeout;
+};
+
+/* Start the bash process of a worker. Returns false (0) on error. */
+static int _worker_spawn(_worker_t *worker)
+{
+	char *argv[] = {"bash", "--noprofile", "--norc", "-c", NULL, NULL};
+	char *envp[] = {"PATH=/usr/local/bin:/usr/bin:/bin", "LC_ALL=C", NULL};
+	extern char **environ;
+	int fds[2];
+	int null;
+	pid_t pid;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+		return 0;
+	}
+	pid = fork();
+	if(pid == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return 0;
+	}
+	if(pid == 0) {
+		/* Killing the group on a timeout also kills whatever the PKGBUILD
+		started */
+		setpgid(0, 0);
+		null = open("/dev/null", O_WRONLY);
+		dup2(fds[1], STDIN_FILENO);
+		dup2(fds[1], STDOUT_FILENO);
+		dup2(null, STDERR_FILENO);
+		argv[4] = (char *)_worker_script;
+		environ = envp;
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	setpgid(pid, pid);
+	close(fds[1]);
+	/* Keep the workers started later from holding on to the socket */
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	worker->pid = pid;
+	worker->fd = fds[0];
+	return 1;
+}
+
+/* Stop the bash process of a worker, and anything it started. */
+static void _worker_kill(_worker_t *worker)
+{
+	if(worker->pid != 0) {
+		kill(-worker->pid, SIGKILL);
+		close(worker->fd);
+		waitpid(worker->pid, NULL, 0);
+		worker->pid = 0;
+	}
+}
+
+/* Milliseconds elapsed since an arbitrary point. */
+static long long _now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+Determine the length of the record at the start of a response.
+
+Parameters:
+	data - The start of the record.
+	length - The amount of data read past the start of the record.
+
+Returns:
+	The length of the record, or 0 if it has not been read completely.
+*/
+static size_t _record_length(const char *data, size_t length)
+{
+	const char *end = data + length;
+	const char *ptr;
+	unsigned long count = 0;
+
+	ptr = memchr(data, '\0', length);
+	if(ptr == NULL) {
+		return 0;
+	}
+	ptr++;
+	if(data[0] == 's') {
+		count = 1;
+	} else if(data[0] == 'a') {
+		if(memchr(ptr, '\0', end - ptr) == NULL) {
+			return 0;
+		}
+		count = strtoul(ptr, NULL, 10);
+		ptr += strlen(ptr) + 1;
+	}
+	for(; count > 0; count--) {
+		if(ptr >= end || (ptr = memchr(ptr, '\0', end - ptr)) == NULL) {
+			return 0;
+		}
+		ptr++;
+	}
+	return ptr - data;
+}
+
+/*
+Read the response to a request, up to the terminating record.
+
+Parameters:
+	worker - The worker the request was sent to.
+	timeout - The amount of milliseconds to wait, or 0.
+	length - The address where the length of the response is stored.
+
+Returns:
+	The response, which must be deallocated using free(), or NULL if it
+	could not be read in time.
+*/
+static char *_worker_read(_worker_t *worker, unsigned int timeout,
+	size_t *length)
+{
+	struct pollfd pollfd;
+	long long deadline;
+	long long remaining = -1;
+	char *buffer;
+	size_t size = kPoolBufferSize;
+	size_t offset = 0;
+	size_t record;
+	ssize_t len;
+	int ready;
+
+	*length = 0;
+	deadline = _now() + timeout;
+	buffer = malloc(size);
+	pollfd.fd = worker->fd;
+	pollfd.events = POLLIN;
+	for(;;) {
+		/* Skip over the records read completely */
+		while((record = _record_length(buffer + offset, *length - offset)) > 0) {
+			if(buffer[offset] == 'z') {
+				*length = offset + record;
+				return buffer;
+			}
+			offset += record;
+		}
+
+		if(timeout > 0) {
+			remaining = deadline - _now();
+			if(remaining <= 0) {
+				break;
+			}
+		}
+		ready = poll(&pollfd, 1, remaining > INT_MAX ? INT_MAX : (int)remaining);
+		if(ready == -1 && errno == EINTR) {
+			continue;
+		} else if(ready <= 0) {
+			break;
+		}
+		if(size - *length < kPoolBufferSize) {
+			size *= 2;
+			buffer = realloc(buffer, size);
+		}
+		len = read(worker->fd, buffer + *length, size - *length);
+		if(len <= 0) {
+			break;
+		}
+		*length += len;
+	}
+	free(buffer);
+	return NULL;
+}
+
+/*
+Build a pkgbuild from the variables in a response, with the same extraction
+as the parser.
+
+Parameters:
+	data - The response read by <_worker_read()>.
+	length - The length of the response.
+
+Returns:
+	An initialized pkgbuild_t structure, or NULL if the PKGBUILD could not be
+	sourced.
+*/
+static pkgbuild_t *_decode(char *data, size_t length)
+{
+	pkgbuild_t *pkgbuild = NULL;
+	arena_t *arena;
+	table_t *root;
+	table_t *table;
+	symbol_t *symbol;
+	char **elements;
+	char *ptr;
+	char *next;
+	char *value;
+	char *end = data + length;
+	unsigned long count;
+	unsigned long i;
+
+	/* As with the parser, every symbol is allocated within an arena, which
+	also frees those kept alive by references between function tables */
+	arena = arena_new();
+	root = table_new_with_arena(arena);
+	table = root;
+	for(ptr = data; ptr < end; ptr = next) {
+		next = ptr + _record_length(ptr, end - ptr);
+		value = ptr + strlen(ptr) + 1;
+		symbol = NULL;
+		if(ptr[0] == 'z') {
+			if(strcmp(ptr + 1, "0") == 0) {
+				pkgbuild = pkgbuild_new();
+			}
+			break;
+		} else if(ptr[0] == 'f') {
+			table = table_new_with_parent(root);
+			symbol = symbol_new_with_arena(ptr + 1, arena);
+			symbol_set_function(symbol, table);
+			table_release(table);
+			table_insert(root, symbol);
+		} else if(ptr[0] == 's') {
+			symbol = symbol_new_with_arena(ptr + 1, arena);
+			symbol_set_string(symbol, value);
+			table_insert(table, symbol);
+		} else if(ptr[0] == 'a') {
+			symbol = symbol_new_with_arena(ptr + 1, arena);
+			count = strtoul(value, NULL, 10);
+			elements = malloc((count + 1) * sizeof(*elements));
+			for(i = 0; i < count; i++) {
+				value += strlen(value) + 1;
+				elements[i] = value;
+			}
+			elements[count] = NULL;
+			symbol_set_array(symbol, elements);
+			free(elements);
+			table_insert(table, symbol);
+		}
+		symbol_release(symbol);
+	}
+
+	if(pkgbuild != NULL) {
+		pkgbuild_set_table(pkgbuild, root);
+		pkgbuild_copy_arch_variables(pkgbuild, root);
+		pkgbuild_load_fields(pkgbuild, kPkgbuildFieldAll);
+		pkgbuild_detach(pkgbuild);
+	}
+	table_release(root);
+	arena_release(arena);
+	return pkgbuild;
+}
+
+/*
+Source a PKGBUILD with a worker, starting it if it is not running.
+
+Parameters:
+	worker - The worker checked out for the request.
+	path - The absolute path to the PKGBUILD.
+	timeout - The amount of milliseconds the PKGBUILD may take, or 0.
+
+Returns:
+	An initialized pkgbuild_t structure, or NULL on error.
+*/
+static pkgbuild_t *_worker_evaluate(_worker_t *worker, const char *path,
+	unsigned int timeout)
+{
+	pkgbuild_t *pkgbuild;
+	char *response;
+	size_t length;
+	size_t sent = 0;
+	ssize_t len;
+
+	if(worker->pid == 0 && !_worker_spawn(worker)) {
+		return NULL;
+	}
+	/* The terminator is part of the request. A worker which died is
+	detected here, without raising SIGPIPE. */
+	length = strlen(path) + 1;
+	while(sent < length) {
+		len = send(worker->fd, path + sent, length - sent, MSG_NOSIGNAL);
+		if(len == -1 && errno == EINTR) {
+			continue;
+		} else if(len <= 0) {
+			_worker_kill(worker);
+			return NULL;
+		}
+		sent += len;
+	}
+
+	response = _worker_read(worker, timeout, &length);
+	if(response == NULL) {
+		/* The worker is in an unknown state, so it is replaced by the
+		next request */
+		_worker_kill(worker);
+		return NULL;
+	}
+	pkgbuild = _decode(response, length);
+	free(response);
+	return pkgbuild;
+}
+
+pkgbuild_pool_t *pkgbuild_pool_new(size_t workers, unsigned int timeout)
+{
+	pkgbuild_pool_t *pool;
+
+	if(workers == 0) {
+		return NULL;
+	}
+	pool = malloc(sizeof(*pool));
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->available, NULL);
+	pool->workers = calloc(workers, sizeof(*pool->workers));
+	pool->worker_count = workers;
+	pool->timeout = timeout;
+	return pkgbuild_pool_retain(pool);
+}
+
+pkgbuild_t *pkgbuild_pool_evaluate(pkgbuild_pool_t *pool, const char *path)
+{
+	pkgbuild_t *pkgbuild;
+	_worker_t *worker = NULL;
+	char *absolute;
+	size_t i;
+
+	if(pool == NULL || path == NULL) {
+		return NULL;
+	}
+	/* Workers change into the directory of the PKGBUILD */
+	absolute = realpath(path, NULL);
+	if(absolute == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	while(worker == NULL) {
+		for(i = 0; i < pool->worker_count && worker == NULL; i++) {
+			if(!pool->workers[i].busy) {
+				worker = &pool->workers[i];
+			}
+		}
+		if(worker == NULL) {
+			pthread_cond_wait(&pool->available, &pool->mutex);
+		}
+	}
+	worker->busy = 1;
+	pthread_mutex_unlock(&pool->mutex);
+
+	pkgbuild = _worker_evaluate(worker, absolute, pool->timeout);
+	free(absolute);
+
+	pthread_mutex_lock(&pool->mutex);
+	worker->busy = 0;
+	pthread_cond_signal(&pool->available);
+	pthread_mutex_unlock(&pool->mutex);
+	return pkgbuild;
+}
+
+pkgbuild_pool_t *pkgbuild_pool_retain(pkgbuild_pool_t *pool)
+{
+	if(pool != NULL) {
+		__sync_add_and_fetch(&pool->refcount, 1);
+	}
+	return pool;
+}
+
+static void _pool_free(pkgbuild_pool_t *pool)
+{
+	size_t i;
+
+	for(i = 0; i < pool->worker_count; i++) {
+		_worker_kill(&pool->workers[i]);
+	}
+	free(pool->workers);
+	pthread_cond_destroy(&pool->available);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+void pkgbuild_pool_release(pkgbuild_pool_t *pool)
+{
+	/* The count is atomic, so that a pool may be shared between threads,
+	such as those of a watch */
+	if(pool != NULL && __sync_sub_and_fetch(&pool->refcount, 1) == 0) {
+		_pool_free(pool);
+	}
+}
@@ -0,0 +1,175 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: pool_test.c
+Unit tests for the bash worker pool.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+
+/* Create a directory for the PKGBUILD of a test. */
+void create_pkgbuild_directory(void **state)
+{
+	char template[] = "/tmp/pkgparse_test.XXXXXX";
+	assert_true(mkdtemp(template) != NULL);
+	*state = strdup(template);
+}
+
+/* Remove the directory of a test, together with the files written to it. */
+void remove_pkgbuild_directory(void **state)
+{
+	struct dirent *entry;
+	char path[128];
+	DIR *dir;
+
+	dir = opendir(*state);
+	while(dir != NULL && (entry = readdir(dir)) != NULL) {
+		snprintf(path, sizeof(path), "%s/%s", (char *)*state, entry->d_name);
+		unlink(path);
+	}
+	closedir(dir);
+	rmdir(*state);
+	free(*state);
+}
+
+/* Write a file into the directory of a test, returning its path. */
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents)
+{
+	static char path[128];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	fp = fopen(path, "w");
+	assert_true(fp != NULL);
+	fputs(contents, fp);
+	fclose(fp);
+	return path;
+}
+
+void test_pool_evaluate(void **directory)
+{
+	pkgbuild_pool_t *pool;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t **splitpkgs;
+	char *path;
+
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=(foo bar)\n"
+		"pkgver=$(echo 1.2)\n"
+		"pkgrel=1\n"
+		"_dir=$(basename \"$PWD\")\n"
+		"source=(\"$_dir\")\n"
+		"echo noise\n"
+		"package_foo() {\n"
+		"	pkgdesc=\"Foo $pkgver\"\n"
+		"	depends=(baz \"qux quux\")\n"
+		"}\n"
+		"package_bar() {\n"
+		"	pkgdesc=bar\n"
+		"}\n");
+	pool = pkgbuild_pool_new(2, 0);
+	pkgbuild = pkgbuild_pool_evaluate(pool, path);
+	assert_true(pkgbuild != NULL);
+	assert_string_equal(pkgbuild_names(pkgbuild)[1], "bar");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.2");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0],
+		strrchr(*directory, '/') + 1);
+	splitpkgs = pkgbuild_splitpkgs(pkgbuild);
+	assert_string_equal(pkgbuild_desc(splitpkgs[0]), "Foo 1.2");
+	assert_string_equal(pkgbuild_depends(splitpkgs[0])[1], "qux quux");
+	assert_string_equal(pkgbuild_desc(splitpkgs[1]), "bar");
+	pkgbuild_release(pkgbuild);
+
+	/* Variables of one PKGBUILD do not leak into the next */
+	write_pkgbuild_file(*directory, "PKGBUILD", "pkgname=foo\n");
+	pkgbuild = pkgbuild_pool_evaluate(pool, path);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_true(pkgbuild_version(pkgbuild) == NULL);
+	assert_true(pkgbuild_sources(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+	pkgbuild_pool_release(pool);
+}
+
+void test_pool_timeout(void **directory)
+{
+	pkgbuild_pool_t *pool;
+	pkgbuild_t *pkgbuild;
+	char *path;
+
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"sleep 10\n"
+		"pkgname=foo\n");
+	pool = pkgbuild_pool_new(1, 200);
+	assert_true(pkgbuild_pool_evaluate(pool, path) == NULL);
+
+	/* The worker which timed out is replaced */
+	write_pkgbuild_file(*directory, "PKGBUILD", "pkgname=bar\n");
+	pkgbuild = pkgbuild_pool_evaluate(pool, path);
+	assert_true(pkgbuild != NULL);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	pkgbuild_release(pkgbuild);
+
+	write_pkgbuild_file(*directory, "PKGBUILD", "exit 1\n");
+	assert_true(pkgbuild_pool_evaluate(pool, path) == NULL);
+	pkgbuild_pool_release(pool);
+}
+
+void test_parse_file(void **directory)
+{
+	pkgbuild_pool_t *pool;
+	pkgbuild_t *pkgbuild;
+	char *path;
+
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=foo\n"
+		"pkgver=1\n");
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, NULL);
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_version(pkgbuild), "1");
+	pkgbuild_release(pkgbuild);
+
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=foo\n"
+		"pkgver=`echo 2`\n");
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, NULL);
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	pkgbuild_release(pkgbuild);
+
+	pool = pkgbuild_pool_new(1, 0);
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, pool);
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	pkgbuild_release(pkgbuild);
+	pkgbuild_pool_release(pool);
+}
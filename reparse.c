@@ -0,0 +1,337 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+#include "symbol.h"
+
+#include "pkgbuild_parse.h"
+
+void parse_index_free(parse_index_t *index)
+{
+	if(index != NULL) {
+		free(index->checkpoints);
+		free(index->functions);
+		free(index);
+	}
+}
+
+parse_index_t *parse_index_copy(parse_index_t *index)
+{
+	parse_index_t *copy;
+
+	if(index == NULL) {
+		return NULL;
+	}
+	copy = malloc(sizeof(*copy));
+	*copy = *index;
+	/* The arrays of an empty index may be NULL, which memcpy() must not be
+	given even for no bytes */
+	copy->checkpoints = NULL;
+	copy->functions = NULL;
+	if(index->checkpoint_count > 0) {
+		copy->checkpoints = malloc(index->checkpoint_count
+			* sizeof(*copy->checkpoints));
+		memcpy(copy->checkpoints, index->checkpoints,
+			index->checkpoint_count * sizeof(*copy->checkpoints));
+	}
+	if(index->function_count > 0) {
+		copy->functions = malloc(index->function_count
+			* sizeof(*copy->functions));
+		memcpy(copy->functions, index->functions,
+			index->function_count * sizeof(*copy->functions));
+	}
+	return copy;
+}
+
+void pkgbuild_set_index(pkgbuild_t *pkgbuild, parse_index_t *index)
+{
+	if(pkgbuild != NULL) {
+		parse_index_free(pkgbuild->index);
+		pkgbuild->index = index;
+	}
+}
+
+/* Parse a whole PKGBUILD from a buffer. */
+static pkgbuild_t *_parse(const char *buffer, size_t length, int options)
+{
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+
+	parser = pkgbuild_parser_new_with_options(options);
+	pkgbuild_parser_feed(parser, buffer, length);
+	pkgbuild = pkgbuild_parser_finish(parser);
+	pkgbuild_parser_release(parser);
+	return pkgbuild;
+}
+
+/*
+Determine whether a range of a PKGBUILD holds nothing but the definition of a
+function other than package() and package_*(), whose body is not parsed.
+
+Parameters:
+	buffer - The PKGBUILD.
+	offset - The offset of the range, at the start of a line.
+	end - The offset following the range, at the end of a line.
+*/
+static int _is_function(const char *buffer, size_t offset, size_t end)
+{
+	lexer_t lexer;
+	token_t token;
+	char *input;
+	int state = 0;
+	int type;
+
+	if(end <= offset || buffer[end - 1] != '\n') {
+		return 0;
+	}
+	input = malloc(end - offset + 2);
+	memcpy(input, buffer + offset, end - offset);
+	input[end - offset] = '\0';
+	input[end - offset + 1] = '\0';
+	lexer_init(&lexer, input, end - offset);
+	lexer.skip_functions = 1;
+
+	/* The expected tokens are NAME ( ) FUNCTION_BODY, surrounded by blanks
+	and newlines */
+	while((type = lexer_next(&lexer, &token)) != 0 && state >= 0) {
+		if(type == NEWLINE || ((type == ' ' || type == '\t') && state == 3)) {
+			continue;
+		}
+		if(state == 0 && type == NAME) {
+			state = token.length >= 7 && strncmp(input + token.offset,
+				"package", 7) == 0 ? -1 : 1;
+		} else if((state == 1 && type == '(') || (state == 2 && type == ')')
+				|| (state == 3 && type == FUNCTION_BODY)) {
+			state++;
+		} else {
+			state = -1;
+		}
+	}
+	free(input);
+	return state == 4;
+}
+
+/*
+Reparse a PKGBUILD whose edit lies within the body of a function other than
+package() and package_*(), which is not parsed with
+kPkgbuildOptionSkipFunctions. The metadata is unchanged, so the pkgbuild is
+copied and only the layout of the copy is moved.
+
+Parameters:
+	pkgbuild - The pkgbuild of the PKGBUILD before it was edited. It is left
+		unchanged.
+	buffer - The edited PKGBUILD.
+	offset - The offset of the edit.
+	removed - The amount of bytes removed at the offset.
+	inserted - The amount of bytes inserted at the offset.
+
+Returns:
+	A new pkgbuild if the edit was handled, otherwise NULL.
+*/
+static pkgbuild_t *_reparse_function(pkgbuild_t *pkgbuild, const char *buffer,
+	size_t offset, size_t removed, size_t inserted)
+{
+	parse_index_t *index = pkgbuild->index;
+	function_range_t *function = NULL;
+	pkgbuild_t *result;
+	size_t i;
+
+	if(!(index->options & kPkgbuildOptionSkipFunctions)) {
+		return NULL;
+	}
+	for(i = 0; i < index->function_count; i++) {
+		if(index->functions[i].offset <= offset
+				&& offset + removed < index->functions[i].end) {
+			function = &index->functions[i];
+			break;
+		}
+	}
+	if(function == NULL || function->package
+			|| !_is_function(buffer, function->offset,
+				function->end - removed + inserted)) {
+		return NULL;
+	}
+
+	result = pkgbuild_copy(pkgbuild);
+	index = result->index;
+	for(i = 0; i < index->checkpoint_count; i++) {
+		if(index->checkpoints[i] > offset) {
+			index->checkpoints[i] = index->checkpoints[i] - removed + inserted;
+		}
+	}
+	for(i = 0; i < index->function_count; i++) {
+		if(index->functions[i].offset > offset) {
+			index->functions[i].offset = index->functions[i].offset - removed
+				+ inserted;
+		}
+		if(index->functions[i].end > offset) {
+			index->functions[i].end = index->functions[i].end - removed
+				+ inserted;
+		}
+	}
+	for(i = 0; i < result->derivation_count; i++) {
+		if(result->derivations[i].offset > offset) {
+			result->derivations[i].offset = result->derivations[i].offset
+				- removed + inserted;
+		}
+	}
+	index->length = index->length - removed + inserted;
+	return result;
+}
+
+/*
+Prepend the derivations and layout preceding a checkpoint to those of a
+pkgbuild parsed from the checkpoint on.
+
+Parameters:
+	pkgbuild - The pkgbuild parsed from the checkpoint on.
+	previous - The pkgbuild of the PKGBUILD before it was edited.
+	checkpoint - The offset of the checkpoint.
+	length - The length of the edited PKGBUILD.
+*/
+static void _merge_prefix(pkgbuild_t *pkgbuild, pkgbuild_t *previous,
+	size_t checkpoint, size_t length)
+{
+	parse_index_t *index = pkgbuild->index;
+	parse_index_t *prefix = previous->index;
+	derivation_t *derivations;
+	size_t *checkpoints;
+	function_range_t *functions;
+	size_t count;
+	size_t i;
+
+	index->length = length;
+	if(pkgbuild->derivations == NULL) {
+		return;
+	}
+
+	for(count = 0; count < previous->derivation_count
+			&& previous->derivations[count].offset < checkpoint; count++);
+	derivations = malloc((count + pkgbuild->derivation_count)
+		* sizeof(*derivations));
+	for(i = 0; i < count; i++) {
+		derivation_copy(&derivations[i], &previous->derivations[i]);
+	}
+	if(pkgbuild->derivation_count > 0) {
+		memcpy(derivations + count, pkgbuild->derivations,
+			pkgbuild->derivation_count * sizeof(*derivations));
+	}
+	count += pkgbuild->derivation_count;
+	free(pkgbuild->derivations);
+	pkgbuild->derivations = derivations;
+	pkgbuild->derivation_count = count;
+
+	for(count = 0; count < prefix->checkpoint_count
+			&& prefix->checkpoints[count] <= checkpoint; count++);
+	checkpoints = malloc((count + index->checkpoint_count)
+		* sizeof(*checkpoints));
+	/* Either part may be empty, with an array which is NULL */
+	if(count > 0) {
+		memcpy(checkpoints, prefix->checkpoints, count * sizeof(*checkpoints));
+	}
+	if(index->checkpoint_count > 0) {
+		memcpy(checkpoints + count, index->checkpoints,
+			index->checkpoint_count * sizeof(*checkpoints));
+	}
+	free(index->checkpoints);
+	index->checkpoints = checkpoints;
+	index->checkpoint_count += count;
+
+	for(count = 0; count < prefix->function_count
+			&& prefix->functions[count].end != 0
+			&& prefix->functions[count].end <= checkpoint; count++);
+	functions = malloc((count + index->function_count) * sizeof(*functions));
+	if(count > 0) {
+		memcpy(functions, prefix->functions, count * sizeof(*functions));
+	}
+	if(index->function_count > 0) {
+		memcpy(functions + count, index->functions,
+			index->function_count * sizeof(*functions));
+	}
+	free(index->functions);
+	index->functions = functions;
+	index->function_count += count;
+}
+
+pkgbuild_t *pkgbuild_reparse(pkgbuild_t *pkgbuild, const char *buffer,
+	size_t length, size_t offset, size_t removed, size_t inserted)
+{
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *result;
+	parse_index_t *index;
+	table_t *table;
+	size_t checkpoint = 0;
+	size_t count;
+	size_t i;
+
+	if(pkgbuild == NULL || buffer == NULL) {
+		return NULL;
+	}
+	index = pkgbuild->index;
+	if(index == NULL) {
+		return _parse(buffer, length, kPkgbuildOptionTrackDependencies
+			| kPkgbuildOptionSkipFunctions);
+	}
+	/* The layout is of no use if the edit does not match it */
+	if(pkgbuild->derivations == NULL || offset + removed > index->length
+			|| length != index->length - removed + inserted) {
+		return _parse(buffer, length, index->options);
+	}
+	result = _reparse_function(pkgbuild, buffer, offset, removed, inserted);
+	if(result != NULL) {
+		return result;
+	}
+
+	/* Parsing resumes at the last statement boundary preceding the edit, or
+	at the first package function, whose variables are not derived */
+	for(i = 0; i < index->checkpoint_count
+			&& index->checkpoints[i] <= offset; i++) {
+		checkpoint = index->checkpoints[i];
+	}
+	for(i = 0; i < index->function_count; i++) {
+		if(index->functions[i].package) {
+			if(index->functions[i].offset < checkpoint) {
+				checkpoint = index->functions[i].offset;
+			}
+			break;
+		}
+	}
+
+	for(count = 0; count < pkgbuild->derivation_count
+			&& pkgbuild->derivations[count].offset < checkpoint; count++);
+	table = derivations_replay(pkgbuild->derivations, count);
+	parser = pkgbuild_parser_new_with_options(index->options);
+	pkgbuild_parser_resume(parser, table, checkpoint);
+	pkgbuild_parser_feed(parser, buffer + checkpoint, length - checkpoint);
+	result = pkgbuild_parser_finish(parser);
+	pkgbuild_parser_release(parser);
+	table_release(table);
+
+	_merge_prefix(result, pkgbuild, checkpoint, length);
+	return result;
+}
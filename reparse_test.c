@@ -0,0 +1,239 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: reparse_test.c
+Unit tests for parsing edited PKGBUILDs incrementally.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pkgparse.h"
+
+static const char *_pkgbuild =
+	"pkgname=foo\n"
+	"pkgver=1.0\n"
+	"pkgrel=1\n"
+	"pkgdesc='A package'\n"
+	"url=\"https://example.org/$pkgname\"\n"
+	"source=(\"$url/$pkgname-$pkgver.tar.gz\")\n"
+	"\n"
+	"build() {\n"
+	"\tcd \"$pkgname-$pkgver\"\n"
+	"\tmake\n"
+	"}\n"
+	"\n"
+	"depends=('glibc' \"libfoo>=$pkgver\")\n"
+	"\n"
+	"package() {\n"
+	"\tpkgdesc='The foo package'\n"
+	"}\n";
+
+/* Parse a PKGBUILD from a string. */
+static pkgbuild_t *_parse(const char *contents, int options)
+{
+	pkgbuild_parser_t *parser;
+	pkgbuild_t *pkgbuild;
+
+	parser = pkgbuild_parser_new_with_options(options);
+	pkgbuild_parser_feed(parser, contents, strlen(contents));
+	pkgbuild = pkgbuild_parser_finish(parser);
+	pkgbuild_parser_release(parser);
+	return pkgbuild;
+}
+
+/*
+Replace the first occurrence of a string in a buffer, and reparse the pkgbuild
+of the buffer, which is then replaced by the result.
+*/
+static pkgbuild_t *_edit(pkgbuild_t *pkgbuild, char *buffer, const char *from,
+	const char *to)
+{
+	pkgbuild_t *result;
+	char *position;
+	size_t removed = strlen(from);
+	size_t inserted = strlen(to);
+
+	position = strstr(buffer, from);
+	assert_true(position != NULL);
+	memmove(position + inserted, position + removed,
+		strlen(position + removed) + 1);
+	memcpy(position, to, inserted);
+	result = pkgbuild_reparse(pkgbuild, buffer, strlen(buffer),
+		position - buffer, removed, inserted);
+	assert_true(result != NULL);
+	pkgbuild_release(pkgbuild);
+	return result;
+}
+
+/* Assert that a pkgbuild matches a full parse of the buffer. */
+static void _assert_parsed(pkgbuild_t *pkgbuild, const char *buffer,
+	int options)
+{
+	pkgbuild_t *expected;
+	char *actual_srcinfo;
+	char *expected_srcinfo;
+	size_t length;
+
+	expected = _parse(buffer, options);
+	length = pkgbuild_format_srcinfo(expected, NULL, 0);
+	expected_srcinfo = malloc(length + 1);
+	pkgbuild_format_srcinfo(expected, expected_srcinfo, length + 1);
+	length = pkgbuild_format_srcinfo(pkgbuild, NULL, 0);
+	actual_srcinfo = malloc(length + 1);
+	pkgbuild_format_srcinfo(pkgbuild, actual_srcinfo, length + 1);
+	assert_string_equal(actual_srcinfo, expected_srcinfo);
+	free(actual_srcinfo);
+	free(expected_srcinfo);
+	pkgbuild_release(expected);
+}
+
+void test_reparse_variables(void **state)
+{
+	int options = kPkgbuildOptionTrackDependencies
+		| kPkgbuildOptionSkipFunctions;
+	pkgbuild_t *pkgbuild;
+	char buffer[1024];
+
+	strcpy(buffer, _pkgbuild);
+	pkgbuild = _parse(buffer, options);
+
+	pkgbuild = _edit(pkgbuild, buffer, "pkgver=1.0", "pkgver=1.0.1");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.0.1");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0],
+		"https://example.org/foo/foo-1.0.1.tar.gz");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "libfoo>=1.0.1");
+	_assert_parsed(pkgbuild, buffer, options);
+
+	/* Edits following an edit are offset by it */
+	pkgbuild = _edit(pkgbuild, buffer, "'glibc'", "'glibc' 'zlib'");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "zlib");
+	_assert_parsed(pkgbuild, buffer, options);
+
+	pkgbuild = _edit(pkgbuild, buffer, "pkgname=foo", "pkgname=bar");
+	assert_string_equal(pkgbuild_url(pkgbuild), "https://example.org/bar");
+	_assert_parsed(pkgbuild, buffer, options);
+
+	pkgbuild = _edit(pkgbuild, buffer, "pkgrel=1\n", "");
+	assert_int_equal((int)pkgbuild_rel(pkgbuild), 0);
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_reparse_functions(void **state)
+{
+	int options = kPkgbuildOptionTrackDependencies
+		| kPkgbuildOptionSkipFunctions;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *previous;
+	char original[1024];
+	char buffer[1024];
+
+	strcpy(buffer, _pkgbuild);
+	pkgbuild = _parse(buffer, options);
+
+	/* The body of build() is not parsed, and the layout of the previous
+	pkgbuild is left alone */
+	previous = pkgbuild;
+	pkgbuild_retain(previous);
+	pkgbuild = _edit(pkgbuild, buffer, "\tmake\n", "\tmake -j4\n\tmake check\n");
+	assert_true(pkgbuild != previous);
+	_assert_parsed(pkgbuild, buffer, options);
+	strcpy(original, _pkgbuild);
+	previous = _edit(previous, original, "'glibc'", "'glibc' 'zlib'");
+	_assert_parsed(previous, original, options);
+	pkgbuild_release(previous);
+
+	/* The layout of the PKGBUILD is moved by the edit */
+	pkgbuild = _edit(pkgbuild, buffer, "'glibc'", "'glibc' 'zlib'");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[1], "zlib");
+	_assert_parsed(pkgbuild, buffer, options);
+
+	pkgbuild_release(pkgbuild);
+
+	/* Renaming a function to package_*() requires a parse */
+	strcpy(buffer, "pkgname=(foo bar)\npkgver=1.0\n"
+		"build() {\n\tpkgdesc='A package'\n}\n");
+	pkgbuild = _parse(buffer, options);
+	previous = pkgbuild;
+	pkgbuild_retain(previous);
+	pkgbuild = _edit(pkgbuild, buffer, "build()", "package_foo()");
+	assert_true(pkgbuild != previous);
+	pkgbuild_release(previous);
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+
+	/* An edit of package() parses from package() on */
+	strcpy(buffer, _pkgbuild);
+	pkgbuild = _parse(buffer, options);
+	pkgbuild = _edit(pkgbuild, buffer, "The foo", "The bar");
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild = _edit(pkgbuild, buffer, "pkgver=1.0", "pkgver=2.0");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2.0");
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_reparse_fallback(void **state)
+{
+	int options = kPkgbuildOptionTrackDependencies
+		| kPkgbuildOptionSkipFunctions;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *previous;
+	char buffer[1024];
+
+	/* Conditional assignments are not tracked */
+	strcpy(buffer, _pkgbuild);
+	strcat(buffer, "if [ \"$CARCH\" = x86_64 ]; then\n\tpkgrel=2\nfi\n");
+	pkgbuild = _parse(buffer, options);
+	pkgbuild = _edit(pkgbuild, buffer, "pkgver=1.0", "pkgver=1.1");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.1");
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+
+	/* Without tracking, the buffer is parsed again */
+	strcpy(buffer, _pkgbuild);
+	pkgbuild = _parse(buffer, kPkgbuildOptionSkipFunctions);
+	pkgbuild = _edit(pkgbuild, buffer, "pkgver=1.0", "pkgver=1.1");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.1");
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+
+	/* An edit which does not match the previous buffer */
+	strcpy(buffer, _pkgbuild);
+	pkgbuild = _parse(buffer, options);
+	assert_true(pkgbuild_reparse(pkgbuild, NULL, 0, 0, 0, 0) == NULL);
+	previous = pkgbuild;
+	strcpy(buffer, "pkgname=bar\npkgver=1.0\n");
+	pkgbuild = pkgbuild_reparse(previous, buffer, strlen(buffer), 0, 0, 4);
+	pkgbuild_release(previous);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	_assert_parsed(pkgbuild, buffer, options);
+	pkgbuild_release(pkgbuild);
+}
@@ -0,0 +1,694 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+#include "symbol.h"
+
+/* The amount of pkgbuild_field_t flags */
+#define kSrcinfoFieldCount 28
+
+/* Fields holding a single value, for which the last assignment wins */
+#define kSrcinfoStringFields (kPkgbuildFieldBasename | kPkgbuildFieldVersion \
+	| kPkgbuildFieldRel | kPkgbuildFieldDesc | kPkgbuildFieldUrl \
+	| kPkgbuildFieldInstall | kPkgbuildFieldEpoch)
+
+/* Keys of .SRCINFO files, indexed by the bit position of the pkgbuild_field_t
+ * flag of the field they assign. They are named after the variables of the
+ * PKGBUILD, see pkgbuild_field_lvalue(). */
+static const char *_keys[kSrcinfoFieldCount] = {
+	"pkgname", "pkgbase", "pkgver", "pkgrel", "pkgdesc", "url", "license",
+	"install", "source", "noextract", "md5sums", "sha1sums", "sha256sums",
+	"sha384sums", "sha512sums", "groups", "arch", "backup", "depends",
+	"makedepends", "optdepends", "conflicts", "provides", "replaces", "options",
+	NULL, /* splitpkgs */
+	"epoch", "checkdepends",
+};
+
+/* Offsets of the members of a pkgbuild holding each field, indexed by the bit
+ * position of its pkgbuild_field_t flag, or 0 for those which are not stored
+ * as a string or an array. */
+static const size_t _field_offsets[kSrcinfoFieldCount] = {
+	offsetof(struct _pkgbuild_t, names),
+	offsetof(struct _pkgbuild_t, basename),
+	offsetof(struct _pkgbuild_t, version),
+	0, /* rel */
+	offsetof(struct _pkgbuild_t, desc),
+	offsetof(struct _pkgbuild_t, url),
+	offsetof(struct _pkgbuild_t, licenses),
+	offsetof(struct _pkgbuild_t, install),
+	offsetof(struct _pkgbuild_t, sources),
+	offsetof(struct _pkgbuild_t, noextract),
+	offsetof(struct _pkgbuild_t, md5sums),
+	offsetof(struct _pkgbuild_t, sha1sums),
+	offsetof(struct _pkgbuild_t, sha256sums),
+	offsetof(struct _pkgbuild_t, sha384sums),
+	offsetof(struct _pkgbuild_t, sha512sums),
+	offsetof(struct _pkgbuild_t, groups),
+	offsetof(struct _pkgbuild_t, architectures),
+	offsetof(struct _pkgbuild_t, backup),
+	offsetof(struct _pkgbuild_t, depends),
+	offsetof(struct _pkgbuild_t, makedepends),
+	offsetof(struct _pkgbuild_t, optdepends),
+	offsetof(struct _pkgbuild_t, conflicts),
+	offsetof(struct _pkgbuild_t, provides),
+	offsetof(struct _pkgbuild_t, replaces),
+	offsetof(struct _pkgbuild_t, options),
+	0, /* splitpkgs */
+	offsetof(struct _pkgbuild_t, epoch),
+	offsetof(struct _pkgbuild_t, checkdepends),
+};
+
+/* Type: _section_t
+A pkgbase or pkgname section of a .SRCINFO.
+
+pkgbuild - The pkgbuild the keys of the section are stored in. The fields
+	it has loaded are those assigned within the section.
+lengths - The amount of elements of each array field.
+*/
+typedef struct {
+	pkgbuild_t *pkgbuild;
+	size_t lengths[kSrcinfoFieldCount];
+} _section_t;
+
+/* The member of a pkgbuild holding a string field. */
+#define STRING_MEMBER(pkgbuild, bit) \
+	((char **)((char *)(pkgbuild) + _field_offsets[bit]))
+/* The member of a pkgbuild holding an array field. */
+#define ARRAY_MEMBER(pkgbuild, bit) \
+	((char ***)((char *)(pkgbuild) + _field_offsets[bit]))
+
+static void _free_array(char **array)
+{
+	size_t i;
+	if(array != NULL) {
+		for(i = 0; array[i] != NULL; i++) {
+			free(array[i]);
+		}
+		free(array);
+	}
+}
+
+/*
+Find the field a key assigns.
+
+Parameters:
+	key - The NUL terminated key, such as "depends" or "source_x86_64".
+	length - The length of the key.
+	arch_specific - Set to true (1) if the key is the architecture specific
+		variant of the field, such as "source_x86_64".
+
+Returns:
+	The bit position of the field's pkgbuild_field_t flag, or -1 if the key
+	does not assign a field.
+*/
+static int _field_bit(const char *key, size_t length, int *arch_specific)
+{
+	const char *name;
+	size_t name_length;
+	int bit;
+
+	for(bit = 0; bit < kSrcinfoFieldCount; bit++) {
+		name = _keys[bit];
+		if(name == NULL || name[0] != key[0]) {
+			continue;
+		}
+		name_length = strlen(name);
+		if(length < name_length || memcmp(key, name, name_length) != 0) {
+			continue;
+		}
+		if(length == name_length) {
+			*arch_specific = 0;
+			return bit;
+		} else if(key[name_length] == '_'
+				&& ((1u << bit) & kPkgbuildFieldArchSpecific)) {
+			*arch_specific = 1;
+			return bit;
+		}
+	}
+	return -1;
+}
+
+/*
+Assign a value to a field of a section.
+
+Parameters:
+	section - The section being parsed.
+	bit - The bit position of the field's pkgbuild_field_t flag.
+	value - The value, which is copied. An empty value assigned to an array
+		only clears it, as makepkg writes arrays a split package empties.
+*/
+static void _assign(_section_t *section, int bit, const char *value)
+{
+	pkgbuild_t *pkgbuild = section->pkgbuild;
+	unsigned int field = 1u << bit;
+	char ***array;
+	char **string;
+	size_t *length;
+
+	pkgbuild->loaded |= field;
+	if(field == kPkgbuildFieldRel) {
+		pkgbuild->rel = atoi(value);
+		return;
+	} else if(field & kSrcinfoStringFields) {
+		string = STRING_MEMBER(pkgbuild, bit);
+		free(*string);
+		*string = strdup(value);
+		return;
+	}
+
+	array = ARRAY_MEMBER(pkgbuild, bit);
+	length = &section->lengths[bit];
+	if(*array == NULL) {
+		/* An array exists as soon as it is assigned, even if it is empty */
+		*array = calloc(1, sizeof(**array));
+	}
+	if(value[0] == '\0') {
+		return;
+	}
+	/* The capacity doubles whenever the length reaches a power of two less
+	one, leaving room for the terminating NULL */
+	if(((*length + 1) & *length) == 0) {
+		*array = realloc(*array, 2 * (*length + 1) * sizeof(**array));
+	}
+	(*array)[(*length)++] = strdup(value);
+	(*array)[*length] = NULL;
+}
+
+/*
+Append a value to an architecture specific variable, such as source_x86_64,
+for use by <pkgbuild_for_arch()>.
+
+Parameters:
+	pkgbuild - The pkgbuild being parsed.
+	key - The NUL terminated name of the variable.
+	value - The value, which is copied. An empty value only defines the
+		variable.
+*/
+static void _assign_arch(pkgbuild_t *pkgbuild, char *key, char *value)
+{
+	char *elements[2] = {NULL, NULL};
+	symbol_t *symbol;
+
+	if(pkgbuild->arch_variables == NULL) {
+		pkgbuild->arch_variables = table_new();
+	}
+	if(value[0] != '\0') {
+		elements[0] = value;
+	}
+	symbol = symbol_new(key);
+	symbol_set_array(symbol, elements);
+	table_append(pkgbuild->arch_variables, symbol);
+	symbol_release(symbol);
+}
+
+/*
+Move the fields assigned by the only pkgname section of a .SRCINFO into its
+pkgbase section, as they apply to the only package built.
+
+Parameters:
+	base - The pkgbase section.
+	section - The pkgname section, whose pkgbuild is released.
+*/
+static void _merge_section(_section_t *base, _section_t *section)
+{
+	pkgbuild_t *pkgbuild = base->pkgbuild;
+	pkgbuild_t *package = section->pkgbuild;
+	unsigned int field;
+	char **string;
+	char ***array;
+	int bit;
+
+	for(bit = 0; bit < kSrcinfoFieldCount; bit++) {
+		field = 1u << bit;
+		if(!(package->loaded & field)) {
+			continue;
+		}
+		if(field == kPkgbuildFieldRel) {
+			pkgbuild->rel = package->rel;
+		} else if(field & kSrcinfoStringFields) {
+			string = STRING_MEMBER(pkgbuild, bit);
+			free(*string);
+			*string = *STRING_MEMBER(package, bit);
+			*STRING_MEMBER(package, bit) = NULL;
+		} else {
+			array = ARRAY_MEMBER(pkgbuild, bit);
+			_free_array(*array);
+			*array = *ARRAY_MEMBER(package, bit);
+			*ARRAY_MEMBER(package, bit) = NULL;
+		}
+	}
+	if(package->arch_variables != NULL) {
+		if(pkgbuild->arch_variables == NULL) {
+			pkgbuild->arch_variables = table_new();
+		}
+		table_copy(pkgbuild->arch_variables, package->arch_variables, NULL);
+	}
+	pkgbuild_release(package);
+}
+
+/*
+Parse the contents of a .SRCINFO.
+
+Parameters:
+	data - The contents, terminated by an additional byte which may be
+		overwritten. Keys and values are terminated in place.
+	length - The length of the contents.
+
+Returns:
+	An initialized pkgbuild_t structure, or NULL if there is no pkgname
+	section.
+*/
+static pkgbuild_t *_parse(char *data, size_t length)
+{
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t **splitpkgs;
+	_section_t *sections;
+	_section_t *section;
+	size_t section_count = 1;
+	size_t section_size = 8;
+	size_t i;
+	char *end = data + length;
+	char *ptr;
+	char *eol;
+	char *next;
+	char *key_end;
+	char *value;
+	int arch_specific;
+	int bit;
+
+	sections = calloc(section_size, sizeof(*sections));
+	sections[0].pkgbuild = pkgbuild_new();
+	section = &sections[0];
+
+	for(ptr = data; ptr < end; ptr = next) {
+		eol = memchr(ptr, '\n', end - ptr);
+		if(eol == NULL) {
+			eol = end;
+		}
+		next = eol + 1;
+
+		while(ptr < eol && (*ptr == ' ' || *ptr == '\t')) {
+			ptr++;
+		}
+		while(eol > ptr && (eol[-1] == ' ' || eol[-1] == '\t'
+				|| eol[-1] == '\r')) {
+			eol--;
+		}
+		if(ptr == eol || *ptr == '#') {
+			continue;
+		}
+		key_end = memchr(ptr, '=', eol - ptr);
+		if(key_end == NULL) {
+			continue;
+		}
+		value = key_end + 1;
+		while(key_end > ptr && (key_end[-1] == ' ' || key_end[-1] == '\t')) {
+			key_end--;
+		}
+		while(value < eol && (*value == ' ' || *value == '\t')) {
+			value++;
+		}
+		*key_end = '\0';
+		*eol = '\0';
+
+		if(strcmp(ptr, "pkgname") == 0) {
+			_assign(&sections[0], 0, value);
+			if(section_count == section_size) {
+				section_size *= 2;
+				sections = realloc(sections, section_size * sizeof(*sections));
+			}
+			section = &sections[section_count++];
+			memset(section, 0, sizeof(*section));
+			section->pkgbuild = pkgbuild_new();
+			section->pkgbuild->split = 1;
+			continue;
+		} else if(strcmp(ptr, "pkgbase") == 0) {
+			section = &sections[0];
+		}
+
+		bit = _field_bit(ptr, key_end - ptr, &arch_specific);
+		if(bit < 0) {
+			continue;
+		} else if(arch_specific) {
+			_assign_arch(section->pkgbuild, ptr, value);
+		} else {
+			_assign(section, bit, value);
+		}
+	}
+
+	pkgbuild = sections[0].pkgbuild;
+	if(section_count == 1) {
+		pkgbuild_release(pkgbuild);
+		pkgbuild = NULL;
+	} else if(section_count == 2) {
+		_merge_section(&sections[0], &sections[1]);
+		pkgbuild_set_splitpkgs(pkgbuild, NULL);
+	} else {
+		splitpkgs = malloc(section_count * sizeof(*splitpkgs));
+		for(i = 1; i < section_count; i++) {
+			splitpkgs[i - 1] = sections[i].pkgbuild;
+		}
+		splitpkgs[section_count - 1] = NULL;
+		pkgbuild_set_splitpkgs(pkgbuild, splitpkgs);
+	}
+	if(pkgbuild != NULL) {
+		/* Fields missing from the .SRCINFO are not set by the PKGBUILD */
+		pkgbuild->loaded = kPkgbuildFieldAll;
+	}
+	free(sections);
+	return pkgbuild;
+}
+
+pkgbuild_t *pkgbuild_parse_srcinfo(FILE *fp)
+{
+	pkgbuild_t *pkgbuild;
+	char *data;
+	size_t length = 0;
+	size_t size = BUFSIZ;
+
+	if(fp == NULL) {
+		return NULL;
+	}
+	data = malloc(size);
+	while(!feof(fp) && !ferror(fp)) {
+		if(size - length < BUFSIZ) {
+			size *= 2;
+			data = realloc(data, size);
+		}
+		length += fread(data + length, 1, size - length - 1, fp);
+	}
+	pkgbuild = _parse(data, length);
+	free(data);
+	return pkgbuild;
+}
+
+/* Fields written to the pkgbase section, in the order of makepkg */
+static const unsigned int _base_fields[] = {
+	kPkgbuildFieldDesc, kPkgbuildFieldVersion, kPkgbuildFieldRel,
+	kPkgbuildFieldEpoch, kPkgbuildFieldUrl, kPkgbuildFieldInstall,
+	kPkgbuildFieldArchitectures, kPkgbuildFieldGroups, kPkgbuildFieldLicenses,
+	kPkgbuildFieldCheckdepends, kPkgbuildFieldMakedepends,
+	kPkgbuildFieldDepends, kPkgbuildFieldOptdepends, kPkgbuildFieldProvides,
+	kPkgbuildFieldConflicts, kPkgbuildFieldReplaces, kPkgbuildFieldNoextract,
+	kPkgbuildFieldOptions, kPkgbuildFieldBackup, kPkgbuildFieldSources,
+	kPkgbuildFieldMd5sums, kPkgbuildFieldSha1sums, kPkgbuildFieldSha256sums,
+	kPkgbuildFieldSha384sums, kPkgbuildFieldSha512sums,
+};
+
+/* Fields a package section may override, in the order of makepkg */
+static const unsigned int _package_fields[] = {
+	kPkgbuildFieldDesc, kPkgbuildFieldUrl, kPkgbuildFieldInstall,
+	kPkgbuildFieldArchitectures, kPkgbuildFieldGroups, kPkgbuildFieldLicenses,
+	kPkgbuildFieldDepends, kPkgbuildFieldOptdepends, kPkgbuildFieldProvides,
+	kPkgbuildFieldConflicts, kPkgbuildFieldReplaces, kPkgbuildFieldOptions,
+	kPkgbuildFieldBackup,
+};
+
+/* Architecture specific fields, in the order of makepkg */
+static const unsigned int _arch_fields[] = {
+	kPkgbuildFieldSources, kPkgbuildFieldProvides, kPkgbuildFieldConflicts,
+	kPkgbuildFieldDepends, kPkgbuildFieldReplaces, kPkgbuildFieldOptdepends,
+	kPkgbuildFieldMakedepends, kPkgbuildFieldCheckdepends,
+	kPkgbuildFieldMd5sums, kPkgbuildFieldSha1sums, kPkgbuildFieldSha256sums,
+	kPkgbuildFieldSha384sums, kPkgbuildFieldSha512sums,
+};
+
+/* Type: _output_t
+The buffer a .SRCINFO is formatted into. Output beyond its size is only
+counted, as with snprintf().
+
+buffer - The buffer, or NULL if size is 0.
+size - The size of the buffer.
+length - The length of the output so far.
+*/
+typedef struct {
+	char *buffer;
+	size_t size;
+	size_t length;
+} _output_t;
+
+/* Retrieve the bit position of a pkgbuild_field_t flag. */
+static int _field_index(unsigned int field)
+{
+	int bit = 0;
+	while(field > 1) {
+		field >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+/* Append a string of a given length to the output. */
+static void _put(_output_t *output, const char *str, size_t length)
+{
+	size_t available;
+
+	if(output->length + 1 < output->size) {
+		available = output->size - output->length - 1;
+		memcpy(output->buffer + output->length, str,
+			length < available ? length : available);
+	}
+	output->length += length;
+}
+
+/*
+Append a value to the output, with runs of whitespace replaced by a single
+space and leading and trailing whitespace removed, as makepkg does.
+*/
+static void _put_value(_output_t *output, const char *value)
+{
+	const char *ptr = value;
+	const char *start;
+	int words = 0;
+
+	for(;;) {
+		while(isspace((unsigned char)*ptr)) {
+			ptr++;
+		}
+		if(*ptr == '\0') {
+			break;
+		}
+		start = ptr;
+		while(*ptr != '\0' && !isspace((unsigned char)*ptr)) {
+			ptr++;
+		}
+		if(words++ > 0) {
+			_put(output, " ", 1);
+		}
+		_put(output, start, ptr - start);
+	}
+}
+
+/* Append a "\tkey = value" line to the output. */
+static void _put_line(_output_t *output, const char *key, size_t key_length,
+	const char *value)
+{
+	_put(output, "\t", 1);
+	_put(output, key, key_length);
+	_put(output, " = ", 3);
+	_put_value(output, value);
+	_put(output, "\n", 1);
+}
+
+/*
+Append the lines of an array. An empty array is written as a key without a
+value, which makepkg uses for arrays a split package empties.
+*/
+static void _put_array(_output_t *output, const char *key, size_t key_length,
+	char **array)
+{
+	size_t i;
+
+	if(array[0] == NULL) {
+		_put_line(output, key, key_length, "");
+	}
+	for(i = 0; array[i] != NULL; i++) {
+		_put_line(output, key, key_length, array[i]);
+	}
+}
+
+/*
+Append the fields of a pkgbuild which have a value.
+
+Parameters:
+	output - The output being formatted.
+	pkgbuild - The pkgbuild, whose fields have been loaded.
+	fields - The fields to be written, in order.
+	count - The amount of fields.
+*/
+static void _put_fields(_output_t *output, pkgbuild_t *pkgbuild,
+	const unsigned int *fields, size_t count)
+{
+	char rel[32];
+	const char *key;
+	char *string;
+	char **array;
+	size_t i;
+	int bit;
+
+	for(i = 0; i < count; i++) {
+		bit = _field_index(fields[i]);
+		key = _keys[bit];
+		if(fields[i] == kPkgbuildFieldRel) {
+			if(pkgbuild->rel != 0) {
+				snprintf(rel, sizeof(rel), "%g", pkgbuild->rel);
+				_put_line(output, key, strlen(key), rel);
+			}
+		} else if(fields[i] & kSrcinfoStringFields) {
+			string = *STRING_MEMBER(pkgbuild, bit);
+			if(string != NULL) {
+				_put_line(output, key, strlen(key), string);
+			}
+		} else {
+			array = *ARRAY_MEMBER(pkgbuild, bit);
+			if(array != NULL) {
+				_put_array(output, key, strlen(key), array);
+			}
+		}
+	}
+}
+
+/*
+Append the architecture specific variables of a pkgbuild, such as
+source_x86_64, for each of its architectures other than "any". A split
+package without architectures of its own has those of the pkgbase.
+*/
+static void _put_arch_fields(_output_t *output, pkgbuild_t *pkgbuild,
+	char **architectures)
+{
+	char name[64];
+	char *str_array[2] = {NULL, NULL};
+	char **array;
+	symbol_t *symbol;
+	size_t length;
+	size_t i;
+	size_t j;
+
+	if(pkgbuild->arch_variables == NULL || architectures == NULL) {
+		return;
+	}
+	for(i = 0; architectures[i] != NULL; i++) {
+		if(strcmp(architectures[i], "any") == 0) {
+			continue;
+		}
+		for(j = 0; j < sizeof(_arch_fields) / sizeof(*_arch_fields); j++) {
+			length = snprintf(name, sizeof(name), "%s_%s",
+				_keys[_field_index(_arch_fields[j])], architectures[i]);
+			if(length >= sizeof(name)) {
+				continue;
+			}
+			symbol = table_lookup(pkgbuild->arch_variables, name);
+			if(symbol == NULL) {
+				continue;
+			}
+			if(symbol_type(symbol) == kSymbolTypeArray) {
+				array = symbol_array(symbol);
+			} else {
+				str_array[0] = symbol_string(symbol);
+				array = str_array;
+			}
+			if(array != NULL && array[0] != NULL) {
+				_put_array(output, name, length, array);
+			}
+		}
+	}
+}
+
+size_t pkgbuild_format_srcinfo(pkgbuild_t *pkgbuild, char *buffer,
+	size_t size)
+{
+	_output_t output = {buffer, size, 0};
+	pkgbuild_t **splitpkgs;
+	const char *basename;
+	char **names;
+	size_t i;
+
+	if(pkgbuild == NULL) {
+		return 0;
+	}
+	pkgbuild_load_fields(pkgbuild, kPkgbuildFieldAll);
+	basename = pkgbuild_basename(pkgbuild);
+	names = pkgbuild->names;
+	splitpkgs = pkgbuild->splitpkgs;
+
+	if(basename != NULL) {
+		_put(&output, "pkgbase = ", 10);
+		_put(&output, basename, strlen(basename));
+		_put(&output, "\n", 1);
+	}
+	_put_fields(&output, pkgbuild, _base_fields,
+		sizeof(_base_fields) / sizeof(*_base_fields));
+	if(pkgbuild->base == NULL) {
+		_put_arch_fields(&output, pkgbuild, pkgbuild->architectures);
+	}
+	_put(&output, "\n", 1);
+
+	/* There is a split package for each name, or none at all */
+	for(i = 0; names != NULL && names[i] != NULL; i++) {
+		_put(&output, "pkgname = ", 10);
+		_put(&output, names[i], strlen(names[i]));
+		_put(&output, "\n", 1);
+		if(splitpkgs != NULL && splitpkgs[i] != NULL) {
+			pkgbuild_load_fields(splitpkgs[i], kPkgbuildFieldAll);
+			_put_fields(&output, splitpkgs[i], _package_fields,
+				sizeof(_package_fields) / sizeof(*_package_fields));
+			_put_arch_fields(&output, splitpkgs[i],
+				splitpkgs[i]->architectures != NULL
+				? splitpkgs[i]->architectures : pkgbuild->architectures);
+		}
+		_put(&output, "\n", 1);
+	}
+
+	if(size > 0) {
+		buffer[output.length < size ? output.length : size - 1] = '\0';
+	}
+	return output.length;
+}
+
+int pkgbuild_write_srcinfo(pkgbuild_t *pkgbuild, FILE *fp)
+{
+	char buffer[4096];
+	char *output = buffer;
+	size_t length;
+	int success;
+
+	if(pkgbuild == NULL || fp == NULL) {
+		return 0;
+	}
+	length = pkgbuild_format_srcinfo(pkgbuild, buffer, sizeof(buffer));
+	if(length >= sizeof(buffer)) {
+		output = malloc(length + 1);
+		pkgbuild_format_srcinfo(pkgbuild, output, length + 1);
+	}
+	success = fwrite(output, 1, length, fp) == length;
+	if(output != buffer) {
+		free(output);
+	}
+	return success;
+}
@@ -0,0 +1,269 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* File: srcinfo_test.c
+Unit tests for the .SRCINFO parser.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include "pkgparse.h"
+
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+
+void test_parse_srcinfo(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *view;
+	pkgbuild_t **splitpkgs;
+
+	fp = tmpfile();
+	fprintf(fp,
+		"# Generated by makepkg\n"
+		"pkgbase = foo\n"
+		"\tpkgdesc = Foo = bar\n"
+		"\tpkgver = 1.2\n"
+		"\tpkgrel = 3\n"
+		"\tepoch = 1\n"
+		"\tarch = i686\n"
+		"\tarch = x86_64\n"
+		"\tlicense = MIT\n"
+		"\tmakedepends = cmake\n"
+		"\tdepends = glibc\n"
+		"\tsource = foo.tar.gz\n"
+		"\tsource_x86_64 = foo64.patch\n"
+		"\tmd5sums = SKIP\n"
+		"\n"
+		"pkgname = foo\n"
+		"\tdepends = glibc\n"
+		"\tdepends = zlib\n"
+		"\n"
+		"pkgname = foo-docs\n"
+		"\tpkgdesc = Documentation\n"
+		"\tarch = any\n"
+		"\tdepends = \n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_srcinfo(fp);
+	fclose(fp);
+
+	assert_true(pkgbuild != NULL);
+	assert_string_equal(pkgbuild_basename(pkgbuild), "foo");
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "foo");
+	assert_string_equal(pkgbuild_names(pkgbuild)[1], "foo-docs");
+	assert_true(pkgbuild_names(pkgbuild)[2] == NULL);
+	assert_string_equal(pkgbuild_desc(pkgbuild), "Foo = bar");
+	assert_string_equal(pkgbuild_version(pkgbuild), "1.2");
+	assert_true(pkgbuild_rel(pkgbuild) == 3);
+	assert_string_equal(pkgbuild_architectures(pkgbuild)[1], "x86_64");
+	assert_string_equal(pkgbuild_sources(pkgbuild)[0], "foo.tar.gz");
+	assert_true(pkgbuild_sources(pkgbuild)[1] == NULL);
+	assert_true(pkgbuild_url(pkgbuild) == NULL);
+
+	splitpkgs = pkgbuild_splitpkgs(pkgbuild);
+	assert_true(splitpkgs != NULL);
+	assert_string_equal(pkgbuild_depends(splitpkgs[0])[1], "zlib");
+	assert_true(pkgbuild_desc(splitpkgs[0]) == NULL);
+	assert_string_equal(pkgbuild_desc(splitpkgs[1]), "Documentation");
+	assert_string_equal(pkgbuild_architectures(splitpkgs[1])[0], "any");
+	/* An empty value clears the array for the package */
+	assert_true(pkgbuild_depends(splitpkgs[1]) != NULL);
+	assert_true(pkgbuild_depends(splitpkgs[1])[0] == NULL);
+	assert_true(splitpkgs[2] == NULL);
+
+	view = pkgbuild_for_arch(pkgbuild, "x86_64");
+	assert_string_equal(pkgbuild_sources(view)[1], "foo64.patch");
+	pkgbuild_release(view);
+	pkgbuild_release(pkgbuild);
+}
+
+void test_parse_srcinfo_single(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+
+	/* The only package overrides the fields of the base */
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgbase = bar\r\n"
+		"\tpkgdesc = Base\r\n"
+		"\tpkgver = 2\r\n"
+		"\tdepends = glibc\r\n"
+		"\r\n"
+		"pkgname = bar\r\n"
+		"\tpkgdesc = Package\r\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse_srcinfo(fp);
+	fclose(fp);
+
+	assert_true(pkgbuild != NULL);
+	assert_string_equal(pkgbuild_names(pkgbuild)[0], "bar");
+	assert_string_equal(pkgbuild_desc(pkgbuild), "Package");
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	assert_string_equal(pkgbuild_depends(pkgbuild)[0], "glibc");
+	assert_true(pkgbuild_splitpkgs(pkgbuild) == NULL);
+	pkgbuild_release(pkgbuild);
+
+	/* Without a package, it is not a .SRCINFO */
+	fp = tmpfile();
+	fprintf(fp, "pkgbase = bar\n\tpkgver = 2\n");
+	fseek(fp, 0, SEEK_SET);
+	assert_true(pkgbuild_parse_srcinfo(fp) == NULL);
+	fclose(fp);
+}
+
+void test_parse_file_srcinfo(void **directory)
+{
+	pkgbuild_t *pkgbuild;
+	struct utimbuf times;
+	char *path;
+
+	write_pkgbuild_file(*directory, ".SRCINFO",
+		"pkgbase = foo\n"
+		"\tpkgver = 2\n"
+		"\n"
+		"pkgname = foo\n");
+	path = write_pkgbuild_file(*directory, "PKGBUILD",
+		"pkgname=foo\n"
+		"pkgver=$(date +%Y)\n");
+
+	/* The .SRCINFO is preferred */
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, NULL);
+	assert_false(pkgbuild_unsupported(pkgbuild));
+	assert_string_equal(pkgbuild_version(pkgbuild), "2");
+	pkgbuild_release(pkgbuild);
+
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionIgnoreSrcinfo, NULL);
+	assert_true(pkgbuild_unsupported(pkgbuild));
+	pkgbuild_release(pkgbuild);
+
+	/* A .SRCINFO older than the PKGBUILD may be out of date */
+	times.actime = 0;
+	times.modtime = 0;
+	path = write_pkgbuild_file(*directory, ".SRCINFO",
+		"pkgbase = foo\n"
+		"\tpkgver = 2\n"
+		"\n"
+		"pkgname = foo\n");
+	assert_int_equal(utime(path, &times), 0);
+	path = write_pkgbuild_file(*directory, "PKGBUILD", "pkgname=foo\npkgver=3\n");
+	pkgbuild = pkgbuild_parse_file(path, kPkgbuildOptionNone, NULL);
+	assert_string_equal(pkgbuild_version(pkgbuild), "3");
+	pkgbuild_release(pkgbuild);
+}
+
+void test_write_srcinfo(void **state)
+{
+	FILE *fp;
+	pkgbuild_t *pkgbuild;
+	pkgbuild_t *parsed;
+	char buffer[1024];
+	char small[16];
+	size_t length;
+	const char *expected =
+		"pkgbase = foo\n"
+		"\tpkgdesc = A foo package\n"
+		"\tpkgver = 1.2\n"
+		"\tpkgrel = 3\n"
+		"\tepoch = 1\n"
+		"\tarch = i686\n"
+		"\tarch = x86_64\n"
+		"\tlicense = MIT\n"
+		"\tcheckdepends = python\n"
+		"\tmakedepends = cmake\n"
+		"\tdepends = glibc\n"
+		"\tsource = foo.tar.gz\n"
+		"\tmd5sums = SKIP\n"
+		"\tsource_x86_64 = foo64.patch\n"
+		"\n"
+		"pkgname = foo\n"
+		"\tdepends = glibc\n"
+		"\tdepends = zlib\n"
+		"\tdepends_x86_64 = libx\n"
+		"\n"
+		"pkgname = foo-docs\n"
+		"\tpkgdesc = Documentation\n"
+		"\tarch = any\n"
+		"\tdepends = \n"
+		"\n";
+
+	fp = tmpfile();
+	fprintf(fp,
+		"pkgbase=foo\n"
+		"pkgname=(foo foo-docs)\n"
+		"pkgver=1.2\n"
+		"pkgrel=3\n"
+		"epoch=1\n"
+		"pkgdesc=\" A  foo\tpackage \"\n"
+		"arch=(i686 x86_64)\n"
+		"license=(MIT)\n"
+		"makedepends=(cmake)\n"
+		"checkdepends=(python)\n"
+		"depends=(glibc)\n"
+		"source=(foo.tar.gz)\n"
+		"source_x86_64=(foo64.patch)\n"
+		"md5sums=(SKIP)\n"
+		"package_foo() {\n"
+		"    depends=(glibc zlib)\n"
+		"    depends_x86_64=(libx)\n"
+		"}\n"
+		"package_foo-docs() {\n"
+		"    pkgdesc=\"Documentation\"\n"
+		"    arch=(any)\n"
+		"    depends=()\n"
+		"}\n");
+	fseek(fp, 0, SEEK_SET);
+	pkgbuild = pkgbuild_parse(fp);
+	fclose(fp);
+
+	length = pkgbuild_format_srcinfo(pkgbuild, buffer, sizeof(buffer));
+	assert_int_equal(length, strlen(expected));
+	assert_string_equal(buffer, expected);
+
+	/* Truncated output reports the length required */
+	assert_int_equal(pkgbuild_format_srcinfo(pkgbuild, small, sizeof(small)),
+		length);
+	assert_string_equal(small, "pkgbase = foo\n\t");
+
+	/* The .SRCINFO parser reads it back */
+	fp = tmpfile();
+	assert_true(pkgbuild_write_srcinfo(pkgbuild, fp));
+	fseek(fp, 0, SEEK_SET);
+	parsed = pkgbuild_parse_srcinfo(fp);
+	fclose(fp);
+	assert_int_equal(pkgbuild_format_srcinfo(parsed, buffer, sizeof(buffer)),
+		length);
+	assert_string_equal(buffer, expected);
+	assert_string_equal(pkgbuild_epoch(parsed), "1");
+	assert_string_equal(pkgbuild_checkdepends(parsed)[0], "python");
+	pkgbuild_release(parsed);
+	pkgbuild_release(pkgbuild);
+}
@@ -24,6 +24,7 @@
 
 #include "symbol.h"
 #include "symbol_private.h"
+#include "utility.h"
 
 static void _table_free(table_t *table)
 {
@@ -32,9 +33,20 @@ static void _table_free(table_t *table)
 		if(table->symbols[i] != NULL) {
 			symbol_release(table->symbols[i]);
 		}
+		arena_free(table->arena, table->expansions[i]);
 	}
 	table_release(table->parent);
-	free(table);
+	arena_free(table->arena, table);
+}
+
+static table_t *_table_new(table_t *parent, arena_t *arena)
+{
+	table_t *table;
+	table = arena_alloc(arena, sizeof(*table));
+	table = memset(table, 0, sizeof(*table));
+	table->parent = table_retain(parent);
+	table->arena = arena;
+	return table_retain(table);
 }
 
 table_t *table_new()
@@ -44,49 +56,81 @@ table_t *table_new()
 
 table_t *table_new_with_parent(table_t *parent)
 {
-	table_t *table;
-	table = malloc(sizeof(*table));
-	table = memset(table, 0, sizeof(*table));
-	table->parent = table_retain(parent);
-	return table_retain(table);
+	return _table_new(parent, parent != NULL ? parent->arena : NULL);
+}
+
+table_t *table_new_with_arena(arena_t *arena)
+{
+	return _table_new(NULL, arena);
+}
+
+table_t *table_snapshot(table_t *table)
+{
+	table_t *snapshot;
+	table_t *parent;
+	int i;
+
+	if(table == NULL) {
+		return NULL;
+	}
+
+	parent = table_snapshot(table->parent);
+	snapshot = _table_new(parent, table->arena);
+	table_release(parent);
+	for(i = 0; i < TABLE_SIZE; i++) {
+		snapshot->symbols[i] = symbol_retain(table->symbols[i]);
+	}
+	return snapshot;
 }
 
 table_t *table_retain(table_t *table)
 {
+	/* The count is atomic, since tables of helper scripts are shared by the
+	parsers of several threads */
 	if(table != NULL) {
-		table->refcount++;
+		__sync_add_and_fetch(&table->refcount, 1);
 	}
 	return table;
 }
 
 void table_release(table_t *table)
 {
-	if(table != NULL) {
-		table->refcount--;
-		if(table->refcount == 0) {
-			_table_free(table);
-		}
+	if(table != NULL && __sync_sub_and_fetch(&table->refcount, 1) == 0) {
+		_table_free(table);
 	}
 }
 
-static symbol_t *_table_lookup(table_t *table, char *lvalue, int recurse)
+/* Locate the slot holding a symbol named lvalue. The table the symbol was
+ * found in is stored in owner, which is only searched recursively if recurse
+ * is true. Returns the index of the slot, or -1 if not found. */
+static int _table_find(table_t *table, char *lvalue, int recurse,
+		table_t **owner)
 {
-	symbol_t *symbol = NULL;
-	int found = 0;
+	symbol_t *symbol;
 	int i;
-	for(i = 0; i < TABLE_SIZE && found == 0; i++) {
+	for(i = 0; i < TABLE_SIZE; i++) {
 		symbol = table->symbols[i];
 		if(symbol != NULL && strcmp(symbol->lvalue, lvalue) == 0) {
-			found = 1;
+			*owner = table;
+			return i;
 		}
 	}
 
 	/* Lookup in parent, if symbol not found */
-	if(recurse && !found && table_parent(table) != NULL) {
-		symbol = _table_lookup(table_parent(table), lvalue, recurse);
+	if(recurse && table_parent(table) != NULL) {
+		return _table_find(table_parent(table), lvalue, recurse, owner);
 	}
 
-	return symbol;
+	*owner = NULL;
+	return -1;
+}
+
+static symbol_t *_table_lookup(table_t *table, char *lvalue, int recurse)
+{
+	table_t *owner;
+	int slot;
+	slot = _table_find(table, lvalue, recurse, &owner);
+	return slot < 0 ? NULL : owner->symbols[slot];
 }
 
 symbol_t *table_lookup(table_t *table, char *lvalue)
@@ -99,9 +143,36 @@ symbol_t *table_lookupr(table_t *table, char *lvalue)
 	return _table_lookup(table, lvalue, 1);
 }
 
+symbol_t *table_lookupr_cached(table_t *table, char *lvalue, char ***expansion)
+{
+	table_t *owner;
+	int slot;
+	slot = _table_find(table, lvalue, 1, &owner);
+	if(slot < 0) {
+		*expansion = NULL;
+		return NULL;
+	}
+	*expansion = &owner->expansions[slot];
+	return owner->symbols[slot];
+}
+
 int table_insert(table_t *table, symbol_t *symbol)
 {
+	table_t *owner;
+	int slot;
 	int i;
+
+	/* Reassignment replaces the symbol and invalidates its expansion */
+	slot = _table_find(table, symbol->lvalue, 0, &owner);
+	if(slot >= 0) {
+		symbol_retain(symbol);
+		symbol_release(table->symbols[slot]);
+		table->symbols[slot] = symbol;
+		arena_free(table->arena, table->expansions[slot]);
+		table->expansions[slot] = NULL;
+		return 1;
+	}
+
 	for(i = 0; i < TABLE_SIZE; i++) {
 		if(table->symbols[i] == NULL) {
 			table->symbols[i] = symbol_retain(symbol);
@@ -111,6 +182,148 @@ int table_insert(table_t *table, symbol_t *symbol)
 	return 0;
 }
 
+/* Make room for count more elements in an array symbol. */
+static void _symbol_reserve(symbol_t *symbol, size_t count)
+{
+	size_t capacity;
+
+	if(symbol->rvalue.array == NULL) {
+		symbol->length = 0;
+		symbol->capacity = 0;
+	} else if(symbol->capacity == 0) {
+		for(symbol->length = 0; symbol->rvalue.array[symbol->length] != NULL;
+			symbol->length++);
+		symbol->capacity = symbol->length + 1;
+	}
+	if(symbol->length + count + 1 > symbol->capacity) {
+		capacity = symbol->capacity > 4 ? symbol->capacity : 4;
+		while(capacity < symbol->length + count + 1) {
+			capacity *= 2;
+		}
+		symbol->rvalue.array = arena_realloc(symbol->arena,
+			symbol->rvalue.array, symbol->capacity * sizeof(char *),
+			capacity * sizeof(char *));
+		symbol->capacity = capacity;
+	}
+}
+
+/* Concatenate a string to another, allocated within an arena. */
+static char *_strcat(arena_t *arena, char *string, char *suffix)
+{
+	size_t length = string != NULL ? strlen(string) : 0;
+	size_t suffix_length = strlen(suffix);
+
+	string = arena_realloc(arena, string, length + (string != NULL),
+		length + suffix_length + 1);
+	memcpy(string + length, suffix, suffix_length + 1);
+	return string;
+}
+
+/* Copy the value of a string or array symbol. */
+static void _symbol_copy_value(symbol_t *symbol, symbol_t *source)
+{
+	if(source->type == kSymbolTypeArray) {
+		symbol_set_array(symbol, symbol_array(source));
+	} else if(symbol_string(source) != NULL) {
+		symbol_set_string(symbol, symbol_string(source));
+	} else {
+		symbol->type = kSymbolTypeString;
+	}
+}
+
+/* Append the value of suffix to that of symbol, see table_append(). */
+static void _symbol_append(symbol_t *symbol, symbol_t *suffix)
+{
+	char **array;
+	char *string;
+	size_t count;
+
+	/* Deferred values are expanded first */
+	if(suffix->type == kSymbolTypeArray) {
+		array = symbol_array(suffix);
+		if(symbol->type == kSymbolTypeString) {
+			string = symbol_string(symbol);
+			symbol->rvalue.strval = NULL;
+			symbol->type = kSymbolTypeArray;
+			_symbol_reserve(symbol, 1);
+			if(string != NULL) {
+				symbol->rvalue.array[symbol->length++] = string;
+			}
+		} else {
+			symbol_array(symbol);
+		}
+		for(count = 0; array != NULL && array[count] != NULL; count++);
+		_symbol_reserve(symbol, count);
+		for(count = 0; array != NULL && array[count] != NULL; count++) {
+			symbol->rvalue.array[symbol->length++] =
+				arena_strdup(symbol->arena, array[count]);
+		}
+		symbol->rvalue.array[symbol->length] = NULL;
+	} else if(symbol_string(suffix) != NULL) {
+		if(symbol->type == kSymbolTypeString) {
+			symbol_string(symbol);
+			symbol->rvalue.strval = _strcat(symbol->arena,
+				symbol->rvalue.strval, symbol_string(suffix));
+		} else if(symbol_array(symbol) != NULL && symbol->rvalue.array[0] != NULL) {
+			symbol->rvalue.array[0] = _strcat(symbol->arena,
+				symbol->rvalue.array[0], symbol_string(suffix));
+		} else {
+			_symbol_reserve(symbol, 1);
+			symbol->rvalue.array[symbol->length++] =
+				arena_strdup(symbol->arena, symbol_string(suffix));
+			symbol->rvalue.array[symbol->length] = NULL;
+		}
+	}
+}
+
+int table_append(table_t *table, symbol_t *symbol)
+{
+	table_t *owner;
+	symbol_t *target;
+	int slot;
+
+	slot = _table_find(table, symbol->lvalue, 1, &owner);
+	if(slot < 0 || owner->symbols[slot]->type == kSymbolTypeFunction) {
+		return table_insert(table, symbol);
+	}
+
+	target = owner->symbols[slot];
+	if(owner != table || target->refcount > 1) {
+		/* Copy on write, as the symbol is visible elsewhere */
+		target = symbol_new_with_arena(target->lvalue, table->arena);
+		_symbol_copy_value(target, owner->symbols[slot]);
+		table_insert(table, target);
+		symbol_release(target);
+		slot = _table_find(table, symbol->lvalue, 0, &owner);
+	}
+
+	_symbol_append(target, symbol);
+	arena_free(table->arena, table->expansions[slot]);
+	table->expansions[slot] = NULL;
+	return 1;
+}
+
+int table_copy(table_t *table, table_t *source, char *lvalue)
+{
+	symbol_t *symbol;
+	int copied = 0;
+	int i;
+
+	for(i = 0; i < TABLE_SIZE; i++) {
+		if(source->symbols[i] == NULL
+				|| source->symbols[i]->type == kSymbolTypeFunction
+				|| (lvalue != NULL && strcmp(source->symbols[i]->lvalue, lvalue) != 0)) {
+			continue;
+		}
+		symbol = symbol_new_with_arena(source->symbols[i]->lvalue, table->arena);
+		_symbol_copy_value(symbol, source->symbols[i]);
+		table_insert(table, symbol);
+		symbol_release(symbol);
+		copied = 1;
+	}
+	return copied;
+}
+
 int table_remove(table_t *table, char *lvalue)
 {
 	int i;
@@ -119,6 +332,8 @@ int table_remove(table_t *table, char *lvalue)
 			if(strcmp(table->symbols[i]->lvalue, lvalue) == 0) {
 				symbol_release(table->symbols[i]);
 				table->symbols[i] = NULL;
+				arena_free(table->arena, table->expansions[i]);
+				table->expansions[i] = NULL;
 				return 1;
 			}
 		}
@@ -126,6 +341,46 @@ int table_remove(table_t *table, char *lvalue)
 	return 0;
 }
 
+void table_clear(table_t *table)
+{
+	int i;
+	for(i = 0; i < TABLE_SIZE; i++) {
+		symbol_release(table->symbols[i]);
+		table->symbols[i] = NULL;
+		arena_free(table->arena, table->expansions[i]);
+		table->expansions[i] = NULL;
+	}
+}
+
+void table_include(table_t *table, table_t *include)
+{
+	int i;
+
+	if(table == NULL || include == NULL) {
+		return;
+	}
+	if(table->parent != NULL) {
+		table_copy(table, include, NULL);
+		return;
+	}
+	/* Variables assigned before the inclusion are overridden by it */
+	for(i = 0; i < TABLE_SIZE; i++) {
+		if(include->symbols[i] != NULL) {
+			table_remove(table, include->symbols[i]->lvalue);
+		}
+	}
+	table_set_parent(table, include);
+}
+
+void table_set_parent(table_t *table, table_t *parent)
+{
+	if(table != NULL) {
+		table_retain(parent);
+		table_release(table->parent);
+		table->parent = parent;
+	}
+}
+
 table_t *table_parent(table_t *table)
 {
 	table_t *parent = NULL;
@@ -135,33 +390,78 @@ table_t *table_parent(table_t *table)
 	return parent;
 }
 
-static void _symbol_free(symbol_t *symbol)
+/* Deallocate the value of a symbol, whatever its type, including any deferred
+ * rvalue. */
+static void _symbol_free_value(symbol_t *symbol)
 {
 	char **ptr = NULL;
-	free(symbol->lvalue);
 	switch(symbol->type) {
 		case kSymbolTypeString:
-			free(symbol->rvalue.strval);
+			arena_free(symbol->arena, symbol->rvalue.strval);
 			break;
 		case kSymbolTypeArray:
-			for(ptr = symbol->rvalue.array; *ptr != NULL; ptr++) {
-				free(*ptr);
+			if(symbol->rvalue.array != NULL && symbol->arena == NULL) {
+				for(ptr = symbol->rvalue.array; *ptr != NULL; ptr++) {
+					free(*ptr);
+				}
+				ptr = NULL;
+				free(symbol->rvalue.array);
 			}
-			ptr = NULL;
-			free(symbol->rvalue.array);
+			break;
+		case kSymbolTypeFunction:
+			table_release(symbol->rvalue.function);
 			break;
 		default:
 			break;
 	}
-	free(symbol);
+	memset(&symbol->rvalue, 0, sizeof(symbol->rvalue));
+	symbol->length = 0;
+	symbol->capacity = 0;
+	arena_free(symbol->arena, symbol->raw);
+	symbol->raw = NULL;
+	table_release(symbol->scope);
+	symbol->scope = NULL;
+}
+
+/* Expand the deferred rvalue of a symbol, if any, in its captured scope. */
+static void _symbol_expand(symbol_t *symbol)
+{
+	if(symbol->raw == NULL) {
+		return;
+	}
+
+	if(symbol->type == kSymbolTypeArray) {
+		symbol->rvalue.array = sh_parse_array_with_arena(symbol->scope,
+			symbol->raw, symbol->arena);
+	} else {
+		symbol->rvalue.strval = sh_parse_word_with_arena(symbol->scope,
+			symbol->raw, symbol->arena);
+	}
+	arena_free(symbol->arena, symbol->raw);
+	symbol->raw = NULL;
+	table_release(symbol->scope);
+	symbol->scope = NULL;
+}
+
+static void _symbol_free(symbol_t *symbol)
+{
+	arena_free(symbol->arena, symbol->lvalue);
+	_symbol_free_value(symbol);
+	arena_free(symbol->arena, symbol);
 }
 
 symbol_t *symbol_new(char *lvalue)
+{
+	return symbol_new_with_arena(lvalue, NULL);
+}
+
+symbol_t *symbol_new_with_arena(char *lvalue, arena_t *arena)
 {
 	symbol_t *symbol;
-	symbol = malloc(sizeof(*symbol));
+	symbol = arena_alloc(arena, sizeof(*symbol));
 	symbol = memset(symbol, 0, sizeof(*symbol));
-	symbol->lvalue = strdup(lvalue);
+	symbol->lvalue = arena_strdup(arena, lvalue);
+	symbol->arena = arena;
 	return symbol_retain(symbol);
 }
 
@@ -186,9 +486,9 @@ void symbol_release(symbol_t *symbol)
 void symbol_set_string(symbol_t *symbol, char *rvalue)
 {
 	if(symbol != NULL) {
+		_symbol_free_value(symbol);
 		symbol->type = kSymbolTypeString;
-		free(symbol->rvalue.strval);
-		symbol->rvalue.strval = strdup(rvalue);
+		symbol->rvalue.strval = arena_strdup(symbol->arena, rvalue);
 	}
 }
 
@@ -197,28 +497,41 @@ void symbol_set_array(symbol_t *symbol, char **rvalue)
 	char **ptr;
 	int i;
 	if(symbol != NULL) {
+		_symbol_free_value(symbol);
 		symbol->type = kSymbolTypeArray;
 		if(rvalue == NULL) {
 			symbol->rvalue.array = NULL;
 		} else {
 			/* Count elements */
 			for(i = 0; rvalue[i] != NULL; i++);
-			ptr = malloc((i + 1) * sizeof(*ptr));
+			ptr = arena_alloc(symbol->arena, (i + 1) * sizeof(*ptr));
 			ptr[i] = NULL;
 			for(i = 0; rvalue[i] != NULL; i++) {
-				ptr[i] = strdup(rvalue[i]);
+				ptr[i] = arena_strdup(symbol->arena, rvalue[i]);
 			}
 			symbol->rvalue.array = ptr;
 		}
 	}
 }
 
+void symbol_set_deferred(symbol_t *symbol, symbol_type_t type, char *rvalue,
+	table_t *scope)
+{
+	if(symbol != NULL) {
+		_symbol_free_value(symbol);
+		symbol->type = type;
+		symbol->raw = arena_strdup(symbol->arena, rvalue);
+		symbol->scope = table_snapshot(scope);
+	}
+}
+
 void symbol_set_function(symbol_t *symbol, table_t *rvalue)
 {
 	if(symbol != NULL) {
+		table_retain(rvalue);
+		_symbol_free_value(symbol);
 		symbol->type = kSymbolTypeFunction;
-		table_release(symbol->rvalue.function);
-		symbol->rvalue.function = table_retain(rvalue);
+		symbol->rvalue.function = rvalue;
 	}
 }
 
@@ -236,6 +549,7 @@ char *symbol_string(symbol_t *symbol)
 {
 	char *string = NULL;
 	if(symbol != NULL && symbol->type == kSymbolTypeString) {
+		_symbol_expand(symbol);
 		string = symbol->rvalue.strval;
 	}
 	return string;
@@ -245,6 +559,7 @@ char **symbol_array(symbol_t *symbol)
 {
 	char **array = NULL;
 	if(symbol != NULL && symbol->type == kSymbolTypeArray) {
+		_symbol_expand(symbol);
 		array = symbol->rvalue.array;
 	}
 	return array;
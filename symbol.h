@@ -27,6 +27,8 @@ A collection of functions and data structures related to symbols and symbol
 lookup tables.
 */
 
+#include "arena.h"
+
 /* Enumeration: symbol_type_t
 An enumeration indicating the type of a symbol.
 
@@ -75,6 +77,24 @@ Returns:
 */
 symbol_t *symbol_new(char *lvalue);
 
+/* Constructor: symbol_new_with_arena
+Initialize and return a new symbol, as with <symbol_new()>, whose name and
+values are allocated within an arena instead. Releasing the symbol then
+deallocates nothing, as the memory is reclaimed when the arena is reset.
+
+This is used to avoid allocations while parsing, for symbols which do not
+outlive the parse.
+
+Parameters:
+	lvalue - A string representing the name of the symbol.
+	arena - The arena to allocate within, or NULL to behave as
+		<symbol_new()>. It must not be reset while the symbol is in use.
+
+Returns:
+	An initialized symbol with the specified lvalue, or NULL on error.
+*/
+symbol_t *symbol_new_with_arena(char *lvalue, arena_t *arena);
+
 /* Function: symbol_retain
 Increment the symbol's reference count. This should be used whenever you want
 to prevent it from being deallocated without your express permission.
@@ -139,6 +159,26 @@ Parameters:
 */
 void symbol_set_array(symbol_t *symbol, char **rvalue);
 
+/* Function: symbol_set_deferred
+Assign an unexpanded shell value to the symbol. Expansion is deferred until
+the value is first retrieved with <symbol_string()> or <symbol_array()>, at
+which point the symbol holds the expanded value.
+
+Parameters:
+	symbol - A reference to the symbol being modified.
+	type - Either <kSymbolTypeString> or <kSymbolTypeArray>.
+	rvalue - The shell string to be expanded, such as "$pkgname-$pkgver" or
+		"(foo $bar)".
+	scope - The table variables are substituted from, or NULL if rvalue
+		contains no substitutions. A snapshot is taken, so later changes to
+		the table do not affect the value.
+
+See Also:
+	<sh_parse_word()>, <sh_parse_array()>, <table_snapshot()>
+*/
+void symbol_set_deferred(symbol_t *symbol, symbol_type_t type, char *rvalue,
+	table_t *scope);
+
 /* Function: symbol_set_function
 Assign a namespace to the symbol. The symbol type is changed to
 <kSymbolTypeFunction> implicitely, to reflect the new value type.
@@ -228,6 +268,9 @@ Initialize and return a new table with the specified table as the parent.
 This is the designated constructor. The created table should be released with
 <table_release()>.
 
+The table is allocated within the arena of the parent, if any, see
+<table_new_with_arena()>.
+
 Parameters:
 	parent - A parent table. This is used when searching recursively.
 
@@ -239,6 +282,38 @@ See Also:
 */
 table_t *table_new_with_parent(table_t *parent);
 
+/* Constructor: table_new_with_arena
+Initialize and return a new table allocated within an arena. Tables created
+with it as their parent, its snapshots, and the values it caches for
+<sh_parse_word()>, are allocated within the same arena. Symbols inserted into
+it should be created with <symbol_new_with_arena()>.
+
+Parameters:
+	arena - The arena to allocate within, or NULL to behave as
+		<table_new()>. It must not be reset while the table is in use.
+
+Returns:
+	An initialized table, or NULL on error.
+
+See Also:
+	<table_clear()>
+*/
+table_t *table_new_with_arena(arena_t *arena);
+
+/* Function: table_snapshot
+Create a copy of the table, and recursively of its parents, sharing the
+contained symbols. Symbols inserted into or removed from the original
+afterwards are not reflected in the snapshot.
+
+Parameters:
+	table - A reference to the table to be copied.
+
+Returns:
+	An initialized table, or NULL if table is NULL. The created table should be
+	released with <table_release()>.
+*/
+table_t *table_snapshot(table_t *table);
+
 /* Function: table_retain
 Increment the tables's reference count. This should be used whenever you want
 to prevent it from being deallocated without your express permission.
@@ -330,7 +405,8 @@ symbol_t *table_lookupr(table_t *table, char *lvalue);
 /* Function: table_insert
 Insert a symbol into the table. The symbol will be retained until it is
 either removed with <table_remove()>, or the table is deallocated with
-<table_release()>.
+<table_release()>. A symbol of the same name already in the table is replaced,
+as is the case when a shell variable is reassigned.
 
 Parameters:
 	table - A reference to the table being modified.
@@ -341,6 +417,45 @@ Returns:
 */
 int table_insert(table_t *table, symbol_t *symbol);
 
+/* Function: table_append
+Append the value of a symbol to the variable of the same name, as is the case
+with "name+=value". Strings are concatenated, and arrays extended. A string
+appended to an array is concatenated to its first element, while an array
+appended to a string makes it an array.
+
+The variable is searched for recursively. If it is found in a parent table,
+or is retained elsewhere, such as by a snapshot, a copy holding the result is
+inserted into the table, leaving the original untouched. Otherwise it is
+modified in place, and arrays grow geometrically, so that repeatedly
+appending to an array takes linear time. If the variable is not found, the
+symbol is inserted as with <table_insert()>.
+
+Parameters:
+	table - A reference to the table being modified.
+	symbol - A string or array symbol holding the value to be appended.
+
+Returns:
+	True (1) on success or false (0) on error.
+*/
+int table_append(table_t *table, symbol_t *symbol);
+
+/* Function: table_copy
+Copy variables from one table into another. Functions, and variables of
+parent tables, are not copied. Deferred values are expanded, so that the
+copies do not depend on the source table.
+
+Parameters:
+	table - A reference to the table being modified. The copies are allocated
+		within its arena.
+	source - The table to copy from.
+	lvalue - The name of the variable to be copied, or NULL to copy all of
+		them.
+
+Returns:
+	True (1) if any variable was copied, otherwise false (0).
+*/
+int table_copy(table_t *table, table_t *source, char *lvalue);
+
 /* Function: table_remove
 Remove a symbol from the table.
 
@@ -353,6 +468,39 @@ Returns:
 */
 int table_remove(table_t *table, char *lvalue);
 
+/* Function: table_clear
+Remove all symbols from the table, so that it can be reused.
+
+Parameters:
+	table - A reference to the table to be cleared.
+*/
+void table_clear(table_t *table);
+
+/* Function: table_include
+Make the variables of another table visible within a table, as if they had
+been assigned at this point, such as when a PKGBUILD sources a helper
+script. A table without a parent takes the included table as its parent,
+which is shared rather than copied, and its own variables of the same names
+are removed. Otherwise the variables are copied, as with <table_copy()>.
+
+The included table must not be modified afterwards, since it may be the
+parent of any amount of tables.
+
+Parameters:
+	table - A reference to the table being modified.
+	include - The table holding the variables to be included.
+*/
+void table_include(table_t *table, table_t *include);
+
+/* Function: table_set_parent
+Replace the parent namespace of the table.
+
+Parameters:
+	table - A reference to the table being modified.
+	parent - The new parent, which is retained, or NULL.
+*/
+void table_set_parent(table_t *table, table_t *parent);
+
 /* Function: table_parent
 Retrieve the parent namespace of the table.
 
@@ -41,8 +41,16 @@ struct _table_t {
 	unsigned int refcount;
 	/* TODO: Use a more appropriate data structure, such as a hash table. */
 	symbol_t *symbols[TABLE_SIZE];
+	/* Expanded values of the symbols, indexed in parallel with symbols. An
+	entry is computed on first use and discarded when the slot is
+	reassigned. */
+	char *expansions[TABLE_SIZE];
 	/* Reference to a parent "namespace" */
 	table_t *parent;
+	/* The arena the table is allocated within, or NULL. It is shared by the
+	parent, so that values cached by any table of a chain are allocated
+	within it. */
+	arena_t *arena;
 };
 
 struct _symbol_t {
@@ -56,6 +64,38 @@ struct _symbol_t {
 		char **array; /* NULL terminated */
 		table_t *function;
 	} rvalue;
+	/* The amount of elements in the array, and the amount it has room for,
+	including the terminating NULL. Both are 0 until the array is first
+	appended to. */
+	size_t length;
+	size_t capacity;
+	/* The unexpanded rvalue of a deferred symbol, or NULL once expanded */
+	char *raw;
+	/* A snapshot of the scope the raw rvalue is to be expanded in */
+	table_t *scope;
+	/* The arena the name and values are allocated within, or NULL */
+	arena_t *arena;
 };
 
+/* Function: table_lookupr_cached
+Search recursively for a symbol, as with <table_lookupr()>, and retrieve the
+expansion cache entry of the table the symbol was found in.
+
+The entry initially holds NULL. The caller may store a dynamically allocated
+string representing the expanded value of the symbol in it, which is then
+owned by the table. The entry is invalidated when the symbol is reassigned
+with <table_insert()> or removed with <table_remove()>.
+
+Parameters:
+	table - A reference to the table being searched.
+	lvalue - A string representing the name of the symbol to be found.
+	expansion - The address where the location of the cache entry should be
+		stored. It is set to NULL if the symbol is not found.
+
+Returns:
+	A symbol whose name is lvalue, or NULL if such a symbol is not
+	found.
+*/
+symbol_t *table_lookupr_cached(table_t *table, char *lvalue, char ***expansion);
+
 #endif
\ No newline at end of file
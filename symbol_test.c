@@ -28,6 +28,7 @@ See Also:
 
 #include "cmockery.h"
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "symbol.h"
 #include "symbol_private.h"
@@ -171,3 +172,149 @@ void test_table_lookup_recursive(void **state)
 	assert_string_equal(symbol_string(symbol), "eggs");
 	symbol_release(symbol);
 }
+
+void test_table_insert_reassign(void **state)
+{
+	table_t *table;
+	symbol_t *symbol;
+	table = table_new();
+
+	symbol = symbol_new("foo");
+	symbol_set_string(symbol, "bar");
+	table_insert(table, symbol);
+	symbol_release(symbol);
+
+	symbol = symbol_new("foo");
+	symbol_set_string(symbol, "baz");
+	table_insert(table, symbol);
+	symbol_release(symbol);
+
+	symbol = table_lookup(table, "foo");
+	assert_true(symbol != NULL);
+	assert_string_equal(symbol_string(symbol), "baz");
+	assert_true(table_remove(table, "foo"));
+	assert_true(table_lookup(table, "foo") == NULL);
+
+	table_release(table);
+}
+
+void test_symbol_deferred(void **state)
+{
+	table_t *table;
+	symbol_t *symbol;
+	symbol_t *deferred;
+	table = table_new();
+
+	symbol = symbol_new("foo");
+	symbol_set_string(symbol, "bar");
+	table_insert(table, symbol);
+	symbol_release(symbol);
+
+	deferred = symbol_new("ham");
+	symbol_set_deferred(deferred, kSymbolTypeArray, "(\"$foo\" eggs)", table);
+
+	/* Reassignment must not be visible to the deferred value */
+	symbol = symbol_new("foo");
+	symbol_set_string(symbol, "baz");
+	table_insert(table, symbol);
+	symbol_release(symbol);
+	table_release(table);
+
+	assert_true(symbol_string(deferred) == NULL);
+	assert_string_equal(symbol_array(deferred)[0], "bar");
+	assert_string_equal(symbol_array(deferred)[1], "eggs");
+	symbol_release(deferred);
+}
+
+void test_table_arena(void **state)
+{
+	arena_t *arena;
+	table_t *table;
+	table_t *function;
+	symbol_t *symbol;
+
+	arena = arena_new();
+	table = table_new_with_arena(arena);
+	function = table_new_with_parent(table);
+	assert_true(function->arena == arena);
+
+	symbol = symbol_new_with_arena("foo", arena);
+	symbol_set_array(symbol, (char *[]){"bar", "baz", NULL});
+	table_insert(table, symbol);
+	symbol_release(symbol);
+
+	symbol = symbol_new_with_arena("ham", arena);
+	symbol_set_deferred(symbol, kSymbolTypeString, "$foo eggs", function);
+	table_insert(function, symbol);
+	symbol_release(symbol);
+
+	assert_string_equal(symbol_string(table_lookup(function, "ham")),
+		"bar baz eggs");
+	assert_string_equal(symbol_array(table_lookupr(function, "foo"))[1], "baz");
+
+	table_clear(table);
+	assert_true(table_lookup(table, "foo") == NULL);
+	table_release(function);
+	table_release(table);
+	arena_release(arena);
+}
+
+void test_table_append(void **state)
+{
+	table_t *table;
+	table_t *function;
+	symbol_t *symbol;
+	char **array;
+	char name[8];
+	int i;
+
+	table = table_new();
+	function = table_new_with_parent(table);
+
+	symbol = symbol_new("foo");
+	symbol_set_array(symbol, (char *[]){"bar", NULL});
+	table_insert(table, symbol);
+	symbol_release(symbol);
+	symbol = symbol_new("foo");
+	symbol_set_array(symbol, (char *[]){"baz", NULL});
+	table_append(function, symbol);
+	symbol_release(symbol);
+	symbol = symbol_new("foo");
+	symbol_set_string(symbol, "ham");
+	table_append(function, symbol);
+	symbol_release(symbol);
+
+	/* The parent is left untouched */
+	array = symbol_array(table_lookup(table, "foo"));
+	assert_string_equal(array[0], "bar");
+	assert_true(array[1] == NULL);
+	array = symbol_array(table_lookup(function, "foo"));
+	assert_string_equal(array[0], "barham");
+	assert_string_equal(array[1], "baz");
+	assert_true(array[2] == NULL);
+
+	for(i = 0; i < 200; i++) {
+		snprintf(name, sizeof(name), "%d", i);
+		symbol = symbol_new("foo");
+		symbol_set_array(symbol, (char *[]){name, NULL});
+		table_append(table, symbol);
+		symbol_release(symbol);
+	}
+	array = symbol_array(table_lookup(table, "foo"));
+	assert_string_equal(array[0], "bar");
+	assert_string_equal(array[200], "199");
+	assert_true(array[201] == NULL);
+
+	symbol = symbol_new("eggs");
+	symbol_set_string(symbol, "spam");
+	table_append(table, symbol);
+	symbol_release(symbol);
+	symbol = symbol_new("eggs");
+	symbol_set_string(symbol, "spam");
+	table_append(table, symbol);
+	symbol_release(symbol);
+	assert_string_equal(symbol_string(table_lookup(table, "eggs")), "spamspam");
+
+	table_release(function);
+	table_release(table);
+}
@@ -21,9 +21,24 @@
 
 #include "cmockery.h"
 
+void test_arena_alloc(void **state);
+void test_arena_realloc(void **state);
+void test_arena_reset(void **state);
 void test_unquote_simple_string(void **state);
 void test_unquote_subsequenctly_quoted(void **state);
 void test_split_array(void **state);
+void test_lexer_assignment(void **state);
+void test_lexer_function(void **state);
+void test_lexer_skip_function(void **state);
+void test_lexer_partial(void **state);
+void test_lexer_array(void **state);
+void test_lexer_test(void **state);
+void test_lexer_case(void **state);
+void test_lexer_source(void **state);
+void test_lexer_command(void **state);
+#ifdef PKGPARSE_FLEX_SCANNER
+void test_lexer_flex(void **state);
+#endif
 void test_symbol_new_retain_release(void **state);
 void test_symbol_name(void **state);
 void test_symbol_string(void **symbol);
@@ -31,11 +46,63 @@ void test_symbol_array(void **symbol);
 void test_table_new_retain_release(void **state);
 void test_table_insert_lookup_remove(void **state);
 void test_table_lookup_recursive(void **state);
+void test_table_insert_reassign(void **state);
+void test_symbol_deferred(void **state);
+void test_table_arena(void **state);
+void test_table_append(void **state);
 void test_sh_parse_array_simple_expanded(void **table);
+void test_sh_parse_word_array_reassigned(void **table);
+void test_sh_parse_word_parameter_expansion(void **table);
+void test_sh_parse_word_array_index(void **table);
+void test_sh_references(void **state);
+void test_condition_test(void **table);
+void test_condition_test_unknown(void **table);
+void test_condition_test_arch(void **table);
+void test_condition_case(void **table);
+void test_condition_match(void **state);
 void test_parse_pkgbuild_minimal(void **state);
 void test_parse_pkgbuild_arrays(void **state);
 void test_parse_pkgbuild_simple(void **state);
 void test_parse_pkgbuild_splitpkg(void **state);
+void test_parse_pkgbuild_lazy(void **state);
+void test_parse_pkgbuild_skip_functions(void **state);
+void test_parse_pkgbuild_fields(void **state);
+void test_parse_pkgbuild_chunked(void **state);
+void test_parse_pkgbuild_multiline_array(void **state);
+void test_parse_pkgbuild_append(void **state);
+void test_parse_pkgbuild_for_arch(void **state);
+void test_parse_pkgbuild_case(void **state);
+void test_parse_pkgbuild_commands(void **state);
+void test_parse_pkgbuild_source(void **directory);
+void create_pkgbuild_directory(void **state);
+void remove_pkgbuild_directory(void **state);
+char *write_pkgbuild_file(char *directory, const char *name,
+	const char *contents);
+void test_pool_evaluate(void **directory);
+void test_pool_timeout(void **directory);
+void test_parse_file(void **directory);
+void test_parse_srcinfo(void **state);
+void test_parse_srcinfo_single(void **state);
+void test_parse_file_srcinfo(void **directory);
+void test_write_srcinfo(void **state);
+void test_hash_digests(void **state);
+void test_hash_incremental(void **state);
+void test_verify_sources(void **directory);
+void test_pkgbuild_dependencies(void **state);
+void test_pkgbuild_set_variable(void **state);
+void test_edit_pkgbuild(void **directory);
+void test_edit_conditional(void **directory);
+void test_edit_batch(void **directory);
+void test_reparse_variables(void **state);
+void test_reparse_functions(void **state);
+void test_reparse_fallback(void **state);
+#ifdef PKGPARSE_INOTIFY
+void test_watch_tree(void **directory);
+#endif
+void test_cache_get_put(void **state);
+void test_cache_concurrent(void **state);
+void test_parse_files(void **directory);
+void test_parse_files_srcinfo(void **directory);
 
 void create_symbol(void **symbol);
 void release_symbol(void **symbol);
@@ -45,9 +112,24 @@ void release_table(void **symbol);
 int main()
 {
 	const UnitTest tests[] = {
+		unit_test(test_arena_alloc),
+		unit_test(test_arena_realloc),
+		unit_test(test_arena_reset),
 		unit_test(test_unquote_simple_string),
 		unit_test(test_unquote_subsequenctly_quoted),
 		unit_test(test_split_array),
+		unit_test(test_lexer_assignment),
+		unit_test(test_lexer_function),
+		unit_test(test_lexer_skip_function),
+		unit_test(test_lexer_partial),
+		unit_test(test_lexer_array),
+		unit_test(test_lexer_test),
+		unit_test(test_lexer_case),
+		unit_test(test_lexer_source),
+		unit_test(test_lexer_command),
+#ifdef PKGPARSE_FLEX_SCANNER
+		unit_test(test_lexer_flex),
+#endif
 		unit_test(test_symbol_new_retain_release),
 		unit_test(test_symbol_name),
 		unit_test_setup_teardown(test_symbol_string, create_symbol,
@@ -57,12 +139,79 @@ int main()
 		unit_test(test_table_new_retain_release),
 		unit_test(test_table_insert_lookup_remove),
 		unit_test(test_table_lookup_recursive),
+		unit_test(test_table_insert_reassign),
+		unit_test(test_symbol_deferred),
+		unit_test(test_table_arena),
+		unit_test(test_table_append),
 		unit_test_setup_teardown(test_sh_parse_array_simple_expanded,
 			create_table, release_table),
+		unit_test_setup_teardown(test_sh_parse_word_array_reassigned,
+			create_table, release_table),
+		unit_test_setup_teardown(test_sh_parse_word_parameter_expansion,
+			create_table, release_table),
+		unit_test_setup_teardown(test_sh_parse_word_array_index,
+			create_table, release_table),
+		unit_test(test_sh_references),
+		unit_test_setup_teardown(test_condition_test, create_table,
+			release_table),
+		unit_test_setup_teardown(test_condition_test_unknown, create_table,
+			release_table),
+		unit_test_setup_teardown(test_condition_test_arch, create_table,
+			release_table),
+		unit_test_setup_teardown(test_condition_case, create_table,
+			release_table),
+		unit_test(test_condition_match),
 		unit_test(test_parse_pkgbuild_minimal),
 		unit_test(test_parse_pkgbuild_arrays),
 		unit_test(test_parse_pkgbuild_simple),
 		unit_test(test_parse_pkgbuild_splitpkg),
+		unit_test(test_parse_pkgbuild_lazy),
+		unit_test(test_parse_pkgbuild_skip_functions),
+		unit_test(test_parse_pkgbuild_fields),
+		unit_test(test_parse_pkgbuild_chunked),
+		unit_test(test_parse_pkgbuild_multiline_array),
+		unit_test(test_parse_pkgbuild_append),
+		unit_test(test_parse_pkgbuild_for_arch),
+		unit_test(test_parse_pkgbuild_case),
+		unit_test(test_parse_pkgbuild_commands),
+		unit_test_setup_teardown(test_parse_pkgbuild_source,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_pool_evaluate, create_pkgbuild_directory,
+			remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_pool_timeout, create_pkgbuild_directory,
+			remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_parse_file, create_pkgbuild_directory,
+			remove_pkgbuild_directory),
+		unit_test(test_parse_srcinfo),
+		unit_test(test_parse_srcinfo_single),
+		unit_test_setup_teardown(test_parse_file_srcinfo,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test(test_write_srcinfo),
+		unit_test(test_hash_digests),
+		unit_test(test_hash_incremental),
+		unit_test_setup_teardown(test_verify_sources,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test(test_pkgbuild_dependencies),
+		unit_test(test_pkgbuild_set_variable),
+		unit_test_setup_teardown(test_edit_pkgbuild,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_edit_conditional,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_edit_batch,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test(test_reparse_variables),
+		unit_test(test_reparse_functions),
+		unit_test(test_reparse_fallback),
+#ifdef PKGPARSE_INOTIFY
+		unit_test_setup_teardown(test_watch_tree,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+#endif
+		unit_test(test_cache_get_put),
+		unit_test(test_cache_concurrent),
+		unit_test_setup_teardown(test_parse_files,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
+		unit_test_setup_teardown(test_parse_files_srcinfo,
+			create_pkgbuild_directory, remove_pkgbuild_directory),
 	};
 	return run_tests(tests);
 }
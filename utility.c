@@ -19,25 +19,30 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fnmatch.h>
 
 #include "utility.h"
+#include "symbol_private.h"
 
 /* Function: _strcpy_partial
 Copy a substring, from start to end.
 
 Parameters:
+	arena - The arena to allocate within, or NULL.
 	string - The string to be copied.
 	start - A marker indicating the beginning of the substring.
 	end - A marker indicating the end of a substring.
 
 Returns:
 	A copy of the string between start and end. The returned string should be
-	deallocated by the caller.
+	deallocated by the caller, using <arena_free()>.
 */
-static char *_strcpy_partial(char *string, char *start, char *end);
+static char *_strcpy_partial(arena_t *arena, char *string, char *start,
+	char *end);
 
 /* Function: _find_next_substitution
 Locate the next word substitution within a string.
@@ -72,41 +77,44 @@ Substitute variables with their values
 Parameters:
 	table - A symbol table containing the values of variables
 	string - The string to be parsed.
+	arena - The arena to allocate within, or NULL.
 
 Returns:
 	A string with substituted words, or NULL on error. The returned string
-	should be deallocated by the caller.
+	should be deallocated by the caller, using <arena_free()>.
 
 See Also:
 	<sh_parse_word()>
 */
-static char *_substitute_words(table_t *table, char *string);
+static char *_substitute_words(table_t *table, char *string, arena_t *arena);
 
 /* Function: _array_cat
 Concatenate an array of strings to a single string.
 
 Parameters:
+	arena - The arena to allocate within, or NULL.
 	array - An array of strings.
 
 Returns:
 	A string consisting of all elements in array, delimited by a space, or NULL
 	on error, or if array is empty. The returned string should be deallocated by
-	the caller.
+	the caller, using <arena_free()>.
 */
-static char *_array_cat(char **array);
+static char *_array_cat(arena_t *arena, char **array);
 
-static char *_strcpy_partial(char *string, char *start, char *end)
+static char *_strcpy_partial(arena_t *arena, char *string, char *start,
+	char *end)
 {
 	char *result;
 	size_t len = end - start + 1;
 
-	result = malloc((len + 1) * sizeof(*result));
+	result = arena_alloc(arena, (len + 1) * sizeof(*result));
 	result = strncpy(result, string, len);
 	result[len] = '\0';
 	return result;
 }
 
-static char *_array_cat(char **array)
+static char *_array_cat(arena_t *arena, char **array)
 {
 	char *result = NULL;
 	size_t size = 0;
@@ -120,8 +128,8 @@ static char *_array_cat(char **array)
 		size += strlen(array[i]);
 	}
 	size += i - 1; /* spaces between elements */
-	result = malloc(sizeof(*result) * (size + 1));
-	result[size] = '\0';
+	result = arena_alloc(arena, sizeof(*result) * (size + 1));
+	result[0] = '\0';
 
 	for(i = 0; array[i] != NULL; i++) {
 		result = strncat(result, array[i], size);
@@ -145,7 +153,7 @@ static size_t _array_size(const char *array)
 		str_ptr++;
 	}
 
-	end_of_array = *array == ')' || *array == '\0';
+	end_of_array = *str_ptr == ')' || *str_ptr == '\0';
 
 	while(!end_of_array) {
 		switch(*str_ptr) {
@@ -182,7 +190,8 @@ static size_t _array_size(const char *array)
 	return count;
 }
 
-char **sh_split_array(char *string)
+/* Split a shell array, as with sh_split_array(), allocating within arena. */
+static char **_split_array(arena_t *arena, char *string)
 {
 	size_t count_elem;
 	int in_quote = 0;
@@ -195,11 +204,11 @@ char **sh_split_array(char *string)
 	int end_of_array;
 
 	/* Copy string as we will be mutating it */
-	str_cpy = strdup(string);
+	str_cpy = arena_strdup(arena, string);
 
 	count_elem = _array_size(str_cpy);
 
-	array = malloc((count_elem + 1) * sizeof(*array));
+	array = arena_alloc(arena, (count_elem + 1) * sizeof(*array));
 	array[count_elem] = NULL;
 	elem = 0;
 
@@ -226,8 +235,8 @@ char **sh_split_array(char *string)
 				if(!in_quote && *(str_ptr - 1) != '\\') {
 					*str_ptr = '\0';
 					/* Skip multiple spaces */
-					if(strlen(start_ptr) != 1 && !isspace(*start_ptr)) {
-						array[elem] = strdup(start_ptr);
+					if(*start_ptr != '\0') {
+						array[elem] = arena_strdup(arena, start_ptr);
 						elem++;
 					}
 					start_ptr = str_ptr + 1;
@@ -236,7 +245,10 @@ char **sh_split_array(char *string)
 			case ')':
 				if(!in_quote && *(str_ptr - 1) != '\\') {
 					*str_ptr = '\0';
-					array[elem] = strdup(start_ptr);
+					if(*start_ptr != '\0') {
+						array[elem] = arena_strdup(arena, start_ptr);
+						elem++;
+					}
 					end_of_array = 1;
 				}
 				break;
@@ -248,15 +260,23 @@ char **sh_split_array(char *string)
 		}
 		str_ptr++;
 	}
+	/* Separators are counted as elements, so fewer may have been found */
+	array[elem] = NULL;
 
-	free(str_cpy);
+	arena_free(arena, str_cpy);
 
 	return array;
 }
 
+char **sh_split_array(char *string)
+{
+	return _split_array(NULL, string);
+}
+
+/* Unquote a string, as with sh_unquote(), allocating within arena. */
 /* TODO: Unquote strings in the middle of a string, e.g.
  * "foo'bar baz'zer" */
-char *sh_unquote(char *string)
+static char *_unquote(arena_t *arena, char *string)
 {
 	size_t len = 0;
 	char *str_ptr = string;
@@ -269,18 +289,23 @@ char *sh_unquote(char *string)
 	if(*str_ptr == '\'' || *str_ptr == '"') {
 		str_ptr++;
 		len = strlen(str_ptr);
-		return_string = malloc(len * sizeof(*string));
+		return_string = arena_alloc(arena, len * sizeof(*string));
 		return_string = strncpy(return_string, str_ptr, len - 1);
 		return_string[len - 1] = '\0';
 	} else {
 		/* Since we allocate when the string is quoted, we should do so
          * when it's not for consistency. */
-		return_string = strdup(string);
+		return_string = arena_strdup(arena, string);
 	}
 
 	return return_string;
 }
 
+char *sh_unquote(char *string)
+{
+	return _unquote(NULL, string);
+}
+
 static int _find_next_substitution(char *string, char **start, char **end)
 {
 	char *str_ptr;
@@ -304,17 +329,20 @@ static int _find_next_substitution(char *string, char **start, char **end)
 				escaped = !escaped;
 				break;
 			case '$':
-				if(!escaped && !in_literal_quote) {
+				if(!escaped && !in_literal_quote && !in_brace) {
 					variable = 1;
 					*start = str_ptr;
 				}
 				escaped = 0;
 				break;
 			case '{':
-				in_brace = variable && !escaped;
+				/* Expansions may be nested, as in ${foo:-${bar}} */
+				if(variable && !escaped && *(str_ptr - 1) == '$') {
+					in_brace++;
+				}
 				break;
 			case '}':
-				if(in_brace) {
+				if(in_brace && --in_brace == 0) {
 					*end = str_ptr;
 					found = 1;
 				}
@@ -334,7 +362,449 @@ static int _find_next_substitution(char *string, char **start, char **end)
 	return found;
 }
 
-static char *_substitute_words(table_t *table, char *string)
+/* Function: _variable_value
+Retrieve the value of a variable. An array is joined into a single string, as
+with "${array[*]}".
+
+Parameters:
+	table - A symbol table containing the values of variables, or NULL.
+	name - The name of the variable.
+
+Returns:
+	The value of the variable, which is owned by the table, or NULL if the
+	variable is unset.
+*/
+static char *_variable_value(table_t *table, char *name)
+{
+	symbol_t *symbol = NULL;
+	char **expansion = NULL;
+	char *joined;
+
+	if(table != NULL) {
+		symbol = table_lookupr_cached(table, name, &expansion);
+	}
+	if(symbol == NULL) {
+		return NULL;
+	} else if(symbol_type(symbol) == kSymbolTypeArray) {
+		/* Joining is done once per assignment of the array */
+		if(*expansion == NULL) {
+			/* The cache is owned by the table defining the symbol, which
+			may be a parent allocated within another arena, or the table of
+			a helper script shared by several threads */
+			joined = _array_cat(symbol->arena, symbol_array(symbol));
+			if(!__sync_bool_compare_and_swap(expansion, NULL, joined)) {
+				arena_free(symbol->arena, joined);
+			}
+		}
+		return *expansion;
+	}
+	return symbol_string(symbol);
+}
+
+/* Whether a string only consists of the characters of a variable name. */
+static int _is_name(const char *string)
+{
+	if(!isalpha((unsigned char)*string) && *string != '_') {
+		return 0;
+	}
+	while(isalnum((unsigned char)*string) || *string == '_') {
+		string++;
+	}
+	return *string == '\0';
+}
+
+/* Expand the variables within a word of a parameter expansion, such as the
+ * pattern of ${foo%$bar}, and remove its quotes. */
+static char *_expand_word(table_t *table, char *word, arena_t *arena)
+{
+	char *substituted;
+	char *parsed;
+
+	substituted = _substitute_words(table, word, arena);
+	parsed = _unquote(arena, substituted);
+	arena_free(arena, substituted);
+	return parsed;
+}
+
+/* Remove the backslashes escaping characters of a string, in place. */
+static void _strip_escapes(char *string)
+{
+	char *ptr;
+
+	for(ptr = string; *string != '\0'; string++) {
+		if(*string == '\\' && string[1] != '\0') {
+			string++;
+		}
+		*ptr++ = *string;
+	}
+	*ptr = '\0';
+}
+
+/* Whether a pattern has to be matched with fnmatch(), rather than compared. */
+static int _is_glob(const char *pattern)
+{
+	return strpbrk(pattern, "*?[\\") != NULL;
+}
+
+/*
+Determine whether a pattern matches the characters of a string between start
+and end.
+
+Parameters:
+	pattern - A shell pattern.
+	start - The first character to be matched.
+	end - The character following those to be matched. It is replaced with a
+		NUL character while matching, so the string must be writable.
+
+Returns:
+	True (1) if the pattern matches, otherwise false (0).
+*/
+static int _match_range(const char *pattern, char *start, char *end)
+{
+	char hold;
+	int matched;
+
+	if(!_is_glob(pattern)) {
+		return strlen(pattern) == (size_t)(end - start)
+			&& memcmp(pattern, start, end - start) == 0;
+	}
+	hold = *end;
+	*end = '\0';
+	matched = fnmatch(pattern, start, 0) == 0;
+	*end = hold;
+	return matched;
+}
+
+/*
+Remove the shortest or longest prefix or suffix of a value matching a
+pattern, as with ${var#pattern}, ${var##pattern}, ${var%pattern} and
+${var%%pattern}.
+
+Parameters:
+	value - The value to be trimmed, which is modified in place.
+	pattern - The pattern to be removed.
+	suffix - Whether a suffix (1) or prefix (0) is removed.
+	longest - Whether the longest (1) or shortest (0) match is removed.
+
+Returns:
+	The trimmed value, which is within value.
+*/
+static char *_remove_match(char *value, const char *pattern, int suffix,
+	int longest)
+{
+	size_t length = strlen(value);
+	size_t i;
+	size_t n;
+
+	for(n = 0; n <= length; n++) {
+		i = longest ? length - n : n;
+		if(suffix && _match_range(pattern, value + length - i, value + length)) {
+			value[length - i] = '\0';
+			return value;
+		} else if(!suffix && _match_range(pattern, value, value + i)) {
+			return value + i;
+		}
+	}
+	return value;
+}
+
+/* Append length characters of text to a string of size characters, which
+ * holds result_length characters, growing it as needed. */
+static char *_append(arena_t *arena, char *result, size_t *result_length,
+	size_t *size, const char *text, size_t length)
+{
+	size_t new_size = *size;
+
+	while(*result_length + length + 1 > new_size) {
+		new_size *= 2;
+	}
+	if(new_size != *size) {
+		result = arena_realloc(arena, result, *size, new_size);
+		*size = new_size;
+	}
+	memcpy(result + *result_length, text, length);
+	*result_length += length;
+	result[*result_length] = '\0';
+	return result;
+}
+
+/* Find the end of the longest match of a pattern beginning at start, and
+ * ending no later than end. Returns NULL if there is no match. */
+static char *_longest_match(const char *pattern, char *start, char *end)
+{
+	char *ptr;
+
+	for(ptr = end; ptr >= start; ptr--) {
+		if(_match_range(pattern, start, ptr)) {
+			return ptr;
+		}
+	}
+	return NULL;
+}
+
+/*
+Replace matches of a pattern within a value, as with ${var/pattern/string}.
+The longest match at each position is replaced.
+
+Parameters:
+	value - The value, which is modified while matching, but restored.
+	pattern - The pattern to be replaced. A leading '/' replaces every match,
+		while a leading '#' or '%' anchors the match at the beginning or the
+		end of the value.
+	replacement - The string replacing each match.
+	arena - The arena to allocate within, or NULL.
+
+Returns:
+	The value with matches replaced. It must be deallocated using
+	<arena_free()>.
+*/
+static char *_replace_matches(char *value, const char *pattern,
+	const char *replacement, arena_t *arena)
+{
+	size_t length = strlen(value);
+	size_t replacement_length = strlen(replacement);
+	size_t result_length = 0;
+	size_t size = length + 1;
+	char *result;
+	char *ptr = value;
+	char *end;
+	int global = 0;
+
+	result = arena_alloc(arena, size);
+	result[0] = '\0';
+	if(*pattern == '#') {
+		end = _longest_match(pattern + 1, value, value + length);
+		if(end != NULL) {
+			result = _append(arena, result, &result_length, &size, replacement,
+				replacement_length);
+			ptr = end;
+		}
+	} else if(*pattern == '%') {
+		/* The longest match begins first */
+		for(end = value; end <= value + length; end++) {
+			if(_match_range(pattern + 1, end, value + length)) {
+				result = _append(arena, result, &result_length, &size, value,
+					end - value);
+				result = _append(arena, result, &result_length, &size,
+					replacement, replacement_length);
+				return result;
+			}
+		}
+	} else {
+		if(*pattern == '/') {
+			global = 1;
+			pattern++;
+		}
+		while(*ptr != '\0' && *pattern != '\0') {
+			end = _longest_match(pattern, ptr, value + length);
+			if(end != NULL && end > ptr) {
+				result = _append(arena, result, &result_length, &size,
+					replacement, replacement_length);
+				ptr = end;
+				if(!global) {
+					break;
+				}
+			} else {
+				result = _append(arena, result, &result_length, &size, ptr, 1);
+				ptr++;
+			}
+		}
+	}
+	return _append(arena, result, &result_length, &size, ptr, strlen(ptr));
+}
+
+/* Parse the offset or length of a substring expansion, which may be negative
+ * and surrounded by blanks or parentheses, as in ${var: -3} or ${var:(-3)}. */
+static long _parse_offset(const char *string, char **end)
+{
+	long offset;
+
+	while(*string == ' ' || *string == '(') {
+		string++;
+	}
+	offset = strtol(string, end, 10);
+	while(**end == ' ' || **end == ')') {
+		(*end)++;
+	}
+	return offset;
+}
+
+/*
+Expand a parameter expansion, such as ${pkgver//./_}. The forms
+${#var}, ${var[index]}, ${var:offset:length}, ${var-word}, ${var:-word},
+${var+word}, ${var:+word}, ${var#pattern}, ${var%pattern},
+${var/pattern/string}, ${var^^} and ${var,,} are supported, including the
+variants of each. ${var=word} and ${var?word} expand as ${var-word}, without
+assigning or failing.
+
+Parameters:
+	table - A symbol table containing the values of variables, or NULL.
+	expression - The text between the braces.
+	arena - The arena to allocate within, or NULL.
+
+Returns:
+	The expanded value, which must be deallocated using <arena_free()>. An
+	unset variable expands to an empty string.
+*/
+static char *_expand_parameter(table_t *table, char *expression,
+	arena_t *arena)
+{
+	char *name = expression;
+	char *op;
+	char *value;
+	char *word;
+	char *pattern;
+	char *result;
+	char **array;
+	symbol_t *symbol;
+	char buffer[32];
+	size_t length;
+	long offset;
+	long count;
+	int null;
+
+	/* ${#var[@]} is the amount of elements, and a string has one */
+	for(op = name + 1; isalnum((unsigned char)*op) || *op == '_'; op++);
+	if(name[0] == '#' && op != name + 1 && op[0] == '['
+			&& (op[1] == '@' || op[1] == '*') && strcmp(op + 2, "]") == 0) {
+		*op = '\0';
+		symbol = table != NULL ? table_lookupr(table, name + 1) : NULL;
+		count = 0;
+		if(symbol != NULL && symbol_type(symbol) == kSymbolTypeArray) {
+			array = symbol_array(symbol);
+			for(; array != NULL && array[count] != NULL; count++);
+		} else if(symbol != NULL && symbol_string(symbol) != NULL) {
+			count = 1;
+		}
+		snprintf(buffer, sizeof(buffer), "%ld", count);
+		return arena_strdup(arena, buffer);
+	}
+
+	/* ${#var} is the length of the value, unlike ${#} */
+	if(name[0] == '#' && name[1] != '\0') {
+		value = _expand_parameter(table, name + 1, arena);
+		snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)strlen(value));
+		arena_free(arena, value);
+		return arena_strdup(arena, buffer);
+	}
+
+	for(op = name; isalnum((unsigned char)*op) || *op == '_'; op++);
+	if(*op == '[') {
+		/* Only a literal index is supported */
+		*op = '\0';
+		count = strtol(op + 1, &word, 10);
+		symbol = table != NULL ? table_lookupr(table, name) : NULL;
+		value = NULL;
+		if(word[0] == '@' || word[0] == '*') {
+			value = _variable_value(table, name);
+			word++;
+		} else if(symbol != NULL && symbol_type(symbol) == kSymbolTypeArray) {
+			array = symbol_array(symbol);
+			for(length = 0; array != NULL && array[length] != NULL; length++);
+			if(count < 0) {
+				count += length;
+			}
+			value = count >= 0 && (size_t)count < length ? array[count] : NULL;
+		} else if(count == 0) {
+			value = _variable_value(table, name);
+		}
+		op = word[0] == ']' ? word + 1 : word;
+	} else {
+		word = arena_strndup(arena, name, op - name);
+		value = _variable_value(table, word);
+		arena_free(arena, word);
+	}
+	null = value == NULL || value[0] == '\0';
+
+	switch(*op) {
+		case ':':
+			if(op[1] == '-' || op[1] == '=' || op[1] == '?') {
+				return null ? _expand_word(table, op + 2, arena)
+					: arena_strdup(arena, value);
+			} else if(op[1] == '+') {
+				return null ? arena_strdup(arena, "")
+					: _expand_word(table, op + 2, arena);
+			}
+			/* Substring */
+			value = value != NULL ? value : "";
+			length = strlen(value);
+			offset = _parse_offset(op + 1, &word);
+			if(offset < 0) {
+				offset = (long)length + offset < 0 ? (long)length : (long)length + offset;
+			}
+			if((size_t)offset > length) {
+				offset = length;
+			}
+			count = length - offset;
+			if(*word == ':') {
+				count = _parse_offset(word + 1, &word);
+				if(count < 0) {
+					count = (long)length + count - offset;
+				}
+				if(count < 0) {
+					count = 0;
+				} else if((size_t)count > length - offset) {
+					count = length - offset;
+				}
+			}
+			return arena_strndup(arena, value + offset, count);
+		case '-':
+		case '=':
+		case '?':
+			return value == NULL ? _expand_word(table, op + 1, arena)
+				: arena_strdup(arena, value);
+		case '+':
+			return value == NULL ? arena_strdup(arena, "")
+				: _expand_word(table, op + 1, arena);
+		case '#':
+		case '%':
+			result = arena_strdup(arena, value != NULL ? value : "");
+			length = op[1] == op[0];
+			pattern = _expand_word(table, op + 1 + length, arena);
+			value = _remove_match(result, pattern, *op == '%', length);
+			arena_free(arena, pattern);
+			/* The result is moved within its allocation */
+			memmove(result, value, strlen(value) + 1);
+			return result;
+		case '/':
+			/* The pattern extends to the next unescaped '/' */
+			for(word = op[1] != '\0' ? op + 2 : op + 1;
+					*word != '\0' && *word != '/'; word++) {
+				if(*word == '\\' && word[1] != '\0') {
+					word++;
+				}
+			}
+			if(*word == '/') {
+				*word++ = '\0';
+			}
+			pattern = _expand_word(table, op + 1, arena);
+			word = _expand_word(table, word, arena);
+			/* Unlike the pattern, the replacement is not matched, so it is
+			taken literally, as with ${pkgver//./\/} */
+			_strip_escapes(word);
+			value = arena_strdup(arena, value != NULL ? value : "");
+			result = _replace_matches(value, pattern, word, arena);
+			arena_free(arena, value);
+			arena_free(arena, word);
+			arena_free(arena, pattern);
+			return result;
+		case '^':
+		case ',':
+			result = arena_strdup(arena, value != NULL ? value : "");
+			for(word = result; *word != '\0'; word++) {
+				*word = *op == '^' ? toupper((unsigned char)*word)
+					: tolower((unsigned char)*word);
+				if(op[1] != op[0]) {
+					break;
+				}
+			}
+			return result;
+		default:
+			return arena_strdup(arena, value != NULL ? value : "");
+	}
+}
+
+static char *_substitute_words(table_t *table, char *string, arena_t *arena)
 {
 	size_t len = 0;
 	size_t result_len;
@@ -344,14 +814,13 @@ static char *_substitute_words(table_t *table, char *string)
 	char *word = NULL;
 	char *result = NULL;
 	char *value = NULL;
-	int free_value = 0;
-	symbol_t *symbol = NULL;
+	char *expanded = NULL;
 
 	if(!_find_next_substitution(str_ptr, &start, &end)) {
-		return strdup(string);
+		return arena_strdup(arena, string);
 	} else {
 		/* The string has to be NULL terminated for strncpy() to work */
-		result = malloc(sizeof(*result));
+		result = arena_alloc(arena, sizeof(*result));
 		result[0] = '\0';
 		result_len = 1;
 	}
@@ -359,32 +828,29 @@ static char *_substitute_words(table_t *table, char *string)
 	while(_find_next_substitution(str_ptr, &start, &end)) {
 		/* Skip word identifier marks ("${...}") */
 		if(*(start + 1) == '{' && *end == '}') {
-			word = _strcpy_partial(start + 2, start + 2, end - 1);
+			word = _strcpy_partial(arena, start + 2, start + 2, end - 1);
+		} else {
+			word = _strcpy_partial(arena, start + 1, start + 1, end);
+		}
+		expanded = NULL;
+		if(_is_name(word)) {
+			value = _variable_value(table, word);
 		} else {
-			word = _strcpy_partial(start + 1, start + 1, end);
+			value = expanded = _expand_parameter(table, word, arena);
 		}
-		symbol = table_lookupr(table, word);
-		free(word);
 
-		if(symbol != NULL) {
-			if(symbol_type(symbol) == kSymbolTypeArray) {
-				value = _array_cat(symbol_array(symbol));
-				free_value = 1;
-			} else {
-				value = symbol_string(symbol);
-			}
-			len = strlen(value);
-			result_len += start - str_ptr + len;
-			result = realloc(result, result_len * sizeof(*result));
-			/* Concatenate the string preceeding substitution */
-			result = strncat(result, str_ptr, (start - str_ptr) * sizeof(*result));
+		len = value != NULL ? strlen(value) : 0;
+		result = arena_realloc(arena, result, result_len * sizeof(*result),
+			(result_len + (start - str_ptr) + len) * sizeof(*result));
+		result_len += start - str_ptr + len;
+		/* Concatenate the string preceeding substitution, which is kept even
+		if the variable is unset */
+		result = strncat(result, str_ptr, (start - str_ptr) * sizeof(*result));
+		if(value != NULL) {
 			result = strncat(result, value, len);
-			if(free_value) {
-				free(value);
-				free_value = 0;
-				value = NULL;
-			}
 		}
+		arena_free(arena, expanded);
+		arena_free(arena, word);
 
 		str_ptr = end + 1;
 	}
@@ -392,8 +858,9 @@ static char *_substitute_words(table_t *table, char *string)
 	/* Append the remainder of the string */
 	if(strlen(str_ptr) > 0) {
 		len = strlen(str_ptr);
+		result = arena_realloc(arena, result, result_len * sizeof(*result),
+			(result_len + len) * sizeof(*result));
 		result_len += len;
-		result = realloc(result, result_len * sizeof(*result));
 		result = strncat(result, str_ptr, len);
 	}
 	
@@ -401,15 +868,21 @@ static char *_substitute_words(table_t *table, char *string)
 }
 
 char **sh_parse_array(table_t *table, char *string)
+{
+	return sh_parse_array_with_arena(table, string, NULL);
+}
+
+char **sh_parse_array_with_arena(table_t *table, char *string,
+	arena_t *arena)
 {
 	char **result;
 	char **array_ptr;
 	char *parsed;
-	result = sh_split_array(string);
-	if(result != NULL && table != NULL) {
+	result = _split_array(arena, string);
+	if(result != NULL) {
 		for(array_ptr = result; *array_ptr != NULL; array_ptr++) {
-			parsed = sh_parse_word(table, *array_ptr);
-			free(*array_ptr);
+			parsed = sh_parse_word_with_arena(table, *array_ptr, arena);
+			arena_free(arena, *array_ptr);
 			*array_ptr = parsed;
 			parsed = NULL;
 		}
@@ -418,13 +891,61 @@ char **sh_parse_array(table_t *table, char *string)
 }
 
 char *sh_parse_word(table_t *table, char *string)
+{
+	return sh_parse_word_with_arena(table, string, NULL);
+}
+
+char *sh_parse_word_with_arena(table_t *table, char *string, arena_t *arena)
 {
 	char *substituted;
 	char *parsed;
 
-	substituted = _substitute_words(table, string);
-	parsed = sh_unquote(substituted);
-	free(substituted);
+	substituted = _substitute_words(table, string, arena);
+	parsed = _unquote(arena, substituted);
+	arena_free(arena, substituted);
 	return parsed;
 }
 
+char **sh_references(const char *string)
+{
+	const char *ptr;
+	char **names;
+	size_t count = 0;
+	size_t length;
+	size_t i;
+	int quoted = 0;
+
+	names = malloc(sizeof(*names));
+	for(ptr = string; *ptr != '\0'; ptr++) {
+		if(*ptr == '\\' && ptr[1] != '\0') {
+			ptr++;
+		} else if(*ptr == '"') {
+			quoted = !quoted;
+		} else if(*ptr == '\'' && !quoted) {
+			ptr = strchr(ptr + 1, '\'');
+			if(ptr == NULL) {
+				break;
+			}
+		} else if(*ptr == '$') {
+			if(ptr[1] == '{') {
+				ptr += ptr[2] == '#' || ptr[2] == '!' ? 2 : 1;
+			}
+			length = strspn(ptr + 1, "abcdefghijklmnopqrstuvwxyz"
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+			for(i = 0; i < count; i++) {
+				if(strncmp(names[i], ptr + 1, length) == 0
+						&& names[i][length] == '\0') {
+					break;
+				}
+			}
+			/* Positional parameters are not variables */
+			if(length > 0 && i == count && !isdigit((unsigned char)ptr[1])) {
+				names = realloc(names, (count + 2) * sizeof(*names));
+				names[count++] = strndup(ptr + 1, length);
+			}
+			ptr += length;
+		}
+	}
+	names[count] = NULL;
+	return names;
+}
@@ -97,7 +97,8 @@ Example:
 	(end)
 
 Parameters:
-	table - A symbol table used for word substitution.
+	table - A symbol table used for word substitution, or NULL if all
+		variables are to be treated as unset.
 	string - The string representation of an array to be parsed.
 
 Returns:
@@ -107,10 +108,35 @@ Returns:
 */
 char **sh_parse_array(table_t *table, char *string);
 
+/* Function: sh_parse_array_with_arena
+
+Parse a shell array, as with <sh_parse_array()>, allocating the result and
+any temporary strings within an arena.
+
+Parameters:
+	table - A symbol table used for word substitution, or NULL if all
+		variables are to be treated as unset.
+	string - The string representation of an array to be parsed.
+	arena - The arena to allocate within, or NULL to behave as
+		<sh_parse_array()>.
+
+Returns:
+	A native array of strings on success, otherwise a NULL pointer. The
+	returned array, and its contained strings, must be deallocated using
+	<arena_free()>.
+*/
+char **sh_parse_array_with_arena(table_t *table, char *string,
+	arena_t *arena);
+
 /* Function: sh_parse_word
 
 Normalize a shell string and substitute variables with their values.
 
+Besides $var and ${var}, the parameter expansions of bash which do not
+execute commands are evaluated, such as ${var//pattern/string},
+${var%suffix}, ${var#prefix}, ${var:offset:length}, ${var:-default},
+${#var} and ${array[index]}. Patterns are matched with fnmatch().
+
 Example:
 	(start code)
 	table_t *table = table_new();
@@ -129,7 +155,8 @@ Example:
 	(end)
 
 Parameters:
-	table - A symbol table used for word substitution.
+	table - A symbol table used for word substitution, or NULL if all
+		variables are to be treated as unset.
 	string - The string to be parsed.
 
 Returns:
@@ -138,4 +165,42 @@ Returns:
 */
 char *sh_parse_word(table_t *table, char *string);
 
+/* Function: sh_parse_word_with_arena
+
+Parse a shell string, as with <sh_parse_word()>, allocating the result and
+any temporary strings within an arena.
+
+Parameters:
+	table - A symbol table used for word substitution, or NULL if all
+		variables are to be treated as unset.
+	string - The string to be parsed.
+	arena - The arena to allocate within, or NULL to behave as
+		<sh_parse_word()>.
+
+Returns:
+	A parsed string on success, otherwise NULL. The returned string must be
+	deallocated using <arena_free()>.
+*/
+char *sh_parse_word_with_arena(table_t *table, char *string, arena_t *arena);
+
+/* Function: sh_references
+
+Find the variables a shell string references, as $var or ${var...}. Text
+within single quotes is not expanded, and references nothing.
+
+Example:
+	(start code)
+	char **names = sh_references("${pkgname}-$pkgver.tar.gz");
+	// names: {"pkgname", "pkgver", NULL}
+	(end)
+
+Parameters:
+	string - The string as written.
+
+Returns:
+	A NULL-terminated array of the distinct names, in order of appearance. The
+	array and its strings must be deallocated by the caller.
+*/
+char **sh_references(const char *string);
+
 #endif
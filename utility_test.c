@@ -113,6 +113,16 @@ void test_split_array(void **state)
 	free(parsed[0]);
 	free(parsed[1]);
 	free(parsed);
+
+	parsed = sh_split_array("(a  b c )");
+	assert_string_equal(parsed[0], "a");
+	assert_string_equal(parsed[1], "b");
+	assert_string_equal(parsed[2], "c");
+	assert_true(parsed[3] == NULL);
+	free(parsed[0]);
+	free(parsed[1]);
+	free(parsed[2]);
+	free(parsed);
 }
 
 /* TODO: What is expected if an invalid expansion like '${foo' is attempted?
@@ -135,3 +145,108 @@ void test_sh_parse_array_simple_expanded(void **table)
 	}
 	free(parsed);
 }
+
+void test_sh_parse_word_array_reassigned(void **table)
+{
+	char *array1[] = {"foo", "bar", NULL};
+	char *array2[] = {"spam", NULL};
+	symbol_t *symbol;
+	char *parsed;
+
+	symbol = symbol_new("list");
+	symbol_set_array(symbol, array1);
+	table_insert(*table, symbol);
+	symbol_release(symbol);
+
+	parsed = sh_parse_word(*table, "$list-${list}");
+	assert_string_equal(parsed, "foo bar-foo bar");
+	free(parsed);
+
+	symbol = symbol_new("list");
+	symbol_set_array(symbol, array2);
+	table_insert(*table, symbol);
+	symbol_release(symbol);
+
+	parsed = sh_parse_word(*table, "$list");
+	assert_string_equal(parsed, "spam");
+	free(parsed);
+}
+
+void test_sh_parse_word_parameter_expansion(void **table)
+{
+	struct {
+		char *word;
+		char *expected;
+	} cases[] = {
+		{"${foo//o/0}", "f00bar"},
+		{"${foo/o/0}", "f0obar"},
+		{"${foo/#f/F}", "Foobar"},
+		{"${foo/%r/R}", "foobaR"},
+		{"${foo%bar}", "foo"},
+		{"${foo%%o*}", "f"},
+		{"${foo%o*}", "fo"},
+		{"${foo#f*o}", "obar"},
+		{"${foo##f*o}", "bar"},
+		{"${foo:0:3}", "foo"},
+		{"${foo:3}", "bar"},
+		{"${foo: -2}", "ar"},
+		{"${foo:1:-1}", "ooba"},
+		{"${#foo}", "6"},
+		{"${foo^^}", "FOOBAR"},
+		{"${foo^}", "Foobar"},
+		{"${nothing:-$foo}", "foobar"},
+		{"${foo:+set}", "set"},
+		{"${nothing+set}", ""},
+		{"${ham// /_}", "eggs_and_ham"},
+		{"${foo//o/\\/}", "f//bar"},
+		{"${_eggs/chick/$foo}", "foobarens"},
+		{"pre-$nothing-post", "pre--post"},
+		{NULL, NULL},
+	};
+	char *parsed;
+	int i;
+
+	for(i = 0; cases[i].word != NULL; i++) {
+		parsed = sh_parse_word(*table, cases[i].word);
+		assert_string_equal(parsed, cases[i].expected);
+		free(parsed);
+	}
+}
+
+void test_sh_parse_word_array_index(void **table)
+{
+	char *array[] = {"foo", "bar", NULL};
+	symbol_t *symbol;
+	char *parsed;
+
+	symbol = symbol_new("list");
+	symbol_set_array(symbol, array);
+	table_insert(*table, symbol);
+	symbol_release(symbol);
+
+	parsed = sh_parse_word(*table, "${list[1]}-${list[0]}-${list[@]}");
+	assert_string_equal(parsed, "bar-foo-foo bar");
+	free(parsed);
+
+	/* The amount of elements, not the length of their joined values */
+	parsed = sh_parse_word(*table, "${#list[@]}-${#list[*]}-${#foo[@]}");
+	assert_string_equal(parsed, "2-2-1");
+	free(parsed);
+}
+
+void test_sh_references(void **state)
+{
+	char **names;
+	size_t i;
+
+	names = sh_references("\"${pkgname}-$pkgver.tar.gz\"::$_url/${#pkgver}"
+		"'$quoted'\\$escaped$1");
+	assert_string_equal(names[0], "pkgname");
+	assert_string_equal(names[1], "pkgver");
+	assert_string_equal(names[2], "_url");
+	assert_true(names[3] == NULL);
+	for(i = 0; names[i] != NULL; i++) {
+		free(names[i]);
+	}
+	free(names);
+}
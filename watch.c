@@ -0,0 +1,731 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+#include "pkgbuild_private.h"
+
+/* Events of watched directories which may change the index */
+#define kWatchMask (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM \
+	| IN_MOVED_TO | IN_ONLYDIR)
+/* Milliseconds without events after which a burst of events is complete */
+#define kWatchSettle 100
+/* Milliseconds after which a burst of events is handled regardless */
+#define kWatchSettleLimit 2000
+
+/* Enumeration: _change_kind_t
+Kinds of pending changes, in the order they are applied.
+
+kChangeRemove - A directory was removed or moved away.
+kChangeScan - A directory was created or moved into the tree.
+kChangeFile - The PKGBUILD or .SRCINFO of a directory changed.
+*/
+typedef enum {
+	kChangeRemove,
+	kChangeScan,
+	kChangeFile,
+} _change_kind_t;
+
+/* Type: _change_t
+A change reported by inotify, not yet applied to the index.
+
+kind - The kind of change.
+directory - The path of the directory changed.
+*/
+typedef struct {
+	_change_kind_t kind;
+	char *directory;
+} _change_t;
+
+/* Type: _entry_t
+A PKGBUILD of the index, shared by the trees it has not changed in.
+
+refcount - The amount of trees holding the entry, which may be released
+	from any thread.
+path - The path of the PKGBUILD.
+pkgbuild - The pkgbuild parsed from it.
+*/
+typedef struct {
+	unsigned int refcount;
+	char *path;
+	pkgbuild_t *pkgbuild;
+} _entry_t;
+
+/* Type: _directory_t
+A watched directory.
+
+wd - The watch descriptor.
+path - The path of the directory.
+*/
+typedef struct {
+	int wd;
+	char *path;
+} _directory_t;
+
+struct _pkgbuild_tree_t {
+	unsigned int refcount;
+	/* The entries, in order of their paths */
+	_entry_t **entries;
+	size_t count;
+};
+
+struct _pkgbuild_watch_t {
+	unsigned int refcount;
+	char *root;
+	int options;
+	pkgbuild_pool_t *pool;
+	/* The inotify instance, and the directories it watches */
+	int fd;
+	_directory_t *directories;
+	size_t directory_count;
+	size_t directory_size;
+	/* Changes read since the index was last updated */
+	_change_t *changes;
+	size_t change_count;
+	size_t change_size;
+	/* Guards tree, which is replaced with each update */
+	pthread_mutex_t mutex;
+	pkgbuild_tree_t *tree;
+};
+
+/* Milliseconds elapsed since an arbitrary point. */
+static long long _now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Join a directory and the name of one of its files. */
+static char *_join(const char *directory, const char *name)
+{
+	size_t length = strlen(directory);
+	char *path;
+
+	path = malloc(length + strlen(name) + 2);
+	memcpy(path, directory, length);
+	path[length] = '/';
+	strcpy(path + length + 1, name);
+	return path;
+}
+
+/* Determine whether a path lies within a directory, or is the directory. */
+static int _within(const char *path, const char *directory)
+{
+	size_t length = strlen(directory);
+
+	return strncmp(path, directory, length) == 0
+		&& (path[length] == '\0' || path[length] == '/');
+}
+
+static _entry_t *_entry_new(char *path, pkgbuild_t *pkgbuild)
+{
+	_entry_t *entry;
+
+	entry = malloc(sizeof(*entry));
+	entry->refcount = 1;
+	entry->path = path;
+	entry->pkgbuild = pkgbuild;
+	return entry;
+}
+
+static _entry_t *_entry_retain(_entry_t *entry)
+{
+	__sync_add_and_fetch(&entry->refcount, 1);
+	return entry;
+}
+
+static void _entry_release(_entry_t *entry)
+{
+	if(entry != NULL && __sync_sub_and_fetch(&entry->refcount, 1) == 0) {
+		pkgbuild_release(entry->pkgbuild);
+		free(entry->path);
+		free(entry);
+	}
+}
+
+static int _entry_compare(const void *a, const void *b)
+{
+	return strcmp((*(_entry_t **)a)->path, (*(_entry_t **)b)->path);
+}
+
+static int _change_compare(const void *a, const void *b)
+{
+	const _change_t *x = a;
+	const _change_t *y = b;
+
+	if(x->kind != y->kind) {
+		return x->kind < y->kind ? -1 : 1;
+	}
+	return strcmp(x->directory, y->directory);
+}
+
+/* Append an entry to an array of entries. */
+static void _entries_push(_entry_t ***entries, size_t *count, size_t *size,
+	_entry_t *entry)
+{
+	if(*count == *size) {
+		*size = *size == 0 ? 64 : *size * 2;
+		*entries = realloc(*entries, *size * sizeof(**entries));
+	}
+	(*entries)[(*count)++] = entry;
+}
+
+/* Append a path to an array of paths. */
+static void _paths_push(char ***paths, size_t *count, size_t *size,
+	char *path)
+{
+	if(*count == *size) {
+		*size = *size == 0 ? 64 : *size * 2;
+		*paths = realloc(*paths, *size * sizeof(**paths));
+	}
+	(*paths)[(*count)++] = path;
+}
+
+static int _path_compare(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+static void _watch_add_change(pkgbuild_watch_t *watch, _change_kind_t kind,
+	char *directory)
+{
+	if(watch->change_count == watch->change_size) {
+		watch->change_size = watch->change_size == 0 ? 16
+			: watch->change_size * 2;
+		watch->changes = realloc(watch->changes,
+			watch->change_size * sizeof(*watch->changes));
+	}
+	watch->changes[watch->change_count].kind = kind;
+	watch->changes[watch->change_count].directory = directory;
+	watch->change_count++;
+}
+
+/* Find a watched directory by its watch descriptor. */
+static _directory_t *_watch_directory(pkgbuild_watch_t *watch, int wd)
+{
+	size_t i;
+
+	for(i = 0; i < watch->directory_count; i++) {
+		if(watch->directories[i].wd == wd) {
+			return &watch->directories[i];
+		}
+	}
+	return NULL;
+}
+
+/* Watch a directory, or update its path if it is watched already. */
+static void _watch_add_directory(pkgbuild_watch_t *watch, const char *path)
+{
+	_directory_t *directory;
+	int wd;
+
+	wd = inotify_add_watch(watch->fd, path, kWatchMask);
+	if(wd < 0) {
+		return;
+	}
+	directory = _watch_directory(watch, wd);
+	if(directory == NULL) {
+		if(watch->directory_count == watch->directory_size) {
+			watch->directory_size = watch->directory_size == 0 ? 64
+				: watch->directory_size * 2;
+			watch->directories = realloc(watch->directories,
+				watch->directory_size * sizeof(*watch->directories));
+		}
+		directory = &watch->directories[watch->directory_count++];
+		directory->wd = wd;
+	} else {
+		free(directory->path);
+	}
+	directory->path = strdup(path);
+}
+
+/* Stop watching a directory and its subdirectories. */
+static void _watch_remove_directory(pkgbuild_watch_t *watch,
+	const char *path)
+{
+	size_t i = 0;
+
+	while(i < watch->directory_count) {
+		if(_within(watch->directories[i].path, path)) {
+			inotify_rm_watch(watch->fd, watch->directories[i].wd);
+			free(watch->directories[i].path);
+			watch->directories[i] = watch->directories[--watch->directory_count];
+		} else {
+			i++;
+		}
+	}
+}
+
+/*
+Watch a directory and its subdirectories, and collect the paths of the
+PKGBUILDs found. Hidden directories, such as .git, and symbolic links are not
+followed.
+
+Parameters:
+	watch - The watch.
+	path - The path of the directory.
+	paths - The array the paths of the PKGBUILDs are appended to.
+	count - The amount of paths in the array.
+	size - The capacity of the array.
+*/
+static void _watch_scan(pkgbuild_watch_t *watch, const char *path,
+	char ***paths, size_t *count, size_t *size)
+{
+	struct dirent *dirent;
+	struct stat st;
+	char *child;
+	DIR *dir;
+
+	/* The watch is added first, so that no PKGBUILD created during the scan
+	is missed */
+	_watch_add_directory(watch, path);
+	dir = opendir(path);
+	if(dir == NULL) {
+		return;
+	}
+	while((dirent = readdir(dir)) != NULL) {
+		if(strcmp(dirent->d_name, "PKGBUILD") == 0) {
+			_paths_push(paths, count, size, _join(path, dirent->d_name));
+			continue;
+		} else if(dirent->d_name[0] == '.') {
+			continue;
+		}
+		child = _join(path, dirent->d_name);
+		if(dirent->d_type == DT_DIR || (dirent->d_type == DT_UNKNOWN
+				&& lstat(child, &st) == 0 && S_ISDIR(st.st_mode))) {
+			_watch_scan(watch, child, paths, count, size);
+		}
+		free(child);
+	}
+	closedir(dir);
+}
+
+/*
+Read the pending inotify events, and record the changes they describe.
+
+Returns:
+	The amount of events read, or -1 on error.
+*/
+static int _watch_read(pkgbuild_watch_t *watch)
+{
+	char buffer[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	_directory_t *directory;
+	ssize_t length;
+	char *offset;
+	int events = 0;
+
+	while((length = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+		for(offset = buffer; offset < buffer + length;
+				offset += sizeof(*event) + event->len) {
+			event = (const struct inotify_event *)offset;
+			events++;
+			if(event->mask & IN_Q_OVERFLOW) {
+				/* Events were lost, so the whole tree is scanned again */
+				_watch_add_change(watch, kChangeRemove, strdup(watch->root));
+				_watch_add_change(watch, kChangeScan, strdup(watch->root));
+				continue;
+			}
+			directory = _watch_directory(watch, event->wd);
+			if(directory == NULL) {
+				continue;
+			}
+			if(event->mask & IN_IGNORED) {
+				free(directory->path);
+				*directory = watch->directories[--watch->directory_count];
+			} else if(event->len == 0) {
+				continue;
+			} else if(event->mask & IN_ISDIR) {
+				if(event->name[0] == '.') {
+					continue;
+				}
+				_watch_add_change(watch,
+					event->mask & (IN_CREATE | IN_MOVED_TO) ? kChangeScan
+						: kChangeRemove,
+					_join(directory->path, event->name));
+			} else if(strcmp(event->name, "PKGBUILD") == 0
+					|| strcmp(event->name, ".SRCINFO") == 0) {
+				_watch_add_change(watch, kChangeFile,
+					strdup(directory->path));
+			}
+		}
+	}
+	if(length < 0 && errno != EAGAIN && errno != EINTR) {
+		return -1;
+	}
+	return events;
+}
+
+/*
+Wait for events, until none have arrived for a while.
+
+Parameters:
+	watch - The watch.
+	timeout - The amount of milliseconds to wait for the first event, or -1
+		to wait indefinitely.
+
+Returns:
+	The amount of events read, or -1 on error.
+*/
+static int _watch_wait(pkgbuild_watch_t *watch, int timeout)
+{
+	struct pollfd pfd;
+	long long start = 0;
+	int events = 0;
+	int result;
+
+	pfd.fd = watch->fd;
+	pfd.events = POLLIN;
+	for(;;) {
+		result = poll(&pfd, 1, timeout);
+		if(result < 0 && errno != EINTR) {
+			return -1;
+		} else if(result == 0) {
+			return events;
+		} else if(result > 0) {
+			result = _watch_read(watch);
+			if(result < 0) {
+				return -1;
+			}
+			events += result;
+		}
+		/* A burst, such as a checkout, is handled once it has settled */
+		if(events > 0) {
+			if(start == 0) {
+				start = _now();
+			} else if(_now() - start >= kWatchSettleLimit) {
+				return events;
+			}
+			timeout = kWatchSettle;
+		}
+	}
+}
+
+/*
+Apply the pending changes to the index, and publish the resulting tree.
+
+Returns:
+	The amount of PKGBUILDs added, changed or removed.
+*/
+static int _watch_apply(pkgbuild_watch_t *watch,
+	pkgbuild_watch_callback_t callback, void *data)
+{
+	pkgbuild_tree_t *previous = watch->tree;
+	pkgbuild_tree_t *tree;
+	pkgbuild_t **pkgbuilds;
+	_entry_t **updates;
+	_entry_t *entry;
+	char **paths = NULL;
+	size_t path_count = 0;
+	size_t path_size = 0;
+	size_t update_count = 0;
+	size_t size;
+	size_t i, j;
+	int *removed;
+	int changed = 0;
+	int order;
+
+	qsort(watch->changes, watch->change_count, sizeof(*watch->changes),
+		_change_compare);
+	removed = calloc(previous->count + 1, sizeof(*removed));
+	for(i = 0; i < watch->change_count; i++) {
+		if(i > 0 && _change_compare(&watch->changes[i],
+				&watch->changes[i - 1]) == 0) {
+			continue;
+		}
+		switch(watch->changes[i].kind) {
+			case kChangeRemove:
+				_watch_remove_directory(watch, watch->changes[i].directory);
+				for(j = 0; j < previous->count; j++) {
+					if(_within(previous->entries[j]->path,
+							watch->changes[i].directory)) {
+						removed[j] = 1;
+					}
+				}
+				break;
+			case kChangeScan:
+				_watch_scan(watch, watch->changes[i].directory, &paths,
+					&path_count, &path_size);
+				break;
+			case kChangeFile:
+				_paths_push(&paths, &path_count, &path_size,
+					_join(watch->changes[i].directory, "PKGBUILD"));
+				break;
+		}
+	}
+
+	/* The PKGBUILDs found or changed are parsed as a batch, each once */
+	qsort(paths, path_count, sizeof(*paths), _path_compare);
+	for(i = 0, j = 0; i < path_count; i++) {
+		if(j > 0 && strcmp(paths[i], paths[j - 1]) == 0) {
+			free(paths[i]);
+		} else {
+			paths[j++] = paths[i];
+		}
+	}
+	path_count = j;
+	pkgbuilds = calloc(path_count + 1, sizeof(*pkgbuilds));
+	pkgbuild_parse_files((const char **)paths, path_count, watch->options,
+		watch->pool, 0, pkgbuilds);
+	/* A PKGBUILD which could not be read replaces its entry by none */
+	updates = malloc((path_count + 1) * sizeof(*updates));
+	for(i = 0; i < path_count; i++) {
+		updates[update_count++] = _entry_new(paths[i], pkgbuilds[i]);
+	}
+	free(pkgbuilds);
+
+	/* Merge the updates into the previous entries */
+	tree = malloc(sizeof(*tree));
+	tree->refcount = 1;
+	tree->entries = NULL;
+	tree->count = 0;
+	size = 0;
+	for(i = 0, j = 0; i < previous->count || j < update_count;) {
+		if(i == previous->count) {
+			order = 1;
+		} else if(j == update_count) {
+			order = -1;
+		} else {
+			order = strcmp(previous->entries[i]->path, updates[j]->path);
+		}
+		if(order < 0) {
+			if(removed[i]) {
+				changed++;
+				if(callback != NULL) {
+					callback(previous->entries[i]->path, NULL, data);
+				}
+			} else {
+				_entries_push(&tree->entries, &tree->count, &size,
+					_entry_retain(previous->entries[i]));
+			}
+			i++;
+			continue;
+		}
+		entry = updates[j++];
+		if(order == 0) {
+			i++;
+		}
+		if(entry->pkgbuild == NULL) {
+			if(order == 0) {
+				changed++;
+				if(callback != NULL) {
+					callback(entry->path, NULL, data);
+				}
+			}
+			_entry_release(entry);
+		} else {
+			changed++;
+			if(callback != NULL) {
+				callback(entry->path, entry->pkgbuild, data);
+			}
+			_entries_push(&tree->entries, &tree->count, &size, entry);
+		}
+	}
+
+	pthread_mutex_lock(&watch->mutex);
+	watch->tree = tree;
+	pthread_mutex_unlock(&watch->mutex);
+	pkgbuild_tree_release(previous);
+
+	for(i = 0; i < watch->change_count; i++) {
+		free(watch->changes[i].directory);
+	}
+	watch->change_count = 0;
+	free(updates);
+	free(paths);
+	free(removed);
+	return changed;
+}
+
+pkgbuild_watch_t *pkgbuild_watch_new(const char *root, int options,
+	pkgbuild_pool_t *pool)
+{
+	pkgbuild_watch_t *watch;
+	struct stat st;
+	size_t length;
+
+	if(root == NULL || stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		return NULL;
+	}
+	watch = malloc(sizeof(*watch));
+	memset(watch, 0, sizeof(*watch));
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(watch->fd < 0) {
+		free(watch);
+		return NULL;
+	}
+	watch->root = strdup(root);
+	length = strlen(watch->root);
+	while(length > 1 && watch->root[length - 1] == '/') {
+		watch->root[--length] = '\0';
+	}
+	/* Readers may share the pkgbuilds, which must not be loaded on
+	access */
+	watch->options = options & ~kPkgbuildOptionLazy;
+	watch->pool = pkgbuild_pool_retain(pool);
+	pthread_mutex_init(&watch->mutex, NULL);
+	watch->tree = calloc(1, sizeof(*watch->tree));
+	watch->tree->refcount = 1;
+
+	_watch_add_change(watch, kChangeScan, strdup(watch->root));
+	_watch_apply(watch, NULL, NULL);
+	return pkgbuild_watch_retain(watch);
+}
+
+int pkgbuild_watch_fd(pkgbuild_watch_t *watch)
+{
+	return watch != NULL ? watch->fd : -1;
+}
+
+int pkgbuild_watch_update(pkgbuild_watch_t *watch, int timeout,
+	pkgbuild_watch_callback_t callback, void *data)
+{
+	if(watch == NULL || _watch_wait(watch, timeout) < 0) {
+		return -1;
+	}
+	if(watch->change_count == 0) {
+		return 0;
+	}
+	return _watch_apply(watch, callback, data);
+}
+
+pkgbuild_tree_t *pkgbuild_watch_tree(pkgbuild_watch_t *watch)
+{
+	pkgbuild_tree_t *tree;
+
+	if(watch == NULL) {
+		return NULL;
+	}
+	pthread_mutex_lock(&watch->mutex);
+	tree = pkgbuild_tree_retain(watch->tree);
+	pthread_mutex_unlock(&watch->mutex);
+	return tree;
+}
+
+pkgbuild_watch_t *pkgbuild_watch_retain(pkgbuild_watch_t *watch)
+{
+	if(watch != NULL) {
+		watch->refcount++;
+	}
+	return watch;
+}
+
+static void _watch_free(pkgbuild_watch_t *watch)
+{
+	size_t i;
+
+	close(watch->fd);
+	for(i = 0; i < watch->directory_count; i++) {
+		free(watch->directories[i].path);
+	}
+	free(watch->directories);
+	for(i = 0; i < watch->change_count; i++) {
+		free(watch->changes[i].directory);
+	}
+	free(watch->changes);
+	pkgbuild_tree_release(watch->tree);
+	pthread_mutex_destroy(&watch->mutex);
+	pkgbuild_pool_release(watch->pool);
+	free(watch->root);
+	free(watch);
+}
+
+void pkgbuild_watch_release(pkgbuild_watch_t *watch)
+{
+	if(watch != NULL) {
+		watch->refcount--;
+		if(watch->refcount == 0) {
+			_watch_free(watch);
+		}
+	}
+}
+
+size_t pkgbuild_tree_count(pkgbuild_tree_t *tree)
+{
+	return tree != NULL ? tree->count : 0;
+}
+
+const char *pkgbuild_tree_path(pkgbuild_tree_t *tree, size_t index)
+{
+	if(tree == NULL || index >= tree->count) {
+		return NULL;
+	}
+	return tree->entries[index]->path;
+}
+
+pkgbuild_t *pkgbuild_tree_pkgbuild(pkgbuild_tree_t *tree, size_t index)
+{
+	if(tree == NULL || index >= tree->count) {
+		return NULL;
+	}
+	return tree->entries[index]->pkgbuild;
+}
+
+pkgbuild_t *pkgbuild_tree_find(pkgbuild_tree_t *tree, const char *path)
+{
+	_entry_t key;
+	_entry_t *pkey = &key;
+	_entry_t **entry;
+
+	if(tree == NULL || path == NULL) {
+		return NULL;
+	}
+	key.path = (char *)path;
+	entry = bsearch(&pkey, tree->entries, tree->count, sizeof(*tree->entries),
+		_entry_compare);
+	return entry != NULL ? (*entry)->pkgbuild : NULL;
+}
+
+pkgbuild_tree_t *pkgbuild_tree_retain(pkgbuild_tree_t *tree)
+{
+	if(tree != NULL) {
+		__sync_add_and_fetch(&tree->refcount, 1);
+	}
+	return tree;
+}
+
+void pkgbuild_tree_release(pkgbuild_tree_t *tree)
+{
+	size_t i;
+
+	if(tree != NULL && __sync_sub_and_fetch(&tree->refcount, 1) == 0) {
+		for(i = 0; i < tree->count; i++) {
+			_entry_release(tree->entries[i]);
+		}
+		free(tree->entries);
+		free(tree);
+	}
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2009 Sebastian Nowicki <sebnow@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* File: watch_test.c
+Unit tests for keeping an index of PKGBUILDs fresh.
+
+See Also:
+	<pkgparse.h>
+*/
+
+#include "cmockery.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pkgparse.h"
+
+/* Write the PKGBUILD of a package into the directory of a test, creating the
+directory of the package. */
+static void _write_pkgbuild(char *directory, const char *package,
+	const char *version)
+{
+	char path[128];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", directory, package);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/%s/PKGBUILD", directory, package);
+	fp = fopen(path, "w");
+	assert_true(fp != NULL);
+	fprintf(fp, "pkgname=%s\npkgver=%s\npkgrel=1\n", package, version);
+	fclose(fp);
+}
+
+/* Remove the directory of a package written by a test. */
+static void _remove_package(char *directory, const char *package)
+{
+	char path[128];
+
+	snprintf(path, sizeof(path), "%s/%s/PKGBUILD", directory, package);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/%s", directory, package);
+	rmdir(path);
+}
+
+/* Count the PKGBUILDs changed by an update. */
+static void _count_change(const char *path, pkgbuild_t *pkgbuild, void *data)
+{
+	(*(int *)data)++;
+}
+
+void test_watch_tree(void **directory)
+{
+	pkgbuild_watch_t *watch;
+	pkgbuild_tree_t *previous;
+	pkgbuild_tree_t *tree;
+	char path[128];
+	int changed = 0;
+	int attempts;
+
+	_write_pkgbuild(*directory, "foo", "1.0");
+	_write_pkgbuild(*directory, "bar", "2.0");
+	_write_pkgbuild(*directory, "baz", "3.0");
+	_write_pkgbuild(*directory, ".hidden", "4.0");
+
+	watch = pkgbuild_watch_new(*directory, kPkgbuildOptionNone, NULL);
+	assert_true(watch != NULL);
+	previous = pkgbuild_watch_tree(watch);
+	assert_int_equal(pkgbuild_tree_count(previous), 3);
+	assert_string_equal(pkgbuild_names(pkgbuild_tree_pkgbuild(previous, 0))[0],
+		"bar");
+	snprintf(path, sizeof(path), "%s/foo/PKGBUILD", (char *)*directory);
+	assert_string_equal(pkgbuild_tree_path(previous, 2), path);
+	assert_string_equal(pkgbuild_version(pkgbuild_tree_find(previous, path)),
+		"1.0");
+	assert_int_equal(pkgbuild_watch_update(watch, 0, NULL, NULL), 0);
+
+	/* A burst of changes is handled by an update */
+	_write_pkgbuild(*directory, "foo", "1.1");
+	_remove_package(*directory, "bar");
+	_write_pkgbuild(*directory, "qux", "5.0");
+	for(attempts = 0; changed < 3 && attempts < 10; attempts++) {
+		assert_true(pkgbuild_watch_update(watch, 1000, _count_change,
+			&changed) >= 0);
+	}
+	assert_int_equal(changed, 3);
+
+	tree = pkgbuild_watch_tree(watch);
+	assert_int_equal(pkgbuild_tree_count(tree), 3);
+	assert_string_equal(pkgbuild_version(pkgbuild_tree_find(tree, path)),
+		"1.1");
+	assert_string_equal(pkgbuild_names(pkgbuild_tree_pkgbuild(tree, 2))[0],
+		"qux");
+	/* Unchanged pkgbuilds are shared, and earlier trees remain intact */
+	assert_true(pkgbuild_tree_pkgbuild(tree, 0)
+		== pkgbuild_tree_pkgbuild(previous, 1));
+	assert_string_equal(pkgbuild_version(pkgbuild_tree_find(previous, path)),
+		"1.0");
+	pkgbuild_tree_release(previous);
+	pkgbuild_watch_release(watch);
+	assert_int_equal(pkgbuild_tree_count(tree), 3);
+	pkgbuild_tree_release(tree);
+
+	_remove_package(*directory, "foo");
+	_remove_package(*directory, "baz");
+	_remove_package(*directory, "qux");
+	_remove_package(*directory, ".hidden");
+}